@@ -17,9 +17,11 @@ void michaelcc::assembly::assembler::assemble_block(const linear::translation_un
     }
 
     if (emit_label) {
-        m_output << "block" << block_id << ":";
+        this->emit_label("block" + std::to_string(block_id));
     }
+    m_current_unit = std::make_optional(&unit);
     begin_block_preamble(block);
+    m_current_unit = std::nullopt;
 
     std::unordered_set<size_t> begun_function_calls;
     for (auto it = block.instructions().begin(); it != block.instructions().end(); it++) {
@@ -95,10 +97,73 @@ void michaelcc::assembly::assembler::assemble_function(const linear::translation
     }
 }
 
-void michaelcc::assembly::assembler::assemble(const linear::translation_unit& unit, const linear::allocators::frame_allocator& frame_allocator) {
+void michaelcc::assembly::assembler::assemble_static_sections(const linear::translation_unit& unit) {
+    auto sections = linear::static_storage::pool_static_sections(unit.static_sections, unit.platform_info);
+
+    if (!sections.data.empty()) {
+        begin_data_section();
+
+        size_t offset = 0;
+        for (const auto& data : sections.data) {
+            size_t alignment = std::max<size_t>(data.alignment, 1);
+            size_t padding = (alignment - (offset % alignment)) % alignment;
+            if (padding > 0) {
+                emit_zero_fill(padding);
+                offset += padding;
+            }
+
+            // labels are sorted by offset, so they can be placed while walking the words
+            auto label = data.labels.begin();
+            size_t position = 0;
+            for (const auto& word : data.data_words) {
+                for (; label != data.labels.end() && label->offset <= position; label++) {
+                    emit_label(label->label);
+                }
+                emit_data_word(word);
+                // a word narrower than the addressable unit still occupies a whole unit
+                position += std::max<size_t>(unit.platform_info.bits_to_au(word.size), 1);
+            }
+            for (; label != data.labels.end(); label++) {
+                emit_label(label->label);
+            }
+            offset += data.size;
+        }
+    }
+
+    if (!sections.bss_labels.empty()) {
+        begin_bss_section();
+
+        size_t position = 0;
+        for (const auto& label : sections.bss_labels) {
+            if (label.offset > position) {
+                emit_zero_fill(label.offset - position);
+                position = label.offset;
+            }
+            emit_label(label.label);
+        }
+        if (sections.bss_size > position) {
+            emit_zero_fill(sections.bss_size - position);
+        }
+    }
+}
+
+void michaelcc::assembly::assembler::assemble_functions(const linear::translation_unit& unit, const linear::allocators::frame_allocator& frame_allocator) {
     m_current_frame_allocator = std::make_optional(&frame_allocator);
     for (size_t i = 0; i < unit.function_definitions.size(); i++) {
+        std::streampos begin = m_output.tellp();
         assemble_function(unit, i);
+        m_function_text_ranges.push_back(function_text_range{ .name = unit.function_definitions[i]->name(), .begin = begin, .end = m_output.tellp() });
     }
     m_current_frame_allocator = std::nullopt;
+}
+
+void michaelcc::assembly::assembler::assemble_static_data(const linear::translation_unit& unit) {
+    m_current_unit = std::make_optional(&unit);
+    assemble_static_sections(unit);
+    m_current_unit = std::nullopt;
+}
+
+void michaelcc::assembly::assembler::assemble(const linear::translation_unit& unit, const linear::allocators::frame_allocator& frame_allocator) {
+    assemble_functions(unit, frame_allocator);
+    assemble_static_data(unit);
 }
\ No newline at end of file
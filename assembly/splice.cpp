@@ -0,0 +1,117 @@
+#include "assembly/splice.hpp"
+#include "linear/static.hpp"
+#include <iterator>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+    const std::regex local_label_pattern(R"(\b(block|sym)(\d+)\b)");
+    const std::regex string_label_pattern(R"(@string_(\d+)\b)");
+
+    // strings are hex encoded so the header stays line oriented whatever the literal contains
+    std::string to_hex(const std::string& str) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string result;
+        result.reserve(str.size() * 2);
+        for (unsigned char c : str) {
+            result.push_back(digits[c >> 4]);
+            result.push_back(digits[c & 0xf]);
+        }
+        return result;
+    }
+
+    std::string from_hex(const std::string& hex) {
+        if (hex.size() % 2 != 0) {
+            throw std::runtime_error("Malformed relocatable assembly string");
+        }
+        std::string result;
+        result.reserve(hex.size() / 2);
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            result.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        }
+        return result;
+    }
+
+    template<typename Fn>
+    std::string replace_matches(const std::string& text, const std::regex& pattern, Fn&& replacement) {
+        std::string result;
+        result.reserve(text.size());
+
+        auto last = text.cbegin();
+        for (std::sregex_iterator it(text.begin(), text.end(), pattern), end; it != end; it++) {
+            result.append(last, text.cbegin() + it->position());
+            result += replacement(*it);
+            last = text.cbegin() + it->position() + it->length();
+        }
+        result.append(last, text.cend());
+        return result;
+    }
+}
+
+std::string michaelcc::assembly::make_relocatable(const std::string& function_name, const std::string& text, const std::vector<std::string>& strings) {
+    std::string renamed = replace_matches(text, local_label_pattern, [&](const std::smatch& match) {
+        return function_name + "__" + match[1].str() + match[2].str();
+    });
+
+    // string references are renumbered densely in order of first use
+    std::vector<size_t> referenced;
+    std::unordered_map<size_t, size_t> local_indices;
+    std::string body = replace_matches(renamed, string_label_pattern, [&](const std::smatch& match) {
+        size_t index = std::stoull(match[1].str());
+        if (index >= strings.size()) {
+            throw std::runtime_error("Assembly refers to an unknown string literal");
+        }
+        auto it = local_indices.find(index);
+        if (it == local_indices.end()) {
+            it = local_indices.insert({ index, referenced.size() }).first;
+            referenced.push_back(index);
+        }
+        return linear::static_storage::string_label(it->second);
+    });
+
+    std::ostringstream result;
+    result << "strings " << referenced.size() << "\n";
+    for (size_t index : referenced) {
+        result << to_hex(strings[index]) << "\n";
+    }
+    result << body;
+    return result.str();
+}
+
+std::optional<std::string> michaelcc::assembly::relocate(const std::string& relocatable, const std::vector<std::string>& strings) {
+    std::istringstream input(relocatable);
+    std::string keyword;
+    size_t count;
+    if (!(input >> keyword >> count) || keyword != "strings") {
+        throw std::runtime_error("Malformed relocatable assembly header");
+    }
+    input.ignore(1);
+
+    std::unordered_map<std::string, size_t> unit_indices;
+    for (size_t i = 0; i < strings.size(); i++) {
+        unit_indices.insert({ strings[i], i });
+    }
+
+    std::vector<size_t> indices;
+    indices.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        std::string hex;
+        std::getline(input, hex);
+        auto it = unit_indices.find(from_hex(hex));
+        if (it == unit_indices.end()) {
+            return std::nullopt;
+        }
+        indices.push_back(it->second);
+    }
+
+    std::string body(std::istreambuf_iterator<char>(input), {});
+    return replace_matches(body, string_label_pattern, [&](const std::smatch& match) {
+        size_t local_index = std::stoull(match[1].str());
+        if (local_index >= indices.size()) {
+            throw std::runtime_error("Malformed relocatable assembly string reference");
+        }
+        return linear::static_storage::string_label(indices[local_index]);
+    });
+}
@@ -0,0 +1,278 @@
+#include "compile_cache.hpp"
+#include "hashing.hpp"
+#include "linear/serialize.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+using namespace michaelcc;
+
+namespace {
+    const char* artifact_extension(compile_cache::artifact kind) {
+        switch (kind) {
+            case compile_cache::artifact::ASSEMBLY: return ".s";
+            case compile_cache::artifact::LINEAR_IR: return ".mcir";
+            case compile_cache::artifact::FUNCTION_ASSEMBLY: return ".fs";
+            default: throw std::runtime_error("Invalid cache artifact");
+        }
+    }
+
+    // the stats file is a list of "name value" lines
+    std::map<std::string, uint64_t> read_counters(const std::filesystem::path& path) {
+        std::map<std::string, uint64_t> counters;
+
+        std::ifstream input(path);
+        std::string name;
+        uint64_t value;
+        while (input >> name >> value) {
+            counters[name] = value;
+        }
+        return counters;
+    }
+
+    std::filesystem::path temporary_path(const std::filesystem::path& path) {
+        auto temporary = path;
+        // the thread id keeps requests served concurrently by one compile server apart
+        temporary += ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())
+            + "-" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        return temporary;
+    }
+
+    // writes go to a temporary file first so concurrent compilers never observe a partial entry
+    void atomic_copy(const std::filesystem::path& source, const std::filesystem::path& destination) {
+        auto temporary = temporary_path(destination);
+        std::filesystem::copy_file(source, temporary, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::rename(temporary, destination);
+    }
+}
+
+compile_cache::compile_cache(std::filesystem::path directory, uintmax_t max_size_bytes)
+    : m_directory(std::move(directory)), m_max_size_bytes(max_size_bytes) {
+    std::filesystem::create_directories(m_directory);
+}
+
+std::filesystem::path compile_cache::entry_path(const std::string& key, artifact kind) const {
+    return m_directory / (key + artifact_extension(kind));
+}
+
+const std::string& compile_cache::compiler_identity() {
+    // the size and modification time of the executable change with every rebuild, hashing its contents would cost
+    // more than most compilations. where the executable cannot be found, the build time of this file stands in
+    static const std::string identity = [] {
+        std::error_code error;
+        auto executable = std::filesystem::read_symlink("/proc/self/exe", error);
+        if (!error) {
+            auto size = std::filesystem::file_size(executable, error);
+            auto modified = std::filesystem::last_write_time(executable, error);
+            if (!error) {
+                return executable.string() + ":" + std::to_string(size) + ":" + std::to_string(modified.time_since_epoch().count());
+            }
+        }
+        return std::string(__DATE__ " " __TIME__);
+    }();
+    return identity;
+}
+
+std::string compile_cache::compute_key(const std::vector<token>& tokens, const std::vector<std::string>& options) {
+    content_hasher hasher;
+    hasher.integer(format_version);
+    hasher.string(compiler_identity());
+    hasher.integer(linear::serialization::format_version);
+
+    hasher.integer(options.size());
+    for (const auto& option : options) {
+        hasher.string(option);
+    }
+
+    // columns are left out, they only affect diagnostics and failed compilations are never cached
+    hasher.integer(tokens.size());
+    for (const auto& tok : tokens) {
+        hasher.integer(tok.type());
+        switch (tok.type()) {
+            case MICHAELCC_TOKEN_FLOAT32_LITERAL: {
+                float value = tok.float32();
+                hasher.bytes(&value, sizeof(value));
+                break;
+            }
+            case MICHAELCC_TOKEN_FLOAT64_LITERAL: {
+                double value = tok.float64();
+                hasher.bytes(&value, sizeof(value));
+                break;
+            }
+            case MICHAELCC_TOKEN_LINE_DIRECTIVE: {
+                auto location = tok.location();
+                hasher.integer(location.row());
+                hasher.string(location.filename().string());
+                break;
+            }
+            case MICHAELCC_TOKEN_INTEGER_LITERAL:
+            case MICHAELCC_TOKEN_CHAR_LITERAL:
+                hasher.integer(tok.integer());
+                break;
+            case MICHAELCC_TOKEN_IDENTIFIER:
+            case MICHAELCC_TOKEN_STRING_LITERAL:
+            case MICHAELCC_PREPROCESSOR_STRINGIFY_IDENTIFIER:
+                hasher.string(tok.string());
+                break;
+            default:
+                break;
+        }
+    }
+    return hasher.hex();
+}
+
+std::string compile_cache::compute_function_key(const std::string& fingerprint, const std::vector<std::string>& options) {
+    content_hasher hasher;
+    hasher.integer(format_version);
+    hasher.string(compiler_identity());
+    hasher.string(fingerprint);
+
+    hasher.integer(options.size());
+    for (const auto& option : options) {
+        hasher.string(option);
+    }
+    return hasher.hex();
+}
+
+void compile_cache::record_lookup(const std::string& counter) const {
+    // the read-modify-write would lose counts when a compile server handles several clients at once
+    static std::mutex stats_mutex;
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    auto counters = read_counters(stats_path());
+    counters[counter]++;
+
+    auto temporary = temporary_path(stats_path());
+    {
+        std::ofstream output(temporary, std::ios::trunc);
+        for (const auto& [name, value] : counters) {
+            output << name << " " << value << "\n";
+        }
+    }
+    std::filesystem::rename(temporary, stats_path());
+}
+
+bool compile_cache::fetch(const std::string& key, const std::vector<std::pair<artifact, std::filesystem::path>>& artifacts) const {
+    for (const auto& [kind, destination] : artifacts) {
+        if (!std::filesystem::exists(entry_path(key, kind))) {
+            record_lookup("misses");
+            return false;
+        }
+    }
+
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& [kind, destination] : artifacts) {
+        auto path = entry_path(key, kind);
+        std::filesystem::copy_file(path, destination, std::filesystem::copy_options::overwrite_existing);
+
+        // the modification time doubles as the last use time for eviction
+        std::filesystem::last_write_time(path, now);
+    }
+    record_lookup("hits");
+    return true;
+}
+
+void compile_cache::store(const std::string& key, artifact kind, const std::filesystem::path& source) const {
+    atomic_copy(source, entry_path(key, kind));
+}
+
+std::optional<std::string> compile_cache::fetch_function(const std::string& key) const {
+    auto path = entry_path(key, artifact::FUNCTION_ASSEMBLY);
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        record_lookup("function_misses");
+        return std::nullopt;
+    }
+
+    std::stringstream text;
+    text << input.rdbuf();
+    input.close();
+
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now());
+    record_lookup("function_hits");
+    return text.str();
+}
+
+void compile_cache::store_function(const std::string& key, const std::string& text) const {
+    auto path = entry_path(key, artifact::FUNCTION_ASSEMBLY);
+    auto temporary = temporary_path(path);
+    {
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        output << text;
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+void compile_cache::evict() const {
+    if (m_max_size_bytes == 0) {
+        return;
+    }
+
+    struct entry {
+        std::vector<std::filesystem::path> files;
+        uintmax_t size_bytes = 0;
+        std::filesystem::file_time_type last_used = std::filesystem::file_time_type::min();
+    };
+
+    // all artifacts of a key are evicted together, a partial entry would only ever miss
+    std::map<std::string, entry> entries;
+    uintmax_t total_size = 0;
+    for (const auto& file : std::filesystem::directory_iterator(m_directory)) {
+        if (!file.is_regular_file() || file.path() == stats_path()) {
+            continue;
+        }
+        auto& current = entries[file.path().stem().string()];
+        current.files.push_back(file.path());
+        current.size_bytes += file.file_size();
+        current.last_used = std::max(current.last_used, file.last_write_time());
+        total_size += file.file_size();
+    }
+
+    if (total_size <= m_max_size_bytes) {
+        return;
+    }
+
+    std::vector<const entry*> by_age;
+    by_age.reserve(entries.size());
+    for (const auto& [key, current] : entries) {
+        by_age.push_back(&current);
+    }
+    std::sort(by_age.begin(), by_age.end(), [](const entry* a, const entry* b) { return a->last_used < b->last_used; });
+
+    for (const entry* current : by_age) {
+        if (total_size <= m_max_size_bytes) {
+            break;
+        }
+        for (const auto& file : current->files) {
+            std::error_code error;
+            std::filesystem::remove(file, error);
+        }
+        total_size -= current->size_bytes;
+    }
+}
+
+compile_cache::statistics compile_cache::stats() const {
+    statistics result;
+    auto counters = read_counters(stats_path());
+    result.hits = counters["hits"];
+    result.misses = counters["misses"];
+    result.function_hits = counters["function_hits"];
+    result.function_misses = counters["function_misses"];
+
+    std::unordered_set<std::string> keys;
+    for (const auto& file : std::filesystem::directory_iterator(m_directory)) {
+        if (!file.is_regular_file() || file.path() == stats_path()) {
+            continue;
+        }
+        keys.insert(file.path().stem().string());
+        result.size_bytes += file.file_size();
+    }
+    result.entry_count = keys.size();
+    return result;
+}
@@ -0,0 +1,134 @@
+#ifndef MICHAELCC_ANALYSIS_MANAGER_HPP
+#define MICHAELCC_ANALYSIS_MANAGER_HPP
+
+#include <memory>
+#include <optional>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace michaelcc {
+    // the set of analyses whose cached results remain valid after a pass ran
+    class preserved_analyses {
+    private:
+        bool m_preserve_all;
+        std::unordered_set<std::type_index> m_preserved;
+
+        preserved_analyses(bool preserve_all) : m_preserve_all(preserve_all) {}
+
+    public:
+        static preserved_analyses all() { return preserved_analyses(true); }
+        static preserved_analyses none() { return preserved_analyses(false); }
+
+        template<typename Analysis>
+        preserved_analyses& preserve() {
+            m_preserved.insert(std::type_index(typeid(Analysis)));
+            return *this;
+        }
+
+        bool is_preserved(std::type_index analysis) const {
+            return m_preserve_all || m_preserved.contains(analysis);
+        }
+
+        template<typename Analysis>
+        bool is_preserved() const {
+            return is_preserved(std::type_index(typeid(Analysis)));
+        }
+
+        // keeps only what both sides preserve, used when several passes ran between queries
+        void intersect(const preserved_analyses& other) {
+            if (other.m_preserve_all) {
+                return;
+            }
+            if (m_preserve_all) {
+                *this = other;
+                return;
+            }
+            std::erase_if(m_preserved, [&](const std::type_index& analysis) { return !other.m_preserved.contains(analysis); });
+        }
+    };
+
+    // caches analysis results per function (or any other Key) and computes them on demand.
+    // an analysis is a type providing a `result` type and
+    //     static result run(Unit& unit, const Key& key, analysis_manager<Key, Unit>& manager);
+    // the manager is passed along so analyses can request the analyses they depend on.
+    template<typename Key, typename Unit>
+    class analysis_manager {
+    private:
+        struct result_base {
+            virtual ~result_base() = default;
+        };
+
+        template<typename Result>
+        struct result_holder final : public result_base {
+            Result value;
+            result_holder(Result&& value) : value(std::move(value)) {}
+        };
+
+        Unit& m_unit;
+        std::unordered_map<Key, std::unordered_map<std::type_index, std::unique_ptr<result_base>>> m_results;
+
+        size_t m_hits = 0;
+        size_t m_misses = 0;
+
+    public:
+        analysis_manager(Unit& unit) : m_unit(unit) {}
+
+        Unit& unit() noexcept { return m_unit; }
+
+        template<typename Analysis>
+        typename Analysis::result& get(const Key& key) {
+            auto& results = m_results[key];
+            auto it = results.find(std::type_index(typeid(Analysis)));
+            if (it != results.end()) {
+                m_hits++;
+                return static_cast<result_holder<typename Analysis::result>*>(it->second.get())->value;
+            }
+
+            m_misses++;
+            auto holder = std::make_unique<result_holder<typename Analysis::result>>(Analysis::run(m_unit, key, *this));
+            auto& value = holder->value;
+
+            // running the analysis may have requested others, so look the slot up again
+            m_results[key].insert_or_assign(std::type_index(typeid(Analysis)), std::move(holder));
+            return value;
+        }
+
+        template<typename Analysis>
+        std::optional<typename Analysis::result*> get_cached(const Key& key) {
+            auto results = m_results.find(key);
+            if (results == m_results.end()) {
+                return std::nullopt;
+            }
+            auto it = results->second.find(std::type_index(typeid(Analysis)));
+            if (it == results->second.end()) {
+                return std::nullopt;
+            }
+            return &static_cast<result_holder<typename Analysis::result>*>(it->second.get())->value;
+        }
+
+        void invalidate(const Key& key, const preserved_analyses& preserved) {
+            auto results = m_results.find(key);
+            if (results == m_results.end()) {
+                return;
+            }
+            std::erase_if(results->second, [&](const auto& entry) { return !preserved.is_preserved(entry.first); });
+        }
+
+        void invalidate_all(const preserved_analyses& preserved) {
+            for (auto& [key, results] : m_results) {
+                std::erase_if(results, [&](const auto& entry) { return !preserved.is_preserved(entry.first); });
+            }
+        }
+
+        // drops every result for a key, e.g. when the function itself is removed
+        void forget(const Key& key) {
+            m_results.erase(key);
+        }
+
+        size_t hits() const noexcept { return m_hits; }
+        size_t misses() const noexcept { return m_misses; }
+    };
+}
+
+#endif
@@ -4,11 +4,22 @@
 #include "linear/ir.hpp"
 #include "linear/registers.hpp"
 #include "linear/allocators/frame_allocator.hpp"
+#include "linear/static.hpp"
+#include <ostream>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace michaelcc::assembly {
     class assembler: public linear::instruction_dispatcher<void> {
+    public:
+        // where a function's text starts and ends in the output stream
+        struct function_text_range {
+            std::string name;
+            std::streampos begin;
+            std::streampos end;
+        };
+
     private:
         bool m_skip_next_instruction;
         std::optional<const linear::instruction*> m_next_instruction;
@@ -16,6 +27,7 @@ namespace michaelcc::assembly {
 
         std::unordered_set<size_t> m_assembled_blocks;
         std::vector<size_t> prioritized_blocks_to_assemble;
+        std::vector<function_text_range> m_function_text_ranges;
     protected:
 
         std::ostream& m_output;
@@ -39,6 +51,7 @@ namespace michaelcc::assembly {
     private:
         void assemble_block(const linear::translation_unit& unit, size_t block_id, bool emit_label);
         void assemble_function(const linear::translation_unit& unit, size_t function_id);
+        void assemble_static_sections(const linear::translation_unit& unit);
 
     protected:
         void begin_new_line() {
@@ -103,6 +116,12 @@ namespace michaelcc::assembly {
         // use this to potentially save caller-saved registers for a function call
         virtual void begin_function_call(const linear::function_call& instruction) = 0;
 
+        // static data is emitted after all functions, initialized data first then the bss reservation
+        virtual void begin_data_section() = 0;
+        virtual void begin_bss_section() = 0;
+        virtual void emit_data_word(const linear::static_storage::data_word& word) = 0;
+        virtual void emit_zero_fill(size_t size) = 0;
+
         void dispatch(const linear::a_instruction& instruction) override = 0;
         void dispatch(const linear::a2_instruction& instruction) override = 0;
         void dispatch(const linear::u_instruction& instruction) override = 0;
@@ -116,6 +135,8 @@ namespace michaelcc::assembly {
         void dispatch(const linear::valloca_instruction& instruction) override = 0;
         void dispatch(const linear::branch& instruction) override = 0;
         void dispatch(const linear::branch_condition& instruction) override = 0;
+        void dispatch(const linear::jump_table& instruction) override = 0;
+        void dispatch(const linear::select_instruction& instruction) override = 0;
         void dispatch(const linear::push_function_argument& instruction) override = 0;
         void dispatch(const linear::function_call& instruction) override = 0;
         void dispatch(const linear::function_return& instruction) override = 0;
@@ -123,6 +144,14 @@ namespace michaelcc::assembly {
 
     public:
         void assemble(const linear::translation_unit& unit, const linear::allocators::frame_allocator& frame_allocator);
+
+        // the two halves of assemble, for units that are assembled a few functions at a time.
+        // the static data has to come last, after every function has been assembled.
+        void assemble_functions(const linear::translation_unit& unit, const linear::allocators::frame_allocator& frame_allocator);
+        void assemble_static_data(const linear::translation_unit& unit);
+
+        // only meaningful when the output stream supports tellp
+        const std::vector<function_text_range>& function_text_ranges() const noexcept { return m_function_text_ranges; }
     };
 }
 
@@ -0,0 +1,22 @@
+#ifndef MICHAELCC_ASSEMBLY_SPLICE_HPP
+#define MICHAELCC_ASSEMBLY_SPLICE_HPP
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace michaelcc::assembly {
+    // assembled functions refer to block labels, generated symbols and string literal labels that are
+    // numbered per translation unit. to reuse a function's text in a later compilation those references
+    // have to be made independent of the unit they came from.
+
+    // renames the function's block and symbol labels into a namespace derived from its name, and records
+    // the contents of every string literal it refers to in place of the literal's index
+    std::string make_relocatable(const std::string& function_name, const std::string& text, const std::vector<std::string>& strings);
+
+    // turns relocatable text back into assembly for a unit with the given string literals.
+    // returns nullopt when the unit lacks a string the function refers to.
+    std::optional<std::string> relocate(const std::string& relocatable, const std::vector<std::string>& strings);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef MICHAELCC_BOUNDED_QUEUE_HPP
+#define MICHAELCC_BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace michaelcc {
+    // a bounded buffer handing values from a producer thread to a consumer thread, used between the stages of the compiler.
+    // the producer blocks while it is full and the consumer while it is empty, so at most capacity values are in flight.
+    template<typename T>
+    class bounded_queue {
+    private:
+        std::vector<std::optional<T>> m_slots;
+        size_t m_head = 0;
+        size_t m_count = 0;
+
+        // set by the producer once it is done, and by the consumer when it gives up early
+        bool m_closed = false;
+        bool m_cancelled = false;
+        std::exception_ptr m_error;
+
+        std::mutex m_mutex;
+        std::condition_variable m_not_empty;
+        std::condition_variable m_not_full;
+
+    public:
+        explicit bounded_queue(size_t capacity) : m_slots(capacity) {
+            if (capacity == 0) {
+                throw std::invalid_argument("A bounded queue needs room for at least one value.");
+            }
+        }
+
+        // blocks until there is room. returns false if the consumer cancelled, the producer should then stop.
+        bool push(T&& value) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_full.wait(lock, [this]() { return m_count < m_slots.size() || m_cancelled; });
+            if (m_cancelled) {
+                return false;
+            }
+
+            m_slots[(m_head + m_count) % m_slots.size()].emplace(std::move(value));
+            m_count++;
+            lock.unlock();
+            m_not_empty.notify_one();
+            return true;
+        }
+
+        // marks the end of the stream, after the remaining values the consumer gets nullopt
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_closed = true;
+            }
+            m_not_empty.notify_one();
+        }
+
+        // ends the stream with an error, which the consumer rethrows once it reaches it
+        void fail(std::exception_ptr error) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_error = error;
+                m_closed = true;
+            }
+            m_not_empty.notify_one();
+        }
+
+        // unblocks a producer waiting for room, used when the consumer stops before the end of the stream
+        void cancel() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_cancelled = true;
+            }
+            m_not_full.notify_one();
+        }
+
+        // the next value, or nullopt once the producer closed the queue
+        std::optional<T> pop() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_not_empty.wait(lock, [this]() { return m_count > 0 || m_closed; });
+            if (m_count == 0) {
+                if (m_error) {
+                    std::rethrow_exception(m_error);
+                }
+                return std::nullopt;
+            }
+
+            std::optional<T> value(std::move(m_slots[m_head]));
+            m_slots[m_head].reset();
+            m_head = (m_head + 1) % m_slots.size();
+            m_count--;
+            lock.unlock();
+            m_not_full.notify_one();
+            return value;
+        }
+    };
+}
+
+#endif
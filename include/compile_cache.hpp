@@ -0,0 +1,78 @@
+#ifndef MICHAELCC_COMPILE_CACHE_HPP
+#define MICHAELCC_COMPILE_CACHE_HPP
+
+#include "syntax/tokens.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace michaelcc {
+    // an on-disk, content-addressed store of compiler outputs.
+    // entries are keyed on a hash of the preprocessed token stream plus everything else that
+    // influences code generation, so a hit can skip parsing, lowering and optimization entirely.
+    class compile_cache {
+    public:
+        // bump whenever the layout of entries changes. changes to code generation are covered by compiler_identity
+        static constexpr uint64_t format_version = 1;
+
+        enum artifact {
+            ASSEMBLY,
+            LINEAR_IR,
+            FUNCTION_ASSEMBLY
+        };
+
+        struct statistics {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t function_hits = 0;
+            uint64_t function_misses = 0;
+            uintmax_t size_bytes = 0;
+            size_t entry_count = 0;
+
+            double hit_rate() const noexcept {
+                uint64_t lookups = hits + misses;
+                return lookups == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(lookups);
+            }
+        };
+
+    private:
+        std::filesystem::path m_directory;
+        uintmax_t m_max_size_bytes;
+
+        std::filesystem::path entry_path(const std::string& key, artifact kind) const;
+        std::filesystem::path stats_path() const { return m_directory / "stats"; }
+
+        void record_lookup(const std::string& counter) const;
+
+        // identifies the compiler binary, so entries written by any other build of it are never used
+        static const std::string& compiler_identity();
+
+    public:
+        // a max size of 0 disables eviction
+        compile_cache(std::filesystem::path directory, uintmax_t max_size_bytes);
+
+        // options holds every setting that affects the output, e.g. the platform name and requested stages
+        static std::string compute_key(const std::vector<token>& tokens, const std::vector<std::string>& options);
+
+        // copies every requested artifact to its destination. it is a hit only if all of them are
+        // cached, on a miss nothing is written.
+        bool fetch(const std::string& key, const std::vector<std::pair<artifact, std::filesystem::path>>& artifacts) const;
+
+        void store(const std::string& key, artifact kind, const std::filesystem::path& source) const;
+
+        // per-function entries hold relocatable assembly, see assembly/splice.hpp.
+        // they are looked up when the whole-file entry misses.
+        static std::string compute_function_key(const std::string& fingerprint, const std::vector<std::string>& options);
+        std::optional<std::string> fetch_function(const std::string& key) const;
+        void store_function(const std::string& key, const std::string& text) const;
+
+        // drops least recently used entries until the cache fits in its size limit
+        void evict() const;
+
+        statistics stats() const;
+    };
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MICHAELCC_HASHING_HPP
+#define MICHAELCC_HASHING_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace michaelcc {
+    // a 128 bit content hash for cache keys: two independent 64 bit lanes, fnv-1a and a multiply-rotate mix.
+    // not cryptographic, only meant to make accidental collisions between compiler inputs negligible.
+    class content_hasher {
+    private:
+        uint64_t m_fnv = 0xcbf29ce484222325ull;
+        uint64_t m_mix = 0x9e3779b97f4a7c15ull;
+
+    public:
+        void bytes(const void* data, size_t size) {
+            auto* begin = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) {
+                m_fnv = (m_fnv ^ begin[i]) * 0x100000001b3ull;
+                m_mix = (m_mix ^ begin[i]) * 0xff51afd7ed558ccdull;
+                m_mix = (m_mix << 29) | (m_mix >> 35);
+            }
+        }
+
+        void integer(uint64_t value) { bytes(&value, sizeof(value)); }
+
+        // strings are length prefixed so that concatenations cannot collide
+        void string(const std::string& value) {
+            integer(value.size());
+            bytes(value.data(), value.size());
+        }
+
+        std::string hex() const {
+            static constexpr char digits[] = "0123456789abcdef";
+            std::string result;
+            for (uint64_t lane : { m_fnv, m_mix }) {
+                for (int shift = 60; shift >= 0; shift -= 4) {
+                    result.push_back(digits[(lane >> shift) & 0xf]);
+                }
+            }
+            return result;
+        }
+    };
+}
+
+#endif
@@ -55,6 +55,11 @@ namespace michaelcc::isa::lc2200 {
         void begin_function_preamble(const linear::function_definition& definition) override;
         void begin_function_call(const linear::function_call& instruction) override;
 
+        void begin_data_section() override;
+        void begin_bss_section() override;
+        void emit_data_word(const linear::static_storage::data_word& word) override;
+        void emit_zero_fill(size_t size) override;
+
         void emit_multiplication(linear::virtual_register destination, linear::virtual_register operand_a, linear::virtual_register operand_b);
         void emit_compare_equal(linear::virtual_register destination, linear::virtual_register operand_a, linear::virtual_register operand_b);
         void emit_compare_not_equal(linear::virtual_register destination, linear::virtual_register operand_a, linear::virtual_register operand_b);
@@ -75,6 +80,8 @@ namespace michaelcc::isa::lc2200 {
         void dispatch(const linear::valloca_instruction& instruction) override;
         void dispatch(const linear::branch& instruction) override;
         void dispatch(const linear::branch_condition& instruction) override;
+        void dispatch(const linear::jump_table& instruction) override;
+        void dispatch(const linear::select_instruction& instruction) override;
         void dispatch(const linear::push_function_argument& instruction) override;
         void dispatch(const linear::function_call& instruction) override;
         void dispatch(const linear::function_return& instruction) override;
@@ -17,11 +17,20 @@ namespace michaelcc::linear::allocators {
         std::unordered_map<size_t, std::pair<size_t, linear::virtual_register>> function_to_frame_pointer;
 
         void allocate_block(linear::function_definition* function, size_t block_id);
+
+        // grows the frame by a slot, returning its offset below the frame pointer
+        size_t reserve(size_t entry_block_id, size_t size_bytes, size_t alignment);
     public:
         frame_allocator(linear::translation_unit& translation_unit);
 
         void allocate();
 
+        // a slot for a spilled vreg, addressed directly off the frame pointer so no alloca has to be lowered
+        std::pair<linear::virtual_register, int64_t> allocate_slot(size_t entry_block_id, size_t size_bytes, size_t alignment) {
+            size_t offset = reserve(entry_block_id, size_bytes, alignment);
+            return { function_to_frame_pointer.at(entry_block_id).second, -static_cast<int64_t>(offset) };
+        }
+
         size_t get_reserved_stack_space(size_t function_id) const {
             return function_to_frame_pointer.at(function_id).first;
         }
@@ -0,0 +1,45 @@
+#ifndef MICHAELCC_LINEAR_ALLOCATORS_INSTRUCTION_SCHEDULER_HPP
+#define MICHAELCC_LINEAR_ALLOCATORS_INSTRUCTION_SCHEDULER_HPP
+
+#include "linear/ir.hpp"
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace michaelcc::linear::allocators {
+    // reorders the instructions of each block to keep fewer vregs live at once. the dependency DAG of a block is
+    // scheduled bottom up, each step taking the ready instruction that adds the fewest vregs to the live set, and a
+    // block only takes the new order if it lowers the most vregs live at any point. side effects and parameter loads
+    // keep their order, loads stay between the same stores and calls, and nothing moves above an argument push of a
+    // call that is still to come. runs after phi removal, before register allocation
+    class instruction_scheduler {
+    private:
+        // one per instruction of the block, at the same index
+        struct node {
+            // nodes defining an operand, and nodes that have to come first for any other reason
+            std::vector<size_t> data_predecessors;
+            std::vector<size_t> order_predecessors;
+            size_t successor_count = 0;
+
+            // registers needed to evaluate the node and everything it reads
+            size_t label = 0;
+        };
+
+        translation_unit& m_translation_unit;
+
+        // the vregs live out of each block of the function
+        std::unordered_map<size_t, std::unordered_set<virtual_register>> compute_live_out(const function_definition& function) const;
+
+        // returns the new order of the instructions, or nothing if the block has to stay as it is
+        std::optional<std::vector<size_t>> schedule_block(const std::vector<std::unique_ptr<instruction>>& instructions, const std::unordered_set<virtual_register>& live_out) const;
+
+    public:
+        instruction_scheduler(translation_unit& translation_unit) : m_translation_unit(translation_unit) {}
+
+        void schedule();
+    };
+}
+
+#endif
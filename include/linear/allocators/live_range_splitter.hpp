@@ -0,0 +1,67 @@
+#ifndef MICHAELCC_LINEAR_ALLOCATORS_LIVE_RANGE_SPLITTER_HPP
+#define MICHAELCC_LINEAR_ALLOCATORS_LIVE_RANGE_SPLITTER_HPP
+
+#include "linear/ir.hpp"
+#include "linear/registers.hpp"
+#include "linear/allocators/frame_allocator.hpp"
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace michaelcc::linear::allocators {
+    // splits the live ranges of vregs that only pass through a loop with calls in it. once the callee saved
+    // registers run out, the allocator puts the rest of the vregs live across the calls in caller saved registers,
+    // which are saved and restored around every call on every iteration. a vreg the loop never touches is instead
+    // stored once on each edge into the loop and reloaded on the edges out of it where it is still live.
+    // runs after phi removal, before register allocation
+    class live_range_splitter {
+    public:
+        // every iteration of a loop is assumed to run this many times per entry, up to max_loop_depth loops deep
+        static constexpr size_t loop_weight = 8;
+        static constexpr size_t max_loop_depth = 6;
+
+    private:
+        struct loop_info {
+            size_t header_block_id;
+            std::unordered_set<size_t> body;
+        };
+
+        struct call_info {
+            size_t block_id;
+            std::unordered_set<virtual_register> live_across;
+        };
+
+        translation_unit& m_translation_unit;
+        frame_allocator& m_frame_allocator;
+
+        std::unordered_map<size_t, std::unordered_set<virtual_register>> m_live_in;
+        std::unordered_map<size_t, std::unordered_set<virtual_register>> m_referenced;
+        std::vector<call_info> m_calls;
+
+        // an edge can leave one loop and enter another, the reloads for the first go before the stores for the second
+        struct edge_code {
+            std::vector<std::unique_ptr<instruction>> reloads;
+            std::vector<std::unique_ptr<instruction>> stores;
+        };
+
+        // keyed by (predecessor, successor)
+        std::map<std::pair<size_t, size_t>, edge_code> m_edge_code;
+
+        void compute_liveness(const function_definition& function);
+        std::vector<loop_info> find_loops(const function_definition& function) const;
+        void split_function(const function_definition& function);
+
+        // returns whether any edge had to be split
+        bool place_edge_instructions();
+
+    public:
+        live_range_splitter(translation_unit& translation_unit, frame_allocator& frame_allocator)
+            : m_translation_unit(translation_unit), m_frame_allocator(frame_allocator) {}
+
+        void split();
+    };
+}
+
+#endif
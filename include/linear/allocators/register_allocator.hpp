@@ -40,6 +40,28 @@ namespace michaelcc::linear::allocators {
         std::unordered_map<size_t, block_liveliness> m_block_liveliness;
         std::unordered_map<size_t, block_info> m_block_info;
 
+        // liveness and the graph are only built from scratch once, spill rounds patch them
+        bool m_built = false;
+
+        // colors fixed before allocation started, they are never taken away
+        std::unordered_set<virtual_register> m_precolored;
+
+        // colors dropped before the next round: the spill temporaries of the last spill and the vregs they interfere
+        // with. every other vreg keeps its color since none of its neighbours changed
+        std::unordered_set<virtual_register> m_recolor;
+
+        // the vregs live across each call by function call id, before the ones given callee saved registers are
+        // filtered out, so the filter can be redone with new colors
+        std::unordered_map<size_t, std::vector<virtual_register>> m_live_across_calls;
+
+        // vregs the spiller would recompute rather than reload, the cheapest to spill
+        std::unordered_set<virtual_register> m_rematerializable;
+
+        // reloads and recomputations made by the spiller, their ranges cannot get any shorter so they are never
+        // preferred as spill candidates
+        std::unordered_set<virtual_register> m_spill_temporaries;
+        void find_rematerializable();
+
         std::unordered_set<virtual_register> compute_defined_vregs(size_t block_id);
         std::unordered_set<virtual_register> compute_used_vregs(size_t block_id, const std::unordered_set<virtual_register>& defined_vregs);
 
@@ -91,6 +113,11 @@ namespace michaelcc::linear::allocators {
 
         // returns a list of spilled vregs
         std::vector<virtual_register> allocate();
+
+        // brings liveness and the graph up to date after the spiller rewrote changed_blocks. spilled vregs are only
+        // live between their definition and its store, and the reload temporaries never leave their block, so only
+        // the changed blocks need to be walked again
+        void update_after_spill(const std::vector<virtual_register>& spilled_vregs, const std::unordered_set<size_t>& changed_blocks);
     };
 }
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "linear/ir.hpp"
 #include "linear/registers.hpp"
+#include "linear/allocators/frame_allocator.hpp"
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -10,13 +11,23 @@
 namespace michaelcc::linear::allocators {
     class register_spiller {
     private:
+        struct spill_slot {
+            virtual_register frame_pointer;
+            int64_t offset;
+        };
+
         translation_unit& m_translation_unit;
+        frame_allocator& m_frame_allocator;
         std::unordered_set<michaelcc::linear::virtual_register> m_spilled_vregs;    
 
-        std::unordered_map<michaelcc::linear::virtual_register, std::vector<michaelcc::linear::virtual_register>> m_spill_address;
+        std::unordered_map<michaelcc::linear::virtual_register, spill_slot> m_spill_slots;
+
+        // spilled vregs recomputed at each use instead of going through memory, mapped to their definition
+        std::unordered_map<michaelcc::linear::virtual_register, std::unique_ptr<instruction>> m_rematerialized;
 
         virtual_register get_value(virtual_register vreg, std::vector<std::unique_ptr<instruction>>& new_instructions) const;
 
+        bool mentions_spilled_vreg(const basic_block& block) const;
         void spill_block(size_t block_id);
 
         class replace_operands_transform : public instruction_transformer {
@@ -93,8 +104,8 @@ namespace michaelcc::linear::allocators {
 
             std::unique_ptr<instruction> dispatch(const store_memory& node) override {
                 return std::make_unique<store_memory>(
-                    node.value(),
                     m_spiller.get_value(node.destination_address(), m_new_instructions),
+                    m_spiller.get_value(node.value(), m_new_instructions),
                     node.offset());
             }
 
@@ -106,16 +117,39 @@ namespace michaelcc::linear::allocators {
                     node.is_loop());
             }
 
+            std::unique_ptr<instruction> dispatch(const jump_table& node) override {
+                return std::make_unique<jump_table>(
+                    m_spiller.get_value(node.index(), m_new_instructions),
+                    std::vector<size_t>(node.target_block_ids()));
+            }
+
+            std::unique_ptr<instruction> dispatch(const select_instruction& node) override {
+                return std::make_unique<select_instruction>(
+                    node.destination(),
+                    m_spiller.get_value(node.condition(), m_new_instructions),
+                    m_spiller.get_value(node.if_true(), m_new_instructions),
+                    m_spiller.get_value(node.if_false(), m_new_instructions));
+            }
+
             std::unique_ptr<instruction> handle_default(const instruction& node) override {
                 return nullptr;
             }
         };
 
     public:
-        register_spiller(translation_unit& translation_unit, const std::vector<virtual_register>& spilled_vregs) 
-            : m_translation_unit(translation_unit), m_spilled_vregs(spilled_vregs.begin(), spilled_vregs.end()) {}
+        register_spiller(translation_unit& translation_unit, frame_allocator& frame_allocator, const std::vector<virtual_register>& spilled_vregs) 
+            : m_translation_unit(translation_unit), m_frame_allocator(frame_allocator), m_spilled_vregs(spilled_vregs.begin(), spilled_vregs.end()) {}
+
+        // stores every definition of a spilled vreg to its slot and reloads it before every use, or recomputes it
+        // before every use when it is rematerializable. returns the blocks that were rewritten
+        std::unordered_set<size_t> spill();
+
+        // whether the definition is cheaper to recompute than to reload: constants, label addresses and offsets from
+        // the frame pointer. only meaningful for vregs with a single definition
+        static bool is_rematerializable(const instruction& definition, const translation_unit& translation_unit);
 
-        void spill();
+        // a copy of a rematerializable definition writing to another vreg
+        static std::unique_ptr<instruction> rematerialize(const instruction& definition, virtual_register destination);
     };
 }
 
@@ -2,9 +2,15 @@
 #define MICHAELCC_LINEAR_ALLOCATORS_REMOVE_PHI_HPP
 
 #include "linear/ir.hpp"
+#include <memory>
+#include <vector>
 
 namespace michaelcc::linear::allocators {
     void remove_phi_nodes(linear::translation_unit& translation_unit);
+
+    // puts a new block holding the instructions on the edge, so they only run when the edge is taken.
+    // returns the new block's id, the dominator info has to be recomputed afterwards
+    size_t split_edge(linear::translation_unit& translation_unit, size_t pred_block_id, size_t block_id, std::vector<std::unique_ptr<linear::instruction>>&& instructions);
 }
 
 #endif
\ No newline at end of file
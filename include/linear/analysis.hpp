@@ -0,0 +1,30 @@
+#ifndef MICHAELCC_LINEAR_ANALYSIS_HPP
+#define MICHAELCC_LINEAR_ANALYSIS_HPP
+
+#include "analysis_manager.hpp"
+#include "linear/ir.hpp"
+#include "linear/dominators.hpp"
+
+namespace michaelcc::linear {
+    // keyed by index into translation_unit::function_definitions
+    using analysis_manager = michaelcc::analysis_manager<size_t, translation_unit>;
+
+    // dominator info is stored on the basic blocks, the cached result only records that it is current
+    struct dominator_analysis {
+        using result = bool;
+
+        static result run(translation_unit& unit, size_t function_id, analysis_manager&) {
+            compute_dominators(unit, function_id);
+            return true;
+        }
+    };
+
+    // brings the dominator info of every function up to date, recomputing only the functions that lost it
+    inline void request_dominators(analysis_manager& analyses) {
+        for (size_t i = 0; i < analyses.unit().function_definitions.size(); i++) {
+            analyses.get<dominator_analysis>(i);
+        }
+    }
+}
+
+#endif
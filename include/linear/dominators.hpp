@@ -4,9 +4,13 @@
 #include "ir.hpp"
 
 namespace michaelcc::linear {
+    // sets the idom, dominator tree numbering and dominance frontier of every reachable block,
+    // and the reverse postorder of each function
     void compute_dominators(translation_unit& unit);
+    void compute_dominators(translation_unit& unit, size_t function_id);
 
-    bool is_dominated_by(const translation_unit& unit, size_t dominator_block_id, size_t dominated_block_id);
+    // constant time, both blocks must belong to the same function and the dominator info must be current
+    bool dominates(const translation_unit& unit, size_t dominator_block_id, size_t dominated_block_id);
 }
 
 #endif
@@ -4,6 +4,7 @@
 #include "linear/ir.hpp"
 #include "logic/ir.hpp"
 #include "logic/typing.hpp"
+#include "logic/analysis/side_effects.hpp"
 #include "platform.hpp"
 #include "linear/registers.hpp"
 #include "registers.hpp"
@@ -68,6 +69,26 @@ namespace michaelcc {
             }
         };
 
+        // sethi-ullman labels: how many new registers lowering an expression needs at once
+        class register_need_calculator : public logic::const_expression_dispatcher<size_t> {
+        private:
+            logic_lowerer& m_lowerer;
+
+        public:
+            register_need_calculator(logic_lowerer& lowerer) : m_lowerer(lowerer) {}
+
+        protected:
+            size_t dispatch(const logic::variable_reference& node) override;
+            size_t dispatch(const logic::arithmetic_operator& node) override;
+            size_t dispatch(const logic::unary_operation& node) override;
+            size_t dispatch(const logic::type_cast& node) override;
+            size_t dispatch(const logic::dereference& node) override;
+            size_t dispatch(const logic::member_access& node) override;
+            size_t dispatch(const logic::array_index& node) override;
+
+            size_t handle_default(const logic::expression& expr) override { return 1; }
+        };
+
         class statement_lowerer : public logic::const_statement_dispatcher<void> {
         private:
             logic_lowerer& m_lowerer;
@@ -81,6 +102,7 @@ namespace michaelcc {
             void dispatch(const logic::return_statement& node) override;
             void dispatch(const logic::if_statement& node) override;
             void dispatch(const logic::loop_statement& node) override;
+            void dispatch(const logic::switch_statement& node) override;
             void dispatch(const logic::break_statement& node) override;
             void dispatch(const logic::continue_statement& node) override;
             void dispatch(const logic::statement_block& node) override;
@@ -106,7 +128,8 @@ namespace michaelcc {
 
             std::string next_static_label(const std::shared_ptr<logic::variable>& variable) {
                 size_t id = static_var_counter++;
-                std::string label = name + "_" + std::to_string(id);
+                // '@' cannot start a c identifier, so the label never collides with a global or function
+                std::string label = "@static_" + name + "_" + std::to_string(id);
                 static_var_labels[variable] = label;
                 return label;
             }
@@ -122,6 +145,21 @@ namespace michaelcc {
             std::unordered_map<std::shared_ptr<logic::variable>, linear::phi_instruction*> init_phi_nodes;
         };
 
+        struct switch_target {
+            int64_t value;
+            size_t block_id;
+        };
+
+        static bool switch_value_less(int64_t a, int64_t b, bool is_unsigned) noexcept {
+            return is_unsigned ? static_cast<uint64_t>(a) < static_cast<uint64_t>(b) : a < b;
+        }
+
+        // a run of at least this many cases, with no more than this many table entries per case, becomes a jump
+        // table. anything sparser is split into a binary tree of compares, down to a short chain of equality tests
+        static constexpr size_t jump_table_min_cases = 4;
+        static constexpr size_t jump_table_max_entries_per_case = 3;
+        static constexpr size_t compare_chain_max_cases = 3;
+
         struct compound_expression_info {
             size_t return_block_id;
             std::vector<size_t> incoming_block_ids;
@@ -138,8 +176,18 @@ namespace michaelcc {
         std::unordered_map<size_t, block_var_ctx> m_finished_block_var_ctx;
         std::unordered_map<size_t, loop_info> m_loop_infos;
         std::vector<size_t> m_loop_stack;
+
+        // the loops and switches a break can leave, by the id of their entry in m_loop_infos
+        std::vector<size_t> m_break_stack;
         std::vector<compound_expression_info> m_compound_expression_stack;
         size_t m_next_block_id = 0;
+        size_t m_block_id_stride = 1;
+
+        // labels of the expressions in the function being lowered, so nested operators do not relabel their subtrees
+        std::unordered_map<const logic::expression*, size_t> m_register_needs;
+
+        // whether operands can be reordered, kept for the function being lowered like the labels above
+        logic::analysis::side_effects_analyzer m_side_effects;
 
         block_var_ctx reconcile_var_regs(const std::vector<size_t>& incoming_block_ids);
 
@@ -151,7 +199,7 @@ namespace michaelcc {
 
         size_t allocate_block_id() {
             size_t id = m_next_block_id;
-            m_next_block_id++;
+            m_next_block_id += m_block_id_stride;
             return id;
         }
 
@@ -178,8 +226,13 @@ namespace michaelcc {
             return m_loop_stack.size();
         }
 
+        size_t current_break_depth() const {
+            return m_break_stack.size();
+        }
+
         void pop_loop_stack() {
             m_loop_stack.pop_back();
+            m_break_stack.pop_back();
         }
 
         size_t seal_block();
@@ -195,6 +248,15 @@ namespace michaelcc {
 
         std::optional<size_t> lower_statements(const std::vector<std::unique_ptr<logic::statement>>& statements);
 
+        // seals the current block with a compare of condition against constant, returns the sealed block's id
+        size_t emit_compare_branch(linear::a_instruction_type type, linear::virtual_register condition, int64_t constant, size_t if_true_block_id, size_t if_false_block_id);
+
+        // sends condition to the block of the matching target, sorted by value, or to default_block_id. condition is
+        // known to lie within the given bounds, compared unsigned when is_unsigned. every block sealed along the way is
+        // recorded under the targets it branches to
+        void lower_switch_dispatch(linear::virtual_register condition, bool is_unsigned, const std::vector<switch_target>& targets, size_t begin, size_t end, size_t default_block_id,
+            std::optional<int64_t> lower_bound, std::optional<int64_t> upper_bound, std::unordered_map<size_t, std::vector<size_t>>& incoming_block_ids);
+
         linear::virtual_register lower_at_address(linear::virtual_register dest_address, const std::unique_ptr<logic::expression>& initializer, size_t offset);
 
         linear::virtual_register lower_expression(const logic::expression& expr) {
@@ -207,6 +269,16 @@ namespace michaelcc {
             (*lowerer)(statement);
         }
 
+        size_t register_need(const logic::expression& expr) {
+            auto it = m_register_needs.find(&expr);
+            if (it != m_register_needs.end()) {
+                return it->second;
+            }
+            size_t need = register_need_calculator(*this)(expr);
+            m_register_needs.insert({ &expr, need });
+            return need;
+        }
+
         linear::virtual_register compute_lvalue_address(const logic::expression& expr) {
             auto lowerer = std::make_unique<lvalue_lowerer>(*this);
             return (*lowerer)(expr);
@@ -218,7 +290,8 @@ namespace michaelcc {
 
 
         void lower_function(const logic::function_definition& function);
-        void lower_static_variable_declaration(const logic::variable_declaration& declaration);
+        void link_blocks(linear::translation_unit& unit);
+        void lower_static_variable_declaration(const logic::variable_declaration& declaration, const std::string& label);
     public:
         explicit logic_lowerer(isa::isa& isa) : m_translation_unit(linear::translation_unit{
             .platform_info = isa.get_platform_info()
@@ -226,6 +299,14 @@ namespace michaelcc {
 
         void lower(const logic::translation_unit& translation_unit);
 
+        // lowers the string literals and global variables, after which functions can be lowered one at a time
+        void begin(const logic::translation_unit& translation_unit);
+
+        // lowers one function into a translation unit of its own, which the backend can finish independently.
+        // block ids keep counting across functions, so labels stay unique when their assembly is concatenated.
+        // the static sections, including the function's static locals, stay behind in this lowerer's unit.
+        linear::translation_unit lower_function_unit(const logic::function_definition& function);
+
         const linear::translation_unit& get_translation_unit() const { return m_translation_unit; }
 
         linear::translation_unit&& release_translation_unit() { return std::move(m_translation_unit); }
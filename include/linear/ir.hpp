@@ -6,11 +6,14 @@
 #include "utils.hpp"
 #include "registers.hpp"
 #include "static.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <unordered_set>
 #include <unordered_map>
 #include <cassert>
@@ -46,11 +49,13 @@ namespace michaelcc {
         class basic_block;
         class branch;
         class branch_condition;
+        class jump_table;
         class push_function_argument;
         class function_call;
         class function_return;
         class load_parameter;
         class phi_instruction;
+        class select_instruction;
         class load_effective_address;
 
         template<typename ReturnType>
@@ -67,10 +72,12 @@ namespace michaelcc {
             const load_parameter,
             const branch,
             const branch_condition,
+            const jump_table,
             const push_function_argument,
             const function_call,
             const function_return,
             const phi_instruction,
+            const select_instruction,
             const load_effective_address
         >;
 
@@ -89,10 +96,12 @@ namespace michaelcc {
             const load_parameter,
             const branch,
             const branch_condition,
+            const jump_table,
             const push_function_argument,
             const function_call,
             const function_return,
             const phi_instruction,
+            const select_instruction,
             const load_effective_address
         >;
 
@@ -348,6 +357,10 @@ namespace michaelcc {
             std::optional<size_t> m_immediate_dominator_block_id;
             std::vector<size_t> m_predecessor_block_ids;
             std::vector<size_t> m_immediately_dominated_block_ids;
+            std::vector<size_t> m_dominance_frontier;
+
+            // preorder and postorder numbers in the dominator tree, unset while the block is unreachable
+            std::optional<std::pair<size_t, size_t>> m_dominator_interval;
 
             size_t m_id;
 
@@ -363,10 +376,17 @@ namespace michaelcc {
             const std::vector<size_t>& predecessor_block_ids() const noexcept { return m_predecessor_block_ids; }
             const std::vector<size_t>& immediately_dominated_block_ids() const noexcept { return m_immediately_dominated_block_ids; }
 
+            const std::vector<size_t>& dominance_frontier() const noexcept { return m_dominance_frontier; }
+
             std::optional<size_t> immediate_dominator_block_id() const noexcept { return m_immediate_dominator_block_id; }
+            const std::optional<std::pair<size_t, size_t>>& dominator_interval() const noexcept { return m_dominator_interval; }
 
             std::vector<std::unique_ptr<instruction>>&& release_instructions() noexcept { return std::move(m_instructions); }   
 
+            void add_successor_block_id(size_t block_id) {
+                m_successor_block_ids.push_back(block_id);
+            }
+
             void add_predecessor_block_id(size_t block_id) {
                 m_predecessor_block_ids.push_back(block_id);
             }
@@ -376,6 +396,11 @@ namespace michaelcc {
                 m_immediately_dominated_block_ids = std::move(ids);
             }
 
+            void set_dominance_info(std::optional<std::pair<size_t, size_t>> interval, std::vector<size_t>&& frontier) {
+                m_dominator_interval = interval;
+                m_dominance_frontier = std::move(frontier);
+            }
+
             void replace_instructions(std::vector<std::unique_ptr<instruction>>&& instructions) {
                 m_instructions = std::move(instructions);
             }
@@ -388,6 +413,14 @@ namespace michaelcc {
                 m_predecessor_block_ids.erase(std::remove(m_predecessor_block_ids.begin(), m_predecessor_block_ids.end(), block_id), m_predecessor_block_ids.end());
             }
 
+            void replace_successor_block_id(size_t block_id, size_t new_block_id) {
+                std::replace(m_successor_block_ids.begin(), m_successor_block_ids.end(), block_id, new_block_id);
+            }
+
+            void replace_predecessor_block_id(size_t block_id, size_t new_block_id) {
+                std::replace(m_predecessor_block_ids.begin(), m_predecessor_block_ids.end(), block_id, new_block_id);
+            }
+
             void phi_add_instruction(std::unique_ptr<instruction>&& instruction) {
                 m_instructions.insert(m_instructions.end() - 1, std::move(instruction));
             }
@@ -429,6 +462,37 @@ namespace michaelcc {
             bool has_side_effects() const noexcept override { return true; }
         };
 
+        // jumps to the target at index, which has already been checked to be in range
+        class jump_table : public instruction {
+        private:
+            virtual_register m_index;
+            std::vector<size_t> m_target_block_ids;
+        public:
+            jump_table(virtual_register index, std::vector<size_t>&& target_block_ids)
+                : m_index(index), m_target_block_ids(std::move(target_block_ids)) {}
+
+            virtual_register index() const noexcept { return m_index; }
+
+            // one entry per index, a block may appear more than once
+            const std::vector<size_t>& target_block_ids() const noexcept { return m_target_block_ids; }
+
+            // the distinct targets in order of first appearance
+            std::vector<size_t> successor_block_ids() const {
+                std::vector<size_t> successors;
+                for (size_t block_id : m_target_block_ids) {
+                    if (std::find(successors.begin(), successors.end(), block_id) == successors.end()) {
+                        successors.push_back(block_id);
+                    }
+                }
+                return successors;
+            }
+
+            std::optional<linear::virtual_register> destination_register() const noexcept override { return std::nullopt; }
+            std::vector<linear::virtual_register> operand_registers() const noexcept override { return { m_index }; }
+
+            bool has_side_effects() const noexcept override { return true; }
+        };
+
 
         // Function Stuff
         struct function_parameter {
@@ -472,6 +536,9 @@ namespace michaelcc {
             size_t m_entry_block_id;
             std::vector<function_parameter> m_parameters;
 
+            // reachable blocks in reverse postorder, set alongside the dominator info
+            std::vector<size_t> m_reverse_postorder;
+
         public:
             function_definition(std::string name, size_t entry_block_id, std::vector<function_parameter>&& parameters) 
                 : m_name(name), m_entry_block_id(entry_block_id), m_parameters(std::move(parameters)) {}
@@ -479,6 +546,11 @@ namespace michaelcc {
             size_t entry_block_id() const noexcept { return m_entry_block_id; }
             const std::vector<function_parameter>& parameters() const noexcept { return m_parameters; }
             const std::string& name() const noexcept { return m_name; }
+            const std::vector<size_t>& reverse_postorder() const noexcept { return m_reverse_postorder; }
+
+            void set_reverse_postorder(std::vector<size_t>&& block_ids) {
+                m_reverse_postorder = std::move(block_ids);
+            }
         };
 
 
@@ -599,6 +671,30 @@ namespace michaelcc {
             }
         };
 
+
+        // Select Instruction / picks one of two values without branching in the IR, built by if-conversion
+        class select_instruction : public instruction {
+        private:
+            virtual_register m_destination;
+            virtual_register m_condition;
+            virtual_register m_if_true;
+            virtual_register m_if_false;
+
+        public:
+            select_instruction(virtual_register destination, virtual_register condition, virtual_register if_true, virtual_register if_false)
+                : m_destination(destination), m_condition(condition), m_if_true(if_true), m_if_false(if_false) {
+                    assert(if_true.reg_size == if_false.reg_size);
+                    assert(if_true.reg_class == if_false.reg_class);
+                }
+
+            virtual_register destination() const noexcept { return m_destination; }
+            virtual_register condition() const noexcept { return m_condition; }
+            virtual_register if_true() const noexcept { return m_if_true; }
+            virtual_register if_false() const noexcept { return m_if_false; }
+
+            std::optional<linear::virtual_register> destination_register() const noexcept override { return m_destination; }
+            std::vector<linear::virtual_register> operand_registers() const noexcept override { return { m_condition, m_if_true, m_if_false }; }
+        };
         
         // Load Effective Address / loads address of a global label
         class load_effective_address : public instruction {
@@ -628,6 +724,11 @@ namespace michaelcc {
 
             size_t next_function_call_id = 0;
 
+            // block ids are unique across the whole output, since they become assembly labels. a unit lowered on its
+            // own takes every other id, the lowerer numbers later functions with the rest
+            size_t next_block_id = 0;
+            size_t block_id_stride = 1;
+
             static_storage::static_sections static_sections;
             const platform_info& platform_info;
 
@@ -652,11 +753,36 @@ namespace michaelcc {
                 }
             }
 
+            size_t new_block_id() {
+                size_t id = next_block_id;
+                next_block_id += block_id_stride;
+                return id;
+            }
+
             size_t new_function_call_id() {
                 size_t id = next_function_call_id;
                 next_function_call_id++;
                 return id;
             }
+
+            // drops a function and every block reachable from its entry, shifting later function indices down
+            void remove_function(size_t function_id) {
+                std::vector<size_t> worklist = { function_definitions.at(function_id)->entry_block_id() };
+                while (!worklist.empty()) {
+                    size_t block_id = worklist.back();
+                    worklist.pop_back();
+
+                    auto it = blocks.find(block_id);
+                    if (it == blocks.end()) {
+                        continue;
+                    }
+                    for (size_t successor : it->second.successor_block_ids()) {
+                        worklist.push_back(successor);
+                    }
+                    blocks.erase(it);
+                }
+                function_definitions.erase(function_definitions.begin() + function_id);
+            }
         };
 
         std::string print_linear_ir(const translation_unit& unit);
@@ -2,6 +2,8 @@
 #include "linear/pass.hpp"
 #include "linear/registers.hpp"
 #include <optional>
+#include <utility>
+#include <vector>
 
 namespace michaelcc::linear::optimization {
     class const_prop_pass final : public pass {
@@ -21,7 +23,9 @@ namespace michaelcc::linear::optimization {
             std::unique_ptr<instruction> dispatch(const c_instruction& node) override;
             std::unique_ptr<instruction> dispatch(const valloca_instruction& node) override;
             std::unique_ptr<instruction> dispatch(const branch_condition& node) override;
+            std::unique_ptr<instruction> dispatch(const jump_table& node) override;
             std::unique_ptr<instruction> dispatch(const phi_instruction& node) override;
+            std::unique_ptr<instruction> dispatch(const select_instruction& node) override;
             std::unique_ptr<instruction> dispatch(const load_memory& node) override;
             std::unique_ptr<instruction> dispatch(const store_memory& node) override;
 
@@ -34,6 +38,9 @@ namespace michaelcc::linear::optimization {
         std::unordered_map<virtual_register, a2_instruction> m_a2_definitions;
         std::optional<size_t> m_current_block_id = std::nullopt;
 
+        // edges a folded branch no longer takes, keyed by the block it ends and the successor
+        std::vector<std::pair<size_t, size_t>> m_removed_edges;
+
         std::optional<register_word> get_const_value(virtual_register vreg) const {
             auto it = m_const_definitions.find(vreg);
             if (it != m_const_definitions.end()) {
@@ -46,6 +53,15 @@ namespace michaelcc::linear::optimization {
 
         bool optimize(translation_unit& unit) override;
 
-        void reset() override { m_const_definitions.clear(); m_current_block_id = std::nullopt; }
+        void reset() override { m_const_definitions.clear(); m_current_block_id = std::nullopt; m_removed_edges.clear(); }
+
+        std::optional<std::vector<size_t>> changed_edge_blocks() const override {
+            std::vector<size_t> block_ids;
+            block_ids.reserve(m_removed_edges.size());
+            for (const auto& [block_id, successor_block_id] : m_removed_edges) {
+                block_ids.push_back(block_id);
+            }
+            return block_ids;
+        }
     };
 }
\ No newline at end of file
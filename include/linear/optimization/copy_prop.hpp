@@ -9,9 +9,10 @@ namespace michaelcc {
     namespace linear {
         namespace optimization {
 
+            // rewrites operands through a substitution table it does not own, unchanged instructions are left alone
             class replace_operands_transform : public instruction_transformer {
             private:
-                std::unordered_map<virtual_register, virtual_register> m_vreg_substitutions;
+                const std::unordered_map<virtual_register, virtual_register>& m_vreg_substitutions;
 
                 virtual_register get_replacement(virtual_register vreg) const {
                     auto it = m_vreg_substitutions.find(vreg);
@@ -22,8 +23,8 @@ namespace michaelcc {
                 }
 
             public:
-                explicit replace_operands_transform(std::unordered_map<virtual_register, virtual_register> vreg_substitutions) 
-                    : m_vreg_substitutions(std::move(vreg_substitutions)) {}
+                explicit replace_operands_transform(const std::unordered_map<virtual_register, virtual_register>& vreg_substitutions) 
+                    : m_vreg_substitutions(vreg_substitutions) {}
 
             protected:
                 std::unique_ptr<instruction> dispatch(const a_instruction& node) override {
@@ -127,6 +128,24 @@ namespace michaelcc {
                     return nullptr;
                 }
 
+                std::unique_ptr<instruction> dispatch(const jump_table& node) override {
+                    auto a = get_replacement(node.index());
+                    if (a != node.index()) {
+                        return std::make_unique<jump_table>(a, std::vector<size_t>(node.target_block_ids()));
+                    }
+                    return nullptr;
+                }
+
+                std::unique_ptr<instruction> dispatch(const select_instruction& node) override {
+                    auto c = get_replacement(node.condition());
+                    auto t = get_replacement(node.if_true());
+                    auto f = get_replacement(node.if_false());
+                    if (c != node.condition() || t != node.if_true() || f != node.if_false()) {
+                        return std::make_unique<select_instruction>(node.destination(), c, t, f);
+                    }
+                    return nullptr;
+                }
+
                 std::unique_ptr<instruction> dispatch(const store_memory& node) override {
                     auto a = get_replacement(node.destination_address());
                     auto v = get_replacement(node.value());
@@ -141,10 +160,21 @@ namespace michaelcc {
             private:
                 std::unordered_map<virtual_register, size_t> m_instruction_map;
 
+                // union-find over vregs, each removed copy links its destination to its source
+                std::unordered_map<virtual_register, virtual_register> m_copy_sources;
+
+                virtual_register find_source(virtual_register vreg);
+
             public:
                 void prescan(const translation_unit& unit) override;
                 bool optimize(translation_unit& unit) override;
-                void reset() override { m_instruction_map.clear(); }
+                void reset() override { m_instruction_map.clear(); m_copy_sources.clear(); }
+
+                // only operands are rewritten
+                preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
+
+                // a copy only replaces the uses its source dominates
+                void request_analyses(analysis_manager& analyses) const override { request_dominators(analyses); }
             };
         }
     }
@@ -10,6 +10,9 @@ namespace michaelcc::linear::optimization {
         void prescan(const translation_unit& unit) override;
         bool optimize(translation_unit& unit) override;
         void reset() override { used_instructions.clear(); }
+
+        // terminators have side effects and are never removed, so the CFG is untouched
+        preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
     };
 
     class dead_block_pass final : public pass {
@@ -20,5 +23,8 @@ namespace michaelcc::linear::optimization {
         void prescan(const translation_unit& unit) override;
         bool optimize(translation_unit& unit) override;
         void reset() override { used_block_ids.clear(); }
+
+        // dominators only cover the blocks reachable from the entry, and none of those is removed
+        preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
     };
 }
\ No newline at end of file
@@ -67,6 +67,8 @@ namespace michaelcc {
                 void prescan(const translation_unit& unit) override;
                 bool optimize(translation_unit& unit) override;
                 void reset() override { m_instruction_cache.clear(); }
+                preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
+                void request_analyses(analysis_manager& analyses) const override { request_dominators(analyses); }
             };
         }
     }
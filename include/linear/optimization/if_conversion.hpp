@@ -0,0 +1,40 @@
+#ifndef MICHAELCC_LINEAR_OPTIMIZATION_IF_CONVERSION_HPP
+#define MICHAELCC_LINEAR_OPTIMIZATION_IF_CONVERSION_HPP
+
+#include "linear/ir.hpp"
+#include "linear/pass.hpp"
+#include <vector>
+
+namespace michaelcc::linear::optimization {
+    // turns small diamonds and triangles, a conditional branch into one or two blocks that fall into the same join,
+    // into straight line code. the arms are hoisted into the branching block and the phis of the join become
+    // selects, so ?: and simple if/else assignments cost no blocks at all. a join left with a single predecessor is
+    // merged back into the branching block
+    class if_conversion_pass final : public pass {
+    private:
+        // both arms together, the arms run unconditionally afterwards
+        static constexpr size_t max_speculated_instructions = 4;
+        static constexpr size_t max_selects = 2;
+
+        // blocks ending in a conditional branch, in id order
+        std::vector<size_t> m_branch_block_ids;
+
+        // branching blocks that now go straight to their join, or past it once it is merged in
+        std::vector<size_t> m_converted_block_ids;
+
+        // cheap, side effect free and unable to trap, so running it on the path that did not ask for it is harmless
+        static bool is_speculatable(const instruction& instruction, const translation_unit& unit);
+
+        bool convert(translation_unit& unit, size_t block_id);
+        void merge_into_predecessor(translation_unit& unit, size_t block_id, size_t predecessor_block_id);
+
+    public:
+        void prescan(const translation_unit& unit) override;
+        bool optimize(translation_unit& unit) override;
+        void reset() override { m_branch_block_ids.clear(); m_converted_block_ids.clear(); }
+
+        std::optional<std::vector<size_t>> changed_edge_blocks() const override { return m_converted_block_ids; }
+    };
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef MICHAELCC_LINEAR_OPTIMIZATION_JUMP_THREADING_HPP
+#define MICHAELCC_LINEAR_OPTIMIZATION_JUMP_THREADING_HPP
+
+#include "linear/ir.hpp"
+#include "linear/pass.hpp"
+#include "linear/registers.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace michaelcc::linear::optimization {
+    // threads the edges into a block whose conditional branch is decided by the predecessor they come from, like the
+    // phi of constants a && or || is lowered to feeding a branch on it. such a predecessor jumps straight to the
+    // successor the branch would take, through its own copy of the block when the block's instructions still have to
+    // run on the way. values of the block read past the new edge are merged again by a phi in that successor
+    class jump_threading_pass final : public pass {
+    private:
+        // instructions copied for a single predecessor
+        static constexpr size_t max_duplicated_instructions = 6;
+
+        // blocks entered from more than one block that end in a conditional branch on something a phi decides, in id order
+        std::vector<size_t> m_branch_block_ids;
+
+        // vregs assigned a constant exactly once, masked to their width
+        std::unordered_map<virtual_register, uint64_t> m_constants;
+
+        // the function of every reachable block and its position in that function's reverse postorder
+        std::unordered_map<size_t, std::pair<size_t, size_t>> m_block_order;
+
+        // predecessors sent around a threaded block
+        std::vector<size_t> m_threaded_predecessor_block_ids;
+
+        static uint64_t width_mask(word_size size) noexcept {
+            return size == MICHAELCC_WORD_SIZE_UINT64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << size) - 1;
+        }
+
+        // the integer operations a branch condition is usually built from, nothing for those that may trap
+        static std::optional<uint64_t> fold(a_instruction_type type, uint64_t a, uint64_t b, word_size size) noexcept;
+
+        // which way the branch ending a block goes when it is entered from a predecessor, if the phis decide it
+        std::optional<bool> decide(const basic_block& block, size_t predecessor_block_id) const;
+
+        // a copy reading and writing renamed vregs, null for an instruction that has to stay where it is
+        static std::unique_ptr<instruction> copy_instruction(const instruction& instruction, const std::unordered_map<virtual_register, virtual_register>& renames);
+
+        bool thread(translation_unit& unit, size_t block_id, size_t predecessor_block_id, bool taken);
+
+    public:
+        void prescan(const translation_unit& unit) override;
+        bool optimize(translation_unit& unit) override;
+        void reset() override { m_branch_block_ids.clear(); m_constants.clear(); m_block_order.clear(); m_threaded_predecessor_block_ids.clear(); }
+
+        void request_analyses(analysis_manager& analyses) const override { request_dominators(analyses); }
+        std::optional<std::vector<size_t>> changed_edge_blocks() const override { return m_threaded_predecessor_block_ids; }
+    };
+}
+
+#endif
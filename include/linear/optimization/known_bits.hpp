@@ -0,0 +1,119 @@
+#ifndef MICHAELCC_LINEAR_OPTIMIZATION_KNOWN_BITS_HPP
+#define MICHAELCC_LINEAR_OPTIMIZATION_KNOWN_BITS_HPP
+
+#include "linear/ir.hpp"
+#include "linear/pass.hpp"
+#include "linear/registers.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace michaelcc {
+    namespace linear {
+        namespace optimization {
+            // tracks which bits of every integer vreg are known to be zero or one, from constants, masks, shifts,
+            // extensions and comparisons. extensions that cannot change their value, masks that clear nothing and
+            // instructions or comparisons whose result is decided by the known bits alone are rewritten into copies
+            // and constants that copy and constant propagation finish off
+            class known_bits_pass final : public pass {
+            private:
+                // bits outside the width of the vreg are in neither mask
+                struct known_bits {
+                    uint64_t zeros = 0;
+                    uint64_t ones = 0;
+                };
+
+                class bits_calculator : public instruction_dispatcher<known_bits> {
+                private:
+                    const known_bits_pass& m_pass;
+
+                public:
+                    bits_calculator(const known_bits_pass& pass) : m_pass(pass) {}
+
+                protected:
+                    known_bits handle_default(const instruction& node) override {
+                        (void)node;
+                        return known_bits{};
+                    }
+
+                    known_bits dispatch(const a_instruction& node) override;
+                    known_bits dispatch(const a2_instruction& node) override;
+                    known_bits dispatch(const u_instruction& node) override;
+                    known_bits dispatch(const c_instruction& node) override;
+                    known_bits dispatch(const init_register& node) override;
+                    known_bits dispatch(const phi_instruction& node) override;
+                    known_bits dispatch(const select_instruction& node) override;
+                };
+
+                class instruction_pass : public instruction_transformer {
+                private:
+                    const known_bits_pass& m_pass;
+
+                public:
+                    instruction_pass(const known_bits_pass& pass) : m_pass(pass) {}
+
+                protected:
+                    std::unique_ptr<instruction> dispatch(const a_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const a2_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const u_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const c_instruction& node) override;
+
+                    std::unique_ptr<instruction> handle_default(const instruction& node) override {
+                        (void)node;
+                        return nullptr;
+                    }
+                };
+
+                std::unordered_map<virtual_register, known_bits> m_known_bits;
+
+                // the defining instruction of each vreg assigned exactly once. precolored vregs are left unknown, calls
+                // and the frame allocator write them without saying so
+                std::unordered_map<virtual_register, const instruction*> m_definitions;
+
+                static uint64_t width_mask(word_size size) noexcept {
+                    return size == MICHAELCC_WORD_SIZE_UINT64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << size) - 1;
+                }
+
+                static bool is_constant(known_bits bits, word_size size) noexcept {
+                    return ((bits.zeros | bits.ones) & width_mask(size)) == width_mask(size);
+                }
+
+                known_bits get_known_bits(virtual_register vreg) const {
+                    auto it = m_known_bits.find(vreg);
+                    if (it == m_known_bits.end() || vreg.reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+                        return known_bits{};
+                    }
+                    return it->second;
+                }
+
+                static known_bits meet(known_bits a, known_bits b) noexcept {
+                    return known_bits{ .zeros = a.zeros & b.zeros, .ones = a.ones & b.ones };
+                }
+
+                // the bits of a + b + carry, a bit is known when the bits below it leave no doubt about its carry in
+                static known_bits add(known_bits a, known_bits b, bool carry, word_size size) noexcept;
+                // the high bits known to be zero because a value is at most as large as a
+                static uint64_t leading_zeros(known_bits a, word_size size) noexcept;
+                static known_bits shift(a_instruction_type type, known_bits a, size_t amount, word_size size) noexcept;
+                static known_bits combine(a_instruction_type type, known_bits a, known_bits b, word_size operand_size, word_size result_size) noexcept;
+
+                // a comparison that holds or fails for every value the known bits allow
+                static std::optional<bool> decide(a_instruction_type type, known_bits a, known_bits b, word_size size) noexcept;
+
+                // a constant for an instruction whose result is known in full
+                std::unique_ptr<instruction> make_constant(virtual_register destination) const;
+
+            public:
+                void prescan(const translation_unit& unit) override;
+                bool optimize(translation_unit& unit) override;
+                void reset() override { m_known_bits.clear(); m_definitions.clear(); }
+
+                // instructions are only replaced by copies and constants writing the same vreg
+                preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
+            };
+        }
+    }
+}
+
+#endif
@@ -19,6 +19,7 @@ namespace michaelcc::linear::optimization::postphi {
         void prescan(const translation_unit& unit) override;
         bool optimize(translation_unit& unit) override;
         void reset() override { m_entry_maps.clear(); }
+        preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
     };
 
     // Frame arithmetic simplification.
@@ -30,6 +31,7 @@ namespace michaelcc::linear::optimization::postphi {
         void prescan(const translation_unit& unit) override;
         bool optimize(translation_unit& unit) override;
         void reset() override { m_a2_defs.clear(); }
+        preserved_analyses preserved() const override { return preserved_analyses::none().preserve<dominator_analysis>(); }
     };
 }
 
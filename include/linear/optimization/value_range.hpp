@@ -0,0 +1,174 @@
+#ifndef MICHAELCC_LINEAR_OPTIMIZATION_VALUE_RANGE_HPP
+#define MICHAELCC_LINEAR_OPTIMIZATION_VALUE_RANGE_HPP
+
+#include "linear/ir.hpp"
+#include "linear/pass.hpp"
+#include "linear/registers.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace michaelcc {
+    namespace linear {
+        namespace optimization {
+            // bounds every integer vreg by the smallest and largest value it can hold, read as signed at its width.
+            // operands are narrowed by the conditional branches that dominate the block reading them, so a loop
+            // counter checked against a constant is bounded inside the body and a phi only sees the values that
+            // reach it. comparisons and branches decided by the bounds are folded, and division and modulo by a
+            // power of two become shifts and masks once the dividend is known not to be negative
+            class value_range_pass final : public pass {
+            private:
+                struct value_range {
+                    int64_t min;
+                    int64_t max;
+
+                    bool is_constant() const noexcept { return min == max; }
+                    bool operator==(const value_range& other) const noexcept { return min == other.min && max == other.max; }
+                };
+
+                // a conditional branch that was taken one way to reach a block
+                struct branch_edge {
+                    virtual_register condition;
+                    bool taken;
+                };
+
+                // phis at the head of a loop that keep growing are widened to the end of the type after this many updates
+                static constexpr size_t max_range_updates = 3;
+                // rounds recomputing the ranges after widening, to take back what widening gave away
+                static constexpr size_t narrowing_rounds = 2;
+
+                class range_calculator : public instruction_dispatcher<std::optional<value_range>> {
+                private:
+                    const value_range_pass& m_pass;
+                    size_t m_block_id;
+
+                public:
+                    range_calculator(const value_range_pass& pass, size_t block_id) : m_pass(pass), m_block_id(block_id) {}
+
+                protected:
+                    std::optional<value_range> handle_default(const instruction& node) override;
+
+                    std::optional<value_range> dispatch(const a_instruction& node) override;
+                    std::optional<value_range> dispatch(const a2_instruction& node) override;
+                    std::optional<value_range> dispatch(const u_instruction& node) override;
+                    std::optional<value_range> dispatch(const c_instruction& node) override;
+                    std::optional<value_range> dispatch(const init_register& node) override;
+                    std::optional<value_range> dispatch(const phi_instruction& node) override;
+                    std::optional<value_range> dispatch(const select_instruction& node) override;
+                };
+
+                class instruction_pass : public instruction_transformer {
+                private:
+                    value_range_pass& m_pass;
+                    translation_unit& m_unit;
+                    size_t m_block_id;
+
+                    // instructions the rewritten one needs ahead of it
+                    std::vector<std::unique_ptr<instruction>> m_prefix;
+
+                    // successors a folded branch no longer goes to, removed once the block is put back together
+                    std::vector<size_t> m_removed_successor_block_ids;
+
+                public:
+                    instruction_pass(value_range_pass& pass, translation_unit& unit, size_t block_id) : m_pass(pass), m_unit(unit), m_block_id(block_id) {}
+
+                    std::vector<std::unique_ptr<instruction>> release_prefix() { return std::move(m_prefix); }
+                    const std::vector<size_t>& removed_successor_block_ids() const noexcept { return m_removed_successor_block_ids; }
+
+                protected:
+                    std::unique_ptr<instruction> dispatch(const a_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const a2_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const u_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const c_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const select_instruction& node) override;
+                    std::unique_ptr<instruction> dispatch(const branch_condition& node) override;
+
+                    std::unique_ptr<instruction> handle_default(const instruction& node) override {
+                        (void)node;
+                        return nullptr;
+                    }
+                };
+
+                // unset for a vreg whose definition has not been reached yet
+                std::unordered_map<virtual_register, value_range> m_ranges;
+                std::unordered_map<virtual_register, size_t> m_range_updates;
+
+                // vregs assigned exactly once, precolored vregs and those assigned more often are left unbounded
+                std::unordered_set<virtual_register> m_defined;
+
+                // the integer comparisons branches are taken on, kept apart from the instructions optimize replaces
+                struct comparison {
+                    a_instruction_type type;
+                    virtual_register a;
+                    virtual_register b;
+                };
+                std::unordered_map<virtual_register, comparison> m_comparisons;
+
+                // the branches taken on the way into each reachable block, from its dominators
+                std::unordered_map<size_t, std::vector<branch_edge>> m_block_edges;
+
+                // the branch taken from each predecessor into a block with phis, keyed by block then predecessor
+                std::unordered_map<size_t, std::unordered_map<size_t, branch_edge>> m_phi_edges;
+
+                // blocks whose branch was folded
+                std::vector<size_t> m_folded_block_ids;
+
+                static value_range full_range(word_size size) noexcept;
+
+                // the range of an exact result, or the whole type when it may wrap
+                static value_range make_range(__int128 min, __int128 max, word_size size) noexcept;
+                static value_range join(value_range a, value_range b) noexcept;
+                static int64_t to_signed(uint64_t value, word_size size) noexcept;
+
+                static value_range combine(a_instruction_type type, value_range a, value_range b, word_size operand_size, word_size result_size) noexcept;
+
+                // a comparison that holds or fails for every pair of values in the ranges
+                static std::optional<bool> decide(a_instruction_type type, value_range a, value_range b) noexcept;
+
+                // narrows the range of a vreg knowing that a comparison it took part in came out one way, or nothing
+                // when no value in the range could have made it come out that way
+                static std::optional<value_range> refine(value_range range, a_instruction_type type, bool is_left, value_range other, bool holds) noexcept;
+
+                std::optional<value_range> get_range(virtual_register vreg) const;
+
+                // the range of a vreg where it is read in a block, or leaving a predecessor along a branch edge. nothing
+                // when the branches on the way there cannot all be taken
+                std::optional<value_range> get_range(virtual_register vreg, size_t block_id) const;
+                std::optional<value_range> get_range(virtual_register vreg, size_t predecessor_block_id, const std::optional<branch_edge>& edge) const;
+                std::optional<value_range> apply_edge(value_range range, virtual_register vreg, const branch_edge& edge) const;
+                static std::optional<branch_edge> get_edge(const translation_unit& unit, size_t predecessor_block_id, size_t block_id);
+
+                // which way a branch on a vreg goes when it can only go one way
+                std::optional<bool> decide_condition(virtual_register condition, size_t block_id) const;
+
+                std::unique_ptr<instruction> make_constant(virtual_register destination, int64_t value) const;
+
+                void compute_ranges(const translation_unit& unit, const function_definition& function);
+                // drops a successor and the phi values that came along the edge to it
+                void remove_edge(translation_unit& unit, size_t block_id, size_t successor_block_id);
+
+            public:
+                void prescan(const translation_unit& unit) override;
+                bool optimize(translation_unit& unit) override;
+                void reset() override {
+                    m_ranges.clear();
+                    m_range_updates.clear();
+                    m_defined.clear();
+                    m_comparisons.clear();
+                    m_block_edges.clear();
+                    m_phi_edges.clear();
+                    m_folded_block_ids.clear();
+                }
+
+                // the branches that narrow a block are found by walking up its immediate dominators
+                void request_analyses(analysis_manager& analyses) const override { request_dominators(analyses); }
+                std::optional<std::vector<size_t>> changed_edge_blocks() const override { return m_folded_block_ids; }
+            };
+        }
+    }
+}
+
+#endif
@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <memory>
+#include <optional>
 #include "linear/ir.hpp"
+#include "linear/analysis.hpp"
 
 namespace michaelcc {
     namespace linear {
@@ -18,10 +20,23 @@ namespace michaelcc {
             // reset the state of the pass
             virtual void reset() = 0;
 
+            // analyses that stay valid after optimize mutated the IR
+            virtual preserved_analyses preserved() const { return preserved_analyses::none(); }
+
+            // blocks whose outgoing edges optimize changed. dominators only depend on the edges, so the functions not
+            // holding one of them keep theirs. nothing means the pass cannot tell, and every function loses them
+            virtual std::optional<std::vector<size_t>> changed_edge_blocks() const { return std::nullopt; }
+
+            // asks for the analyses prescan and optimize read, before prescan runs
+            virtual void request_analyses(analysis_manager& analyses) const { (void)analyses; }
+
             virtual ~pass() = default;
         };
 
         bool transform(translation_unit& unit, std::vector<std::unique_ptr<pass>>& passes, int max_passes=1000);
+
+        // same as above, but keeps analyses cached across passes that preserve them
+        bool transform(translation_unit& unit, std::vector<std::unique_ptr<pass>>& passes, analysis_manager& analyses, int max_passes=1000);
     }
 }
 
@@ -0,0 +1,34 @@
+#ifndef MICHAELCC_LINEAR_SERIALIZE_HPP
+#define MICHAELCC_LINEAR_SERIALIZE_HPP
+
+#include "linear/ir.hpp"
+#include "platform.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace michaelcc::linear::serialization {
+    // bump whenever the encoding changes, readers reject other versions
+    constexpr uint64_t format_version = 4;
+
+    // Layout (all integers are LEB128 varints, signed ones zigzag encoded):
+    //   magic "MCIR", version
+    //   string table: count, then length + bytes for each string
+    //   function table: count, then name, entry block and parameters for each function
+    //   block table: count, then id, edges, dominator info and instructions for each block
+    //   register state: vreg colors, unspillable vregs, vreg and call id counters
+    //   static sections: bss, data and string literals
+    // labels, names and callees are stored as string table indices.
+    std::vector<uint8_t> serialize(const translation_unit& unit);
+
+    // the platform is not part of the format, the caller supplies the one the unit was compiled for
+    translation_unit deserialize(std::span<const uint8_t> data, const platform_info& platform_info);
+
+    void save(const translation_unit& unit, const std::string& path);
+
+    // maps the file into memory and decodes straight out of the mapping
+    translation_unit load(const std::string& path, const platform_info& platform_info);
+}
+
+#endif
@@ -25,13 +25,45 @@ namespace michaelcc {
                 std::string label;
                 const std::vector<data_word> data_words;
                 const type_layout_info layout;
+                bool is_read_only = false;
+
+                // storage for a nested initializer, which has no name of its own and may share an identical copy
+                bool is_literal = false;
             };
 
             struct static_sections {
                 std::vector<bss_allocation> bss_allocations;
                 std::vector<data_allocation> data_allocations;
+
+                // string literals, referenced as @string_<index>
+                std::vector<std::string> strings;
+            };
+
+            // a label that resolves to an offset (in address units) into a pooled object or reservation
+            struct pooled_label {
+                std::string label;
+                size_t offset;
             };
 
+            struct pooled_data {
+                std::vector<pooled_label> labels;
+                std::vector<data_word> data_words;
+                size_t size;
+                size_t alignment;
+            };
+
+            // final image of the static sections: strings interned and suffix merged,
+            // identical read-only literal storage merged, and all bss packed into one zero-fill reservation
+            struct pooled_sections {
+                std::vector<pooled_data> data;
+                std::vector<pooled_label> bss_labels;
+                size_t bss_size;
+                size_t bss_alignment;
+            };
+
+            std::string string_label(size_t index);
+            pooled_sections pool_static_sections(const static_sections& sections, const platform_info& platform_info);
+
             class is_default_initialized : public logic::const_expression_dispatcher<std::optional<type_layout_info>> {
             private:
                 const platform_info m_platform_info;
@@ -10,10 +10,10 @@ namespace michaelcc {
         namespace analysis {
             class constant_cloner final : public logic::const_expression_dispatcher<std::unique_ptr<logic::expression>> {
             private:
-                const platform_info m_platform_info;
+                const platform_info& m_platform_info;
     
             public:
-                constant_cloner(const platform_info platform_info) : m_platform_info(platform_info) {}
+                constant_cloner(const platform_info& platform_info) : m_platform_info(platform_info) {}
     
             protected:
                 std::unique_ptr<logic::expression> dispatch(const logic::integer_constant& node) override { 
@@ -0,0 +1,142 @@
+#ifndef MICHAELCC_LOGIC_FINGERPRINT_HPP
+#define MICHAELCC_LOGIC_FINGERPRINT_HPP
+
+#include "hashing.hpp"
+#include "logic/ir.hpp"
+#include "logic/analysis/recursion_analysis.hpp"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace michaelcc {
+    namespace logic {
+        namespace analysis {
+            // computes a stable hash per function that changes whenever the code generated for it could change.
+            // a fingerprint covers the function's own logic IR, the signatures of everything it calls, the
+            // fingerprints of callees that get inlined into it, and the declarations shared by the whole unit
+            // (aggregate types and static variables), which every function depends on conservatively.
+            // fingerprints must be taken before optimization, since passes such as inlining rewrite bodies.
+            class function_fingerprinter {
+            private:
+                const logic::translation_unit& m_unit;
+                function_dependency_analyzer m_dependencies;
+                std::string m_declarations_hash;
+
+                std::unordered_map<const logic::function_definition*, std::string> m_fingerprints;
+                std::unordered_set<const logic::function_definition*> m_in_progress;
+
+                static std::string signature(const logic::function_definition& function) {
+                    std::string result = std::to_string(function.qualifiers()) + " " + function.return_type().to_string() + " " + function.name() + "(";
+                    for (const auto& parameter : function.parameters()) {
+                        result += parameter->get_type().to_string() + ",";
+                    }
+                    return result + ")";
+                }
+
+                template<typename T, typename Fn>
+                static void hash_sorted(content_hasher& hasher, const std::unordered_map<std::string, std::shared_ptr<T>>& declarations, Fn&& hash_declaration) {
+                    std::vector<const std::string*> names;
+                    names.reserve(declarations.size());
+                    for (const auto& [name, declaration] : declarations) {
+                        names.push_back(&name);
+                    }
+                    std::sort(names.begin(), names.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+                    hasher.integer(names.size());
+                    for (const std::string* name : names) {
+                        hasher.string(*name);
+                        hash_declaration(*declarations.at(*name));
+                    }
+                }
+
+                std::string hash_declarations() const {
+                    content_hasher hasher;
+                    hash_sorted(hasher, m_unit.structs(), [&](const typing::struct_type& type) {
+                        for (const auto& field : type.fields()) {
+                            hasher.string(field.name);
+                            hasher.string(field.member_type.to_string());
+                            hasher.integer(field.offset);
+                        }
+                    });
+                    hash_sorted(hasher, m_unit.unions(), [&](const typing::union_type& type) {
+                        for (const auto& member : type.members()) {
+                            hasher.string(member.name);
+                            hasher.string(member.member_type.to_string());
+                        }
+                    });
+                    hash_sorted(hasher, m_unit.enums(), [&](const typing::enum_type& type) {
+                        for (const auto& enumerator : type.enumerators()) {
+                            hasher.string(enumerator.name);
+                            hasher.integer(static_cast<uint64_t>(enumerator.value));
+                        }
+                    });
+                    hasher.string(static_declarations_to_tree_string(m_unit));
+                    return hasher.hex();
+                }
+
+                std::string compute(const std::shared_ptr<logic::function_definition>& function) {
+                    content_hasher hasher;
+                    hasher.string(m_declarations_hash);
+                    hasher.string(to_tree_string(m_unit, *function));
+
+                    // callees are hashed in name order, the dependency set itself is unordered
+                    std::vector<std::shared_ptr<logic::function_definition>> callees(m_dependencies.dependencies(function).begin(), m_dependencies.dependencies(function).end());
+                    std::sort(callees.begin(), callees.end(), [](const auto& a, const auto& b) { return a->name() < b->name(); });
+
+                    bool inlines_callees = m_dependencies.has_inline_dependencies(function);
+                    hasher.integer(callees.size());
+                    for (const auto& callee : callees) {
+                        hasher.string(signature(*callee));
+
+                        // an inlined body becomes part of this function, so its changes must invalidate it.
+                        // inline functions cannot be recursive, but guard against cycles anyway.
+                        if (inlines_callees && callee->should_inline() && !m_in_progress.contains(callee.get())) {
+                            hasher.string(fingerprint(callee));
+                        }
+                    }
+                    return hasher.hex();
+                }
+
+            public:
+                function_fingerprinter(const logic::translation_unit& unit) : m_unit(unit) {
+                    for (const auto& symbol : m_unit.global_symbols()) {
+                        auto function = std::dynamic_pointer_cast<logic::function_definition>(symbol);
+                        if (function) {
+                            m_dependencies.analyze_function(function);
+                        }
+                    }
+                    m_declarations_hash = hash_declarations();
+                }
+
+                const std::string& fingerprint(const std::shared_ptr<logic::function_definition>& function) {
+                    auto it = m_fingerprints.find(function.get());
+                    if (it != m_fingerprints.end()) {
+                        return it->second;
+                    }
+
+                    m_in_progress.insert(function.get());
+                    std::string result = compute(function);
+                    m_in_progress.erase(function.get());
+                    return m_fingerprints.insert({ function.get(), std::move(result) }).first->second;
+                }
+
+                // fingerprints of every function in the unit, keyed by name
+                std::unordered_map<std::string, std::string> fingerprint_all() {
+                    std::unordered_map<std::string, std::string> result;
+                    for (const auto& symbol : m_unit.global_symbols()) {
+                        auto function = std::dynamic_pointer_cast<logic::function_definition>(symbol);
+                        if (function) {
+                            result.insert({ function->name(), fingerprint(function) });
+                        }
+                    }
+                    return result;
+                }
+            };
+        }
+    }
+}
+
+#endif
@@ -1,4 +1,5 @@
 #ifndef MICHAELCC_RECURSION_ANALYSIS_HPP
+#define MICHAELCC_RECURSION_ANALYSIS_HPP
 
 #include "logic/ir.hpp"
 #include <memory>
@@ -41,6 +42,12 @@ namespace michaelcc {
                     m_function_dependencies.insert(std::make_pair(function, std::move(called_functions)));
                 }
 
+                const std::unordered_set<std::shared_ptr<logic::function_definition>>& dependencies(std::shared_ptr<logic::function_definition> function) const {
+                    static const std::unordered_set<std::shared_ptr<logic::function_definition>> none;
+                    auto it = m_function_dependencies.find(function);
+                    return it == m_function_dependencies.end() ? none : it->second;
+                }
+
                 bool is_recursive(std::shared_ptr<logic::function_definition> function) const {
                     if (!m_function_dependencies.contains(function)) {
                         return false;
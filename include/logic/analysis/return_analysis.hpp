@@ -2,6 +2,7 @@
 #define MICHAELCC_OPTIMIZATION_RETURN_ANALYSIS_HPP
 
 #include "logic/ir.hpp"
+#include <algorithm>
 #include <memory>
 
 namespace michaelcc {
@@ -30,6 +31,71 @@ namespace michaelcc {
                     return analyze_control_block(*node.then_body()) && node.else_body() != nullptr && analyze_control_block(*node.else_body());
                 }
 
+                // a break out of any case may leave the switch without returning. a break inside a nested loop or
+                // switch leaves the outer switch too when it breaks out of more statements than it is nested in
+                bool dispatch(const logic::switch_statement& node) override {
+                    class break_finder final : public logic::const_statement_dispatcher<bool> {
+                    private:
+                        // loops and switches entered below the outer switch
+                        int m_nesting_depth = 0;
+
+                    public:
+                        bool find(const logic::control_block& node) {
+                            for (const auto& statement : node.statements()) {
+                                if ((*this)(*statement)) {
+                                    return true;
+                                }
+                            }
+                            return false;
+                        }
+
+                    protected:
+                        bool dispatch(const logic::break_statement& node) override {
+                            return node.loop_depth() > m_nesting_depth;
+                        }
+
+                        bool dispatch(const logic::statement_block& node) override {
+                            return find(*node.control_block());
+                        }
+
+                        bool dispatch(const logic::if_statement& node) override {
+                            return find(*node.then_body()) || (node.else_body() != nullptr && find(*node.else_body()));
+                        }
+
+                        bool dispatch(const logic::loop_statement& node) override {
+                            m_nesting_depth++;
+                            bool found = find(*node.body());
+                            m_nesting_depth--;
+                            return found;
+                        }
+
+                        bool dispatch(const logic::switch_statement& node) override {
+                            m_nesting_depth++;
+                            bool found = std::any_of(node.cases().begin(), node.cases().end(), [this](const logic::switch_statement::switch_case& switch_case) {
+                                return find(*switch_case.body);
+                            });
+                            m_nesting_depth--;
+                            return found;
+                        }
+
+                        bool handle_default(const logic::statement& node) override {
+                            return false;
+                        }
+                    };
+
+                    if (!node.has_default() || !analyze_control_block(*node.cases().back().body)) {
+                        return false;
+                    }
+
+                    break_finder finder;
+                    for (const auto& switch_case : node.cases()) {
+                        if (finder.find(*switch_case.body)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
                 bool handle_default(const logic::statement& node) override {
                     return false;
                 }
@@ -2,6 +2,7 @@
 #define MICHAELCC_ANALYSIS_SIDE_EFFECTS_HPP
 
 #include "logic/ir.hpp"
+#include <unordered_map>
 
 namespace michaelcc {
     namespace logic {
@@ -28,9 +29,16 @@ namespace michaelcc {
 
                     bool dispatch(const logic::variable_reference& node) override { return false; }
                     bool dispatch(const logic::increment_operator& node) override { return true; }
-                    bool dispatch(const logic::arithmetic_operator& node) override { return (*this)(*node.left()) || (*this)(*node.right()); }
-                    bool dispatch(const logic::unary_operation& node) override { return (*this)(*node.operand()); }
-                    bool dispatch(const logic::type_cast& node) override { return (*this)(*node.operand()); }
+                    // operators nest arbitrarily deep, so their results are remembered and every subtree is walked once
+                    bool dispatch(const logic::arithmetic_operator& node) override {
+                        return m_side_effects_analyzer.remember(node, [&]() { return (*this)(*node.left()) || (*this)(*node.right()); });
+                    }
+                    bool dispatch(const logic::unary_operation& node) override {
+                        return m_side_effects_analyzer.remember(node, [&]() { return (*this)(*node.operand()); });
+                    }
+                    bool dispatch(const logic::type_cast& node) override {
+                        return m_side_effects_analyzer.remember(node, [&]() { return (*this)(*node.operand()); });
+                    }
                     bool dispatch(const logic::dereference& node) override { return (*this)(*node.operand()); }
                     bool dispatch(const logic::member_access& node) override { return (*this)(*node.base()); }
                     bool dispatch(const logic::array_index& node) override { return (*this)(*node.base()) || (*this)(*node.index()); }
@@ -94,6 +102,9 @@ namespace michaelcc {
                     bool dispatch(const logic::statement_block& node) override { return control_block_analyzer(*node.control_block()); }
                     bool dispatch(const logic::if_statement& node) override { return control_block_analyzer(*node.then_body()) || (node.else_body() != nullptr && control_block_analyzer(*node.else_body())); }
                     bool dispatch(const logic::loop_statement& node) override { return control_block_analyzer(*node.body()); }
+                    bool dispatch(const logic::switch_statement& node) override {
+                        return std::any_of(node.cases().begin(), node.cases().end(), [&](const auto& switch_case) { return control_block_analyzer(*switch_case.body); });
+                    }
                     bool dispatch(const logic::break_statement& node) override { return false; }
                     bool dispatch(const logic::continue_statement& node) override { return false; }
                     bool dispatch(const logic::return_statement& node) override { return !node.is_compound_return(); }
@@ -108,8 +119,64 @@ namespace michaelcc {
                 expression_analyzer m_expression_analyzer;
                 statement_analyzer m_statement_analyzer;
 
+                // results for control blocks and operators already walked; only valid while the IR they belong to is unchanged
+                std::unordered_map<const logic::control_block*, bool> m_control_block_results;
+                std::unordered_map<const logic::expression*, bool> m_expression_results;
+
+                template<typename Compute>
+                bool remember(const logic::expression& expression, Compute compute) {
+                    auto it = m_expression_results.find(&expression);
+                    if (it != m_expression_results.end()) {
+                        return it->second;
+                    }
+                    bool has_side_effects = compute();
+                    m_expression_results.insert({ &expression, has_side_effects });
+                    return has_side_effects;
+                }
+
             public:
                 side_effects_analyzer() : m_expression_analyzer(*this), m_statement_analyzer(*this) {}
+                side_effects_analyzer(const side_effects_analyzer&) = delete;
+
+                // drops every remembered result, for when the IR they were computed on is about to change or go away
+                void clear() {
+                    m_control_block_results.clear();
+                    m_expression_results.clear();
+                }
+
+                // drops the result for a single node that is about to be destroyed while its operands live on,
+                // so a later node allocated at the same address is not taken for it
+                void forget(const logic::expression& expression) {
+                    m_expression_results.erase(&expression);
+                }
+
+                // the same for a node destroyed together with everything below it
+                void forget_tree(const logic::expression& expression) {
+                    tree_forgetter forgetter(*this);
+                    expression.accept(forgetter);
+                }
+                void forget_tree(const logic::statement& statement) {
+                    tree_forgetter forgetter(*this);
+                    statement.accept(forgetter);
+                }
+                void forget_tree(const logic::control_block& control_block) {
+                    tree_forgetter forgetter(*this);
+                    control_block.accept(forgetter);
+                }
+
+            private:
+                class tree_forgetter final : public logic::const_visitor {
+                private:
+                    side_effects_analyzer& m_side_effects_analyzer;
+
+                public:
+                    tree_forgetter(side_effects_analyzer& side_effects_analyzer) : m_side_effects_analyzer(side_effects_analyzer) {}
+
+                    void visit(const logic::arithmetic_operator& node) override { m_side_effects_analyzer.m_expression_results.erase(&node); }
+                    void visit(const logic::unary_operation& node) override { m_side_effects_analyzer.m_expression_results.erase(&node); }
+                    void visit(const logic::type_cast& node) override { m_side_effects_analyzer.m_expression_results.erase(&node); }
+                    void visit(const logic::control_block& node) override { m_side_effects_analyzer.m_control_block_results.erase(&node); }
+                };
             };
 
             inline bool side_effects_analyzer::expression_has_side_effects(const logic::expression& expression) {
@@ -121,7 +188,14 @@ namespace michaelcc {
             }
 
             inline bool side_effects_analyzer::control_block_has_side_effects(const logic::control_block& control_block) {
-                return this->m_statement_analyzer.control_block_analyzer(control_block);
+                auto it = m_control_block_results.find(&control_block);
+                if (it != m_control_block_results.end()) {
+                    return it->second;
+                }
+
+                bool has_side_effects = this->m_statement_analyzer.control_block_analyzer(control_block);
+                m_control_block_results.insert({ &control_block, has_side_effects });
+                return has_side_effects;
             }
         }
     }
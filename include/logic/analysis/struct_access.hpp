@@ -0,0 +1,116 @@
+#ifndef MICHAELCC_ANALYSIS_STRUCT_ACCESS_HPP
+#define MICHAELCC_ANALYSIS_STRUCT_ACCESS_HPP
+
+#include "logic/ir.hpp"
+#include "logic/typing.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace michaelcc {
+    namespace logic {
+        namespace analysis {
+            // counts the static accesses to every struct field, weighting each by the loops around it, and finds the
+            // structs whose layout can be observed, which must keep their declared order.
+            // the unit is treated as the whole program: its layouts are only visible elsewhere through external
+            // functions and static data.
+            class struct_access_analyzer {
+            public:
+                // each loop an access sits in multiplies its weight, up to max_loop_depth loops
+                static constexpr size_t loop_weight = 8;
+                static constexpr size_t max_loop_depth = 6;
+
+                struct struct_info {
+                    std::shared_ptr<typing::struct_type> type;
+                    std::vector<size_t> field_heat;
+
+                    // why the layout is observable, empty when the fields may be reordered
+                    std::string exposure;
+                };
+
+            private:
+                class expression_analyzer : public logic::const_expression_dispatcher<void> {
+                private:
+                    struct_access_analyzer& m_analyzer;
+
+                public:
+                    expression_analyzer(struct_access_analyzer& analyzer) : m_analyzer(analyzer) {}
+
+                protected:
+                    void dispatch(const logic::integer_constant& node) override {}
+                    void dispatch(const logic::floating_constant& node) override {}
+                    void dispatch(const logic::string_constant& node) override {}
+                    void dispatch(const logic::enumerator_literal& node) override {}
+                    void dispatch(const logic::variable_reference& node) override {}
+                    void dispatch(const logic::function_reference& node) override {}
+
+                    void dispatch(const logic::increment_operator& node) override;
+                    void dispatch(const logic::arithmetic_operator& node) override;
+                    void dispatch(const logic::unary_operation& node) override;
+                    void dispatch(const logic::type_cast& node) override;
+                    void dispatch(const logic::address_of& node) override;
+                    void dispatch(const logic::dereference& node) override;
+                    void dispatch(const logic::member_access& node) override;
+                    void dispatch(const logic::array_index& node) override;
+                    void dispatch(const logic::array_initializer& node) override;
+                    void dispatch(const logic::allocate_array& node) override;
+                    void dispatch(const logic::struct_initializer& node) override;
+                    void dispatch(const logic::union_initializer& node) override;
+                    void dispatch(const logic::function_call& node) override;
+                    void dispatch(const logic::conditional_expression& node) override;
+                    void dispatch(const logic::set_address& node) override;
+                    void dispatch(const logic::set_variable& node) override;
+                    void dispatch(const logic::compound_expression& node) override;
+                };
+
+                class statement_analyzer : public logic::const_statement_dispatcher<void> {
+                private:
+                    struct_access_analyzer& m_analyzer;
+
+                public:
+                    statement_analyzer(struct_access_analyzer& analyzer) : m_analyzer(analyzer) {}
+
+                protected:
+                    void dispatch(const logic::expression_statement& node) override;
+                    void dispatch(const logic::variable_declaration& node) override;
+                    void dispatch(const logic::return_statement& node) override;
+                    void dispatch(const logic::if_statement& node) override;
+                    void dispatch(const logic::loop_statement& node) override;
+                    void dispatch(const logic::switch_statement& node) override;
+                    void dispatch(const logic::break_statement& node) override {}
+                    void dispatch(const logic::continue_statement& node) override {}
+                    void dispatch(const logic::statement_block& node) override;
+                };
+
+                expression_analyzer m_expression_analyzer;
+                statement_analyzer m_statement_analyzer;
+
+                std::unordered_map<const typing::struct_type*, struct_info> m_structs;
+                std::vector<const typing::struct_type*> m_order;
+                size_t m_loop_depth = 0;
+
+                struct_info& info(const std::shared_ptr<typing::struct_type>& type);
+
+                // the struct a member access reads from, nullptr for unions
+                std::shared_ptr<typing::struct_type> accessed_struct(const logic::member_access& node) const;
+
+                // marks the structs held by value in the type, and through pointers if asked, as observable
+                void expose(const typing::qual_type& type, const std::string& reason, bool through_pointers);
+
+                void analyze_expression(const logic::expression& expression) { m_expression_analyzer(expression); }
+                void analyze_address(const logic::expression& address);
+                void analyze_control_block(const logic::control_block& control_block);
+
+            public:
+                explicit struct_access_analyzer(const logic::translation_unit& unit);
+                struct_access_analyzer(const struct_access_analyzer&) = delete;
+
+                // every struct that was accessed or declared, in the order they were first seen
+                std::vector<const struct_info*> structs() const;
+            };
+        }
+    }
+}
+
+#endif
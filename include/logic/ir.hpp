@@ -1,8 +1,10 @@
 #ifndef MICHAELCC_LOGICAL_IR_HPP
 #define MICHAELCC_LOGICAL_IR_HPP
 
+#include <algorithm>
 #include <cstddef>
 #include <memory>
+#include <optional>
 #include <string>
 #include <cstdint>
 #include <variant>
@@ -47,6 +49,7 @@ namespace michaelcc {
 		class return_statement;
 		class if_statement;
 		class loop_statement;
+		class switch_statement;
 		class break_statement;
 		class continue_statement;
 		class enumerator_literal;
@@ -84,6 +87,7 @@ namespace michaelcc {
 			return_statement,
 			if_statement,
 			loop_statement,
+			switch_statement,
 			break_statement,
 			continue_statement,
 			enumerator_literal,
@@ -128,6 +132,7 @@ namespace michaelcc {
 			return_statement,
 			if_statement,
 			loop_statement,
+			switch_statement,
 			break_statement,
 			continue_statement,
 			enumerator_literal,
@@ -208,6 +213,7 @@ namespace michaelcc {
 			return_statement,
 			if_statement,
 			loop_statement,
+			switch_statement,
 			break_statement,
 			continue_statement,
 			statement_block
@@ -220,6 +226,7 @@ namespace michaelcc {
 			const return_statement,
 			const if_statement,
 			const loop_statement,
+			const switch_statement,
 			const break_statement,
 			const continue_statement,
 			const statement_block
@@ -247,6 +254,7 @@ namespace michaelcc {
 			bool must_use_register() const noexcept { return m_qualifiers & typing::REGISTER_STORAGE_CLASS; }
 			bool use_static_storage() const noexcept { return m_qualifiers & typing::STATIC_STORAGE_CLASS; }
 			void mark_must_alloca() noexcept { m_must_alloca = true; }
+			void mark_static_storage() noexcept { m_qualifiers |= typing::STATIC_STORAGE_CLASS; }
 
             std::string to_string() const noexcept override {
                 return std::format("{} variable {}", m_is_global ? "global" : "local", name());
@@ -414,6 +422,8 @@ namespace michaelcc {
 			token_type get_operator() const noexcept { return m_operator; }
             const std::unique_ptr<expression>& operand() const noexcept { return m_operand; }
 
+			std::unique_ptr<expression> release_operand() noexcept { return std::move(m_operand); }
+
             const typing::qual_type get_type() const override { return m_operand->get_type(); }
 
 			void mutable_accept(visitor& v) override {
@@ -493,6 +503,8 @@ namespace michaelcc {
 			const std::unique_ptr<expression>& base() const noexcept { return m_base; }
 			const typing::member& member() const noexcept { return m_member; }
 			bool is_dereference() const noexcept { return m_is_dereference; }
+
+			std::unique_ptr<expression> release_base() noexcept { return std::move(m_base); }
 			const typing::qual_type get_type() const override { return m_member.member_type.to_owning(m_base->get_type().propagate_qualifiers()); }
 
 			void mutable_accept(visitor& v) override {
@@ -971,8 +983,50 @@ namespace michaelcc {
 			}
 		};
 
+		class switch_statement final : public statement {
+		public:
+			struct switch_case {
+				// nullopt for the default label
+				std::optional<int64_t> value;
+				std::shared_ptr<control_block> body;
+			};
+
+		private:
+			std::unique_ptr<expression> m_condition;
+			std::vector<switch_case> m_cases;
+		public:
+			switch_statement(std::unique_ptr<expression>&& condition, std::vector<switch_case>&& cases)
+				: m_condition(std::move(condition)), m_cases(std::move(cases)) {}
+
+			const std::unique_ptr<expression>& condition() const noexcept { return m_condition; }
+
+			// in source order, control falls through from each body into the next
+			const std::vector<switch_case>& cases() const noexcept { return m_cases; }
+
+			bool has_default() const noexcept {
+				return std::any_of(m_cases.begin(), m_cases.end(), [](const switch_case& switch_case) { return !switch_case.value.has_value(); });
+			}
+
+			void mutable_accept(visitor& v) override {
+				v.visit(*this);
+				m_condition->mutable_accept(v);
+				for (const auto& switch_case : m_cases) {
+					switch_case.body->mutable_accept(v);
+				}
+			}
+
+			void accept(const_visitor& v) const override {
+				v.visit(*this);
+				m_condition->accept(v);
+				for (const auto& switch_case : m_cases) {
+					switch_case.body->accept(v);
+				}
+			}
+		};
+
 		class break_statement final : public statement {
 		private:
+			// counts enclosing loops and switches, continue only counts loops
 			int m_loop_depth;
 		public:
 			explicit break_statement(int loop_depth) : m_loop_depth(loop_depth) {}
@@ -1084,7 +1138,8 @@ namespace michaelcc {
 			const typing::qual_type& element_type() const noexcept { return m_element_type; }
 
 			const typing::qual_type get_type() const override { 
-				return typing::qual_type::owning(std::make_shared<typing::array_type>(m_element_type), m_element_type.propagate_qualifiers()); 
+				// a const array stores its qualifier on the element type, like a declared one
+				return typing::qual_type::owning(std::make_shared<typing::array_type>(m_element_type)); 
 			}
 
 			void mutable_accept(visitor& v) override {
@@ -1321,6 +1376,7 @@ namespace michaelcc {
 		private:
             std::shared_ptr<symbol_context> m_global_context;
 			std::vector<std::string> m_strings;
+			std::unordered_map<std::string, size_t> m_string_indices;
 
             std::unordered_map<std::string, std::shared_ptr<typing::struct_type>> m_structs;
             std::unordered_map<std::string, std::shared_ptr<typing::union_type>> m_unions;
@@ -1372,7 +1428,13 @@ namespace michaelcc {
 				m_static_variable_declarations.push_back(std::move(declaration));
 			}
 
+			// identical literals share one index, and thus one pooled label
 			size_t add_string(std::string&& str) {
+				auto it = m_string_indices.find(str);
+				if (it != m_string_indices.end()) {
+					return it->second;
+				}
+				m_string_indices.insert({ str, m_strings.size() });
 				m_strings.push_back(std::move(str));
 				return m_strings.size() - 1;
 			}
@@ -1424,6 +1486,10 @@ namespace michaelcc {
 
 		// Utility function to print the IR as a tree
 		std::string to_tree_string(const translation_unit& unit);
+
+		// prints a single function, or only the static variable declarations, in the same format
+		std::string to_tree_string(const translation_unit& unit, const function_definition& function);
+		std::string static_declarations_to_tree_string(const translation_unit& unit);
 	}
 }
 
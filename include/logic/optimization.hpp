@@ -102,6 +102,7 @@ namespace michaelcc {
                     virtual std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::return_statement>&& node) = 0;
                     virtual std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::if_statement>&& node) = 0;
                     virtual std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::loop_statement>&& node) = 0;
+                    virtual std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::switch_statement>&& node) = 0;
                     virtual std::unique_ptr<logic::statement> dispatch(const logic::break_statement& node) = 0;
                     virtual std::unique_ptr<logic::statement> dispatch(const logic::continue_statement& node) = 0;
                     virtual std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::statement_block>&& node) = 0;
@@ -166,6 +167,7 @@ namespace michaelcc {
                     std::unique_ptr<logic::statement> dispatch(const logic::return_statement& node) override;
                     std::unique_ptr<logic::statement> dispatch(const logic::if_statement& node) override;
                     std::unique_ptr<logic::statement> dispatch(const logic::loop_statement& node) override;
+                    std::unique_ptr<logic::statement> dispatch(const logic::switch_statement& node) override;
                     std::unique_ptr<logic::statement> dispatch(const logic::break_statement& node) override;
                     std::unique_ptr<logic::statement> dispatch(const logic::continue_statement& node) override;
                     std::unique_ptr<logic::statement> dispatch(const logic::statement_block& node) override;
@@ -258,6 +260,7 @@ namespace michaelcc {
                 std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::return_statement>&& node) override { return node; }
                 std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::if_statement>&& node) override { return node; }
                 std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::loop_statement>&& node) override { return node; }
+                std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::switch_statement>&& node) override { return node; }
                 std::unique_ptr<logic::statement> dispatch(const logic::break_statement& node) override { return std::make_unique<logic::break_statement>(node.loop_depth()); }
                 std::unique_ptr<logic::statement> dispatch(const logic::continue_statement& node) override { return std::make_unique<logic::continue_statement>(node.loop_depth()); }
                 std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::statement_block>&& node) override { return node; }
@@ -6,6 +6,7 @@
 #include "logic/analysis/constant_analysis.hpp"
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace michaelcc {
     namespace logic {
@@ -13,7 +14,113 @@ namespace michaelcc {
             class const_propagation_pass final : public default_pass {
             private:
                 const platform_info m_platform_info;
-                std::unordered_map<std::shared_ptr<logic::variable>, std::unique_ptr<logic::expression>> m_variable_map;
+
+                // one immutable copy of each constant, shared by every use. scalars are cloned into each reference since
+                // they become immediates anyway, aggregates stay in a single read only data object and only the elements
+                // that are read are cloned out of them
+                std::unordered_map<std::shared_ptr<logic::variable>, std::shared_ptr<const logic::expression>> m_variable_map;
+
+                // an aggregate whose address escapes must stay a distinct automatic object. every reference that is not
+                // the root of a read of a scalar element counts as escaping, which covers array decay and whole copies
+                std::unordered_set<std::shared_ptr<logic::variable>> m_address_taken;
+                std::unordered_map<std::shared_ptr<logic::variable>, size_t> m_reference_counts;
+                std::unordered_map<std::shared_ptr<logic::variable>, size_t> m_element_read_counts;
+
+                static bool is_aggregate(const logic::expression& constant) {
+                    return dynamic_cast<const logic::array_initializer*>(&constant)
+                        || dynamic_cast<const logic::struct_initializer*>(&constant)
+                        || dynamic_cast<const logic::union_initializer*>(&constant);
+                }
+
+                // a const array stores its qualifier on the element type
+                static bool is_read_only(const typing::qual_type& type) {
+                    const typing::qual_type* current = &type;
+                    while (!current->is_const()) {
+                        auto array_type = std::dynamic_pointer_cast<typing::array_type>(current->type());
+                        if (!array_type) {
+                            return false;
+                        }
+                        current = &array_type->element_type();
+                    }
+                    return true;
+                }
+
+                static bool is_aggregate_type(const typing::qual_type& type) {
+                    return type.is_same_type<typing::array_type>()
+                        || type.is_same_type<typing::struct_type>()
+                        || type.is_same_type<typing::union_type>();
+                }
+
+                // the variable an access reads from, following indices and member names down to a variable reference
+                static std::shared_ptr<logic::variable> root_variable(const logic::expression& node) {
+                    if (auto variable_reference = dynamic_cast<const logic::variable_reference*>(&node)) {
+                        return variable_reference->get_variable();
+                    }
+                    if (auto array_index = dynamic_cast<const logic::array_index*>(&node)) {
+                        return root_variable(*array_index->base());
+                    }
+                    if (auto member_access = dynamic_cast<const logic::member_access*>(&node)) {
+                        return member_access->is_dereference() ? nullptr : root_variable(*member_access->base());
+                    }
+                    return nullptr;
+                }
+
+                bool is_address_taken(const std::shared_ptr<logic::variable>& variable) const {
+                    if (m_address_taken.contains(variable)) {
+                        return true;
+                    }
+                    auto references = m_reference_counts.find(variable);
+                    auto reads = m_element_read_counts.find(variable);
+                    return (references == m_reference_counts.end() ? 0 : references->second)
+                        > (reads == m_element_read_counts.end() ? 0 : reads->second);
+                }
+
+                // the part of a pooled aggregate an access reads, following constant indices and member names down from
+                // the variable
+                const logic::expression* resolve(const logic::expression& node) const {
+                    if (auto variable_reference = dynamic_cast<const logic::variable_reference*>(&node)) {
+                        auto it = m_variable_map.find(variable_reference->get_variable());
+                        return it == m_variable_map.end() ? nullptr : it->second.get();
+                    }
+                    if (auto array_index = dynamic_cast<const logic::array_index*>(&node)) {
+                        auto index = dynamic_cast<const logic::integer_constant*>(array_index->index().get());
+                        auto base = resolve(*array_index->base());
+                        auto array_initializer = dynamic_cast<const logic::array_initializer*>(base);
+                        if (!index || !array_initializer || index->value() < 0 || static_cast<size_t>(index->value()) >= array_initializer->initializers().size()) {
+                            return nullptr;
+                        }
+                        return array_initializer->initializers()[index->value()].get();
+                    }
+                    if (auto member_access = dynamic_cast<const logic::member_access*>(&node)) {
+                        if (member_access->is_dereference()) {
+                            return nullptr;
+                        }
+                        auto struct_initializer = dynamic_cast<const logic::struct_initializer*>(resolve(*member_access->base()));
+                        if (!struct_initializer) {
+                            return nullptr;
+                        }
+                        for (const auto& initializer : struct_initializer->initializers()) {
+                            if (initializer.member_name == member_access->member().name) {
+                                return initializer.initializer.get();
+                            }
+                        }
+                    }
+                    return nullptr;
+                }
+
+                std::unique_ptr<logic::expression> fold_access(std::unique_ptr<logic::expression>&& node) const {
+                    auto element = resolve(*node);
+                    if (!element || is_aggregate(*element)) {
+                        return std::move(node);
+                    }
+
+                    logic::analysis::constant_cloner cloner(m_platform_info);
+                    auto constant = cloner(*element);
+                    if (!node->get_type().type()->is_equivalent_to(*constant->get_type().type(), m_platform_info)) {
+                        return std::make_unique<logic::type_cast>(std::move(constant), typing::qual_type(node->get_type()));
+                    }
+                    return constant;
+                }
 
                 class expression_pass : public default_expression_pass {
                 private:
@@ -24,14 +131,32 @@ namespace michaelcc {
 
                 protected:
                     std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::variable_reference>&& node) override {
-                        if (m_pass.m_variable_map.contains(node->get_variable())) {
+                        auto it = m_pass.m_variable_map.find(node->get_variable());
+                        if (it != m_pass.m_variable_map.end() && !is_aggregate(*it->second)) {
                             mark_ir_mutated();
-                            auto constant_cloner = logic::analysis::constant_cloner(m_pass.m_platform_info);
-                            auto constant = constant_cloner(*m_pass.m_variable_map[node->get_variable()]);
-                            return constant;
+                            logic::analysis::constant_cloner cloner(m_pass.m_platform_info);
+                            return cloner(*it->second);
                         }
                         return node;
                     }
+
+                    std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::array_index>&& node) override {
+                        return fold(std::move(node));
+                    }
+
+                    std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::member_access>&& node) override {
+                        return fold(std::move(node));
+                    }
+
+                private:
+                    std::unique_ptr<logic::expression> fold(std::unique_ptr<logic::expression>&& node) {
+                        const logic::expression* original = node.get();
+                        auto folded = m_pass.fold_access(std::move(node));
+                        if (folded.get() != original) {
+                            mark_ir_mutated();
+                        }
+                        return folded;
+                    }
                 };
 
                 class statement_pass : public default_statement_pass {
@@ -43,13 +168,28 @@ namespace michaelcc {
 
                 protected:
                     std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::variable_declaration>&& node) override {
-                        if (m_pass.m_variable_map.contains(node->variable())) {
-                            mark_ir_mutated();
-                            return std::make_unique<logic::expression_statement>(
-                                node->release_initializer()
-                            );
+                        auto it = m_pass.m_variable_map.find(node->variable());
+                        if (it == m_pass.m_variable_map.end() || node->variable()->is_global()) {
+                            return node;
                         }
-                        return node;
+
+                        // an aggregate is lowered once into read only data instead of being rebuilt on the stack by every call,
+                        // unless its address escapes and recursive calls could tell their copies apart
+                        if (is_aggregate(*it->second)) {
+                            if (!node->variable()->use_static_storage() && !m_pass.is_address_taken(node->variable())) {
+                                mark_ir_mutated();
+                                node->variable()->mark_static_storage();
+                            }
+                            return node;
+                        }
+                        if (node->variable()->use_static_storage()) {
+                            return node;
+                        }
+
+                        mark_ir_mutated();
+                        return std::make_unique<logic::expression_statement>(
+                            node->release_initializer()
+                        );
                     }
                 };
 
@@ -62,7 +202,7 @@ namespace michaelcc {
 
                 protected:
                     void visit(const logic::variable_declaration& node) override {
-                        if ((node.variable()->get_type().qualifiers() & typing::CONST_TYPE_QUALIFIER) && node.initializer()) {
+                        if (is_read_only(node.variable()->get_type()) && node.initializer()) {
                             logic::analysis::constant_cloner cloner(m_pass.m_platform_info);
                             auto constant = cloner(*node.initializer());
                             if (constant) {
@@ -71,12 +211,45 @@ namespace michaelcc {
                         }
                     }
 
+                    void visit(const logic::variable_reference& node) override {
+                        m_pass.m_reference_counts[node.get_variable()]++;
+                    }
+
+                    void visit(const logic::array_index& node) override {
+                        count_element_read(node);
+                    }
+
+                    void visit(const logic::member_access& node) override {
+                        count_element_read(node);
+                    }
+
+                    // a scalar has no storage left to point at, an aggregate keeps its automatic storage
                     void visit(const logic::address_of& node) override {
                         if (std::holds_alternative<std::shared_ptr<logic::variable>>(node.operand())) {
                             std::shared_ptr<logic::variable> variable = std::get<std::shared_ptr<logic::variable>>(node.operand());
-                            if (m_pass.m_variable_map.contains(variable)) {
-                                m_pass.m_variable_map.erase(variable);
+                            auto it = m_pass.m_variable_map.find(variable);
+                            if (it != m_pass.m_variable_map.end() && !is_aggregate(*it->second)) {
+                                m_pass.m_variable_map.erase(it);
                             }
+                            m_pass.m_address_taken.insert(variable);
+                            return;
+                        }
+                        std::visit([this](const auto& operand) {
+                            if constexpr (!std::is_same_v<std::decay_t<decltype(operand)>, std::shared_ptr<logic::variable>>) {
+                                if (auto variable = root_variable(*operand)) {
+                                    m_pass.m_address_taken.insert(variable);
+                                }
+                            }
+                        }, node.operand());
+                    }
+
+                private:
+                    void count_element_read(const logic::expression& node) {
+                        if (is_aggregate_type(node.get_type())) {
+                            return;
+                        }
+                        if (auto variable = root_variable(node)) {
+                            m_pass.m_element_read_counts[variable]++;
                         }
                     }
                 };
@@ -3,6 +3,7 @@
 
 #include "logic/optimization.hpp"
 #include "logic/ir.hpp"
+#include "logic/analysis/side_effects.hpp"
 
 namespace michaelcc {
     namespace logic {
@@ -10,18 +11,33 @@ namespace michaelcc {
             class dead_code_pass final : public default_pass {
             private:
                 class expression_pass : public default_expression_pass {
+                private:
+                    dead_code_pass& m_pass;
+
                 public:
+                    expression_pass(dead_code_pass& pass) : m_pass(pass) {}
+
                     std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::conditional_expression>&& node) override;
                     std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::arithmetic_operator>&& node) override;
                 };
 
                 class statement_pass : public default_statement_pass {
+                private:
+                    dead_code_pass& m_pass;
+
                 public:
+                    statement_pass(dead_code_pass& pass) : m_pass(pass) {}
+
                     std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::if_statement>&& node) override;
                     std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::loop_statement>&& node) override;
                     std::unique_ptr<logic::statement> dispatch(std::unique_ptr<logic::expression_statement>&& node) override;
                 };
 
+                // shared by every node of a run like in reassociate_pass. its results are keyed by node address, so
+                // every rewrite has to forget (or forget_tree) the nodes it destroys before they go. a later node
+                // allocated at the same address would otherwise get the destroyed node's answer
+                logic::analysis::side_effects_analyzer m_side_effects;
+
                 static bool is_truey(const logic::expression& expression) {
                     if (auto integer_constant = dynamic_cast<const logic::integer_constant*>(&expression)) {
                         return integer_constant->value() != 0;
@@ -48,9 +64,14 @@ namespace michaelcc {
 
             public:
                 dead_code_pass() : default_pass(
-                    std::make_unique<expression_pass>(),
-                    std::make_unique<statement_pass>()
+                    std::make_unique<expression_pass>(*this),
+                    std::make_unique<statement_pass>(*this)
                 ) { }
+
+                void transform(logic::translation_unit& unit) override {
+                    m_side_effects.clear();
+                    default_pass::transform(unit);
+                }
             };
         }
     }
@@ -0,0 +1,59 @@
+#ifndef MICHAELCC_REASSOCIATE_HPP
+#define MICHAELCC_REASSOCIATE_HPP
+
+#include "logic/optimization.hpp"
+#include "logic/ir.hpp"
+#include "logic/type_info.hpp"
+#include "logic/analysis/side_effects.hpp"
+
+namespace michaelcc {
+    namespace logic {
+        namespace optimization {
+            // canonicalizes integer arithmetic. chains of an associative operator are flattened, their constants folded
+            // into one that goes last and the other operands sorted by rank, so (x + 3) + 5 becomes x + 8 and x * 1 * y
+            // becomes x * y. a table of identities respecting the signedness and width of the type handles the rest,
+            // like x - x, (a << 2) << 3 and multiplying by a power of two
+            class reassociate_pass final : public default_pass {
+            private:
+                class expression_pass : public default_expression_pass {
+                private:
+                    reassociate_pass& m_pass;
+
+                public:
+                    expression_pass(reassociate_pass& pass) : m_pass(pass) {}
+
+                protected:
+                    std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::arithmetic_operator>&& node) override;
+                    std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::unary_operation>&& node) override;
+
+                private:
+                    // flattens a chain of +, *, &, | or ^ and rebuilds it in canonical form
+                    std::unique_ptr<logic::expression> reassociate(std::unique_ptr<logic::arithmetic_operator>&& node, size_t width, bool is_unsigned);
+
+                    // the identities of the operators that do not associate
+                    std::unique_ptr<logic::expression> simplify(std::unique_ptr<logic::arithmetic_operator>&& node, size_t width, bool is_unsigned);
+                };
+
+                type_layout_calculator m_layout_calculator;
+
+                // shared by every node of a run, so each operand subtree is walked once. a new run starts from nothing
+                // since other passes rebuild the IR. results are looked up by address, so a new rewrite must forget
+                // each node it destroys first, or a node later allocated in its place reads back a stale answer
+                logic::analysis::side_effects_analyzer m_side_effects;
+
+            public:
+                reassociate_pass(const platform_info& platform_info) : default_pass(
+                    std::make_unique<expression_pass>(*this),
+                    std::make_unique<default_statement_pass>()
+                ), m_layout_calculator(platform_info) { }
+
+                void transform(logic::translation_unit& unit) override {
+                    m_side_effects.clear();
+                    default_pass::transform(unit);
+                }
+            };
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef MICHAELCC_STRUCT_LAYOUT_HPP
+#define MICHAELCC_STRUCT_LAYOUT_HPP
+
+#include "logic/optimization.hpp"
+#include "logic/analysis/struct_access.hpp"
+#include "logic/ir.hpp"
+#include "platform.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace michaelcc {
+    namespace logic {
+        namespace optimization {
+            // reorders the fields of structs whose layout is unobservable so that the most accessed ones come first,
+            // then rewrites every member access with the new offsets. runs once, after the other passes, since the
+            // access counts should describe the code that is actually lowered.
+            class struct_layout_pass final : public default_pass {
+            public:
+                struct field_report {
+                    std::string name;
+                    size_t offset;
+                    size_t heat;
+                };
+
+                struct struct_report {
+                    std::string name;
+                    std::vector<field_report> fields;
+
+                    // why the layout was left alone, empty when the fields were ordered by heat
+                    std::string exposure;
+                };
+
+            private:
+                class expression_pass : public default_expression_pass {
+                public:
+                    std::unique_ptr<logic::expression> dispatch(std::unique_ptr<logic::member_access>&& node) override;
+                };
+
+                platform_info m_platform_info;
+                std::vector<struct_report> m_report;
+
+            public:
+                struct_layout_pass(const platform_info& platform_info) : default_pass(
+                    std::make_unique<expression_pass>(),
+                    std::make_unique<default_statement_pass>()
+                ), m_platform_info(platform_info) { }
+
+                void transform(logic::translation_unit& unit) override;
+
+                // the layout of every struct the unit accesses, fields in offset order
+                const std::vector<struct_report>& report() const noexcept { return m_report; }
+
+                void print_report(std::ostream& out) const;
+
+                // identifies the layouts the pass chose, anything reusing code compiled against them must key on it
+                std::string layout_signature() const;
+            };
+        }
+    }
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define MICHAELCC_SEMANTIC_HPP
 
 #include "syntax/ast.hpp"
+#include "syntax/parser.hpp"
 #include "logic/ir.hpp"
 #include "logic/typing.hpp"
 #include "logic/type_info.hpp"
@@ -249,8 +250,15 @@ namespace michaelcc {
             semantic_lowerer& m_lowerer;
             int m_current_loop_depth;
 
+            // loops and switches, which is what a break can leave
+            int m_current_break_depth;
+
+            // the value of a case label, or nothing if it is not an integer constant expression. throws on shifts and
+            // negations that have no value
+            static std::optional<int64_t> evaluate_case_value(const logic::expression& expression, const source_location& location);
+
         public:
-            statement_resolver(semantic_lowerer& lowerer) : m_lowerer(lowerer), m_current_loop_depth(0) { }
+            statement_resolver(semantic_lowerer& lowerer) : m_lowerer(lowerer), m_current_loop_depth(0), m_current_break_depth(0) { }
 
         protected:
             std::unique_ptr<logic::statement> dispatch(const ast::context_block& node) override;
@@ -259,6 +267,7 @@ namespace michaelcc {
             std::unique_ptr<logic::statement> dispatch(const ast::while_block& node) override;
             std::unique_ptr<logic::statement> dispatch(const ast::if_block& node) override;
             std::unique_ptr<logic::statement> dispatch(const ast::if_else_block& node) override;
+            std::unique_ptr<logic::statement> dispatch(const ast::switch_statement& node) override;
             std::unique_ptr<logic::statement> dispatch(const ast::return_statement& node) override;
             std::unique_ptr<logic::statement> dispatch(const ast::break_statement& node) override;
             std::unique_ptr<logic::statement> dispatch(const ast::continue_statement& node) override;
@@ -287,7 +296,17 @@ namespace michaelcc {
 
         std::map<std::shared_ptr<typing::base_type>, const source_location> m_type_declaration_locations;
 
+        // named types declared since their layouts were last checked
+        std::vector<std::shared_ptr<typing::base_type>> m_unchecked_layouts;
+
         void check_layout_dependencies(const std::shared_ptr<typing::base_type>& type);
+        void check_declared_layouts();
+
+        // lowers a global variable or function body, other elements only declare
+        void lower_definition(const ast::ast_element& element);
+
+        // checks every function is implemented and that inline functions are not recursive
+        void check_functions();
 
         bool is_index_type(const typing::qual_type& type) const noexcept {
             return type.is_same_type<typing::int_type>();
@@ -317,9 +336,25 @@ namespace michaelcc {
             m_statement_resolver(*this),
             m_symbol_explorer() { }
 
+        // continues from a unit that already holds declarations, e.g. those of a precompiled header
+        semantic_lowerer(const platform_info platform_info, logic::translation_unit&& declarations) 
+            : m_translation_unit(std::move(declarations)), m_platform_info(platform_info), 
+            m_layout_dependency_getter(m_translation_unit), 
+            m_type_layout_calculator(m_platform_info),
+            m_address_resolver(*this),
+            m_statement_resolver(*this),
+            m_symbol_explorer() { }
+
+        // declares the types, enumerators and function prototypes of the given top level elements without
+        // lowering any function bodies or variables. lower does this itself before lowering.
+        void declare(const std::vector<std::unique_ptr<ast::ast_element>>& ast);
 
         void lower(const std::vector<std::unique_ptr<ast::ast_element>>& ast);
 
+        // lowers declarations one at a time as the parser produces them, releasing each once it is lowered.
+        // unlike lower on a whole AST, everything has to be declared before it is used, as C requires.
+        void lower(parser& parser);
+
         const logic::translation_unit& get_translation_unit() const { return m_translation_unit; }
 
         logic::translation_unit&& release_translation_unit() { return std::move(m_translation_unit); m_translation_unit = logic::translation_unit(); }
@@ -527,6 +527,7 @@ namespace michaelcc {
         private:
             std::optional<std::string> m_name;
             std::vector<member> m_fields;
+            std::vector<size_t> m_field_heat;
         
             friend class type_context;
 
@@ -592,6 +593,14 @@ namespace michaelcc {
                 }
             }
 
+            // how often each field is accessed, weighted by loop depth. when the platform optimizes struct layout,
+            // hot fields are placed first. only set for structs whose layout nothing outside the unit can observe.
+            const std::vector<size_t>& field_heat() const noexcept { return m_field_heat; }
+
+            void implement_field_heat(std::vector<size_t>&& field_heat) {
+                m_field_heat = std::move(field_heat);
+            }
+
             void to_string(std::ostringstream& ss) const override {
                 if (m_name.has_value()) {
                     ss << "struct " << m_name.value();
@@ -0,0 +1,94 @@
+#ifndef MICHAELCC_PRECOMPILED_HEADER_HPP
+#define MICHAELCC_PRECOMPILED_HEADER_HPP
+
+#include "syntax/preprocessor.hpp"
+#include "syntax/parser.hpp"
+#include "syntax/tokens.hpp"
+#include "logic/ir.hpp"
+#include "platform.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace michaelcc {
+    // the state left behind by the #include directives a translation unit opens with: the macros they
+    // define, their typedefs, and the types, enumerators and function prototypes they declare.
+    // a later compilation whose leading includes start with the same headers, unchanged, loads it
+    // instead of preprocessing, parsing and lowering those headers again.
+    // only declarations can be precompiled, headers that define functions or variables are rejected.
+    class precompiled_header {
+    public:
+        // bump whenever the encoding changes, readers reject other versions
+        static constexpr uint64_t format_version = 1;
+
+    private:
+        std::string m_platform;
+        std::vector<std::filesystem::path> m_includes;
+        std::vector<std::pair<std::filesystem::path, std::string>> m_file_hashes;
+        std::vector<preprocessor::definition> m_definitions;
+        std::vector<token> m_typedef_tokens;
+        logic::translation_unit m_declarations;
+        std::string m_content_hash;
+
+        precompiled_header() = default;
+
+        friend class precompiled_header_cache;
+
+    public:
+        precompiled_header(precompiled_header&&) = default;
+
+        std::vector<uint8_t> serialize() const;
+
+        static precompiled_header deserialize(const std::vector<uint8_t>& bytes);
+
+        // captures the header prefix of a file that has been preprocessed, parsing and declaring it on its own
+        static precompiled_header create(const preprocessor& preprocessor, const std::string& platform, const platform_info& platform_info);
+
+        static precompiled_header load(const std::filesystem::path& path);
+
+        void save(const std::filesystem::path& path) const;
+
+        // whether this header can stand in for the start of a file with the given leading includes,
+        // compiled for the given platform. every header it was made from is hashed again to detect edits.
+        bool matches(const std::vector<std::filesystem::path>& leading_includes, const std::string& platform) const;
+
+        // identifies the headers' contents, compilations using this header must include it in their cache keys
+        const std::string& content_hash() const noexcept { return m_content_hash; }
+
+        void apply(preprocessor& preprocessor) const;
+
+        void apply(parser& parser) const;
+
+        // hands the declarations to a semantic_lowerer, which then lowers the rest of the file on top of them
+        logic::translation_unit&& release_declarations() noexcept { return std::move(m_declarations); }
+    };
+
+    // precompiled headers kept in memory by a long running compiler, one per platform and set of leading includes,
+    // so every compilation after the first one with the same includes starts from their macros, types and declarations.
+    // safe to use from several threads at once.
+    class precompiled_header_cache {
+    private:
+        struct entry {
+            // only used to match against, the declarations a compilation takes come from bytes
+            std::shared_ptr<const precompiled_header> header;
+            std::shared_ptr<const std::vector<uint8_t>> bytes;
+        };
+
+        std::mutex m_mutex;
+        std::vector<entry> m_entries;
+
+    public:
+        // a fresh copy of the header covering the most of the leading includes, if any is still up to date
+        std::optional<precompiled_header> find(const std::vector<std::filesystem::path>& leading_includes, const std::string& platform);
+
+        // replaces the entry for the same platform and includes, which is out of date if it exists
+        void insert(precompiled_header header);
+    };
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef MICHAELCC_SERIALIZATION_HPP
+#define MICHAELCC_SERIALIZATION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace michaelcc::serialization {
+    // building blocks shared by the compiler's binary formats. integers are LEB128 varints, signed ones
+    // zigzag encoded, and strings are indices into a table that is written ahead of the body.
+    // a file is: 4 byte magic, format version, string table (count, then length + bytes per string), body.
+
+    class byte_writer {
+    private:
+        std::vector<uint8_t> m_bytes;
+        std::vector<std::string> m_strings;
+        std::unordered_map<std::string, size_t> m_string_indices;
+
+    public:
+        const std::vector<uint8_t>& bytes() const noexcept { return m_bytes; }
+        const std::vector<std::string>& strings() const noexcept { return m_strings; }
+
+        void raw(const void* data, size_t size) {
+            auto* begin = static_cast<const uint8_t*>(data);
+            m_bytes.insert(m_bytes.end(), begin, begin + size);
+        }
+
+        void varint(uint64_t value) {
+            while (value >= 0x80) {
+                m_bytes.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            m_bytes.push_back(static_cast<uint8_t>(value));
+        }
+
+        void svarint(int64_t value) {
+            varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        void byte(uint8_t value) { m_bytes.push_back(value); }
+        void boolean(bool value) { byte(value ? 1 : 0); }
+
+        void string(const std::string& value) {
+            auto it = m_string_indices.find(value);
+            if (it == m_string_indices.end()) {
+                it = m_string_indices.insert({ value, m_strings.size() }).first;
+                m_strings.push_back(value);
+            }
+            varint(it->second);
+        }
+
+        template<typename T, typename Fn>
+        void optional(const std::optional<T>& value, Fn&& write_value) {
+            boolean(value.has_value());
+            if (value.has_value()) {
+                write_value(value.value());
+            }
+        }
+
+        // the string table has to come first for the reader, so it is written once the body is complete
+        std::vector<uint8_t> finish(const char (&magic)[4], uint64_t format_version) const {
+            byte_writer header;
+            header.raw(magic, sizeof(magic));
+            header.varint(format_version);
+            header.varint(m_strings.size());
+            for (const auto& str : m_strings) {
+                header.varint(str.size());
+                header.raw(str.data(), str.size());
+            }
+
+            std::vector<uint8_t> result = std::move(header.m_bytes);
+            result.insert(result.end(), m_bytes.begin(), m_bytes.end());
+            return result;
+        }
+    };
+
+    class byte_reader {
+    private:
+        std::span<const uint8_t> m_data;
+        size_t m_position = 0;
+        std::vector<std::string> m_strings;
+        std::string m_format_name;
+
+    public:
+        // the format name only appears in error messages, e.g. "serialized linear IR"
+        byte_reader(std::span<const uint8_t> data, std::string format_name) : m_data(data), m_format_name(std::move(format_name)) {}
+
+        [[noreturn]] void malformed(const char* what) const {
+            throw std::runtime_error(std::format("Malformed {} at byte {}: {}", m_format_name, m_position, what));
+        }
+
+        const uint8_t* raw(size_t size) {
+            if (m_data.size() - m_position < size) {
+                malformed("unexpected end of data");
+            }
+            const uint8_t* begin = m_data.data() + m_position;
+            m_position += size;
+            return begin;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                uint8_t current = *raw(1);
+                value |= static_cast<uint64_t>(current & 0x7f) << shift;
+                if (!(current & 0x80)) {
+                    return value;
+                }
+            }
+            malformed("varint too long");
+        }
+
+        int64_t svarint() {
+            uint64_t value = varint();
+            return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+        }
+
+        size_t count() {
+            uint64_t value = varint();
+            // every element takes at least one byte, anything larger cannot be valid
+            if (value > m_data.size() - m_position) {
+                malformed("element count exceeds remaining data");
+            }
+            return static_cast<size_t>(value);
+        }
+
+        uint8_t byte() { return *raw(1); }
+        bool boolean() { return byte() != 0; }
+
+        const std::string& string() {
+            uint64_t index = varint();
+            if (index >= m_strings.size()) {
+                malformed("string index out of range");
+            }
+            return m_strings[index];
+        }
+
+        template<typename Fn>
+        auto optional(Fn&& read_value) -> std::optional<decltype(read_value())> {
+            if (!boolean()) {
+                return std::nullopt;
+            }
+            return read_value();
+        }
+
+        // checks the magic and version, then loads the string table
+        void read_header(const char (&magic)[4], uint64_t format_version) {
+            if (std::memcmp(raw(sizeof(magic)), magic, sizeof(magic)) != 0) {
+                malformed("bad magic");
+            }
+            if (varint() != format_version) {
+                malformed("unsupported format version");
+            }
+
+            m_strings.resize(count());
+            for (auto& str : m_strings) {
+                size_t length = count();
+                const uint8_t* bytes = raw(length);
+                str.assign(reinterpret_cast<const char*>(bytes), length);
+            }
+        }
+
+        bool at_end() const noexcept { return m_position == m_data.size(); }
+    };
+}
+
+#endif
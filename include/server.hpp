@@ -0,0 +1,22 @@
+#ifndef MICHAELCC_SERVER_HPP
+#define MICHAELCC_SERVER_HPP
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace michaelcc::server {
+    // handles one compile request, given the command line arguments a client forwarded.
+    // diagnostics are sent back to the client whenever the stream is flushed, the return value becomes its exit code.
+    using request_handler = std::function<int(const std::vector<std::string>& arguments, std::ostream& diagnostics)>;
+
+    // accepts clients of the same user on a unix domain socket at socket_path until the process is terminated.
+    // up to 16 connections are served at once, each on its own thread, so the handler must be safe to call concurrently.
+    void serve(const std::string& socket_path, const request_handler& handler);
+
+    // sends the arguments to a server, copies its diagnostics to the given stream as they arrive and returns its exit code
+    int forward(const std::string& socket_path, const std::vector<std::string>& arguments, std::ostream& diagnostics);
+}
+
+#endif
@@ -25,6 +25,7 @@ namespace michaelcc {
         class while_block;
         class if_block;
         class if_else_block;
+        class switch_statement;
         class return_statement;
         class break_statement;
         class continue_statement;
@@ -63,6 +64,7 @@ namespace michaelcc {
             while_block,
             if_block,
             if_else_block,
+            switch_statement,
             return_statement,
             break_statement,
             continue_statement,
@@ -141,6 +143,7 @@ namespace michaelcc {
             while_block,
             if_block,
             if_else_block,
+            switch_statement,
             return_statement,
             break_statement,
             continue_statement,
@@ -177,6 +180,7 @@ namespace michaelcc {
             const while_block,
             const if_block,
             const if_else_block,
+            const switch_statement,
             const return_statement,
             const break_statement,
             const continue_statement,
@@ -560,6 +564,57 @@ namespace michaelcc {
             }
         };
 
+        class switch_statement final : public ast_element {
+        public:
+            // the statements after one case label, up to the next label. control falls through into the next case
+            struct switch_case {
+                // null for the default label
+                std::unique_ptr<ast_element> value;
+                context_block body;
+            };
+
+        private:
+            std::unique_ptr<ast_element> m_condition;
+            std::vector<switch_case> m_cases;
+
+        public:
+            switch_statement(std::unique_ptr<ast_element>&& condition, std::vector<switch_case>&& cases, source_location&& location)
+                : ast_element(std::move(location)),
+                m_condition(std::move(condition)),
+                m_cases(std::move(cases)) {}
+
+            const ast_element* condition() const noexcept { return m_condition.get(); }
+            const std::vector<switch_case>& cases() const noexcept { return m_cases; }
+
+            std::unique_ptr<ast_element> clone() const override {
+                std::vector<switch_case> cloned;
+                cloned.reserve(m_cases.size());
+                for (const auto& switch_case : m_cases) {
+                    auto cloned_body = switch_case.body.clone();
+                    cloned.push_back(switch_statement::switch_case{
+                        .value = switch_case.value ? switch_case.value->clone() : nullptr,
+                        .body = std::move(*static_cast<context_block*>(cloned_body.release()))
+                    });
+                }
+                return std::make_unique<switch_statement>(
+                    m_condition->clone(),
+                    std::move(cloned),
+                    source_location(location())
+                );
+            }
+
+            void accept(visitor& v) const override {
+                v.visit(*this);
+                m_condition->accept(v);
+                for (const auto& switch_case : m_cases) {
+                    if (switch_case.value) {
+                        switch_case.value->accept(v);
+                    }
+                    switch_case.body.accept(v);
+                }
+            }
+        };
+
         class return_statement final : public ast_element {
         private:
             std::unique_ptr<ast_element> m_value;
@@ -1100,7 +1155,7 @@ namespace michaelcc {
                         feild.type()->clone(),
                         std::string(feild.identifier()),
                         source_location(feild.location()),
-                        feild.set_value() != nullptr ? std::make_optional(feild.set_value().value()->clone()) : std::nullopt
+                        feild.set_value().has_value() ? std::make_optional(feild.set_value().value()->clone()) : std::nullopt
                     ));
                 }
                 return std::make_unique<struct_declaration>(std::optional<std::string>(m_struct_name), std::move(cloned_feilds), source_location(location()));
@@ -2,8 +2,10 @@
 #define MICHAELCC_PARSER_HPP
 
 #include <cstdint>
+#include <deque>
 #include <unordered_map>
 #include "tokens.hpp"
+#include "token_stream.hpp"
 #include "ast.hpp"
 #include "errors.hpp"
 
@@ -18,15 +20,24 @@ namespace michaelcc {
 		// Result being built (moved out at end of parse_all)
 		std::vector<std::unique_ptr<ast::ast_element>> m_result;
 
-		// Internal typedef tracking for type substitution
-		std::unordered_map<std::string, const ast::ast_element*> m_typedefs;
+		// Internal typedef tracking for type substitution, owning a copy of each type so that
+		// declarations handed out by parse_next can be released while their typedefs stay usable
+		std::unordered_map<std::string, std::unique_ptr<ast::ast_element>> m_typedefs;
+
+		// Tokens of every typedef declaration parsed
+		std::vector<token> m_typedef_tokens;
+
+		// Window of tokens starting at the current top level declaration, the furthest the parser backtracks.
+		// When parsing from a stream, tokens are pulled into it on demand and dropped once their declaration is done.
+		std::deque<token> m_tokens;
+		size_t m_window_begin;
+		token_stream* m_source;
 
-		std::vector<token> m_tokens;
 		int64_t m_token_index;
 		source_location current_loc;
 
 		const bool end() const noexcept {
-			return m_tokens.size() == m_token_index;
+			return static_cast<int64_t>(m_window_begin + m_tokens.size()) == m_token_index;
 		}
 
 		const token current_token() const {
@@ -34,10 +45,12 @@ namespace michaelcc {
 				return token(MICHAELCC_TOKEN_END, current_loc.col());
 			}
 			
-			return m_tokens.at(m_token_index);
+			return m_tokens.at(static_cast<size_t>(m_token_index) - m_window_begin);
 		}
 
-		void next_token() noexcept;
+		void next_token();
+		void fill_window();
+		void release_window();
 		void match_token(token_type type) const;
 
 		const token scan_token() {
@@ -86,18 +99,46 @@ namespace michaelcc {
 		// Find a typedef - returns nullptr if not found
 		const ast::ast_element* find_typedef(const std::string& name) const {
 			auto it = m_typedefs.find(name);
-			return it != m_typedefs.end() ? it->second : nullptr;
+			return it != m_typedefs.end() ? it->second.get() : nullptr;
 		}
 
+		// Parses one top level declaration into m_result, returns false at the end of the tokens
+		bool parse_top_level();
+
 	public:
-		parser(std::vector<token>&& tokens) :
-			m_tokens(std::move(tokens)), 
+		parser(std::vector<token> tokens) :
+			m_tokens(std::make_move_iterator(tokens.begin()), std::make_move_iterator(tokens.end())), 
+			m_window_begin(0),
+			m_source(nullptr),
+			m_token_index(-1),
+			current_loc(0, 0, "invalid_file") { 
+			next_token();
+		}
+
+		// Parses tokens as they are pulled from source, which must outlive the parser
+		parser(token_stream& source) :
+			m_window_begin(0),
+			m_source(&source),
 			m_token_index(-1),
 			current_loc(0, 0, "invalid_file") { 
 			next_token();
 		}
 
 		std::vector<std::unique_ptr<ast::ast_element>> parse_all();
+
+		// Parses and returns the next top level declaration, or nullptr once all tokens are consumed.
+		// Only the tokens of the declaration being parsed are held, so memory grows with the largest declaration, not the file.
+		std::unique_ptr<ast::ast_element> parse_next();
+
+		// The tokens of every typedef declaration parsed so far, each ending in its semicolon.
+		// Parsing them again restores the typedef table, which is how precompiled headers carry it.
+		const std::vector<token>& typedef_tokens() const noexcept {
+			return m_typedef_tokens;
+		}
+
+		// Makes the typedefs declared by tokens from typedef_tokens() available before parsing.
+		// The declarations are only used for type substitution, they do not appear in the result.
+		void import_typedefs(const std::vector<token>& tokens);
 	};
 }
 
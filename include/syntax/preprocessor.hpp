@@ -8,17 +8,20 @@
 #include <deque>
 #include <optional>
 #include <filesystem>
+#include <thread>
 
 #include "tokens.hpp"
+#include "token_stream.hpp"
+#include "bounded_queue.hpp"
 #include "errors.hpp"
 
 namespace michaelcc {
-	class preprocessor {
+	class preprocessor : public token_stream {
 	private:
 		class scanner {
 		private:
-			const std::filesystem::path m_file_name;
-			const std::string m_source;
+			std::filesystem::path m_file_name;
+			std::string m_source;
 
 			std::pair<size_t, size_t> last_tok_begin;
 			token m_last_tok = token(MICHAELCC_TOKEN_END, 0);
@@ -29,7 +32,7 @@ namespace michaelcc {
 
 			std::deque<token> token_backlog;
 
-			const std::map<std::string, token_type> preprocessor_keywords{
+			static inline const std::map<std::string, token_type> preprocessor_keywords{
 				{ "define", MICHAELCC_PREPROCESSOR_TOKEN_DEFINE },
 				{ "ifdef", MICHAELCC_PREPROCESSOR_TOKEN_IFDEF },
 				{ "ifndef", MICHAELCC_PREPROCESSOR_TOKEN_IFNDEF },
@@ -38,7 +41,7 @@ namespace michaelcc {
 				{ "include", MICHAELCC_PREPROCESSOR_TOKEN_INCLUDE }
 			};
 
-			const std::map<std::string, token_type> keywords = {
+			static inline const std::map<std::string, token_type> keywords = {
 				{ "auto", MICHAELCC_TOKEN_AUTO },
 				{ "break", MICHAELCC_TOKEN_BREAK },
 				{ "case", MICHAELCC_TOKEN_CASE },
@@ -86,7 +89,7 @@ namespace michaelcc {
 				return compilation_error(msg, source_location(current_row, current_col, m_file_name));
 			}
 		public:
-			scanner(const std::string m_source, const std::filesystem::path m_file_name) : m_source(m_source), m_file_name(m_file_name), last_tok_begin(1,1) {
+			scanner(std::string source, std::filesystem::path file_name) : m_file_name(std::move(file_name)), m_source(std::move(source)), last_tok_begin(1,1) {
 
 			}
 
@@ -124,6 +127,7 @@ namespace michaelcc {
 			std::optional<std::filesystem::path> resolve_file_path(std::filesystem::path file_path);
 		};
 
+	public:
 		class definition {
 		private:
 			const std::string m_name;
@@ -141,8 +145,27 @@ namespace michaelcc {
 			const source_location location() {
 				return m_location.value();
 			}
+
+			const std::string& name() const noexcept { return m_name; }
+			const std::vector<std::string>& params() const noexcept { return m_params; }
+			const std::vector<token>& tokens() const noexcept { return m_tokens; }
+			const std::optional<source_location>& declared_location() const noexcept { return m_location; }
+		};
+
+		// the run of #include directives a main file opens with. precompiled headers capture the state it
+		// leaves behind, so that later compilations starting with the same includes can skip them.
+		struct header_prefix {
+			// resolved paths of the directives, in order
+			std::vector<std::filesystem::path> includes;
+			// every file read for them, nested includes too
+			std::vector<std::filesystem::path> files;
+			// how many leading tokens of result() came from the prefix
+			size_t token_count = 0;
+			// macros defined by the time the prefix ended
+			std::vector<std::string> macro_names;
 		};
 
+	private:
 		struct preprocessor_scope {
 			token_type type;
 			source_location begin_location;
@@ -155,8 +178,28 @@ namespace michaelcc {
 		};
 
 		std::vector<token> m_result;
-		std::vector<scanner> m_scanners;
+		// a deque, so that including a file never moves the sources of the files including it
+		std::deque<scanner> m_scanners;
 		std::map<std::string, definition> m_definitions;
+		std::vector<preprocessor_scope> m_scopes;
+
+		// tokens produced but not yet pulled by next()
+		std::deque<token> m_pending;
+		size_t m_emitted = 0;
+
+		void emit(token&& tok) {
+			m_pending.push_back(std::move(tok));
+			m_emitted++;
+		}
+
+		// processes one token from the innermost file. returns false once every file has been read.
+		bool step();
+
+		header_prefix m_prefix;
+		bool m_in_prefix = true;
+		size_t m_skipped_includes = 0;
+
+		void end_prefix();
 
 		const compilation_error panic(const std::string msg) const noexcept {
 			return compilation_error(msg, m_scanners.back().location());
@@ -165,14 +208,56 @@ namespace michaelcc {
 		token expect_token(token_type type);
 	public:
 		preprocessor(std::string source, const std::filesystem::path file_name) {
-			m_scanners.emplace_back(scanner(source, file_name));
+			m_scanners.emplace_back(std::move(source), file_name);
+			emit(token(m_scanners.front().location()));
 		}
 
+		// preprocesses the whole file into result()
 		void preprocess();
 
+		// preprocesses only as far as needed to produce the next token. use either this or preprocess, not both.
+		std::optional<token> next() override;
+
 		const std::vector<token>& result() const noexcept {
 			return m_result;
 		}
+
+		std::vector<token>&& release_result() noexcept {
+			return std::move(m_result);
+		}
+
+		const header_prefix& prefix() const noexcept {
+			return m_prefix;
+		}
+
+		// the definitions of the macros named by prefix().macro_names
+		std::vector<definition> prefix_definitions() const;
+
+		// treats the first count leading #include directives as already processed, defining the given macros in
+		// their place. must be called before preprocess; the caller checks that the includes really match.
+		void skip_leading_includes(size_t count, const std::vector<definition>& definitions);
+
+		// resolves the #include directives a file opens with, without preprocessing anything else
+		static std::vector<std::filesystem::path> leading_includes(const std::string& source, const std::filesystem::path& file_name);
+	};
+
+	// runs a preprocessor on a thread of its own, so that lexing overlaps parsing. its tokens are handed over through
+	// a bounded_queue, which bounds how far the preprocessor can run ahead. errors are rethrown to the reader.
+	class background_preprocessor final : public token_stream {
+	private:
+		bounded_queue<token> m_tokens;
+		std::thread m_thread;
+
+	public:
+		background_preprocessor(preprocessor& preprocessor, size_t capacity);
+		~background_preprocessor();
+
+		background_preprocessor(const background_preprocessor&) = delete;
+		background_preprocessor& operator=(const background_preprocessor&) = delete;
+
+		std::optional<token> next() override {
+			return m_tokens.pop();
+		}
 	};
 }
 
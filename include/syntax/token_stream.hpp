@@ -0,0 +1,19 @@
+#ifndef MICHAELCC_TOKEN_STREAM_HPP
+#define MICHAELCC_TOKEN_STREAM_HPP
+
+#include <optional>
+
+#include "tokens.hpp"
+
+namespace michaelcc {
+	// a source the parser pulls tokens from one at a time, so that the whole token stream never has to exist at once
+	class token_stream {
+	public:
+		virtual ~token_stream() = default;
+
+		// the next token, or nullopt once the stream is exhausted
+		virtual std::optional<token> next() = 0;
+	};
+}
+
+#endif
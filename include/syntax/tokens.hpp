@@ -158,6 +158,8 @@ namespace michaelcc {
 			}
 		}
 
+		token(token&& to_move) noexcept = default;
+
 		const token_type type() const noexcept {
 			return m_type;
 		}
@@ -62,6 +62,37 @@ void michaelcc::isa::lc2200::lc2200_assembler::begin_function_preamble(const lin
     write_comment("reserve space for locals");
 }
 
+void michaelcc::isa::lc2200::lc2200_assembler::begin_data_section() {
+    m_output << "\n";
+    write_comment("data");
+}
+
+void michaelcc::isa::lc2200::lc2200_assembler::begin_bss_section() {
+    m_output << "\n";
+    write_comment("bss");
+}
+
+void michaelcc::isa::lc2200::lc2200_assembler::emit_data_word(const linear::static_storage::data_word& word) {
+    begin_new_line();
+    if (word.label_ref.has_value()) {
+        m_output << ".word " << word.label_ref.value();
+        return;
+    }
+
+    // every lc2200 word is 32 bits wide, narrower values are widened to a full word
+    switch (word.size) {
+        case linear::word_size::MICHAELCC_WORD_SIZE_BYTE: m_output << ".word " << static_cast<uint32_t>(word.value.ubyte); break;
+        case linear::word_size::MICHAELCC_WORD_SIZE_UINT16: m_output << ".word " << static_cast<uint32_t>(word.value.uint16); break;
+        case linear::word_size::MICHAELCC_WORD_SIZE_UINT32: m_output << ".word " << word.value.uint32; break;
+        default: throw std::runtime_error("LC-2200 cannot emit data words wider than 32 bits");
+    }
+}
+
+void michaelcc::isa::lc2200::lc2200_assembler::emit_zero_fill(size_t size) {
+    begin_new_line();
+    m_output << ".space " << size;
+}
+
 void michaelcc::isa::lc2200::lc2200_assembler::begin_function_call(const linear::function_call& instruction) {
     std::vector<linear::register_t> physical_registers_to_save;
     for (auto vreg : instruction.caller_saved_registers()) {
@@ -505,10 +536,13 @@ void michaelcc::isa::lc2200::lc2200_assembler::dispatch(const linear::a2_instruc
         break;
     }
     case linear::a_instruction_type::MICHAELCC_LINEAR_A_SHIFT_LEFT:{
-        if (instruction.constant() < 1) { break; }
+        if (instruction.constant() < 1) {
+            m_output << "add " << physical_destination.name << ", " << physical_a.name << ", $zero";
+            break;
+        }
 
         m_output << "add " << physical_destination.name << ", " << physical_a.name << ", " << physical_a.name;
-        for (size_t i = 0; i < instruction.constant(); i++) {
+        for (size_t i = 1; i < instruction.constant(); i++) {
             begin_new_line();
             m_output << "add " << physical_destination.name << ", " << physical_destination.name << ", " << physical_destination.name;
         }
@@ -655,6 +689,71 @@ void michaelcc::isa::lc2200::lc2200_assembler::dispatch(const linear::branch_con
     }
 }
 
+void michaelcc::isa::lc2200::lc2200_assembler::dispatch(const linear::jump_table& instruction) {
+    auto physical_index = get_physical_register(instruction.index());
+    std::string table_label = generate_symbol();
+
+    // load the target address out of the table into $at (scratch) and jump there
+    begin_new_line();
+    m_output << "la $at, " << table_label;
+    begin_new_line();
+    m_output << "add $at, $at, " << physical_index.name;
+    begin_new_line();
+    m_output << "lw $at, 0($at)";
+    begin_new_line();
+    m_output << "jalr $at, $zero";
+
+    // the table stays in the function's text, so its labels move along when the function's assembly is reused
+    emit_label(table_label);
+    for (size_t target_block_id : instruction.target_block_ids()) {
+        begin_new_line();
+        m_output << ".word block" << target_block_id;
+    }
+}
+
+// a mask built out of nand, (a & mask) | (b & ~mask), takes a dozen instructions here, so a short forward branch over
+// a move is always the cheaper expansion
+void michaelcc::isa::lc2200::lc2200_assembler::dispatch(const linear::select_instruction& instruction) {
+    auto physical_destination = get_physical_register(instruction.destination());
+    auto physical_condition = get_physical_register(instruction.condition());
+    auto physical_true = get_physical_register(instruction.if_true());
+    auto physical_false = get_physical_register(instruction.if_false());
+
+    auto emit_move = [&](const linear::register_info& source) {
+        if (source.id != physical_destination.id) {
+            begin_new_line();
+            m_output << "add " << physical_destination.name << ", " << source.name << ", $zero";
+        }
+    };
+
+    if (physical_true.id == physical_false.id) {
+        emit_move(physical_true);
+        return;
+    }
+
+    std::string end_label = generate_symbol();
+
+    // the false value goes in first unless that would clobber the condition or the true value
+    if (physical_destination.id != physical_condition.id && physical_destination.id != physical_true.id) {
+        emit_move(physical_false);
+        begin_new_line();
+        m_output << "beq " << physical_condition.name << ", $zero, " << end_label;
+        emit_move(physical_true);
+        emit_label(end_label);
+        return;
+    }
+
+    std::string false_label = generate_symbol();
+    begin_new_line();
+    m_output << "beq " << physical_condition.name << ", $zero, " << false_label;
+    emit_move(physical_true);
+    begin_new_line();
+    m_output << "beq $zero, $zero, " << end_label;
+    emit_label(false_label);
+    emit_move(physical_false);
+    emit_label(end_label);
+}
+
 void michaelcc::isa::lc2200::lc2200_assembler::dispatch(const linear::push_function_argument& instruction) {
     auto& function_call_info = m_function_call_infos.at(instruction.function_call_id());
     auto argument_physical_register = get_physical_register(instruction.value());
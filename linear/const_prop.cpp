@@ -52,6 +52,23 @@ bool michaelcc::linear::optimization::const_prop_pass::optimize(translation_unit
         block.replace_instructions(std::move(new_instructions));
     }
 
+    // a folded branch leaves values in the phis of the successors it no longer goes to
+    for (const auto& [block_id, successor_block_id] : m_removed_edges) {
+        for (auto& instruction : unit.blocks.at(successor_block_id).mutable_instructions()) {
+            auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+            if (!phi) {
+                continue;
+            }
+            std::vector<var_info> values;
+            for (const auto& value : phi->values()) {
+                if (value.block_id != block_id) {
+                    values.push_back(value);
+                }
+            }
+            instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+        }
+    }
+
     return made_changes;
 }
 
@@ -532,14 +549,34 @@ std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization:
     if (condition_const.value().uint64 == 0) { //take false branch
         m_unit.blocks.at(m_pass.m_current_block_id.value()).remove_successor_block_id(node.if_true_block_id());
         m_unit.blocks.at(node.if_true_block_id()).remove_predecessor_block_id(m_pass.m_current_block_id.value());
+        m_pass.m_removed_edges.push_back({ m_pass.m_current_block_id.value(), node.if_true_block_id() });
         return std::make_unique<branch>(node.if_false_block_id());
     } else { //take true branch
         m_unit.blocks.at(m_pass.m_current_block_id.value()).remove_successor_block_id(node.if_false_block_id());
         m_unit.blocks.at(node.if_false_block_id()).remove_predecessor_block_id(m_pass.m_current_block_id.value());
+        m_pass.m_removed_edges.push_back({ m_pass.m_current_block_id.value(), node.if_false_block_id() });
         return std::make_unique<branch>(node.if_true_block_id());
     }
 }
 
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::const_prop_pass::instruction_pass::dispatch(const michaelcc::linear::jump_table& node) {
+    auto index_const = m_pass.get_const_value(node.index());
+    if (!index_const.has_value() || index_const.value().uint64 >= node.target_block_ids().size()) {
+        return nullptr;
+    }
+
+    size_t current_block_id = m_pass.m_current_block_id.value();
+    size_t target_block_id = node.target_block_ids().at(index_const.value().uint64);
+    for (size_t successor_block_id : node.successor_block_ids()) {
+        if (successor_block_id != target_block_id) {
+            m_unit.blocks.at(current_block_id).remove_successor_block_id(successor_block_id);
+            m_unit.blocks.at(successor_block_id).remove_predecessor_block_id(current_block_id);
+            m_pass.m_removed_edges.push_back({ current_block_id, successor_block_id });
+        }
+    }
+    return std::make_unique<branch>(target_block_id);
+}
+
 std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::const_prop_pass::instruction_pass::dispatch(const michaelcc::linear::phi_instruction& node) {
     std::optional<register_word> common_value;
     
@@ -558,4 +595,17 @@ std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization:
 
     assert(common_value.has_value());
     return std::make_unique<init_register>(node.destination(), common_value.value());
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::const_prop_pass::instruction_pass::dispatch(const michaelcc::linear::select_instruction& node) {
+    // copy propagation cleans up the copy afterwards
+    if (node.if_true() == node.if_false()) {
+        return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), node.if_true());
+    }
+
+    auto condition_const = m_pass.get_const_value(node.condition());
+    if (!condition_const.has_value()) {
+        return nullptr;
+    }
+    return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), condition_const.value().uint64 != 0 ? node.if_true() : node.if_false());
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "linear/optimization/copy_prop.hpp"
 #include "linear/dominators.hpp"
 #include "linear/ir.hpp"
+#include <unordered_set>
 #include <utility>
 
 void michaelcc::linear::optimization::copy_prop_pass::prescan(const translation_unit& unit) {
@@ -17,66 +18,78 @@ void michaelcc::linear::optimization::copy_prop_pass::prescan(const translation_
     }
 }
 
+michaelcc::linear::virtual_register michaelcc::linear::optimization::copy_prop_pass::find_source(virtual_register vreg) {
+    auto it = m_copy_sources.find(vreg);
+    if (it == m_copy_sources.end()) {
+        return vreg;
+    }
+    auto root = find_source(it->second);
+    it->second = root;
+    return root;
+}
+
 bool michaelcc::linear::optimization::copy_prop_pass::optimize(translation_unit& unit) {
-    bool made_changes = false;
-    std::unordered_map<virtual_register, virtual_register> m_vreg_substitutions;
-    for (auto& [block_id, block] : unit.blocks) {
-        std::vector<std::unique_ptr<instruction>> released_instructions = block.release_instructions();
-        std::vector<std::unique_ptr<instruction>> new_instructions;
-        new_instructions.reserve(released_instructions.size());
+    // first find every copy that can be removed, so each operand is rewritten once below
+    std::unordered_set<const instruction*> removed_copies;
+    for (const auto& [block_id, block] : unit.blocks) {
+        for (const auto& instruction : block.instructions()) {
+            auto* copy = dynamic_cast<const linear::c_instruction*>(instruction.get());
+            if (!copy || copy->type() != MICHAELCC_LINEAR_C_COPY_INIT) {
+                continue;
+            }
 
-        auto push_instruction = [&](std::unique_ptr<instruction>&& instruction) {
-            replace_operands_transform transform(m_vreg_substitutions);
-            auto new_instruction = transform(*instruction.get());
-            if (new_instruction) {
-                new_instructions.emplace_back(std::move(new_instruction));
-            } else {
-                new_instructions.emplace_back(std::move(instruction));
+            // a chain of copies collapses onto the value that started it
+            auto source = find_source(copy->source());
+            size_t source_block_id = m_instruction_map.at(source);
+            assert(source.reg_size == copy->destination().reg_size);
+            assert(source.reg_class == copy->destination().reg_class);
+
+            if (!linear::dominates(unit, source_block_id, block_id)) {
+                continue;
             }
-        };
 
-        for (auto& instruction : released_instructions) {
-            if (auto* copy = dynamic_cast<linear::c_instruction*>(instruction.get())) {
-                if (copy->type() != MICHAELCC_LINEAR_C_COPY_INIT) {
-                    push_instruction(std::move(instruction));
+            // if the destination is a physical register, we must keep that vreg
+            if (unit.vreg_colors.contains(copy->destination())) {
+                // source instruction must be from the same block
+                if (source_block_id != block_id) {
                     continue;
                 }
-                
-                size_t source_block_id = m_instruction_map.at(copy->source());
-                assert(copy->source().reg_size == copy->destination().reg_size);
-                assert(copy->source().reg_class == copy->destination().reg_class);
 
-                if (!linear::is_dominated_by(unit, source_block_id, block_id)) {
-                    push_instruction(std::move(instruction));
+                auto color = unit.vreg_colors.at(copy->destination());
+                auto source_color = unit.vreg_colors.find(source);
+                if (source_color != unit.vreg_colors.end() && source_color->second != color) {
                     continue;
                 }
 
-                // if the destination is a physical register, we must keep that vreg
-                if (unit.vreg_colors.contains(copy->destination())) {
-                    // source instruction must be from the same block
-                    if (source_block_id != block_id) {
-                        push_instruction(std::move(instruction));
-                        continue;
-                    }
+                // add the register allocation information
+                unit.vreg_colors[source] = color;
+                unit.free_vreg(copy->destination());
+            }
+
+            m_copy_sources.insert({ copy->destination(), source });
+            removed_copies.insert(copy);
+        }
+    }
 
-                    // add the register allocation information
-                    unit.vreg_colors[copy->source()] = unit.vreg_colors.at(copy->destination());
-                    unit.free_vreg(copy->destination());
-                }
+    if (removed_copies.empty()) {
+        return false;
+    }
 
-                // insert the substitution into the map
-                m_vreg_substitutions.insert({
-                    copy->destination(),
-                    copy->source()
-                });
+    for (auto& [vreg, source] : m_copy_sources) {
+        source = find_source(source);
+    }
 
-                made_changes = true;
-            }
-            else {
-                push_instruction(std::move(instruction));
+    replace_operands_transform transform(m_copy_sources);
+    for (auto& [block_id, block] : unit.blocks) {
+        auto& instructions = block.mutable_instructions();
+        std::erase_if(instructions, [&](const std::unique_ptr<instruction>& instruction) {
+            return removed_copies.contains(instruction.get());
+        });
+        for (auto& instruction : instructions) {
+            if (auto new_instruction = transform(*instruction)) {
+                instruction = std::move(new_instruction);
             }
         }
-        block.replace_instructions(std::move(new_instructions));
     }
-    return made_changes;
+    return true;
 }
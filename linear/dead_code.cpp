@@ -103,6 +103,10 @@ bool michaelcc::linear::optimization::dead_block_pass::optimize(translation_unit
 
     if (!dead_block_ids.empty()) {
         for (auto& [block_id, block] : unit.blocks) {
+            for (size_t dead_block_id : dead_block_ids) {
+                block.remove_predecessor_block_id(dead_block_id);
+            }
+
             auto released = block.release_instructions();
             std::vector<std::unique_ptr<instruction>> new_instructions;
             new_instructions.reserve(released.size());
@@ -10,7 +10,6 @@
 #include <algorithm>
 #include <format>
 #include <memory>
-#include <sstream>
 #include <unordered_set>
 #include <variant>
 #include <stdexcept>
@@ -86,6 +85,7 @@ void logic_lowerer::emit_phi_all() {
         .init_phi_nodes = std::move(init_phi_nodes)
     };
     m_loop_stack.push_back(current_block_id());
+    m_break_stack.push_back(current_block_id());
 }
 
 void logic_lowerer::recurse_block(size_t source_block_id, size_t target_block_id) {
@@ -106,7 +106,14 @@ linear::virtual_register logic_lowerer::get_var_reg(const std::shared_ptr<logic:
             get_platform_info().pointer_size,
             linear::register_class::MICHAELCC_REGISTER_CLASS_INTEGER
         );
-        std::string label = m_current_function.has_value() ? m_current_function->static_var_labels.at(variable) : variable->name();
+        // globals are labelled by name, static locals by the label their declaration was given
+        std::string label = variable->name();
+        if (m_current_function.has_value()) {
+            auto label_it = m_current_function->static_var_labels.find(variable);
+            if (label_it != m_current_function->static_var_labels.end()) {
+                label = label_it->second;
+            }
+        }
         emit(std::make_unique<linear::load_effective_address>(addr_reg, label));
         return addr_reg;
     }
@@ -291,6 +298,98 @@ std::optional<size_t> logic_lowerer::lower_statements(const std::vector<std::uni
     return last_block_id;
 }
 
+size_t logic_lowerer::emit_compare_branch(linear::a_instruction_type type, linear::virtual_register condition, int64_t constant, size_t if_true_block_id, size_t if_false_block_id) {
+    auto constant_reg = m_translation_unit.new_vreg(condition.reg_size, condition.reg_class);
+    emit(std::make_unique<linear::init_register>(constant_reg, linear::register_word{ .uint64 = static_cast<uint64_t>(constant) }));
+
+    auto result_reg = m_translation_unit.new_vreg(get_platform_info().int_size, linear::register_class::MICHAELCC_REGISTER_CLASS_INTEGER);
+    emit(std::make_unique<linear::a_instruction>(type, result_reg, condition, constant_reg));
+    emit(std::make_unique<linear::branch_condition>(result_reg, if_true_block_id, if_false_block_id, false));
+    return seal_block();
+}
+
+void logic_lowerer::lower_switch_dispatch(linear::virtual_register condition, bool is_unsigned, const std::vector<switch_target>& targets, size_t begin, size_t end, size_t default_block_id,
+    std::optional<int64_t> lower_bound, std::optional<int64_t> upper_bound, std::unordered_map<size_t, std::vector<size_t>>& incoming_block_ids) {
+    size_t count = end - begin;
+    if (count == 0) {
+        emit(std::make_unique<linear::branch>(default_block_id));
+        incoming_block_ids[default_block_id].push_back(seal_block());
+        return;
+    }
+
+    int64_t min_value = targets[begin].value;
+    int64_t max_value = targets[end - 1].value;
+
+    // computed unsigned so the widest ranges cannot overflow
+    uint64_t span = static_cast<uint64_t>(max_value) - static_cast<uint64_t>(min_value);
+    if (count >= jump_table_min_cases && span < count * jump_table_max_entries_per_case) {
+        // both ends are checked rather than one unsigned compare of the index, which a signed condition would need
+        if (!lower_bound.has_value() || switch_value_less(lower_bound.value(), min_value, is_unsigned)) {
+            size_t next_block_id = allocate_block_id();
+            size_t check_block_id = emit_compare_branch(is_unsigned ? linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN : linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN, condition, min_value, default_block_id, next_block_id);
+            incoming_block_ids[default_block_id].push_back(check_block_id);
+            begin_block(next_block_id, { check_block_id });
+        }
+        if (!upper_bound.has_value() || switch_value_less(max_value, upper_bound.value(), is_unsigned)) {
+            size_t next_block_id = allocate_block_id();
+            size_t check_block_id = emit_compare_branch(is_unsigned ? linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN : linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN, condition, max_value, default_block_id, next_block_id);
+            incoming_block_ids[default_block_id].push_back(check_block_id);
+            begin_block(next_block_id, { check_block_id });
+        }
+
+        auto index_reg = condition;
+        if (min_value != 0) {
+            index_reg = m_translation_unit.new_vreg(condition.reg_size, condition.reg_class);
+            emit(std::make_unique<linear::a2_instruction>(
+                min_value > 0 ? linear::MICHAELCC_LINEAR_A_SUBTRACT : linear::MICHAELCC_LINEAR_A_ADD,
+                index_reg, condition, static_cast<size_t>(min_value > 0 ? static_cast<uint64_t>(min_value) : uint64_t(0) - static_cast<uint64_t>(min_value))
+            ));
+        }
+
+        std::vector<size_t> table(span + 1, default_block_id);
+        for (size_t i = begin; i < end; i++) {
+            table[static_cast<uint64_t>(targets[i].value) - static_cast<uint64_t>(min_value)] = targets[i].block_id;
+        }
+        auto jump = std::make_unique<linear::jump_table>(index_reg, std::move(table));
+        auto successor_block_ids = jump->successor_block_ids();
+        emit(std::move(jump));
+        size_t table_block_id = seal_block();
+        for (size_t successor_block_id : successor_block_ids) {
+            incoming_block_ids[successor_block_id].push_back(table_block_id);
+        }
+        return;
+    }
+
+    if (count <= compare_chain_max_cases) {
+        for (size_t i = begin; i < end; i++) {
+            bool is_last = i + 1 == end;
+            size_t next_block_id = is_last ? default_block_id : allocate_block_id();
+            size_t compare_block_id = emit_compare_branch(linear::MICHAELCC_LINEAR_A_COMPARE_EQUAL, condition, targets[i].value, targets[i].block_id, next_block_id);
+            incoming_block_ids[targets[i].block_id].push_back(compare_block_id);
+            if (is_last) {
+                incoming_block_ids[default_block_id].push_back(compare_block_id);
+            }
+            else {
+                begin_block(next_block_id, { compare_block_id });
+            }
+        }
+        return;
+    }
+
+    // the pivot is never the smallest value, so pivot - 1 cannot wrap past it
+    size_t middle = begin + count / 2;
+    int64_t pivot = targets[middle].value;
+    size_t lower_block_id = allocate_block_id();
+    size_t upper_block_id = allocate_block_id();
+    size_t split_block_id = emit_compare_branch(is_unsigned ? linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN : linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN, condition, pivot, lower_block_id, upper_block_id);
+
+    begin_block(lower_block_id, { split_block_id });
+    lower_switch_dispatch(condition, is_unsigned, targets, begin, middle, default_block_id, lower_bound, static_cast<int64_t>(static_cast<uint64_t>(pivot) - 1), incoming_block_ids);
+
+    begin_block(upper_block_id, { split_block_id });
+    lower_switch_dispatch(condition, is_unsigned, targets, middle, end, default_block_id, pivot, upper_bound, incoming_block_ids);
+}
+
 linear::virtual_register logic_lowerer::lower_at_address(linear::virtual_register dest_address, const std::unique_ptr<logic::expression>& initializer, size_t offset) {
     type_layout_calculator calculator(get_platform_info());
     auto layout = calculator(*initializer->get_type().type());
@@ -362,12 +461,9 @@ linear::virtual_register logic_lowerer::expression_lowerer::dispatch(const logic
 }
 
 linear::virtual_register logic_lowerer::expression_lowerer::dispatch(const logic::string_constant& node) {
-    std::ostringstream ss;
-    ss << "@string_" << node.index();
-    
     auto dest_reg = m_lowerer.m_translation_unit.new_vreg(m_lowerer.get_platform_info().pointer_size, linear::register_class::MICHAELCC_REGISTER_CLASS_INTEGER);
     m_lowerer.emit(std::make_unique<linear::load_effective_address>(
-        dest_reg, ss.str()
+        dest_reg, linear::static_storage::string_label(node.index())
     ));
     return dest_reg;
 }
@@ -390,6 +486,11 @@ linear::virtual_register logic_lowerer::expression_lowerer::dispatch(const logic
     auto var_reg = m_lowerer.get_var_reg(variable);
     type_layout_calculator calculator(m_lowerer.get_platform_info());
 
+    // a static array holds its elements rather than a pointer to them, so it decays to its own address
+    if (variable->use_static_storage() && variable->get_type().is_same_type<typing::array_type>()) {
+        return var_reg;
+    }
+
     if (variable->must_alloca() || calculator.must_alloca(variable->get_type())) {
         if (!calculator.must_alloca(variable->get_type())) {
             auto layout = calculator(*variable->get_type().type());
@@ -444,7 +545,7 @@ void logic_lowerer::statement_lowerer::dispatch(const logic::variable_declaratio
     auto var_layout = calculator(*node.variable()->get_type().type());
 
     if (node.variable()->use_static_storage()) {
-        m_lowerer.lower_static_variable_declaration(node);
+        m_lowerer.lower_static_variable_declaration(node, m_lowerer.m_current_function->next_static_label(node.variable()));
     }
     else if (node.variable()->must_alloca() || calculator.must_alloca(node.variable()->get_type())) {
         auto var_reg = m_lowerer.m_translation_unit.new_vreg(
@@ -618,8 +719,39 @@ linear::virtual_register logic_lowerer::expression_lowerer::dispatch(const logic
     type_layout_calculator calculator(m_lowerer.get_platform_info());
     auto result_layout = calculator(*node.get_type().type());
 
-    linear::virtual_register left = m_lowerer.lower_expression(*node.left());
-    linear::virtual_register right = m_lowerer.lower_expression(*node.right());
+    // the side needing more registers goes first, so its result is the only one held while the other is computed.
+    // only done when neither side has side effects, since that would change the order they happen in
+    bool right_first = m_lowerer.register_need(*node.right()) > m_lowerer.register_need(*node.left())
+        && !m_lowerer.m_side_effects.expression_has_side_effects(*node.left())
+        && !m_lowerer.m_side_effects.expression_has_side_effects(*node.right());
+
+    // a shift by a constant amount is an immediate operand, the only form of shift some targets have
+    auto shift_amount = dynamic_cast<const logic::integer_constant*>(node.right().get());
+    if (node.get_operator() == MICHAELCC_TOKEN_BITSHIFT_LEFT && shift_amount && shift_amount->value() >= 0) {
+        auto left = m_lowerer.lower_expression(*node.left());
+        auto result_reg = m_lowerer.m_translation_unit.new_vreg(
+            type_layout_info::get_register_size(result_layout.size, m_lowerer.get_platform_info()),
+            m_lowerer.get_register_class(node.get_type().type())
+        );
+        if (shift_amount->value() == 0) {
+            m_lowerer.emit(std::make_unique<linear::c_instruction>(linear::MICHAELCC_LINEAR_C_COPY_INIT, result_reg, left));
+        }
+        else {
+            m_lowerer.emit(std::make_unique<linear::a2_instruction>(linear::MICHAELCC_LINEAR_A_SHIFT_LEFT, result_reg, left, static_cast<size_t>(shift_amount->value())));
+        }
+        return result_reg;
+    }
+
+    linear::virtual_register left;
+    linear::virtual_register right;
+    if (right_first) {
+        right = m_lowerer.lower_expression(*node.right());
+        left = m_lowerer.lower_expression(*node.left());
+    }
+    else {
+        left = m_lowerer.lower_expression(*node.left());
+        right = m_lowerer.lower_expression(*node.right());
+    }
 
     assert(node.left()->get_type().type()->is_equivalent_to(*node.right()->get_type().type(), m_lowerer.get_platform_info()));
     bool is_float = node.left()->get_type().is_same_type<typing::float_type>();
@@ -634,6 +766,40 @@ linear::virtual_register logic_lowerer::expression_lowerer::dispatch(const logic
     return result_reg;
 }
 
+// a value computed by one operand is held while the other is computed, unless both need the same
+static size_t combine_register_needs(size_t first, size_t second) {
+    return first == second ? first + 1 : std::max(first, second);
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::variable_reference& node) {
+    // a variable kept in a register is already live
+    return node.get_variable()->must_alloca() ? 1 : 0;
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::arithmetic_operator& node) {
+    return combine_register_needs(m_lowerer.register_need(*node.left()), m_lowerer.register_need(*node.right()));
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::unary_operation& node) {
+    return std::max<size_t>(m_lowerer.register_need(*node.operand()), 1);
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::type_cast& node) {
+    return m_lowerer.register_need(*node.operand());
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::dereference& node) {
+    return std::max<size_t>(m_lowerer.register_need(*node.operand()), 1);
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::member_access& node) {
+    return std::max<size_t>(m_lowerer.register_need(*node.base()), 1);
+}
+
+size_t logic_lowerer::register_need_calculator::dispatch(const logic::array_index& node) {
+    return combine_register_needs(m_lowerer.register_need(*node.base()), m_lowerer.register_need(*node.index()));
+}
+
 static linear::u_instruction_type token_to_u_type(token_type op, bool is_float) {
     switch (op) {
         case MICHAELCC_TOKEN_MINUS: return is_float ? linear::MICHAELCC_LINEAR_U_FLOAT_NEGATE : linear::MICHAELCC_LINEAR_U_NEGATE;
@@ -1602,12 +1768,100 @@ void logic_lowerer::statement_lowerer::dispatch(const logic::loop_statement& nod
     }
 }
 
+void logic_lowerer::statement_lowerer::dispatch(const logic::switch_statement& node) {
+    auto condition_reg = m_lowerer.lower_expression(*node.condition());
+    const auto& cases = node.cases();
+
+    auto finish_block_id = m_lowerer.allocate_block_id();
+    m_lowerer.m_loop_infos[finish_block_id] = loop_info{
+        .block_id = finish_block_id,
+        .finish_block_id = finish_block_id
+    };
+    m_lowerer.m_break_stack.push_back(finish_block_id);
+
+    // an empty case shares the block of the case it falls into, or the finish block if it is last
+    std::vector<std::optional<size_t>> case_block_ids(cases.size());
+    std::vector<size_t> case_target_block_ids(cases.size());
+    for (size_t i = cases.size(); i-- > 0;) {
+        if (!cases[i].body->statements().empty()) {
+            case_block_ids[i] = m_lowerer.allocate_block_id();
+            case_target_block_ids[i] = case_block_ids[i].value();
+        }
+        else {
+            case_target_block_ids[i] = i + 1 < cases.size() ? case_target_block_ids[i + 1] : finish_block_id;
+        }
+    }
+
+    size_t default_block_id = finish_block_id;
+    std::vector<switch_target> targets;
+    targets.reserve(cases.size());
+    for (size_t i = 0; i < cases.size(); i++) {
+        if (!cases[i].value.has_value()) {
+            default_block_id = case_target_block_ids[i];
+        }
+    }
+    for (size_t i = 0; i < cases.size(); i++) {
+        // a case that lands where default does needs no compare of its own
+        if (cases[i].value.has_value() && case_target_block_ids[i] != default_block_id) {
+            targets.push_back(switch_target{ .value = cases[i].value.value(), .block_id = case_target_block_ids[i] });
+        }
+    }
+    // the case values already have the condition's type, they are ordered the way its compares order them
+    auto* condition_int_type = dynamic_cast<const typing::int_type*>(node.condition()->get_type().type().get());
+    bool is_unsigned = condition_int_type != nullptr && condition_int_type->is_unsigned();
+    std::sort(targets.begin(), targets.end(), [is_unsigned](const switch_target& a, const switch_target& b) { return switch_value_less(a.value, b.value, is_unsigned); });
+
+    std::unordered_map<size_t, std::vector<size_t>> incoming_block_ids;
+    m_lowerer.lower_switch_dispatch(condition_reg, is_unsigned, targets, 0, targets.size(), default_block_id, std::nullopt, std::nullopt, incoming_block_ids);
+
+    // compile case bodies in source order, each falls through into the next
+    std::optional<size_t> fallthrough_block_id;
+    for (size_t i = 0; i < cases.size(); i++) {
+        if (!case_block_ids[i].has_value()) {
+            continue;
+        }
+        size_t case_block_id = case_block_ids[i].value();
+
+        std::vector<size_t> case_incoming_block_ids = std::move(incoming_block_ids[case_block_id]);
+        if (fallthrough_block_id.has_value()) {
+            case_incoming_block_ids.push_back(fallthrough_block_id.value());
+        }
+        fallthrough_block_id = std::nullopt;
+        if (case_incoming_block_ids.empty()) {
+            continue;
+        }
+
+        m_lowerer.begin_block(case_block_id, case_incoming_block_ids);
+        auto case_end_block_id = m_lowerer.lower_statements(cases[i].body->statements());
+        if (case_end_block_id.has_value()) {
+            size_t next_block_id = i + 1 < cases.size() ? case_target_block_ids[i + 1] : finish_block_id;
+            m_lowerer.emit(std::make_unique<linear::branch>(next_block_id));
+            size_t end_block_id = m_lowerer.seal_block();
+            if (next_block_id == finish_block_id) {
+                incoming_block_ids[finish_block_id].push_back(end_block_id);
+            }
+            else {
+                fallthrough_block_id = end_block_id;
+            }
+        }
+    }
+    m_lowerer.m_break_stack.pop_back();
+
+    //compile finish block
+    std::vector<size_t> finish_incoming_block_ids = std::move(incoming_block_ids[finish_block_id]);
+    const auto& break_block_ids = m_lowerer.m_loop_infos.at(finish_block_id).incoming_break_block_ids;
+    finish_incoming_block_ids.insert(finish_incoming_block_ids.end(), break_block_ids.begin(), break_block_ids.end());
+    if (!finish_incoming_block_ids.empty()) {
+        m_lowerer.begin_block(finish_block_id, finish_incoming_block_ids);
+    }
+}
+
 void logic_lowerer::statement_lowerer::dispatch(const logic::break_statement& node) {
-    if (node.loop_depth() > m_lowerer.current_loop_depth()) {
+    if (node.loop_depth() < 0 || static_cast<size_t>(node.loop_depth()) > m_lowerer.current_break_depth()) {
         throw std::runtime_error("Cannot break out of the outer loop");
     }
 
-    auto& loop_info = m_lowerer.m_loop_infos.at(m_lowerer.m_loop_stack[m_lowerer.current_loop_depth() - node.loop_depth()]);
+    auto& loop_info = m_lowerer.m_loop_infos.at(m_lowerer.m_break_stack[m_lowerer.current_break_depth() - static_cast<size_t>(node.loop_depth())]);
     m_lowerer.emit(std::make_unique<linear::branch>(loop_info.finish_block_id));
     loop_info.incoming_break_block_ids.push_back(m_lowerer.current_block_id());
     m_lowerer.seal_block();
@@ -1692,21 +1946,34 @@ void logic_lowerer::lower_function(const logic::function_definition& node) {
         std::move(parameters)
     ));
     m_current_function = std::nullopt;
+    m_register_needs.clear();
+    m_side_effects.clear();
 }
 
-void logic_lowerer::lower_static_variable_declaration(const logic::variable_declaration& declaration) {
+void logic_lowerer::lower_static_variable_declaration(const logic::variable_declaration& declaration, const std::string& label) {
     linear::static_storage::is_default_initialized is_default_initialized(get_platform_info());
     auto default_layout = is_default_initialized(*declaration.initializer());
     if (default_layout.has_value()) {
         m_translation_unit.static_sections.bss_allocations.emplace_back(linear::static_storage::bss_allocation{
-            .label = declaration.variable()->name(),
+            .label = label,
             .layout = *default_layout
         });
     }
     else { //allocate data section
-        linear::static_storage::data_section_builder builder(get_platform_info(), declaration.variable()->name());
+        linear::static_storage::data_section_builder builder(get_platform_info(), label);
         auto data_allocations = builder.build(*declaration.initializer());
+        // a const array stores its qualifier on the element type
+        const typing::qual_type* type = &declaration.variable()->get_type();
+        while (!type->is_const()) {
+            auto array_type = std::dynamic_pointer_cast<typing::array_type>(type->type());
+            if (!array_type) {
+                break;
+            }
+            type = &array_type->element_type();
+        }
+        bool is_read_only = type->is_const();
         for (auto& data_allocation : data_allocations) {
+            data_allocation.is_read_only = is_read_only;
             m_translation_unit.static_sections.data_allocations.emplace_back(std::move(data_allocation));
         }
     }
@@ -1726,6 +1993,9 @@ size_t logic_lowerer::seal_block() {
         successor_block_ids.push_back(branch_condition->if_true_block_id());
         successor_block_ids.push_back(branch_condition->if_false_block_id());
     }
+    else if (auto jump_table = dynamic_cast<const linear::jump_table*>(cb.instructions.back().get())) {
+        successor_block_ids = jump_table->successor_block_ids();
+    }
     
     m_translation_unit.blocks.insert({cb.id, linear::basic_block(
         cb.id, 
@@ -1738,10 +2008,26 @@ size_t logic_lowerer::seal_block() {
     return return_id;
 }
 
-void logic_lowerer::lower(const logic::translation_unit& translation_unit) {
+void logic_lowerer::begin(const logic::translation_unit& translation_unit) {
+    m_translation_unit.static_sections.strings = translation_unit.strings();
     for (const auto& declaration : translation_unit.static_variable_declarations()) {
-        lower_static_variable_declaration(declaration);
+        lower_static_variable_declaration(declaration, declaration.variable()->name());
     }
+}
+
+void logic_lowerer::link_blocks(linear::translation_unit& unit) {
+    // compute predecessor based on all basic block predecessors
+    for (const auto& [block_id, block] : unit.blocks) {
+        for (const auto& successor_block_id : block.successor_block_ids()) {
+            unit.blocks.at(successor_block_id).add_predecessor_block_id(block_id);
+        }
+    }
+
+    linear::compute_dominators(unit);
+}
+
+void logic_lowerer::lower(const logic::translation_unit& translation_unit) {
+    begin(translation_unit);
     for (const auto& sym : translation_unit.global_context()->symbols()) {
         auto* func = dynamic_cast<logic::function_definition*>(sym.get());
         if (func) {
@@ -1749,12 +2035,41 @@ void logic_lowerer::lower(const logic::translation_unit& translation_unit) {
         }
     }
 
-    // compute predecessor based on all basic block predecessors
-    for (const auto& [block_id, block] : m_translation_unit.blocks) {
-        for (const auto& successor_block_id : block.successor_block_ids()) {
-            m_translation_unit.blocks.at(successor_block_id).add_predecessor_block_id(block_id);
-        }
-    }
+    link_blocks(m_translation_unit);
+    m_translation_unit.next_block_id = m_next_block_id;
+}
+
+linear::translation_unit logic_lowerer::lower_function_unit(const logic::function_definition& function) {
+    // the backend adds blocks to each unit while later functions are still being lowered, so the lowerer keeps to the
+    // even ids and leaves the odd ones to the backend
+    if (m_block_id_stride == 1) {
+        m_next_block_id += m_next_block_id % 2;
+        m_block_id_stride = 2;
+    }
+    lower_function(function);
+
+    linear::translation_unit unit{
+        .function_definitions = std::move(m_translation_unit.function_definitions),
+        .blocks = std::move(m_translation_unit.blocks),
+        .vreg_colors = std::move(m_translation_unit.vreg_colors),
+        .cannot_spill_vregs = std::move(m_translation_unit.cannot_spill_vregs),
+        .next_vreg_id = m_translation_unit.next_vreg_id,
+        .next_function_call_id = m_translation_unit.next_function_call_id,
+        .platform_info = get_platform_info()
+    };
+    m_translation_unit.function_definitions.clear();
+    m_translation_unit.blocks.clear();
+    m_translation_unit.vreg_colors.clear();
+    m_translation_unit.cannot_spill_vregs.clear();
 
-    linear::compute_dominators(m_translation_unit);
-}
\ No newline at end of file
+    // the variable contexts of finished blocks are only consulted while their function is being lowered
+    m_finished_block_var_ctx.clear();
+    m_loop_infos.clear();
+
+    link_blocks(unit);
+
+    // the caller carries next_block_id over from the unit before
+    unit.next_block_id = 1;
+    unit.block_id_stride = 2;
+    return unit;
+}
@@ -15,20 +15,20 @@ michaelcc::linear::allocators::frame_allocator::frame_allocator(linear::translat
 void michaelcc::linear::allocators::frame_allocator::allocate_block(linear::function_definition* function, size_t block_id) {
     auto& block = translation_unit.blocks.at(block_id);
     
-    auto [current_offset, frame_pointer_vreg] = function_to_frame_pointer.at(function->entry_block_id());
+    auto frame_pointer_vreg = function_to_frame_pointer.at(function->entry_block_id()).second;
 
     auto released_instructions = block.release_instructions();
     std::vector<std::unique_ptr<instruction>> new_instructions;
     new_instructions.reserve(released_instructions.size());
     for (auto& instruction : released_instructions) {
         if (auto alloca_instruction = dynamic_cast<linear::alloca_instruction*>(instruction.get())) {
-            current_offset += (current_offset % alloca_instruction->alignment()) + alloca_instruction->size_bytes();
+            size_t offset = reserve(function->entry_block_id(), alloca_instruction->size_bytes(), alloca_instruction->alignment());
 
             new_instructions.emplace_back(std::make_unique<linear::a2_instruction>(
                 linear::MICHAELCC_LINEAR_A_SUBTRACT,
                 alloca_instruction->destination(),
                 frame_pointer_vreg,
-                current_offset
+                offset
             ));
         }
         else {
@@ -37,7 +37,12 @@ void michaelcc::linear::allocators::frame_allocator::allocate_block(linear::func
     }
 
     block.replace_instructions(std::move(new_instructions));
-    function_to_frame_pointer.at(function->entry_block_id()) = std::make_pair(current_offset, frame_pointer_vreg);
+}
+
+size_t michaelcc::linear::allocators::frame_allocator::reserve(size_t entry_block_id, size_t size_bytes, size_t alignment) {
+    auto& current_offset = function_to_frame_pointer.at(entry_block_id).first;
+    current_offset += (current_offset % alignment) + size_bytes;
+    return current_offset;
 }
 
 void michaelcc::linear::allocators::frame_allocator::allocate() {
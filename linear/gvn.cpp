@@ -211,7 +211,7 @@ bool michaelcc::linear::optimization::gvn_pass::optimize(translation_unit& unit)
             }
 
             instruction_comparator comparator(existing_instruction);
-            if (!comparator(*instruction.get()) || !linear::is_dominated_by(unit, existing_block_id, block_id)) {
+            if (!comparator(*instruction.get()) || !linear::dominates(unit, existing_block_id, block_id)) {
                 new_instructions.emplace_back(std::move(instruction));
                 continue;
             }
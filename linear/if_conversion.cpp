@@ -0,0 +1,280 @@
+#include "linear/optimization/if_conversion.hpp"
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+bool michaelcc::linear::optimization::if_conversion_pass::is_speculatable(const instruction& instruction, const translation_unit& unit) {
+    // a write to a precolored vreg has to stay on its own path
+    auto destination = instruction.destination_register();
+    if (!destination.has_value() || unit.vreg_colors.contains(destination.value())) {
+        return false;
+    }
+
+    // multiplication and division are software loops on some targets, and division can trap
+    auto is_cheap = [](a_instruction_type type) {
+        switch (type) {
+        case MICHAELCC_LINEAR_A_SIGNED_MULTIPLY:
+        case MICHAELCC_LINEAR_A_UNSIGNED_MULTIPLY:
+        case MICHAELCC_LINEAR_A_SIGNED_DIVIDE:
+        case MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE:
+        case MICHAELCC_LINEAR_A_SIGNED_MODULO:
+        case MICHAELCC_LINEAR_A_UNSIGNED_MODULO:
+        case MICHAELCC_LINEAR_A_FLOAT_MULTIPLY:
+        case MICHAELCC_LINEAR_A_FLOAT_DIVIDE:
+        case MICHAELCC_LINEAR_A_FLOAT_MODULO:
+            return false;
+        default:
+            return true;
+        }
+    };
+
+    if (auto* a = dynamic_cast<const a_instruction*>(&instruction)) {
+        return is_cheap(a->type());
+    }
+    if (auto* a2 = dynamic_cast<const a2_instruction*>(&instruction)) {
+        return is_cheap(a2->type());
+    }
+
+    // loads are left alone, the branch may be what keeps a null pointer from being read
+    return dynamic_cast<const u_instruction*>(&instruction)
+        || dynamic_cast<const c_instruction*>(&instruction)
+        || dynamic_cast<const init_register*>(&instruction)
+        || dynamic_cast<const load_effective_address*>(&instruction)
+        || dynamic_cast<const select_instruction*>(&instruction);
+}
+
+void michaelcc::linear::optimization::if_conversion_pass::prescan(const translation_unit& unit) {
+    for (const auto& [block_id, block] : unit.blocks) {
+        if (block.instructions().empty()) {
+            continue;
+        }
+        auto* terminator = dynamic_cast<const branch_condition*>(block.instructions().back().get());
+        if (terminator && !terminator->is_loop()) {
+            m_branch_block_ids.push_back(block_id);
+        }
+    }
+    std::sort(m_branch_block_ids.begin(), m_branch_block_ids.end());
+}
+
+bool michaelcc::linear::optimization::if_conversion_pass::convert(translation_unit& unit, size_t block_id) {
+    auto& block = unit.blocks.at(block_id);
+    auto* terminator = dynamic_cast<const branch_condition*>(block.instructions().back().get());
+    if (!terminator || terminator->is_loop() || terminator->if_true_block_id() == terminator->if_false_block_id()) {
+        return false;
+    }
+    virtual_register condition = terminator->condition();
+    size_t true_block_id = terminator->if_true_block_id();
+    size_t false_block_id = terminator->if_false_block_id();
+
+    // an arm is only reached from this block and falls straight through to the join
+    auto arm_join = [&](size_t arm_block_id) -> std::optional<size_t> {
+        const auto& arm = unit.blocks.at(arm_block_id);
+        if (arm.predecessor_block_ids().size() != 1 || arm.instructions().empty()) {
+            return std::nullopt;
+        }
+        auto* exit = dynamic_cast<const branch*>(arm.instructions().back().get());
+        if (!exit) {
+            return std::nullopt;
+        }
+        return exit->next_block_id();
+    };
+
+    auto true_join = arm_join(true_block_id);
+    auto false_join = arm_join(false_block_id);
+
+    // a diamond hoists both arms, a triangle only the one that is not the join
+    std::vector<size_t> arm_block_ids;
+    size_t join_block_id;
+    if (true_join.has_value() && false_join.has_value() && true_join == false_join) {
+        join_block_id = true_join.value();
+        arm_block_ids = { true_block_id, false_block_id };
+    }
+    else if (true_join == false_block_id) {
+        join_block_id = false_block_id;
+        arm_block_ids = { true_block_id };
+    }
+    else if (false_join == true_block_id) {
+        join_block_id = true_block_id;
+        arm_block_ids = { false_block_id };
+    }
+    else {
+        return false;
+    }
+    if (join_block_id == block_id) {
+        return false;
+    }
+
+    size_t speculated = 0;
+    for (size_t arm_block_id : arm_block_ids) {
+        const auto& instructions = unit.blocks.at(arm_block_id).instructions();
+        for (size_t i = 0; i + 1 < instructions.size(); i++) {
+            if (!is_speculatable(*instructions[i], unit)) {
+                return false;
+            }
+        }
+        speculated += instructions.size() - 1;
+    }
+
+    // the edges the join's phis are keyed on, a triangle reaches the join straight from this block on one side
+    bool true_hoisted = std::find(arm_block_ids.begin(), arm_block_ids.end(), true_block_id) != arm_block_ids.end();
+    bool false_hoisted = std::find(arm_block_ids.begin(), arm_block_ids.end(), false_block_id) != arm_block_ids.end();
+    size_t true_edge = true_hoisted ? true_block_id : block_id;
+    size_t false_edge = false_hoisted ? false_block_id : block_id;
+
+    auto& join = unit.blocks.at(join_block_id);
+    bool join_has_other_predecessors = std::any_of(join.predecessor_block_ids().begin(), join.predecessor_block_ids().end(), [&](size_t predecessor) {
+        return predecessor != true_edge && predecessor != false_edge;
+    });
+
+    struct merged_value {
+        const phi_instruction* phi;
+        virtual_register if_true;
+        virtual_register if_false;
+    };
+    std::vector<merged_value> merged_values;
+    size_t selects = 0;
+    for (const auto& instruction : join.instructions()) {
+        auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+        if (!phi) {
+            continue;
+        }
+
+        std::optional<virtual_register> if_true;
+        std::optional<virtual_register> if_false;
+        for (const auto& value : phi->values()) {
+            if (value.block_id == true_edge) {
+                if_true = value.vreg;
+            }
+            else if (value.block_id == false_edge) {
+                if_false = value.vreg;
+            }
+        }
+        if (!if_true.has_value() || !if_false.has_value()) {
+            return false;
+        }
+        if (if_true.value() != if_false.value()) {
+            selects++;
+        }
+        merged_values.push_back(merged_value{ .phi = phi, .if_true = if_true.value(), .if_false = if_false.value() });
+    }
+    if (speculated > max_speculated_instructions || selects > max_selects) {
+        return false;
+    }
+
+    // hoist the arms and pick the merged values after them
+    auto instructions = block.release_instructions();
+    instructions.pop_back();
+    for (size_t arm_block_id : arm_block_ids) {
+        auto arm_instructions = unit.blocks.at(arm_block_id).release_instructions();
+        arm_instructions.pop_back();
+        for (auto& instruction : arm_instructions) {
+            instructions.emplace_back(std::move(instruction));
+        }
+    }
+
+    // with other ways into the join its phis stay, fed a single value from this block instead of two
+    std::vector<std::unique_ptr<instruction>> join_instructions;
+    auto released_join_instructions = join.release_instructions();
+    size_t next_merged = 0;
+    for (auto& instruction : released_join_instructions) {
+        if (next_merged == merged_values.size() || instruction.get() != merged_values[next_merged].phi) {
+            join_instructions.emplace_back(std::move(instruction));
+            continue;
+        }
+        const auto& merged = merged_values[next_merged++];
+        virtual_register merged_vreg = merged.if_true;
+        if (merged.if_true != merged.if_false) {
+            merged_vreg = join_has_other_predecessors
+                ? unit.new_vreg(merged.phi->destination().reg_size, merged.phi->destination().reg_class)
+                : merged.phi->destination();
+            instructions.emplace_back(std::make_unique<select_instruction>(merged_vreg, condition, merged.if_true, merged.if_false));
+        }
+        else if (!join_has_other_predecessors) {
+            instructions.emplace_back(std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, merged.phi->destination(), merged.if_true));
+        }
+
+        if (join_has_other_predecessors) {
+            std::vector<var_info> values;
+            for (const auto& value : merged.phi->values()) {
+                if (value.block_id != true_edge && value.block_id != false_edge) {
+                    values.push_back(value);
+                }
+            }
+            values.push_back(var_info{ .vreg = merged_vreg, .block_id = block_id });
+            join_instructions.emplace_back(std::make_unique<phi_instruction>(merged.phi->destination(), std::move(values)));
+        }
+    }
+    join.replace_instructions(std::move(join_instructions));
+
+    instructions.emplace_back(std::make_unique<branch>(join_block_id));
+    block.replace_instructions(std::move(instructions));
+
+    block.remove_successor_block_id(true_block_id);
+    block.remove_successor_block_id(false_block_id);
+    block.add_successor_block_id(join_block_id);
+    m_converted_block_ids.push_back(block_id);
+    join.remove_predecessor_block_id(true_edge);
+    join.remove_predecessor_block_id(false_edge);
+    join.add_predecessor_block_id(block_id);
+    for (size_t arm_block_id : arm_block_ids) {
+        unit.blocks.erase(arm_block_id);
+    }
+
+    if (!join_has_other_predecessors) {
+        merge_into_predecessor(unit, join_block_id, block_id);
+    }
+    return true;
+}
+
+void michaelcc::linear::optimization::if_conversion_pass::merge_into_predecessor(translation_unit& unit, size_t block_id, size_t predecessor_block_id) {
+    auto& predecessor = unit.blocks.at(predecessor_block_id);
+    auto& block = unit.blocks.at(block_id);
+
+    auto instructions = predecessor.release_instructions();
+    instructions.pop_back();
+    for (auto& instruction : block.release_instructions()) {
+        instructions.emplace_back(std::move(instruction));
+    }
+    predecessor.replace_instructions(std::move(instructions));
+
+    predecessor.remove_successor_block_id(block_id);
+    for (size_t successor_block_id : block.successor_block_ids()) {
+        predecessor.add_successor_block_id(successor_block_id);
+
+        auto& successor = unit.blocks.at(successor_block_id);
+        successor.replace_predecessor_block_id(block_id, predecessor_block_id);
+
+        auto successor_instructions = successor.release_instructions();
+        for (auto& instruction : successor_instructions) {
+            auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+            if (!phi) {
+                continue;
+            }
+            std::vector<var_info> values = phi->values();
+            for (auto& value : values) {
+                if (value.block_id == block_id) {
+                    value.block_id = predecessor_block_id;
+                }
+            }
+            instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+        }
+        successor.replace_instructions(std::move(successor_instructions));
+    }
+    unit.blocks.erase(block_id);
+}
+
+bool michaelcc::linear::optimization::if_conversion_pass::optimize(translation_unit& unit) {
+    bool made_changes = false;
+    for (size_t block_id : m_branch_block_ids) {
+        // an earlier conversion may have merged this block away
+        if (!unit.blocks.contains(block_id)) {
+            continue;
+        }
+
+        // merging the join can leave another conditional branch at the end of the block
+        while (!unit.blocks.at(block_id).instructions().empty() && convert(unit, block_id)) {
+            made_changes = true;
+        }
+    }
+    return made_changes;
+}
@@ -0,0 +1,331 @@
+#include "linear/allocators/instruction_scheduler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <variant>
+
+namespace {
+    // a call also reads the register holding an indirect callee
+    std::vector<michaelcc::linear::virtual_register> read_registers(const michaelcc::linear::instruction& instruction) {
+        auto operands = instruction.operand_registers();
+        if (auto* call = dynamic_cast<const michaelcc::linear::function_call*>(&instruction)) {
+            if (auto* callee = std::get_if<michaelcc::linear::virtual_register>(&call->callee())) {
+                operands.push_back(*callee);
+            }
+        }
+        return operands;
+    }
+}
+
+std::unordered_map<size_t, std::unordered_set<michaelcc::linear::virtual_register>> michaelcc::linear::allocators::instruction_scheduler::compute_live_out(const function_definition& function) const {
+    const auto& block_ids = function.reverse_postorder();
+    std::unordered_map<size_t, std::unordered_set<virtual_register>> live_in;
+    std::unordered_map<size_t, std::unordered_set<virtual_register>> defs;
+    for (size_t block_id : block_ids) {
+        auto& block_uses = live_in[block_id];
+        auto& block_defs = defs[block_id];
+        for (const auto& instruction : m_translation_unit.blocks.at(block_id).instructions()) {
+            for (auto operand : read_registers(*instruction)) {
+                if (!block_defs.contains(operand)) {
+                    block_uses.insert(operand);
+                }
+            }
+            if (auto destination = instruction->destination_register()) {
+                block_defs.insert(destination.value());
+            }
+        }
+    }
+
+    std::unordered_map<size_t, std::unordered_set<virtual_register>> live_out;
+    bool changed;
+    do {
+        changed = false;
+        for (auto it = block_ids.rbegin(); it != block_ids.rend(); ++it) {
+            auto& block_live_out = live_out[*it];
+            for (size_t successor : m_translation_unit.blocks.at(*it).successor_block_ids()) {
+                auto successor_live_in = live_in.find(successor);
+                if (successor_live_in != live_in.end()) {
+                    block_live_out.insert(successor_live_in->second.begin(), successor_live_in->second.end());
+                }
+            }
+            auto& block_live_in = live_in.at(*it);
+            for (auto vreg : block_live_out) {
+                if (!defs.at(*it).contains(vreg) && block_live_in.insert(vreg).second) {
+                    changed = true;
+                }
+            }
+        }
+    } while (changed);
+    return live_out;
+}
+
+std::optional<std::vector<size_t>> michaelcc::linear::allocators::instruction_scheduler::schedule_block(const std::vector<std::unique_ptr<instruction>>& instructions, const std::unordered_set<virtual_register>& live_out) const {
+    // the terminator always stays last
+    size_t end = instructions.size();
+    if (end > 0) {
+        const instruction* last = instructions.back().get();
+        if (dynamic_cast<const branch*>(last) || dynamic_cast<const branch_condition*>(last) || dynamic_cast<const jump_table*>(last) || dynamic_cast<const function_return*>(last)) {
+            end--;
+        }
+    }
+    if (end < 3) {
+        return std::nullopt;
+    }
+
+    std::unordered_set<size_t> calls_in_block;
+    for (size_t i = 0; i < end; i++) {
+        if (auto* call = dynamic_cast<const function_call*>(instructions[i].get())) {
+            calls_in_block.insert(call->function_call_id());
+        }
+    }
+
+    std::vector<node> nodes(end);
+    auto add_edge = [&](std::vector<size_t> node::* predecessors, size_t from, size_t to) {
+        if (from != to) {
+            (nodes[to].*predecessors).push_back(from);
+        }
+    };
+
+    std::unordered_map<virtual_register, size_t> last_definition;
+    std::unordered_map<virtual_register, std::vector<size_t>> readers;
+    std::optional<size_t> last_ordered;
+    std::vector<size_t> loads_since_ordered;
+
+    // the latest push of each call still waiting for its call, innermost last. a push overwrites an argument
+    // register, so nothing after it may move above it, or a value would be live across the push without being live
+    // across the call, and the call saves no register for it
+    std::vector<std::pair<size_t, size_t>> open_pushes;
+
+    for (size_t i = 0; i < end; i++) {
+        const instruction* current = instructions[i].get();
+        auto* push = dynamic_cast<const push_function_argument*>(current);
+        auto* call = dynamic_cast<const function_call*>(current);
+        size_t index = i;
+
+        if (!open_pushes.empty()) {
+            add_edge(&node::order_predecessors, open_pushes.back().second, index);
+        }
+        if (push && calls_in_block.contains(push->function_call_id())) {
+            if (!open_pushes.empty() && open_pushes.back().first == push->function_call_id()) {
+                open_pushes.back().second = index;
+            }
+            else {
+                open_pushes.push_back({ push->function_call_id(), index });
+            }
+        }
+        else if (call && !open_pushes.empty() && open_pushes.back().first == call->function_call_id()) {
+            open_pushes.pop_back();
+        }
+
+        for (auto operand : read_registers(*current)) {
+            auto it = last_definition.find(operand);
+            if (it != last_definition.end()) {
+                add_edge(&node::data_predecessors, it->second, index);
+            }
+            readers[operand].push_back(index);
+        }
+
+        // after phi removal a vreg can be written more than once, so earlier reads and writes stay in front
+        if (auto destination = current->destination_register()) {
+            auto& destination_readers = readers[destination.value()];
+            for (size_t reader : destination_readers) {
+                add_edge(&node::order_predecessors, reader, index);
+            }
+            destination_readers.clear();
+
+            auto it = last_definition.find(destination.value());
+            if (it != last_definition.end()) {
+                add_edge(&node::order_predecessors, it->second, index);
+            }
+            last_definition[destination.value()] = index;
+        }
+
+        // parameters are read out of the argument registers, which the first push or call would overwrite
+        bool ordered = current->has_side_effects() || dynamic_cast<const load_parameter*>(current);
+        if (ordered) {
+            if (last_ordered.has_value()) {
+                add_edge(&node::order_predecessors, last_ordered.value(), index);
+            }
+            for (size_t load : loads_since_ordered) {
+                add_edge(&node::order_predecessors, load, index);
+            }
+            loads_since_ordered.clear();
+            last_ordered = index;
+        }
+        else if (dynamic_cast<const load_memory*>(current)) {
+            if (last_ordered.has_value()) {
+                add_edge(&node::order_predecessors, last_ordered.value(), index);
+            }
+            loads_since_ordered.push_back(index);
+        }
+    }
+
+    // every edge points forward in the block, so the original order is already topological
+    for (size_t index = 0; index < nodes.size(); index++) {
+        auto& current = nodes[index];
+        for (auto* predecessors : { &current.data_predecessors, &current.order_predecessors }) {
+            std::sort(predecessors->begin(), predecessors->end());
+            predecessors->erase(std::unique(predecessors->begin(), predecessors->end()), predecessors->end());
+            for (size_t predecessor : *predecessors) {
+                nodes[predecessor].successor_count++;
+            }
+        }
+
+        std::vector<size_t> labels;
+        for (size_t predecessor : current.data_predecessors) {
+            labels.push_back(nodes[predecessor].label);
+        }
+        std::sort(labels.begin(), labels.end(), std::greater<size_t>());
+
+        // the first operand holds its register while the second is evaluated, and so on
+        for (size_t i = 0; i < labels.size(); i++) {
+            current.label = std::max(current.label, labels[i] + i);
+        }
+        if (instructions[index]->destination_register().has_value()) {
+            current.label = std::max<size_t>(current.label, 1);
+        }
+    }
+
+    // the terminator stays behind everything scheduled, so what it reads is live at the end as well
+    std::unordered_set<virtual_register> live_at_end(live_out);
+    for (size_t i = end; i < instructions.size(); i++) {
+        for (auto operand : read_registers(*instructions[i])) {
+            live_at_end.insert(operand);
+        }
+    }
+
+    // the most vregs live at once, a destination needs a register even if nothing reads it
+    auto peak_pressure = [&](const std::vector<size_t>& order) {
+        std::unordered_set<virtual_register> live(live_at_end);
+        size_t peak = live.size();
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (auto destination = instructions[*it]->destination_register()) {
+                peak = std::max(peak, live.size() + (live.contains(destination.value()) ? 0 : 1));
+                live.erase(destination.value());
+            }
+            for (auto operand : read_registers(*instructions[*it])) {
+                live.insert(operand);
+            }
+            peak = std::max(peak, live.size());
+        }
+        return peak;
+    };
+
+    // going backwards an instruction ends the range of its destination and starts the ranges of its operands. ties go
+    // to the instruction needing fewer registers, so the smaller operand is computed right before it is read, like
+    // sethi-ullman numbering does for expression trees, then to the instruction defining the vreg that became live
+    // last, which finishes one expression before starting the next, then to the later one, keeping the original order
+    std::unordered_set<virtual_register> live(live_at_end);
+    std::unordered_map<virtual_register, size_t> live_since;
+    std::vector<size_t> remaining_successors(nodes.size());
+    std::vector<size_t> ready;
+    for (size_t index = 0; index < nodes.size(); index++) {
+        remaining_successors[index] = nodes[index].successor_count;
+        if (remaining_successors[index] == 0) {
+            ready.push_back(index);
+        }
+    }
+
+    auto cost = [&](size_t index) {
+        std::unordered_set<virtual_register> started;
+        for (auto operand : read_registers(*instructions[index])) {
+            if (!live.contains(operand)) {
+                started.insert(operand);
+            }
+        }
+        int64_t added = static_cast<int64_t>(started.size());
+        auto destination = instructions[index]->destination_register();
+        if (destination.has_value() && live.contains(destination.value())) {
+            added--;
+        }
+        return added;
+    };
+    auto recency = [&](size_t index) -> size_t {
+        auto destination = instructions[index]->destination_register();
+        if (!destination.has_value()) {
+            return 0;
+        }
+        auto it = live_since.find(destination.value());
+        return it == live_since.end() ? 0 : it->second;
+    };
+
+    std::vector<size_t> order;
+    order.reserve(instructions.size());
+    for (size_t step = 1; !ready.empty(); step++) {
+        auto best = std::min_element(ready.begin(), ready.end(), [&](size_t a, size_t b) {
+            int64_t cost_a = cost(a);
+            int64_t cost_b = cost(b);
+            if (cost_a != cost_b) {
+                return cost_a < cost_b;
+            }
+            if (nodes[a].label != nodes[b].label) {
+                return nodes[a].label < nodes[b].label;
+            }
+            size_t recency_a = recency(a);
+            size_t recency_b = recency(b);
+            if (recency_a != recency_b) {
+                return recency_a > recency_b;
+            }
+            return a > b;
+        });
+        size_t index = *best;
+        ready.erase(best);
+        order.push_back(index);
+
+        if (auto destination = instructions[index]->destination_register()) {
+            live.erase(destination.value());
+            live_since.erase(destination.value());
+        }
+        for (auto operand : read_registers(*instructions[index])) {
+            if (live.insert(operand).second) {
+                live_since[operand] = step;
+            }
+        }
+        for (auto* predecessors : { &nodes[index].data_predecessors, &nodes[index].order_predecessors }) {
+            for (size_t predecessor : *predecessors) {
+                if (--remaining_successors[predecessor] == 0) {
+                    ready.push_back(predecessor);
+                }
+            }
+        }
+    }
+    assert(order.size() == end);
+    std::reverse(order.begin(), order.end());
+
+    std::vector<size_t> original(end);
+    for (size_t i = 0; i < end; i++) {
+        original[i] = i;
+    }
+    if (order == original || peak_pressure(order) >= peak_pressure(original)) {
+        return std::nullopt;
+    }
+
+    for (size_t i = end; i < instructions.size(); i++) {
+        order.push_back(i);
+    }
+    assert(order.size() == instructions.size());
+    return order;
+}
+
+void michaelcc::linear::allocators::instruction_scheduler::schedule() {
+    for (const auto& function : m_translation_unit.function_definitions) {
+        auto live_out = compute_live_out(*function);
+        for (size_t block_id : function->reverse_postorder()) {
+            auto& block = m_translation_unit.blocks.at(block_id);
+            auto order = schedule_block(block.instructions(), live_out.at(block_id));
+            if (!order.has_value()) {
+                continue;
+            }
+
+            auto& instructions = block.mutable_instructions();
+            std::vector<std::unique_ptr<instruction>> scheduled;
+            scheduled.reserve(instructions.size());
+            for (size_t i : order.value()) {
+                scheduled.emplace_back(std::move(instructions[i]));
+            }
+            block.replace_instructions(std::move(scheduled));
+        }
+    }
+}
@@ -0,0 +1,498 @@
+#include "linear/optimization/jump_threading.hpp"
+#include "linear/optimization/copy_prop.hpp"
+#include "linear/dominators.hpp"
+#include <algorithm>
+#include <queue>
+
+std::optional<uint64_t> michaelcc::linear::optimization::jump_threading_pass::fold(a_instruction_type type, uint64_t a, uint64_t b, word_size size) noexcept {
+    auto to_signed = [size](uint64_t value) {
+        if (size == MICHAELCC_WORD_SIZE_UINT64) {
+            return static_cast<int64_t>(value);
+        }
+        uint64_t sign = uint64_t{ 1 } << (size - 1);
+        return static_cast<int64_t>((value ^ sign) - sign);
+    };
+    int64_t sa = to_signed(a);
+    int64_t sb = to_signed(b);
+
+    switch (type) {
+    case MICHAELCC_LINEAR_A_ADD:          return (a + b) & width_mask(size);
+    case MICHAELCC_LINEAR_A_SUBTRACT:     return (a - b) & width_mask(size);
+    case MICHAELCC_LINEAR_A_BITWISE_AND:  return a & b;
+    case MICHAELCC_LINEAR_A_BITWISE_OR:   return a | b;
+    case MICHAELCC_LINEAR_A_BITWISE_XOR:  return a ^ b;
+    case MICHAELCC_LINEAR_A_BITWISE_NAND: return ~(a & b) & width_mask(size);
+
+    case MICHAELCC_LINEAR_A_AND: return a && b;
+    case MICHAELCC_LINEAR_A_OR:  return a || b;
+    case MICHAELCC_LINEAR_A_XOR: return (a != 0) != (b != 0);
+
+    case MICHAELCC_LINEAR_A_COMPARE_EQUAL:     return a == b;
+    case MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL: return a != b;
+
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN:                return sa < sb;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL:       return sa <= sb;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN:             return sa > sb;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL:    return sa >= sb;
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN:              return a < b;
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL:     return a <= b;
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN:           return a > b;
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL:  return a >= b;
+
+    default: return std::nullopt;
+    }
+}
+
+std::optional<bool> michaelcc::linear::optimization::jump_threading_pass::decide(const basic_block& block, size_t predecessor_block_id) const {
+    // the constants of this block along the edge from the predecessor, phis take the value it sends
+    std::unordered_map<virtual_register, uint64_t> known;
+    auto get_constant = [&](virtual_register vreg) -> std::optional<uint64_t> {
+        if (vreg.reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+            return std::nullopt;
+        }
+        if (auto it = known.find(vreg); it != known.end()) {
+            return it->second;
+        }
+        if (auto it = m_constants.find(vreg); it != m_constants.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    };
+
+    for (const auto& instruction : block.instructions()) {
+        if (auto* phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+            for (const auto& value : phi->values()) {
+                auto constant = m_constants.find(value.vreg);
+                if (value.block_id == predecessor_block_id && constant != m_constants.end()) {
+                    known.insert({ phi->destination(), constant->second });
+                }
+            }
+        }
+        else if (auto* init = dynamic_cast<const init_register*>(instruction.get())) {
+            known.insert({ init->destination(), init->value().uint64 & width_mask(init->destination().reg_size) });
+        }
+        else if (auto* copy = dynamic_cast<const c_instruction*>(instruction.get())) {
+            auto source = get_constant(copy->source());
+            if (copy->type() == MICHAELCC_LINEAR_C_COPY_INIT && source.has_value()) {
+                known.insert({ copy->destination(), source.value() });
+            }
+        }
+        else if (auto* a = dynamic_cast<const a_instruction*>(instruction.get())) {
+            auto operand_a = get_constant(a->operand_a());
+            auto operand_b = get_constant(a->operand_b());
+            if (operand_a.has_value() && operand_b.has_value()) {
+                if (auto result = fold(a->type(), operand_a.value(), operand_b.value(), a->operand_a().reg_size)) {
+                    known.insert({ a->destination(), result.value() & width_mask(a->destination().reg_size) });
+                }
+                continue;
+            }
+
+            // an && folded into the condition is decided by a false side alone, an || by a true one
+            auto is_known = [](const std::optional<uint64_t>& operand, bool value) {
+                return operand.has_value() && (operand.value() != 0) == value;
+            };
+            bool is_and = a->type() == MICHAELCC_LINEAR_A_AND || a->type() == MICHAELCC_LINEAR_A_BITWISE_AND;
+            if (is_and && (is_known(operand_a, false) || is_known(operand_b, false))) {
+                known.insert({ a->destination(), 0 });
+            }
+            else if (a->type() == MICHAELCC_LINEAR_A_OR && (is_known(operand_a, true) || is_known(operand_b, true))) {
+                known.insert({ a->destination(), 1 });
+            }
+        }
+        else if (auto* a2 = dynamic_cast<const a2_instruction*>(instruction.get())) {
+            auto operand = get_constant(a2->operand_a());
+            if (operand.has_value()) {
+                uint64_t constant = a2->constant() & width_mask(a2->operand_a().reg_size);
+                if (auto result = fold(a2->type(), operand.value(), constant, a2->operand_a().reg_size)) {
+                    known.insert({ a2->destination(), result.value() & width_mask(a2->destination().reg_size) });
+                }
+            }
+        }
+        else if (auto* terminator = dynamic_cast<const branch_condition*>(instruction.get())) {
+            auto condition = get_constant(terminator->condition());
+            if (condition.has_value()) {
+                return condition.value() != 0;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::jump_threading_pass::copy_instruction(const instruction& instruction, const std::unordered_map<virtual_register, virtual_register>& renames) {
+    auto get = [&](virtual_register vreg) {
+        auto it = renames.find(vreg);
+        return it != renames.end() ? it->second : vreg;
+    };
+
+    if (auto* a = dynamic_cast<const a_instruction*>(&instruction)) {
+        return std::make_unique<a_instruction>(a->type(), get(a->destination()), get(a->operand_a()), get(a->operand_b()));
+    }
+    if (auto* a2 = dynamic_cast<const a2_instruction*>(&instruction)) {
+        return std::make_unique<a2_instruction>(a2->type(), get(a2->destination()), get(a2->operand_a()), a2->constant());
+    }
+    if (auto* u = dynamic_cast<const u_instruction*>(&instruction)) {
+        return std::make_unique<u_instruction>(u->type(), get(u->destination()), get(u->operand()));
+    }
+    if (auto* c = dynamic_cast<const c_instruction*>(&instruction)) {
+        return std::make_unique<c_instruction>(c->type(), get(c->destination()), get(c->source()));
+    }
+    if (auto* init = dynamic_cast<const init_register*>(&instruction)) {
+        return std::make_unique<init_register>(get(init->destination()), init->value());
+    }
+    if (auto* load = dynamic_cast<const load_memory*>(&instruction)) {
+        return std::make_unique<load_memory>(get(load->destination()), get(load->source_address()), load->offset());
+    }
+    if (auto* store = dynamic_cast<const store_memory*>(&instruction)) {
+        return std::make_unique<store_memory>(get(store->destination_address()), get(store->value()), store->offset());
+    }
+    if (auto* lea = dynamic_cast<const load_effective_address*>(&instruction)) {
+        return std::make_unique<load_effective_address>(get(lea->destination()), lea->label());
+    }
+    if (auto* select = dynamic_cast<const select_instruction*>(&instruction)) {
+        return std::make_unique<select_instruction>(get(select->destination()), get(select->condition()), get(select->if_true()), get(select->if_false()));
+    }
+
+    // calls and stack allocations are numbered and laid out once per function
+    return nullptr;
+}
+
+void michaelcc::linear::optimization::jump_threading_pass::prescan(const translation_unit& unit) {
+    for (size_t i = 0; i < unit.function_definitions.size(); i++) {
+        const auto& order = unit.function_definitions[i]->reverse_postorder();
+        for (size_t j = 0; j < order.size(); j++) {
+            m_block_order.insert({ order[j], { i, j } });
+        }
+    }
+
+    std::unordered_map<virtual_register, size_t> definition_counts;
+    std::unordered_map<virtual_register, uint64_t> constants;
+    for (const auto& [block_id, block] : unit.blocks) {
+        for (const auto& instruction : block.instructions()) {
+            auto destination = instruction->destination_register();
+            if (!destination.has_value()) {
+                continue;
+            }
+            definition_counts[destination.value()]++;
+            auto* init = dynamic_cast<const init_register*>(instruction.get());
+            if (init && destination.value().reg_class == MICHAELCC_REGISTER_CLASS_INTEGER) {
+                constants.insert({ destination.value(), init->value().uint64 & width_mask(destination.value().reg_size) });
+            }
+        }
+    }
+    for (const auto& [vreg, value] : constants) {
+        if (definition_counts.at(vreg) == 1 && !unit.vreg_colors.contains(vreg)) {
+            m_constants.insert({ vreg, value });
+        }
+    }
+
+    for (const auto& [block_id, block] : unit.blocks) {
+        if (block.predecessor_block_ids().size() < 2 || block.instructions().empty() || !m_block_order.contains(block_id)) {
+            continue;
+        }
+        auto* terminator = dynamic_cast<const branch_condition*>(block.instructions().back().get());
+        if (!terminator || terminator->is_loop() || terminator->if_true_block_id() == terminator->if_false_block_id()) {
+            continue;
+        }
+        if (dynamic_cast<const phi_instruction*>(block.instructions().front().get())) {
+            m_branch_block_ids.push_back(block_id);
+        }
+    }
+    std::sort(m_branch_block_ids.begin(), m_branch_block_ids.end());
+}
+
+bool michaelcc::linear::optimization::jump_threading_pass::thread(translation_unit& unit, size_t block_id, size_t predecessor_block_id, bool taken) {
+    const auto& block = unit.blocks.at(block_id);
+    auto* terminator = dynamic_cast<const branch_condition*>(block.instructions().back().get());
+    size_t target_block_id = taken ? terminator->if_true_block_id() : terminator->if_false_block_id();
+
+    // back edges are left alone, threading them would give a loop a second way in
+    auto [function_id, position] = m_block_order.at(block_id);
+    auto predecessor_order = m_block_order.find(predecessor_block_id);
+    auto target_order = m_block_order.find(target_block_id);
+    if (predecessor_order == m_block_order.end() || predecessor_order->second.second >= position
+        || target_order == m_block_order.end() || target_order->second.second <= position) {
+        return false;
+    }
+
+    auto& predecessor = unit.blocks.at(predecessor_block_id);
+    const auto& predecessor_terminator = predecessor.instructions().back();
+    auto* predecessor_branch = dynamic_cast<const branch*>(predecessor_terminator.get());
+    auto* predecessor_branch_condition = dynamic_cast<const branch_condition*>(predecessor_terminator.get());
+    if (!predecessor_branch && !(predecessor_branch_condition && predecessor_branch_condition->if_true_block_id() != predecessor_branch_condition->if_false_block_id())) {
+        return false;
+    }
+
+    // what each vreg of the block holds on the new path, the phis hold what the predecessor sends
+    std::unordered_map<virtual_register, virtual_register> renames;
+    std::unordered_set<virtual_register> definitions;
+    std::vector<const instruction*> body;
+    bool has_side_effects = false;
+    for (const auto& instruction : block.instructions()) {
+        auto destination = instruction->destination_register();
+        if (destination.has_value()) {
+            if (unit.vreg_colors.contains(destination.value())) {
+                return false;
+            }
+            definitions.insert(destination.value());
+        }
+
+        if (auto* phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+            auto value = std::find_if(phi->values().begin(), phi->values().end(), [&](const var_info& value) {
+                return value.block_id == predecessor_block_id;
+            });
+            if (value == phi->values().end()) {
+                return false;
+            }
+            renames.insert({ phi->destination(), value->vreg });
+        }
+        else if (instruction.get() != terminator) {
+            body.push_back(instruction.get());
+            has_side_effects |= instruction->has_side_effects();
+        }
+    }
+
+    // blocks the new edge reaches without going through this block again
+    std::unordered_set<size_t> reached;
+    std::queue<size_t> to_visit;
+    to_visit.push(target_block_id);
+    while (!to_visit.empty()) {
+        size_t visited_block_id = to_visit.front();
+        to_visit.pop();
+        if (visited_block_id == block_id || !reached.insert(visited_block_id).second) {
+            continue;
+        }
+        for (size_t successor_block_id : unit.blocks.at(visited_block_id).successor_block_ids()) {
+            to_visit.push(successor_block_id);
+        }
+    }
+
+    // the values of the block read along the new path. they stay fine wherever the block still comes first, the
+    // target's phis get a value for the new edge and every other read has to be under the target, which merges them
+    std::unordered_set<virtual_register> live;
+    for (size_t use_block_id : unit.function_definitions[function_id]->reverse_postorder()) {
+        if (use_block_id == block_id || !unit.blocks.contains(use_block_id)) {
+            continue;
+        }
+        for (const auto& instruction : unit.blocks.at(use_block_id).instructions()) {
+            std::vector<std::pair<virtual_register, size_t>> uses;
+            if (auto* phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+                for (const auto& value : phi->values()) {
+                    uses.push_back({ value.vreg, value.block_id });
+                }
+            }
+            else {
+                for (virtual_register operand : instruction->operand_registers()) {
+                    uses.push_back({ operand, use_block_id });
+                }
+            }
+
+            for (const auto& [vreg, use_point] : uses) {
+                if (!definitions.contains(vreg)) {
+                    continue;
+                }
+                if (use_block_id == target_block_id && use_point == block_id) {
+                    live.insert(vreg);
+                    continue;
+                }
+                if (!reached.contains(use_point)) {
+                    continue;
+                }
+                if (!dominates(unit, block_id, target_block_id) || !dominates(unit, target_block_id, use_point)) {
+                    return false;
+                }
+                live.insert(vreg);
+            }
+        }
+    }
+
+    // the body only has to run on the new path when it does something or computes something read there
+    bool needs_copy = has_side_effects || std::any_of(body.begin(), body.end(), [&](const instruction* instruction) {
+        auto destination = instruction->destination_register();
+        return destination.has_value() && live.contains(destination.value());
+    });
+    std::vector<std::unique_ptr<instruction>> copies;
+    if (needs_copy) {
+        if (body.size() > max_duplicated_instructions) {
+            return false;
+        }
+        std::vector<virtual_register> copied_vregs;
+        for (const instruction* instruction : body) {
+            auto destination = instruction->destination_register();
+            if (destination.has_value()) {
+                copied_vregs.push_back(unit.new_vreg(destination.value().reg_size, destination.value().reg_class));
+                renames.insert({ destination.value(), copied_vregs.back() });
+            }
+            auto copy = copy_instruction(*instruction, renames);
+            if (!copy) {
+                for (virtual_register vreg : copied_vregs) {
+                    unit.free_vreg(vreg);
+                }
+                return false;
+            }
+            copies.emplace_back(std::move(copy));
+        }
+    }
+    auto get_renamed = [&](virtual_register vreg) {
+        auto it = renames.find(vreg);
+        return it != renames.end() ? it->second : vreg;
+    };
+
+    // values read under the target were the block's own until now, a phi in the target merges them with the new path
+    auto& target = unit.blocks.at(target_block_id);
+    std::vector<size_t> old_target_predecessor_block_ids = target.predecessor_block_ids();
+    std::unordered_map<virtual_register, virtual_register> merged;
+    std::vector<std::unique_ptr<instruction>> merge_phis;
+    for (virtual_register vreg : live) {
+        bool read_under_target = false;
+        for (size_t use_block_id : reached) {
+            for (const auto& instruction : unit.blocks.at(use_block_id).instructions()) {
+                if (auto* phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+                    read_under_target |= std::any_of(phi->values().begin(), phi->values().end(), [&](const var_info& value) {
+                        return value.vreg == vreg && value.block_id != block_id && reached.contains(value.block_id);
+                    });
+                }
+                else {
+                    auto operands = instruction->operand_registers();
+                    read_under_target |= std::find(operands.begin(), operands.end(), vreg) != operands.end();
+                }
+            }
+        }
+        if (!read_under_target) {
+            continue;
+        }
+
+        virtual_register merged_vreg = unit.new_vreg(vreg.reg_size, vreg.reg_class);
+        merged.insert({ vreg, merged_vreg });
+        std::vector<var_info> values;
+        for (size_t target_predecessor_block_id : old_target_predecessor_block_ids) {
+            values.push_back(var_info{ .vreg = vreg, .block_id = target_predecessor_block_id });
+        }
+        merge_phis.emplace_back(std::make_unique<phi_instruction>(merged_vreg, std::move(values)));
+    }
+
+    // rewrite the reads under the target before the new edge makes the dominator info stale
+    if (!merged.empty()) {
+        replace_operands_transform transform(merged);
+        for (size_t use_block_id : reached) {
+            auto& use_block = unit.blocks.at(use_block_id);
+            if (use_block_id == target_block_id) {
+                auto target_instructions = use_block.release_instructions();
+                auto first_instruction = std::find_if(target_instructions.begin(), target_instructions.end(), [](const std::unique_ptr<instruction>& instruction) {
+                    return !dynamic_cast<const phi_instruction*>(instruction.get());
+                });
+                size_t phi_count = first_instruction - target_instructions.begin();
+                for (auto& phi : merge_phis) {
+                    target_instructions.insert(target_instructions.begin() + phi_count++, std::move(phi));
+                }
+                use_block.replace_instructions(std::move(target_instructions));
+            }
+
+            for (auto& instruction : use_block.mutable_instructions()) {
+                if (auto* phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+                    std::vector<var_info> values = phi->values();
+                    bool changed = false;
+                    for (auto& value : values) {
+                        auto it = merged.find(value.vreg);
+                        if (it != merged.end() && dominates(unit, target_block_id, value.block_id)) {
+                            value.vreg = it->second;
+                            changed = true;
+                        }
+                    }
+                    if (changed) {
+                        instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+                    }
+                }
+                else if (auto new_instruction = transform(*instruction)) {
+                    instruction = std::move(new_instruction);
+                }
+            }
+        }
+    }
+
+    // the predecessor goes to the target, through its own copy of the block when it has to run
+    size_t edge_block_id = predecessor_block_id;
+    size_t next_block_id = target_block_id;
+    if (needs_copy || std::find(old_target_predecessor_block_ids.begin(), old_target_predecessor_block_ids.end(), predecessor_block_id) != old_target_predecessor_block_ids.end()) {
+        edge_block_id = unit.new_block_id();
+        next_block_id = edge_block_id;
+        copies.emplace_back(std::make_unique<branch>(target_block_id));
+        basic_block copy_block(edge_block_id, std::move(copies), { target_block_id });
+        copy_block.add_predecessor_block_id(predecessor_block_id);
+        unit.blocks.insert({ edge_block_id, std::move(copy_block) });
+    }
+
+    auto predecessor_instructions = predecessor.release_instructions();
+    if (predecessor_branch) {
+        predecessor_instructions.back() = std::make_unique<branch>(next_block_id);
+    }
+    else {
+        predecessor_instructions.back() = std::make_unique<branch_condition>(
+            predecessor_branch_condition->condition(),
+            predecessor_branch_condition->if_true_block_id() == block_id ? next_block_id : predecessor_branch_condition->if_true_block_id(),
+            predecessor_branch_condition->if_false_block_id() == block_id ? next_block_id : predecessor_branch_condition->if_false_block_id(),
+            predecessor_branch_condition->is_loop()
+        );
+    }
+    predecessor.replace_instructions(std::move(predecessor_instructions));
+    predecessor.replace_successor_block_id(block_id, next_block_id);
+    m_threaded_predecessor_block_ids.push_back(predecessor_block_id);
+
+    // the target's phis take what came along the edge from the block, as seen on the new path
+    auto target_instructions = target.release_instructions();
+    for (auto& instruction : target_instructions) {
+        auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+        if (!phi) {
+            continue;
+        }
+        std::vector<var_info> values = phi->values();
+        for (const auto& value : phi->values()) {
+            if (value.block_id == block_id) {
+                values.push_back(var_info{ .vreg = get_renamed(value.vreg), .block_id = edge_block_id });
+            }
+        }
+        instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+    }
+    target.replace_instructions(std::move(target_instructions));
+    target.add_predecessor_block_id(edge_block_id);
+
+    // and the block no longer hears from the predecessor
+    auto& threaded_block = unit.blocks.at(block_id);
+    threaded_block.remove_predecessor_block_id(predecessor_block_id);
+    auto block_instructions = threaded_block.release_instructions();
+    for (auto& instruction : block_instructions) {
+        auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+        if (!phi) {
+            continue;
+        }
+        std::vector<var_info> values;
+        for (const auto& value : phi->values()) {
+            if (value.block_id != predecessor_block_id) {
+                values.push_back(value);
+            }
+        }
+        instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+    }
+    threaded_block.replace_instructions(std::move(block_instructions));
+    return true;
+}
+
+bool michaelcc::linear::optimization::jump_threading_pass::optimize(translation_unit& unit) {
+    // threading goes by the dominator info of the function, so a function is threaded at most once per round
+    std::unordered_set<size_t> threaded_function_ids;
+    for (size_t block_id : m_branch_block_ids) {
+        size_t function_id = m_block_order.at(block_id).first;
+        if (threaded_function_ids.contains(function_id)) {
+            continue;
+        }
+
+        std::vector<size_t> predecessor_block_ids = unit.blocks.at(block_id).predecessor_block_ids();
+        for (size_t predecessor_block_id : predecessor_block_ids) {
+            auto taken = decide(unit.blocks.at(block_id), predecessor_block_id);
+            if (taken.has_value() && thread(unit, block_id, predecessor_block_id, taken.value())) {
+                threaded_function_ids.insert(function_id);
+                break;
+            }
+        }
+    }
+    return !threaded_function_ids.empty();
+}
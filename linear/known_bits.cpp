@@ -0,0 +1,450 @@
+#include "linear/optimization/known_bits.hpp"
+#include "linear/ir.hpp"
+#include <bit>
+#include <memory>
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::add(known_bits a, known_bits b, bool carry, word_size size) noexcept {
+    uint64_t mask = width_mask(size);
+    uint64_t max_sum = (~a.zeros & mask) + (~b.zeros & mask) + carry;
+    uint64_t min_sum = a.ones + b.ones + carry;
+
+    // the carry into a bit is known when the smallest and largest sums agree on it
+    uint64_t carry_known_zero = ~(max_sum ^ a.zeros ^ b.zeros);
+    uint64_t carry_known_one = min_sum ^ a.ones ^ b.ones;
+    uint64_t known = (a.zeros | a.ones) & (b.zeros | b.ones) & (carry_known_zero | carry_known_one) & mask;
+    return known_bits{ .zeros = ~min_sum & known, .ones = max_sum & known };
+}
+
+uint64_t michaelcc::linear::optimization::known_bits_pass::leading_zeros(known_bits a, word_size size) noexcept {
+    uint64_t mask = width_mask(size);
+    size_t count = std::countl_one(a.zeros | ~mask) - (64 - static_cast<size_t>(size));
+    if (count >= static_cast<size_t>(size)) {
+        return mask;
+    }
+    return mask & ~(mask >> count);
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::shift(a_instruction_type type, known_bits a, size_t amount, word_size size) noexcept {
+    uint64_t mask = width_mask(size);
+    if (amount >= static_cast<size_t>(size)) {
+        return known_bits{};
+    }
+
+    uint64_t vacated;
+    switch (type) {
+    case MICHAELCC_LINEAR_A_SHIFT_LEFT:
+        return known_bits{ .zeros = ((a.zeros << amount) | ((uint64_t{ 1 } << amount) - 1)) & mask, .ones = (a.ones << amount) & mask };
+    case MICHAELCC_LINEAR_A_UNSIGNED_SHIFT_RIGHT:
+        vacated = mask & ~(mask >> amount);
+        return known_bits{ .zeros = (a.zeros >> amount) | vacated, .ones = a.ones >> amount };
+    case MICHAELCC_LINEAR_A_SIGNED_SHIFT_RIGHT: {
+        vacated = mask & ~(mask >> amount);
+        uint64_t sign = uint64_t{ 1 } << (size - 1);
+        known_bits result{ .zeros = a.zeros >> amount, .ones = a.ones >> amount };
+        if (a.zeros & sign) {
+            result.zeros |= vacated;
+        }
+        else if (a.ones & sign) {
+            result.ones |= vacated;
+        }
+        return result;
+    }
+    default:
+        return known_bits{};
+    }
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::combine(a_instruction_type type, known_bits a, known_bits b, word_size operand_size, word_size result_size) noexcept {
+    uint64_t mask = width_mask(operand_size);
+    known_bits boolean{ .zeros = width_mask(result_size) & ~uint64_t{ 1 } };
+
+    switch (type) {
+    case MICHAELCC_LINEAR_A_ADD:
+        return add(a, b, false, operand_size);
+    case MICHAELCC_LINEAR_A_SUBTRACT:
+        return add(a, known_bits{ .zeros = b.ones, .ones = b.zeros }, true, operand_size);
+    case MICHAELCC_LINEAR_A_SIGNED_MULTIPLY:
+    case MICHAELCC_LINEAR_A_UNSIGNED_MULTIPLY: {
+        // the trailing zeros of the factors add up
+        size_t trailing_zeros = std::countr_one(a.zeros) + std::countr_one(b.zeros);
+        if (trailing_zeros >= static_cast<size_t>(operand_size)) {
+            return known_bits{ .zeros = mask };
+        }
+        return known_bits{ .zeros = (uint64_t{ 1 } << trailing_zeros) - 1 };
+    }
+    case MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE:
+        // the quotient is no larger than the dividend
+        return known_bits{ .zeros = leading_zeros(a, operand_size) };
+    case MICHAELCC_LINEAR_A_UNSIGNED_MODULO:
+        // the remainder is smaller than the divisor and no larger than the dividend
+        return known_bits{ .zeros = leading_zeros(a, operand_size) | leading_zeros(b, operand_size) };
+    case MICHAELCC_LINEAR_A_SHIFT_LEFT:
+    case MICHAELCC_LINEAR_A_SIGNED_SHIFT_RIGHT:
+    case MICHAELCC_LINEAR_A_UNSIGNED_SHIFT_RIGHT:
+        if (!is_constant(b, operand_size)) {
+            return known_bits{};
+        }
+        return shift(type, a, b.ones & mask, operand_size);
+    case MICHAELCC_LINEAR_A_BITWISE_AND:
+        return known_bits{ .zeros = a.zeros | b.zeros, .ones = a.ones & b.ones };
+    case MICHAELCC_LINEAR_A_BITWISE_OR:
+        return known_bits{ .zeros = a.zeros & b.zeros, .ones = a.ones | b.ones };
+    case MICHAELCC_LINEAR_A_BITWISE_XOR:
+        return known_bits{ .zeros = (a.zeros & b.zeros) | (a.ones & b.ones), .ones = (a.zeros & b.ones) | (a.ones & b.zeros) };
+    case MICHAELCC_LINEAR_A_BITWISE_NAND:
+        return known_bits{ .zeros = a.ones & b.ones, .ones = (a.zeros | b.zeros) & mask };
+    case MICHAELCC_LINEAR_A_AND:
+        if ((is_constant(a, operand_size) && a.ones == 0) || (is_constant(b, operand_size) && b.ones == 0)) {
+            boolean.zeros |= 1;
+        }
+        else if (a.ones && b.ones) {
+            boolean.ones = 1;
+        }
+        return boolean;
+    case MICHAELCC_LINEAR_A_OR:
+        if (a.ones || b.ones) {
+            boolean.ones = 1;
+        }
+        else if (is_constant(a, operand_size) && is_constant(b, operand_size)) {
+            boolean.zeros |= 1;
+        }
+        return boolean;
+    case MICHAELCC_LINEAR_A_COMPARE_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN:
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN:
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN:
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN:
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL: {
+        auto result = decide(type, a, b, operand_size);
+        if (result.has_value()) {
+            boolean.zeros |= result.value() ? 0 : 1;
+            boolean.ones = result.value() ? 1 : 0;
+        }
+        return boolean;
+    }
+    case MICHAELCC_LINEAR_A_XOR:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_NOT_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_LESS_THAN:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_LESS_THAN_OR_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_GREATER_THAN:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_GREATER_THAN_OR_EQUAL:
+        return boolean;
+    default:
+        return known_bits{};
+    }
+}
+
+std::optional<bool> michaelcc::linear::optimization::known_bits_pass::decide(a_instruction_type type, known_bits a, known_bits b, word_size size) noexcept {
+    uint64_t mask = width_mask(size);
+
+    // flipping the sign bit maps signed order onto unsigned order
+    auto flip_sign = [size](known_bits bits) {
+        uint64_t sign = uint64_t{ 1 } << (size - 1);
+        return known_bits{ .zeros = (bits.zeros & ~sign) | (bits.ones & sign), .ones = (bits.ones & ~sign) | (bits.zeros & sign) };
+    };
+    auto less_than = [mask](known_bits a, known_bits b, bool or_equal) -> std::optional<bool> {
+        uint64_t a_min = a.ones, a_max = ~a.zeros & mask;
+        uint64_t b_min = b.ones, b_max = ~b.zeros & mask;
+        if (or_equal ? a_max <= b_min : a_max < b_min) {
+            return true;
+        }
+        if (or_equal ? a_min > b_max : a_min >= b_max) {
+            return false;
+        }
+        return std::nullopt;
+    };
+
+    switch (type) {
+    case MICHAELCC_LINEAR_A_COMPARE_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL: {
+        std::optional<bool> equal;
+        if ((a.ones & b.zeros) | (a.zeros & b.ones)) {
+            equal = false;
+        }
+        else if (is_constant(a, size) && is_constant(b, size)) {
+            equal = true;
+        }
+        if (equal.has_value() && type == MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL) {
+            equal = !equal.value();
+        }
+        return equal;
+    }
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN: return less_than(a, b, false);
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL: return less_than(a, b, true);
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN: return less_than(b, a, false);
+    case MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL: return less_than(b, a, true);
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN: return less_than(flip_sign(a), flip_sign(b), false);
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL: return less_than(flip_sign(a), flip_sign(b), true);
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN: return less_than(flip_sign(b), flip_sign(a), false);
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL: return less_than(flip_sign(b), flip_sign(a), true);
+    default: return std::nullopt;
+    }
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::known_bits_pass::make_constant(virtual_register destination) const {
+    if (destination.reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+        return nullptr;
+    }
+    known_bits bits = get_known_bits(destination);
+    if (!is_constant(bits, destination.reg_size)) {
+        return nullptr;
+    }
+    register_word value{};
+    value.uint64 = bits.ones & width_mask(destination.reg_size);
+    return std::make_unique<init_register>(destination, value);
+}
+
+void michaelcc::linear::optimization::known_bits_pass::prescan(const translation_unit& unit) {
+    for (const auto& [block_id, block] : unit.blocks) {
+        for (const auto& instruction : block.instructions()) {
+            auto destination = instruction->destination_register();
+            if (!destination.has_value() || destination.value().reg_class != MICHAELCC_REGISTER_CLASS_INTEGER || unit.vreg_colors.contains(destination.value())) {
+                continue;
+            }
+            auto [it, inserted] = m_definitions.insert({ destination.value(), instruction.get() });
+            if (!inserted) {
+                it->second = nullptr;
+            }
+        }
+    }
+
+    // every vreg starts out unknown, which is true of any value, and only ever learns bits. an operand in a loop
+    // that has not been visited yet is unknown as well, so the bits found are those that hold on every path
+    bits_calculator calculator(*this);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& [vreg, definition] : m_definitions) {
+            if (!definition) {
+                continue;
+            }
+
+            known_bits bits = calculator(*definition);
+            known_bits& known = m_known_bits[vreg];
+            uint64_t mask = width_mask(vreg.reg_size);
+            uint64_t zeros = (known.zeros | bits.zeros) & mask;
+            uint64_t ones = (known.ones | bits.ones) & mask;
+            if (zeros != known.zeros || ones != known.ones) {
+                known = known_bits{ .zeros = zeros, .ones = ones };
+                changed = true;
+            }
+        }
+    }
+}
+
+bool michaelcc::linear::optimization::known_bits_pass::optimize(translation_unit& unit) {
+    bool made_changes = false;
+
+    instruction_pass pass(*this);
+    for (auto& [block_id, block] : unit.blocks) {
+        auto released_instructions = block.release_instructions();
+
+        std::vector<std::unique_ptr<instruction>> new_instructions;
+        new_instructions.reserve(released_instructions.size());
+        for (auto& instruction : released_instructions) {
+            std::unique_ptr<linear::instruction> new_instruction = pass(*instruction.get());
+
+            if (new_instruction) {
+                made_changes = true;
+                new_instructions.emplace_back(std::move(new_instruction));
+            } else {
+                new_instructions.emplace_back(std::move(instruction));
+            }
+        }
+
+        block.replace_instructions(std::move(new_instructions));
+    }
+
+    return made_changes;
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::a_instruction& node) {
+    return combine(node.type(), m_pass.get_known_bits(node.operand_a()), m_pass.get_known_bits(node.operand_b()), node.operand_a().reg_size, node.destination().reg_size);
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::a2_instruction& node) {
+    uint64_t mask = width_mask(node.operand_a().reg_size);
+    known_bits constant{ .zeros = ~static_cast<uint64_t>(node.constant()) & mask, .ones = static_cast<uint64_t>(node.constant()) & mask };
+    return combine(node.type(), m_pass.get_known_bits(node.operand_a()), constant, node.operand_a().reg_size, node.destination().reg_size);
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::u_instruction& node) {
+    known_bits operand = m_pass.get_known_bits(node.operand());
+    uint64_t mask = width_mask(node.operand().reg_size);
+
+    switch (node.type()) {
+    case MICHAELCC_LINEAR_U_NEGATE:
+        return add(known_bits{ .zeros = operand.ones, .ones = operand.zeros }, known_bits{ .zeros = mask }, true, node.operand().reg_size);
+    case MICHAELCC_LINEAR_U_BITWISE_NOT:
+        return known_bits{ .zeros = operand.ones, .ones = operand.zeros };
+    case MICHAELCC_LINEAR_U_NOT: {
+        known_bits result{ .zeros = width_mask(node.destination().reg_size) & ~uint64_t{ 1 } };
+        if (operand.ones) {
+            result.zeros |= 1;
+        }
+        else if (is_constant(operand, node.operand().reg_size)) {
+            result.ones = 1;
+        }
+        return result;
+    }
+    default:
+        return known_bits{};
+    }
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::c_instruction& node) {
+    known_bits source = m_pass.get_known_bits(node.source());
+    uint64_t mask = width_mask(node.destination().reg_size);
+
+    switch (node.type()) {
+    case MICHAELCC_LINEAR_C_COPY_INIT:
+        return known_bits{ .zeros = source.zeros & mask, .ones = source.ones & mask };
+    case MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC:
+    case MICHAELCC_LINEAR_C_SEXT_OR_TRUNC: {
+        if (!node.is_extension()) {
+            return known_bits{ .zeros = source.zeros & mask, .ones = source.ones & mask };
+        }
+
+        uint64_t extended = mask & ~width_mask(node.source().reg_size);
+        uint64_t sign = uint64_t{ 1 } << (node.source().reg_size - 1);
+        if (node.type() == MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC || (source.zeros & sign)) {
+            source.zeros |= extended;
+        }
+        else if (source.ones & sign) {
+            source.ones |= extended;
+        }
+        return source;
+    }
+    default:
+        return known_bits{};
+    }
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::init_register& node) {
+    uint64_t mask = width_mask(node.destination().reg_size);
+    return known_bits{ .zeros = ~node.value().uint64 & mask, .ones = node.value().uint64 & mask };
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::phi_instruction& node) {
+    if (node.values().empty()) {
+        return known_bits{};
+    }
+
+    known_bits result = m_pass.get_known_bits(node.values().front().vreg);
+    for (const auto& value : node.values()) {
+        result = meet(result, m_pass.get_known_bits(value.vreg));
+    }
+    return result;
+}
+
+michaelcc::linear::optimization::known_bits_pass::known_bits michaelcc::linear::optimization::known_bits_pass::bits_calculator::dispatch(const michaelcc::linear::select_instruction& node) {
+    known_bits condition = m_pass.get_known_bits(node.condition());
+    if (condition.ones) {
+        return m_pass.get_known_bits(node.if_true());
+    }
+    if (is_constant(condition, node.condition().reg_size)) {
+        return m_pass.get_known_bits(node.if_false());
+    }
+    return meet(m_pass.get_known_bits(node.if_true()), m_pass.get_known_bits(node.if_false()));
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::known_bits_pass::instruction_pass::dispatch(const michaelcc::linear::a_instruction& node) {
+    if (auto constant = m_pass.make_constant(node.destination())) {
+        return constant;
+    }
+
+    known_bits a = m_pass.get_known_bits(node.operand_a());
+    known_bits b = m_pass.get_known_bits(node.operand_b());
+    uint64_t mask = width_mask(node.operand_a().reg_size);
+    if (node.destination().reg_size != node.operand_a().reg_size || node.destination().reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+        return nullptr;
+    }
+
+    // a mask that only clears bits already known to be zero, or sets bits already known to be one, changes nothing
+    auto make_copy = [&](virtual_register source) {
+        return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), source);
+    };
+    switch (node.type()) {
+    case MICHAELCC_LINEAR_A_BITWISE_AND:
+        if ((~b.ones & mask & ~a.zeros) == 0) {
+            return make_copy(node.operand_a());
+        }
+        if ((~a.ones & mask & ~b.zeros) == 0) {
+            return make_copy(node.operand_b());
+        }
+        return nullptr;
+    case MICHAELCC_LINEAR_A_BITWISE_OR:
+        if ((~b.zeros & mask & ~a.ones) == 0) {
+            return make_copy(node.operand_a());
+        }
+        if ((~a.zeros & mask & ~b.ones) == 0) {
+            return make_copy(node.operand_b());
+        }
+        return nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::known_bits_pass::instruction_pass::dispatch(const michaelcc::linear::a2_instruction& node) {
+    if (auto constant = m_pass.make_constant(node.destination())) {
+        return constant;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::known_bits_pass::instruction_pass::dispatch(const michaelcc::linear::u_instruction& node) {
+    if (auto constant = m_pass.make_constant(node.destination())) {
+        return constant;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::optimization::known_bits_pass::instruction_pass::dispatch(const michaelcc::linear::c_instruction& node) {
+    if (node.type() != MICHAELCC_LINEAR_C_SEXT_OR_TRUNC && node.type() != MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC) {
+        return nullptr;
+    }
+    if (auto constant = m_pass.make_constant(node.destination())) {
+        return constant;
+    }
+
+    // a conversion between registers of the same width is a copy, whatever it was asked to extend
+    if (node.destination().reg_size == node.source().reg_size) {
+        return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), node.source());
+    }
+
+    auto definition = m_pass.m_definitions.find(node.source());
+    if (definition == m_pass.m_definitions.end() || !definition->second) {
+        return nullptr;
+    }
+    auto* inner = dynamic_cast<const c_instruction*>(definition->second);
+    if (!inner || (inner->type() != MICHAELCC_LINEAR_C_SEXT_OR_TRUNC && inner->type() != MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC)
+        || inner->source().reg_size != node.destination().reg_size) {
+        return nullptr;
+    }
+
+    // truncating an extension gives back the original
+    if (inner->is_extension() && node.is_truncation()) {
+        return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), inner->source());
+    }
+
+    // extending a truncation gives back the original when the bits cut off were copies of what the extension fills in
+    if (inner->is_truncation() && node.is_extension()) {
+        known_bits original = m_pass.get_known_bits(inner->source());
+        uint64_t mask = width_mask(node.destination().reg_size);
+        uint64_t cut_off = mask & ~width_mask(inner->destination().reg_size);
+        uint64_t sign = uint64_t{ 1 } << (inner->destination().reg_size - 1);
+        bool recoverable = node.type() == MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC
+            ? (original.zeros & cut_off) == cut_off
+            : ((original.zeros & (cut_off | sign)) == (cut_off | sign) || (original.ones & (cut_off | sign)) == (cut_off | sign));
+        if (recoverable) {
+            return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), inner->source());
+        }
+    }
+    return nullptr;
+}
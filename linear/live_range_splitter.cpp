@@ -0,0 +1,301 @@
+#include "linear/allocators/live_range_splitter.hpp"
+#include "linear/allocators/remove_phi.hpp"
+#include "linear/dominators.hpp"
+#include <algorithm>
+#include <cassert>
+#include <variant>
+
+void michaelcc::linear::allocators::live_range_splitter::compute_liveness(const function_definition& function) {
+    m_live_in.clear();
+    m_referenced.clear();
+    m_calls.clear();
+
+    const auto& block_ids = function.reverse_postorder();
+    std::unordered_map<size_t, std::unordered_set<virtual_register>> uses;
+    std::unordered_map<size_t, std::unordered_set<virtual_register>> defs;
+    for (size_t block_id : block_ids) {
+        auto& block_uses = uses[block_id];
+        auto& block_defs = defs[block_id];
+        auto& referenced = m_referenced[block_id];
+        for (const auto& instruction : m_translation_unit.blocks.at(block_id).instructions()) {
+            auto operands = instruction->operand_registers();
+            if (auto* call = dynamic_cast<const function_call*>(instruction.get())) {
+                if (auto* callee = std::get_if<virtual_register>(&call->callee())) {
+                    operands.push_back(*callee);
+                }
+            }
+            for (auto operand : operands) {
+                referenced.insert(operand);
+                if (!block_defs.contains(operand)) {
+                    block_uses.insert(operand);
+                }
+            }
+            if (auto destination = instruction->destination_register()) {
+                referenced.insert(destination.value());
+                block_defs.insert(destination.value());
+            }
+        }
+        m_live_in[block_id] = block_uses;
+    }
+
+    auto live_out = [this](size_t block_id) {
+        std::unordered_set<virtual_register> result;
+        for (size_t successor : m_translation_unit.blocks.at(block_id).successor_block_ids()) {
+            auto it = m_live_in.find(successor);
+            if (it != m_live_in.end()) {
+                result.insert(it->second.begin(), it->second.end());
+            }
+        }
+        return result;
+    };
+
+    bool changed;
+    do {
+        changed = false;
+        for (auto it = block_ids.rbegin(); it != block_ids.rend(); ++it) {
+            auto& live_in = m_live_in.at(*it);
+            for (auto vreg : live_out(*it)) {
+                if (!defs.at(*it).contains(vreg) && live_in.insert(vreg).second) {
+                    changed = true;
+                }
+            }
+        }
+    } while (changed);
+
+    // the same sets the allocator will hand to the calls as their caller saved registers
+    for (size_t block_id : block_ids) {
+        auto live_set = live_out(block_id);
+        const auto& instructions = m_translation_unit.blocks.at(block_id).instructions();
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+            if (auto destination = it->get()->destination_register()) {
+                live_set.erase(destination.value());
+            }
+            if (dynamic_cast<const function_call*>(it->get())) {
+                m_calls.push_back(call_info{ .block_id = block_id, .live_across = live_set });
+            }
+            for (auto operand : it->get()->operand_registers()) {
+                live_set.insert(operand);
+            }
+        }
+    }
+}
+
+std::vector<michaelcc::linear::allocators::live_range_splitter::loop_info> michaelcc::linear::allocators::live_range_splitter::find_loops(const function_definition& function) const {
+    std::unordered_map<size_t, std::unordered_set<size_t>> bodies;
+    for (size_t block_id : function.reverse_postorder()) {
+        for (size_t successor : m_translation_unit.blocks.at(block_id).successor_block_ids()) {
+            if (!dominates(m_translation_unit, successor, block_id)) {
+                continue;
+            }
+
+            // a back edge, the natural loop is everything that reaches it without going through the header
+            auto& body = bodies[successor];
+            body.insert(successor);
+            std::vector<size_t> worklist = { block_id };
+            while (!worklist.empty()) {
+                size_t current = worklist.back();
+                worklist.pop_back();
+                if (!body.insert(current).second) {
+                    continue;
+                }
+                for (size_t predecessor : m_translation_unit.blocks.at(current).predecessor_block_ids()) {
+                    worklist.push_back(predecessor);
+                }
+            }
+        }
+    }
+
+    std::vector<loop_info> loops;
+    for (auto& [header_block_id, body] : bodies) {
+        loops.push_back(loop_info{ .header_block_id = header_block_id, .body = std::move(body) });
+    }
+
+    // outer loops first, a vreg split around one is no longer live in the loops inside it
+    std::sort(loops.begin(), loops.end(), [](const loop_info& a, const loop_info& b) {
+        if (a.body.size() != b.body.size()) {
+            return a.body.size() > b.body.size();
+        }
+        return a.header_block_id < b.header_block_id;
+    });
+    return loops;
+}
+
+void michaelcc::linear::allocators::live_range_splitter::split_function(const function_definition& function) {
+    auto loops = find_loops(function);
+    if (loops.empty()) {
+        return;
+    }
+    compute_liveness(function);
+    if (m_calls.empty()) {
+        return;
+    }
+
+    std::unordered_map<size_t, size_t> loop_depth;
+    for (const auto& loop : loops) {
+        for (size_t block_id : loop.body) {
+            loop_depth[block_id]++;
+        }
+    }
+
+    std::unordered_map<register_class, size_t> callee_saved_registers;
+    for (const auto& physical_register : m_translation_unit.platform_info.registers) {
+        if (physical_register.is_callee_saved && !physical_register.is_protected) {
+            callee_saved_registers[physical_register.reg_class]++;
+        }
+    }
+
+    // the blocks each vreg was split out of
+    std::unordered_map<virtual_register, std::unordered_set<size_t>> split_out;
+    auto is_live_in = [&](virtual_register vreg, size_t block_id) {
+        auto it = split_out.find(vreg);
+        return m_live_in.at(block_id).contains(vreg) && (it == split_out.end() || !it->second.contains(block_id));
+    };
+
+    for (const auto& loop : loops) {
+        std::vector<size_t> entries;
+        for (size_t predecessor : m_translation_unit.blocks.at(loop.header_block_id).predecessor_block_ids()) {
+            if (!loop.body.contains(predecessor)) {
+                entries.push_back(predecessor);
+            }
+        }
+        if (entries.empty()) {
+            continue;
+        }
+
+        // how often the calls run per entry into the loop, and the most vregs of each class live across one
+        size_t call_frequency = 0;
+        std::unordered_map<register_class, size_t> pressure;
+        for (const auto& call : m_calls) {
+            if (!loop.body.contains(call.block_id)) {
+                continue;
+            }
+
+            size_t depth = std::min(loop_depth.at(call.block_id) - loop_depth.at(loop.header_block_id) + 1, max_loop_depth);
+            size_t frequency = 1;
+            for (size_t i = 0; i < depth; i++) {
+                frequency *= loop_weight;
+            }
+            call_frequency += frequency;
+
+            std::unordered_map<register_class, size_t> live_across;
+            for (auto vreg : call.live_across) {
+                auto it = split_out.find(vreg);
+                if (it == split_out.end() || !it->second.contains(call.block_id)) {
+                    live_across[vreg.reg_class]++;
+                }
+            }
+            for (auto [reg_class, count] : live_across) {
+                pressure[reg_class] = std::max(pressure[reg_class], count);
+            }
+        }
+        if (call_frequency == 0) {
+            continue;
+        }
+
+        std::unordered_set<virtual_register> referenced;
+        for (size_t block_id : loop.body) {
+            referenced.insert(m_referenced.at(block_id).begin(), m_referenced.at(block_id).end());
+        }
+
+        struct candidate {
+            virtual_register vreg;
+            std::vector<std::pair<size_t, size_t>> exits;
+        };
+        std::vector<candidate> candidates;
+        for (auto vreg : m_live_in.at(loop.header_block_id)) {
+            if (referenced.contains(vreg) || !is_live_in(vreg, loop.header_block_id)
+                || m_translation_unit.vreg_colors.contains(vreg) || m_translation_unit.cannot_spill_vregs.contains(vreg)) {
+                continue;
+            }
+
+            candidate split{ .vreg = vreg };
+            for (size_t block_id : loop.body) {
+                for (size_t successor : m_translation_unit.blocks.at(block_id).successor_block_ids()) {
+                    if (!loop.body.contains(successor) && m_live_in.at(successor).contains(vreg)) {
+                        split.exits.push_back({ block_id, successor });
+                    }
+                }
+            }
+
+            // a save and a restore around every call against a store per entry and a reload per exit
+            if (entries.size() + split.exits.size() < 2 * call_frequency) {
+                candidates.push_back(std::move(split));
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+            if (a.exits.size() != b.exits.size()) {
+                return a.exits.size() < b.exits.size();
+            }
+            return a.vreg.id < b.vreg.id;
+        });
+
+        // only the vregs that would not fit in the callee saved registers are worth moving out
+        std::unordered_map<register_class, size_t> excess;
+        for (auto [reg_class, count] : pressure) {
+            size_t available = callee_saved_registers[reg_class];
+            excess[reg_class] = count > available ? count - available : 0;
+        }
+
+        for (const auto& split : candidates) {
+            auto& remaining = excess[split.vreg.reg_class];
+            if (remaining == 0) {
+                continue;
+            }
+            remaining--;
+
+            size_t size = m_translation_unit.platform_info.bits_to_au(split.vreg.reg_size);
+            auto [frame_pointer, offset] = m_frame_allocator.allocate_slot(function.entry_block_id(), size, size);
+            for (size_t entry : entries) {
+                m_edge_code[{ entry, loop.header_block_id }].stores.emplace_back(
+                    std::make_unique<store_memory>(frame_pointer, split.vreg, offset));
+            }
+            for (auto exit : split.exits) {
+                m_edge_code[exit].reloads.emplace_back(
+                    std::make_unique<load_memory>(split.vreg, frame_pointer, offset));
+            }
+            split_out[split.vreg].insert(loop.body.begin(), loop.body.end());
+        }
+    }
+}
+
+bool michaelcc::linear::allocators::live_range_splitter::place_edge_instructions() {
+    bool split_any = false;
+    for (auto& [edge, code] : m_edge_code) {
+        auto [pred_block_id, block_id] = edge;
+
+        std::vector<std::unique_ptr<instruction>> instructions = std::move(code.reloads);
+        for (auto& store : code.stores) {
+            instructions.emplace_back(std::move(store));
+        }
+
+        auto& pred_block = m_translation_unit.blocks.at(pred_block_id);
+        auto& block = m_translation_unit.blocks.at(block_id);
+        if (pred_block.successor_block_ids().size() == 1) {
+            for (auto& instruction : instructions) {
+                pred_block.phi_add_instruction(std::move(instruction));
+            }
+        }
+        else if (block.predecessor_block_ids().size() == 1) {
+            auto& block_instructions = block.mutable_instructions();
+            block_instructions.insert(block_instructions.begin(),
+                std::make_move_iterator(instructions.begin()), std::make_move_iterator(instructions.end()));
+        }
+        else {
+            split_edge(m_translation_unit, pred_block_id, block_id, std::move(instructions));
+            split_any = true;
+        }
+    }
+    m_edge_code.clear();
+    return split_any;
+}
+
+void michaelcc::linear::allocators::live_range_splitter::split() {
+    for (const auto& function : m_translation_unit.function_definitions) {
+        split_function(*function);
+    }
+
+    if (place_edge_instructions()) {
+        compute_dominators(m_translation_unit);
+    }
+}
@@ -1,22 +1,67 @@
 #include "linear/pass.hpp"
 #include "linear/dominators.hpp"
+#include <algorithm>
+#include <unordered_set>
 
 namespace michaelcc::linear {
+    namespace {
+        // drops what the pass did not preserve, and collects the functions whose dominator info on the blocks went stale
+        void invalidate(translation_unit& unit, const pass& mutating_pass, analysis_manager& analyses, std::unordered_set<size_t>& stale_functions) {
+            auto preserved = mutating_pass.preserved();
+            if (preserved.is_preserved<dominator_analysis>()) {
+                analyses.invalidate_all(preserved);
+                return;
+            }
+
+            auto changed_edge_blocks = mutating_pass.changed_edge_blocks();
+            if (!changed_edge_blocks.has_value()) {
+                analyses.invalidate_all(preserved);
+                for (size_t i = 0; i < unit.function_definitions.size(); i++) {
+                    stale_functions.insert(i);
+                }
+                return;
+            }
+
+            // the reverse postorder of a function whose dominators are current lists every block it can reach. one
+            // that is stale already is in the set, and an edge out of an unreachable block changes nothing
+            std::unordered_set<size_t> changed(changed_edge_blocks->begin(), changed_edge_blocks->end());
+            auto keeping_dominators = preserved;
+            keeping_dominators.preserve<dominator_analysis>();
+            for (size_t i = 0; i < unit.function_definitions.size(); i++) {
+                const auto& order = unit.function_definitions[i]->reverse_postorder();
+                bool edges_changed = std::any_of(order.begin(), order.end(), [&](size_t block_id) { return changed.contains(block_id); });
+                analyses.invalidate(i, edges_changed ? preserved : keeping_dominators);
+                if (edges_changed) {
+                    stale_functions.insert(i);
+                }
+            }
+        }
+    }
+
     bool transform(translation_unit& unit, std::vector<std::unique_ptr<pass>>& passes, int max_passes) {
+        analysis_manager analyses(unit);
+        return transform(unit, passes, analyses, max_passes);
+    }
+
+    bool transform(translation_unit& unit, std::vector<std::unique_ptr<pass>>& passes, analysis_manager& analyses, int max_passes) {
+        bool converged = true;
+        std::unordered_set<size_t> stale_functions;
         bool any_pass_mutated = false;
         int passes_run = 0;
         do {
             if (passes_run >= max_passes) {
-                return false;
+                converged = false;
+                break;
             }
 
             any_pass_mutated = false;
             for (auto& pass : passes) {
+                pass->request_analyses(analyses);
                 pass->prescan(unit);
 
                 bool mutated_stuff = pass->optimize(unit);
                 if (mutated_stuff) {
-                    compute_dominators(unit);
+                    invalidate(unit, *pass, analyses, stale_functions);
                 }
                 any_pass_mutated |= mutated_stuff;
 
@@ -26,6 +71,11 @@ namespace michaelcc::linear {
             passes_run++;
         } while (any_pass_mutated);
 
-        return true;
+        // later stages read dominator info straight off the blocks. functions a pass already asked about since they
+        // changed are cached and not computed again
+        for (size_t function_id : stale_functions) {
+            analyses.get<dominator_analysis>(function_id);
+        }
+        return converged;
     }
-}
\ No newline at end of file
+}
@@ -2,10 +2,16 @@
 #include "linear/optimization/copy_prop.hpp"
 #include "linear/allocators/register_allocator.hpp"
 #include "linear/allocators/register_spiller.hpp"
+#include "linear/allocators/live_range_splitter.hpp"
+#include "linear/allocators/instruction_scheduler.hpp"
 #include "linear/allocators/frame_allocator.hpp"
 #include "linear/allocators/remove_phi.hpp"
+#include "linear/dominators.hpp"
 #include <algorithm>
+#include <map>
 #include <optional>
+#include <unordered_set>
+#include <variant>
 
 namespace {
 
@@ -29,7 +35,7 @@ virtual_register resolve(virtual_register vreg, const copy_map_t& map) {
     return current;
 }
 
-void invalidate_color(copy_map_t& map, register_t color,
+void invalidate_color(copy_map_t& map, michaelcc::linear::register_t color,
                       const translation_unit& unit) {
     for (auto it = map.begin(); it != map.end(); ) {
         bool src_hit = unit.vreg_colors.contains(it->second)
@@ -336,78 +342,483 @@ void register_allocation(translation_unit& unit,
     postphi_passes.emplace_back(std::make_unique<copy_prop_pass>());
     postphi_passes.emplace_back(std::make_unique<frame_arithmetic_pass>());
 
-    for (;;) {
-        allocators::register_allocator register_allocator(unit);
+    allocators::instruction_scheduler(unit).schedule();
+    allocators::live_range_splitter(unit, frame_allocator).split();
 
+    allocators::register_allocator register_allocator(unit);
+    for (;;) {
         auto spilled_vregs = register_allocator.allocate();
         if (spilled_vregs.empty()) {
-            transform(unit, postphi_passes);
             break;
         }
 
-        allocators::register_spiller register_spiller(unit, spilled_vregs);
-        register_spiller.spill();
-        frame_allocator.allocate();
-        transform(unit, postphi_passes);
+        allocators::register_spiller register_spiller(unit, frame_allocator, spilled_vregs);
+        auto changed_blocks = register_spiller.spill();
+        register_allocator.update_after_spill(spilled_vregs, changed_blocks);
     }
+    transform(unit, postphi_passes);
 }
 
 }
 
 namespace michaelcc::linear::allocators {
 
+namespace {
+
 struct phi_copy {
     virtual_register dest;
     virtual_register source;
 };
 
-static std::vector<phi_copy> sequentialize_parallel_copies(
-    std::vector<phi_copy> copies,
-    linear::translation_unit& unit
-) {
+struct phi_record {
+    size_t block_id;
+    virtual_register dest;
+    std::vector<var_info> values;
+};
+
+using vreg_set = std::unordered_set<virtual_register>;
+
+// renames every register, definitions included, after phi related vregs were merged
+class rename_registers_transform : public instruction_transformer {
+private:
+    const std::unordered_map<virtual_register, virtual_register>& m_renames;
+
+    virtual_register get(virtual_register vreg) const {
+        auto it = m_renames.find(vreg);
+        return it != m_renames.end() ? it->second : vreg;
+    }
+
+    bool renamed(const instruction& node) const {
+        auto destination = node.destination_register();
+        if (destination.has_value() && m_renames.contains(*destination)) {
+            return true;
+        }
+        auto operands = node.operand_registers();
+        return std::any_of(operands.begin(), operands.end(), [this](virtual_register vreg) {
+            return m_renames.contains(vreg);
+        });
+    }
+
+public:
+    explicit rename_registers_transform(const std::unordered_map<virtual_register, virtual_register>& renames)
+        : m_renames(renames) {}
+
+protected:
+    std::unique_ptr<instruction> dispatch(const a_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<a_instruction>(node.type(), get(node.destination()), get(node.operand_a()), get(node.operand_b()));
+    }
+
+    std::unique_ptr<instruction> dispatch(const a2_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<a2_instruction>(node.type(), get(node.destination()), get(node.operand_a()), node.constant());
+    }
+
+    std::unique_ptr<instruction> dispatch(const u_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<u_instruction>(node.type(), get(node.destination()), get(node.operand()));
+    }
+
+    std::unique_ptr<instruction> dispatch(const c_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<c_instruction>(node.type(), get(node.destination()), get(node.source()));
+    }
+
+    std::unique_ptr<instruction> dispatch(const init_register& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<init_register>(get(node.destination()), node.value());
+    }
+
+    std::unique_ptr<instruction> dispatch(const load_memory& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<load_memory>(get(node.destination()), get(node.source_address()), node.offset());
+    }
+
+    std::unique_ptr<instruction> dispatch(const store_memory& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<store_memory>(get(node.destination_address()), get(node.value()), node.offset());
+    }
+
+    std::unique_ptr<instruction> dispatch(const alloca_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<alloca_instruction>(get(node.destination()), node.size_bytes(), node.alignment());
+    }
+
+    std::unique_ptr<instruction> dispatch(const valloca_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<valloca_instruction>(get(node.destination()), get(node.size()), node.alignment());
+    }
+
+    std::unique_ptr<instruction> dispatch(const load_parameter& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<load_parameter>(get(node.destination()), node.parameter());
+    }
+
+    std::unique_ptr<instruction> dispatch(const branch_condition& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<branch_condition>(get(node.condition()), node.if_true_block_id(), node.if_false_block_id(), node.is_loop());
+    }
+
+    std::unique_ptr<instruction> dispatch(const jump_table& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<jump_table>(get(node.index()), std::vector<size_t>(node.target_block_ids()));
+    }
+
+    std::unique_ptr<instruction> dispatch(const select_instruction& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<select_instruction>(get(node.destination()), get(node.condition()), get(node.if_true()), get(node.if_false()));
+    }
+
+    std::unique_ptr<instruction> dispatch(const push_function_argument& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<push_function_argument>(node.argument(), get(node.value()), node.function_call_id());
+    }
+
+    std::unique_ptr<instruction> dispatch(const function_call& node) override {
+        auto* callee_vreg = std::get_if<virtual_register>(&node.callee());
+        bool callee_renamed = callee_vreg && m_renames.contains(*callee_vreg);
+        bool destination_renamed = node.destination().has_value() && m_renames.contains(*node.destination());
+        if (!callee_renamed && !destination_renamed) return nullptr;
+
+        std::optional<virtual_register> destination = node.destination();
+        if (destination.has_value()) {
+            destination = get(*destination);
+        }
+        function_call::callable callee = node.callee();
+        if (callee_vreg) {
+            callee = get(*callee_vreg);
+        }
+        auto call = std::make_unique<function_call>(destination, std::move(callee), node.argument_count(), node.function_call_id());
+        call->set_caller_saved_registers(std::vector<virtual_register>(node.caller_saved_registers()));
+        return call;
+    }
+
+    std::unique_ptr<instruction> dispatch(const load_effective_address& node) override {
+        if (!renamed(node)) return nullptr;
+        return std::make_unique<load_effective_address>(get(node.destination()), node.label());
+    }
+
+    std::unique_ptr<instruction> handle_default(const instruction&) override {
+        return nullptr;
+    }
+};
+
+// merges phi related vregs whose live ranges are disjoint, so the copies between them disappear.
+// interference is only tracked between the vregs phis mention, with ssa liveness: a phi operand is live out of the
+// predecessor it arrives from and a phi result is defined at the top of its block.
+class phi_coalescer {
+private:
+    translation_unit& m_unit;
+    const std::vector<phi_record>& m_phis;
+
+    std::vector<size_t> m_block_ids;
+    vreg_set m_candidates;
+    std::unordered_map<size_t, std::vector<virtual_register>> m_phi_defs;
+    std::unordered_map<size_t, std::vector<virtual_register>> m_phi_uses;
+    std::unordered_map<size_t, vreg_set> m_live_in;
+    std::unordered_map<virtual_register, vreg_set> m_interference;
+
+    std::unordered_map<virtual_register, virtual_register> m_parent;
+    std::unordered_map<virtual_register, std::vector<virtual_register>> m_members;
+
+    void add_interference(virtual_register a, virtual_register b) {
+        if (a == b || a.reg_class != b.reg_class) {
+            return;
+        }
+        m_interference[a].insert(b);
+        m_interference[b].insert(a);
+    }
+
+    vreg_set live_out(size_t block_id) const {
+        vreg_set live;
+        for (size_t successor : m_unit.blocks.at(block_id).successor_block_ids()) {
+            auto it = m_live_in.find(successor);
+            if (it != m_live_in.end()) {
+                live.insert(it->second.begin(), it->second.end());
+            }
+        }
+        auto uses = m_phi_uses.find(block_id);
+        if (uses != m_phi_uses.end()) {
+            live.insert(uses->second.begin(), uses->second.end());
+        }
+        return live;
+    }
+
+    // walks the block backwards from its live out set, recording interference between candidates if asked
+    vreg_set live_before(size_t block_id, vreg_set live, bool record) {
+        const auto& instructions = m_unit.blocks.at(block_id).instructions();
+        for (auto it = instructions.rbegin(); it != instructions.rend(); ++it) {
+            auto destination = (*it)->destination_register();
+            if (destination.has_value() && m_candidates.contains(*destination)) {
+                if (record) {
+                    // a copy's source holds the same value as its destination, so they may share a register
+                    std::optional<virtual_register> copied;
+                    auto* copy = dynamic_cast<const c_instruction*>(it->get());
+                    if (copy && copy->type() == MICHAELCC_LINEAR_C_COPY_INIT) {
+                        copied = copy->source();
+                    }
+                    for (auto vreg : live) {
+                        if (vreg != copied) {
+                            add_interference(*destination, vreg);
+                        }
+                    }
+                }
+                live.erase(*destination);
+            }
+            for (auto operand : (*it)->operand_registers()) {
+                if (m_candidates.contains(operand)) {
+                    live.insert(operand);
+                }
+            }
+        }
+
+        auto defs = m_phi_defs.find(block_id);
+        if (defs != m_phi_defs.end()) {
+            for (auto dest : defs->second) {
+                if (record) {
+                    // every phi of a block is written by the same parallel copy, so their results must stay apart
+                    for (auto vreg : live) {
+                        add_interference(dest, vreg);
+                    }
+                    for (auto other : defs->second) {
+                        add_interference(dest, other);
+                    }
+                }
+            }
+            for (auto dest : defs->second) {
+                live.erase(dest);
+            }
+        }
+        return live;
+    }
+
+    void compute_liveness() {
+        bool changed;
+        do {
+            changed = false;
+            for (auto it = m_block_ids.rbegin(); it != m_block_ids.rend(); ++it) {
+                auto live_in = live_before(*it, live_out(*it), false);
+                auto& current = m_live_in[*it];
+                if (live_in.size() != current.size()) {
+                    current = std::move(live_in);
+                    changed = true;
+                }
+            }
+        } while (changed);
+
+        for (size_t block_id : m_block_ids) {
+            live_before(block_id, live_out(block_id), true);
+        }
+    }
+
+    virtual_register find(virtual_register vreg) {
+        auto it = m_parent.find(vreg);
+        if (it == m_parent.end() || it->second == vreg) {
+            return vreg;
+        }
+        auto root = find(it->second);
+        m_parent[vreg] = root;
+        return root;
+    }
+
+    bool try_merge(virtual_register a, virtual_register b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) {
+            return true;
+        }
+        if (a.reg_class != b.reg_class || a.reg_size != b.reg_size) {
+            return false;
+        }
+        // precolored registers share their physical register with vregs the interference here does not see
+        if (m_unit.vreg_colors.contains(a) || m_unit.vreg_colors.contains(b)) {
+            return false;
+        }
+        if (m_unit.cannot_spill_vregs.contains(a) != m_unit.cannot_spill_vregs.contains(b)) {
+            return false;
+        }
+
+        auto& members_a = m_members[a];
+        auto& members_b = m_members[b];
+        if (members_a.empty()) members_a.push_back(a);
+        if (members_b.empty()) members_b.push_back(b);
+        for (auto x : members_a) {
+            auto it = m_interference.find(x);
+            if (it == m_interference.end()) {
+                continue;
+            }
+            for (auto y : members_b) {
+                if (it->second.contains(y)) {
+                    return false;
+                }
+            }
+        }
+
+        m_parent[b] = a;
+        members_a.insert(members_a.end(), members_b.begin(), members_b.end());
+        m_members.erase(b);
+        return true;
+    }
+
+public:
+    phi_coalescer(translation_unit& unit, const std::vector<phi_record>& phis) : m_unit(unit), m_phis(phis) {
+        for (const auto& [block_id, block] : unit.blocks) {
+            m_block_ids.push_back(block_id);
+        }
+        std::sort(m_block_ids.begin(), m_block_ids.end());
+
+        for (const auto& phi : phis) {
+            m_candidates.insert(phi.dest);
+            m_phi_defs[phi.block_id].push_back(phi.dest);
+            for (const auto& value : phi.values) {
+                m_candidates.insert(value.vreg);
+                m_phi_uses[value.block_id].push_back(value.vreg);
+            }
+
+            // a predecessor without a value leaves the result as it was
+            for (size_t pred_id : unit.blocks.at(phi.block_id).predecessor_block_ids()) {
+                bool has_value = std::any_of(phi.values.begin(), phi.values.end(), [pred_id](const var_info& value) {
+                    return value.block_id == pred_id;
+                });
+                if (!has_value) {
+                    m_phi_uses[pred_id].push_back(phi.dest);
+                }
+            }
+        }
+    }
+
+    // returns the register every merged vreg was renamed to
+    std::unordered_map<virtual_register, virtual_register> coalesce() {
+        compute_liveness();
+        for (const auto& phi : m_phis) {
+            for (const auto& value : phi.values) {
+                try_merge(phi.dest, value.vreg);
+            }
+        }
+
+        std::unordered_map<virtual_register, virtual_register> renames;
+        for (auto vreg : m_candidates) {
+            auto root = find(vreg);
+            if (root != vreg) {
+                renames.insert({ vreg, root });
+            }
+        }
+        return renames;
+    }
+};
+
+// orders a parallel copy so that no source is overwritten before it is read, in time linear in the number of copies.
+// a temporary is only introduced to break a cycle.
+std::vector<phi_copy> sequentialize_parallel_copies(const std::vector<phi_copy>& copies, translation_unit& unit) {
     std::vector<phi_copy> result;
+    result.reserve(copies.size());
+
+    // where the value a source held before the copy now lives, and which source each destination wants
+    std::unordered_map<virtual_register, virtual_register> location;
+    std::unordered_map<virtual_register, virtual_register> wanted;
+    vreg_set written;
+    std::vector<virtual_register> ready;
+    std::vector<virtual_register> pending;
+
+    for (const auto& copy : copies) {
+        location.insert({ copy.source, copy.source });
+        wanted.insert({ copy.dest, copy.source });
+        pending.push_back(copy.dest);
+    }
+    for (const auto& copy : copies) {
+        if (!location.contains(copy.dest)) {
+            ready.push_back(copy.dest);
+        }
+    }
+
+    while (!pending.empty()) {
+        while (!ready.empty()) {
+            auto dest = ready.back();
+            ready.pop_back();
+
+            auto source = wanted.at(dest);
+            auto current = location.at(source);
+            result.push_back({ dest, current });
+            written.insert(dest);
+            location[source] = dest;
 
-    while (!copies.empty()) {
-        auto safe = std::find_if(copies.begin(), copies.end(),
-            [&](const phi_copy& c) {
-                return std::none_of(copies.begin(), copies.end(),
-                    [&](const phi_copy& other) {
-                        return &other != &c && other.source == c.dest;
-                    });
-            });
+            // the source was just copied out for the first time, so it may be overwritten now
+            if (source == current && wanted.contains(source) && !written.contains(source)) {
+                ready.push_back(source);
+            }
+        }
 
-        if (safe != copies.end()) {
-            result.push_back(*safe);
-            copies.erase(safe);
-        } else {
-            auto& first = copies.front();
-            auto temp = unit.new_vreg(first.source.reg_size,
-                                      first.source.reg_class);
-            result.push_back({ temp, first.source });
-            first.source = temp;
+        auto dest = pending.back();
+        pending.pop_back();
+        if (!written.contains(dest)) {
+            // everything left is on a cycle, save this value so its register can be written
+            auto temp = unit.new_vreg(dest.reg_size, dest.reg_class);
+            result.push_back({ temp, dest });
+            location[dest] = temp;
+            ready.push_back(dest);
         }
     }
 
     return result;
 }
 
+}
+
+size_t split_edge(translation_unit& unit, size_t pred_block_id, size_t block_id, std::vector<std::unique_ptr<instruction>>&& instructions) {
+    size_t split_block_id = unit.new_block_id();
+    auto& pred_block = unit.blocks.at(pred_block_id);
+
+    auto& terminator = pred_block.mutable_instructions().back();
+    if (auto* branch = dynamic_cast<const branch_condition*>(terminator.get())) {
+        terminator = std::make_unique<branch_condition>(
+            branch->condition(),
+            branch->if_true_block_id() == block_id ? split_block_id : branch->if_true_block_id(),
+            branch->if_false_block_id() == block_id ? split_block_id : branch->if_false_block_id(),
+            branch->is_loop());
+    }
+    else if (auto* table = dynamic_cast<const jump_table*>(terminator.get())) {
+        std::vector<size_t> target_block_ids = table->target_block_ids();
+        std::replace(target_block_ids.begin(), target_block_ids.end(), block_id, split_block_id);
+        terminator = std::make_unique<jump_table>(table->index(), std::move(target_block_ids));
+    }
+    else {
+        terminator = std::make_unique<linear::branch>(split_block_id);
+    }
+    pred_block.replace_successor_block_id(block_id, split_block_id);
+
+    instructions.emplace_back(std::make_unique<linear::branch>(block_id));
+    basic_block split_block(split_block_id, std::move(instructions), { block_id });
+    split_block.add_predecessor_block_id(pred_block_id);
+    unit.blocks.insert({ split_block_id, std::move(split_block) });
+
+    unit.blocks.at(block_id).replace_predecessor_block_id(pred_block_id, split_block_id);
+    return split_block_id;
+}
+
 void remove_phi_nodes(linear::translation_unit& unit) {
-    std::unordered_map<size_t, std::vector<phi_copy>> pending_copies;
+    std::vector<phi_record> phis;
 
-    for (auto& [block_id, block] : unit.blocks) {
+    std::vector<size_t> block_ids;
+    for (const auto& [block_id, block] : unit.blocks) {
+        block_ids.push_back(block_id);
+    }
+    std::sort(block_ids.begin(), block_ids.end());
+
+    for (size_t block_id : block_ids) {
+        auto& block = unit.blocks.at(block_id);
         auto released_instructions = block.release_instructions();
         std::vector<std::unique_ptr<instruction>> new_instructions;
         new_instructions.reserve(released_instructions.size());
 
         for (auto& instruction : released_instructions) {
             if (auto phi = dynamic_cast<const phi_instruction*>(instruction.get())) {
+                phi_record record{ .block_id = block_id, .dest = phi->destination() };
                 for (const auto& value : phi->values()) {
                     if (phi->destination() == value.vreg) continue;
                     assert(unit.blocks.contains(value.block_id));
-                    pending_copies[value.block_id].push_back({
-                        phi->destination(), value.vreg
-                    });
+                    record.values.push_back(value);
                 }
+                phis.push_back(std::move(record));
             } else {
                 new_instructions.emplace_back(std::move(instruction));
             }
@@ -415,17 +826,70 @@ void remove_phi_nodes(linear::translation_unit& unit) {
         block.replace_instructions(std::move(new_instructions));
     }
 
-    for (auto& [pred_block_id, copies] : pending_copies) {
-        auto sequentialized = sequentialize_parallel_copies(
-            std::move(copies), unit);
+    if (phis.empty()) {
+        return;
+    }
+
+    auto renames = phi_coalescer(unit, phis).coalesce();
+    if (!renames.empty()) {
+        rename_registers_transform rename(renames);
+        for (auto& [block_id, block] : unit.blocks) {
+            for (auto& instruction : block.mutable_instructions()) {
+                if (auto renamed = rename(*instruction)) {
+                    instruction = std::move(renamed);
+                }
+            }
+        }
+        for (const auto& [vreg, root] : renames) {
+            unit.free_vreg(vreg);
+        }
+    }
+
+    auto get = [&renames](virtual_register vreg) {
+        auto it = renames.find(vreg);
+        return it != renames.end() ? it->second : vreg;
+    };
+
+    // the copies left on each edge, keyed by (predecessor, block)
+    std::map<std::pair<size_t, size_t>, std::vector<phi_copy>> edge_copies;
+    for (const auto& phi : phis) {
+        auto dest = get(phi.dest);
+        for (const auto& value : phi.values) {
+            auto source = get(value.vreg);
+            if (source != dest) {
+                edge_copies[{ value.block_id, phi.block_id }].push_back({ dest, source });
+            }
+        }
+    }
+
+    bool split_any = false;
+    for (auto& [edge, copies] : edge_copies) {
+        auto [pred_block_id, block_id] = edge;
+
+        std::vector<std::unique_ptr<instruction>> sequentialized;
+        for (const auto& copy : sequentialize_parallel_copies(copies, unit)) {
+            sequentialized.emplace_back(std::make_unique<linear::c_instruction>(
+                linear::MICHAELCC_LINEAR_C_COPY_INIT, copy.dest, copy.source));
+        }
+
+        // copies at the end of a block with several successors would also run on its other edges
+        const auto& successors = unit.blocks.at(pred_block_id).successor_block_ids();
+        bool is_edge = std::find(successors.begin(), successors.end(), block_id) != successors.end();
+        if (is_edge && successors.size() > 1) {
+            split_edge(unit, pred_block_id, block_id, std::move(sequentialized));
+            split_any = true;
+            continue;
+        }
+
         auto& pred_block = unit.blocks.at(pred_block_id);
         for (auto& copy : sequentialized) {
-            pred_block.phi_add_instruction(
-                std::make_unique<linear::c_instruction>(
-                    linear::MICHAELCC_LINEAR_C_COPY_INIT,
-                    copy.dest, copy.source));
+            pred_block.phi_add_instruction(std::move(copy));
         }
     }
+
+    if (split_any) {
+        compute_dominators(unit);
+    }
 }
 
 }
@@ -1,4 +1,5 @@
 #include "linear/allocators/register_allocator.hpp"
+#include "linear/allocators/register_spiller.hpp"
 #include "linear/ir.hpp"
 #include "linear/registers.hpp"
 #include <algorithm>
@@ -122,6 +123,7 @@ void michaelcc::linear::allocators::register_allocator::build_inference_graph(si
                 ensure_node(live_vreg).prefer_callee_saved = true;
                 caller_saved_registers.push_back(live_vreg);
             }
+            m_live_across_calls[call->function_call_id()] = caller_saved_registers;
             call->set_caller_saved_registers(std::move(caller_saved_registers));
         }
 
@@ -237,6 +239,11 @@ std::vector<michaelcc::linear::virtual_register> michaelcc::linear::allocators::
                 return m_translation_unit.cannot_spill_vregs.contains(a.first); // true => lower priority
             }
 
+            // rematerializable nodes cost an instruction per use instead of a load and a store
+            if (m_rematerializable.contains(a.first) != m_rematerializable.contains(b.first)) {
+                return m_rematerializable.contains(b.first);
+            }
+
             // Otherwise, prefer nodes with lower degree.
             return na.degree < nb.degree;
          }
@@ -330,19 +337,62 @@ std::vector<michaelcc::linear::virtual_register> michaelcc::linear::allocators::
     return spilled_vregs;
 }
 
+void michaelcc::linear::allocators::register_allocator::find_rematerializable() {
+    std::unordered_map<virtual_register, size_t> definition_counts;
+    m_rematerializable.clear();
+    for (const auto& [block_id, block] : m_translation_unit.blocks) {
+        for (const auto& instruction : block.instructions()) {
+            auto destination = instruction->destination_register();
+            if (!destination.has_value()) {
+                continue;
+            }
+            if (++definition_counts[destination.value()] == 1 && !m_spill_temporaries.contains(destination.value())
+                && register_spiller::is_rematerializable(*instruction, m_translation_unit)) {
+                m_rematerializable.insert(destination.value());
+            }
+            else {
+                m_rematerializable.erase(destination.value());
+            }
+        }
+    }
+}
+
 std::vector<michaelcc::linear::virtual_register> michaelcc::linear::allocators::register_allocator::allocate() {
-    compute_all_block_liveliness();
-    build_inference_graph();
+    bool kept_colors = m_built;
+    if (!m_built) {
+        compute_all_block_liveliness();
+        build_inference_graph();
+        for (const auto& [vreg, _] : m_translation_unit.vreg_colors) {
+            m_precolored.insert(vreg);
+        }
+        m_built = true;
+    }
+    else {
+        // reloads sit where the pressure was highest, so their neighbours give up their colors to leave them one
+        for (auto vreg : m_recolor) {
+            m_translation_unit.vreg_colors.erase(vreg);
+        }
+        m_recolor.clear();
+    }
+    find_rematerializable();
     auto select_stack = simplify();
     auto spilled_vregs = select(select_stack);
+    if (kept_colors && !spilled_vregs.empty()) {
+        // the kept colors boxed the new vregs in, coloring everything again spills less than another round would
+        std::erase_if(m_translation_unit.vreg_colors, [this](const auto& color) { return !m_precolored.contains(color.first); });
+        spilled_vregs = select(simplify());
+    }
 
     for (auto& [block_id, block] : m_translation_unit.blocks) {
         for (auto& instruction : block.instructions()) {
             if (auto* call = dynamic_cast<function_call*>(instruction.get())) {
-                auto caller_saved_registers = call->caller_saved_registers();
+                const auto& caller_saved_registers = m_live_across_calls.at(call->function_call_id());
                 std::vector<virtual_register> new_caller_saved_registers;
                 new_caller_saved_registers.reserve(caller_saved_registers.size());
                 for (auto& caller_saved_register : caller_saved_registers) {
+                    if (!m_translation_unit.vreg_colors.contains(caller_saved_register)) {
+                        continue; // spilled, update_after_spill drops it from the list
+                    }
                     register_t register_id = m_translation_unit.vreg_colors.at(caller_saved_register);
                     auto register_info = m_translation_unit.platform_info.get_register_info(register_id);
                     if (register_info.is_caller_saved) {
@@ -355,4 +405,59 @@ std::vector<michaelcc::linear::virtual_register> michaelcc::linear::allocators::
     }
 
     return spilled_vregs;
-}
\ No newline at end of file
+}
+void michaelcc::linear::allocators::register_allocator::update_after_spill(const std::vector<virtual_register>& spilled_vregs, const std::unordered_set<size_t>& changed_blocks) {
+    for (auto& [block_id, liveliness] : m_block_liveliness) {
+        for (auto vreg : spilled_vregs) {
+            liveliness.live_in.erase(vreg);
+            liveliness.live_out.erase(vreg);
+        }
+    }
+    for (size_t block_id : changed_blocks) {
+        m_block_info.erase(block_id);
+    }
+    std::unordered_set<virtual_register> spilled(spilled_vregs.begin(), spilled_vregs.end());
+    for (auto& [function_call_id, live_vregs] : m_live_across_calls) {
+        std::erase_if(live_vregs, [&spilled](virtual_register vreg) { return spilled.contains(vreg); });
+    }
+
+    // drop every edge of the spilled vregs, the walk below adds back the ones around their new short ranges
+    for (auto vreg : spilled_vregs) {
+        auto it = m_inference_graph.find(vreg);
+        if (it == m_inference_graph.end()) {
+            continue;
+        }
+        for (auto adjacent_vreg : it->second.adjacent_vregs) {
+            auto& adjacent_node = m_inference_graph.at(adjacent_vreg);
+            adjacent_node.adjacent_vregs.erase(vreg);
+            adjacent_node.degree--;
+        }
+        it->second.adjacent_vregs.clear();
+        it->second.degree = 0;
+        it->second.prefer_callee_saved = false;
+    }
+
+    std::vector<virtual_register> new_temporaries;
+    for (size_t block_id : changed_blocks) {
+        for (const auto& instruction : m_translation_unit.blocks.at(block_id).instructions()) {
+            auto destination = instruction->destination_register();
+            if (destination.has_value() && !m_inference_graph.contains(destination.value())
+                && m_spill_temporaries.insert(destination.value()).second) {
+                new_temporaries.push_back(destination.value());
+            }
+        }
+    }
+
+    for (size_t block_id : changed_blocks) {
+        build_inference_graph(block_id);
+    }
+
+    for (auto vreg : new_temporaries) {
+        m_recolor.insert(vreg);
+        for (auto adjacent_vreg : m_inference_graph.at(vreg).adjacent_vregs) {
+            if (!m_precolored.contains(adjacent_vreg)) {
+                m_recolor.insert(adjacent_vreg);
+            }
+        }
+    }
+}
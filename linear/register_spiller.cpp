@@ -1,21 +1,50 @@
 #include "linear/allocators/register_spiller.hpp"
 #include "linear/ir.hpp"
 #include <cassert>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 michaelcc::linear::virtual_register michaelcc::linear::allocators::register_spiller::get_value(virtual_register vreg, std::vector<std::unique_ptr<instruction>>& new_instructions) const {
     if (!m_spilled_vregs.contains(vreg)) {
         return vreg;
     }
 
-    assert(m_spill_address.contains(vreg));
-    auto spill_address = m_spill_address.at(vreg);
+    if (m_rematerialized.contains(vreg)) {
+        auto new_vreg = m_translation_unit.new_vreg(vreg.reg_size, vreg.reg_class);
+        new_instructions.emplace_back(rematerialize(*m_rematerialized.at(vreg), new_vreg));
+        return new_vreg;
+    }
+
+    assert(m_spill_slots.contains(vreg));
+    const auto& slot = m_spill_slots.at(vreg);
 
     auto new_vreg = m_translation_unit.new_vreg(vreg.reg_size, vreg.reg_class);
-    new_instructions.emplace_back(std::make_unique<load_memory>(new_vreg, spill_address.at(0), 0));
+    new_instructions.emplace_back(std::make_unique<load_memory>(new_vreg, slot.frame_pointer, slot.offset));
     return new_vreg;
 }
 
+bool michaelcc::linear::allocators::register_spiller::mentions_spilled_vreg(const basic_block& block) const {
+    for (const auto& instruction : block.instructions()) {
+        auto destination = instruction->destination_register();
+        if (destination.has_value() && m_spilled_vregs.contains(destination.value())) {
+            return true;
+        }
+        for (auto operand : instruction->operand_registers()) {
+            if (m_spilled_vregs.contains(operand)) {
+                return true;
+            }
+        }
+        if (auto* call = dynamic_cast<const function_call*>(instruction.get())) {
+            auto* callee = std::get_if<virtual_register>(&call->callee());
+            if (callee && m_spilled_vregs.contains(*callee)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void michaelcc::linear::allocators::register_spiller::spill_block(size_t block_id) {
     auto& block = m_translation_unit.blocks.at(block_id);
     
@@ -32,31 +61,108 @@ void michaelcc::linear::allocators::register_spiller::spill_block(size_t block_i
             assert(new_instruction != nullptr);
         }
 
-        // save destination if necessary
+        // save destination if necessary, rematerialized definitions are recomputed at their uses instead
+        if (new_instruction->destination_register().has_value() && m_rematerialized.contains(new_instruction->destination_register().value())) {
+            continue;
+        }
         if (new_instruction->destination_register().has_value() && m_spilled_vregs.contains(new_instruction->destination_register().value())) {
             auto dest_vreg = new_instruction->destination_register().value();
-            auto address_vreg = m_translation_unit.new_vreg(m_translation_unit.platform_info.pointer_size, MICHAELCC_REGISTER_CLASS_INTEGER);
-            new_instructions.emplace_back(std::make_unique<alloca_instruction>(
-                address_vreg, 
-                m_translation_unit.platform_info.bits_to_au(dest_vreg.reg_size),
-                m_translation_unit.platform_info.bits_to_au(dest_vreg.reg_size)
-            ));
+            const auto& slot = m_spill_slots.at(dest_vreg);
             new_instructions.emplace_back(std::move(new_instruction));
             new_instructions.emplace_back(std::make_unique<store_memory>(
+                slot.frame_pointer,
                 dest_vreg,
-                address_vreg,
-                0
+                slot.offset
             ));
-
-            m_spill_address.insert({ dest_vreg, { address_vreg } });
         } else {
             new_instructions.emplace_back(std::move(new_instruction));
         }
     }
+    block.replace_instructions(std::move(new_instructions));
 }
 
-void michaelcc::linear::allocators::register_spiller::spill() {
-    for (const auto& [block_id, block] : m_translation_unit.blocks) {
-        spill_block(block_id);
+std::unordered_set<size_t> michaelcc::linear::allocators::register_spiller::spill() {
+    std::unordered_set<size_t> spilled_blocks;
+
+    // blocks are not visited in any dominance order, and after phi removal a vreg may be defined in several
+    // blocks, so every spilled vreg gets a single slot up front
+    for (const auto& function : m_translation_unit.function_definitions) {
+        std::vector<size_t> function_blocks;
+        std::unordered_set<size_t> visited;
+        std::vector<size_t> worklist = { function->entry_block_id() };
+        while (!worklist.empty()) {
+            size_t block_id = worklist.back();
+            worklist.pop_back();
+            if (!visited.insert(block_id).second) {
+                continue;
+            }
+            function_blocks.push_back(block_id);
+            for (size_t successor : m_translation_unit.blocks.at(block_id).successor_block_ids()) {
+                worklist.push_back(successor);
+            }
+        }
+
+        std::unordered_map<virtual_register, std::vector<const instruction*>> definitions;
+        for (size_t block_id : function_blocks) {
+            for (const auto& instruction : m_translation_unit.blocks.at(block_id).instructions()) {
+                auto destination = instruction->destination_register();
+                if (destination.has_value() && m_spilled_vregs.contains(destination.value())) {
+                    definitions[destination.value()].push_back(instruction.get());
+                }
+            }
+        }
+
+        for (const auto& [vreg, vreg_definitions] : definitions) {
+            if (vreg_definitions.size() == 1 && is_rematerializable(*vreg_definitions.front(), m_translation_unit)) {
+                m_rematerialized.insert({ vreg, rematerialize(*vreg_definitions.front(), vreg) });
+            }
+        }
+
+        for (size_t block_id : function_blocks) {
+            for (const auto& instruction : m_translation_unit.blocks.at(block_id).instructions()) {
+                auto destination = instruction->destination_register();
+                if (!destination.has_value() || !m_spilled_vregs.contains(destination.value()) || m_spill_slots.contains(destination.value()) || m_rematerialized.contains(destination.value())) {
+                    continue;
+                }
+
+                size_t size = m_translation_unit.platform_info.bits_to_au(destination->reg_size);
+                auto [frame_pointer, offset] = m_frame_allocator.allocate_slot(function->entry_block_id(), size, size);
+                m_spill_slots.insert({ destination.value(), spill_slot{ .frame_pointer = frame_pointer, .offset = offset } });
+            }
+        }
+
+        for (size_t block_id : function_blocks) {
+            if (mentions_spilled_vreg(m_translation_unit.blocks.at(block_id))) {
+                spill_block(block_id);
+                spilled_blocks.insert(block_id);
+            }
+        }
+    }
+
+    return spilled_blocks;
+}
+
+bool michaelcc::linear::allocators::register_spiller::is_rematerializable(const instruction& definition, const translation_unit& translation_unit) {
+    if (dynamic_cast<const init_register*>(&definition) || dynamic_cast<const load_effective_address*>(&definition)) {
+        return true;
+    }
+
+    // the frame pointer holds the same value everywhere in the function
+    if (auto* a2 = dynamic_cast<const a2_instruction*>(&definition)) {
+        auto color = translation_unit.vreg_colors.find(a2->operand_a());
+        return color != translation_unit.vreg_colors.end()
+            && color->second == translation_unit.platform_info.frame_pointer_register_id;
+    }
+    return false;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> michaelcc::linear::allocators::register_spiller::rematerialize(const instruction& definition, virtual_register destination) {
+    if (auto* init = dynamic_cast<const init_register*>(&definition)) {
+        return std::make_unique<init_register>(destination, init->value());
     }
-}
\ No newline at end of file
+    if (auto* lea = dynamic_cast<const load_effective_address*>(&definition)) {
+        return std::make_unique<load_effective_address>(destination, lea->label());
+    }
+    auto& a2 = dynamic_cast<const a2_instruction&>(definition);
+    return std::make_unique<a2_instruction>(a2.type(), destination, a2.operand_a(), a2.constant());
+}
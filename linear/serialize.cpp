@@ -0,0 +1,726 @@
+#include "linear/serialize.hpp"
+#include "linear/ir.hpp"
+#include "linear/dominators.hpp"
+#include "serialization.hpp"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace michaelcc::linear::serialization {
+    namespace {
+        constexpr char magic[4] = { 'M', 'C', 'I', 'R' };
+
+        enum instruction_opcode : uint8_t {
+            OPCODE_A_INSTRUCTION,
+            OPCODE_A2_INSTRUCTION,
+            OPCODE_U_INSTRUCTION,
+            OPCODE_C_INSTRUCTION,
+            OPCODE_INIT_REGISTER,
+            OPCODE_LOAD_MEMORY,
+            OPCODE_STORE_MEMORY,
+            OPCODE_ALLOCA,
+            OPCODE_VALLOCA,
+            OPCODE_LOAD_PARAMETER,
+            OPCODE_BRANCH,
+            OPCODE_BRANCH_CONDITION,
+            OPCODE_PUSH_FUNCTION_ARGUMENT,
+            OPCODE_FUNCTION_CALL,
+            OPCODE_FUNCTION_RETURN,
+            OPCODE_PHI,
+            OPCODE_LOAD_EFFECTIVE_ADDRESS,
+            OPCODE_JUMP_TABLE,
+            OPCODE_SELECT,
+        };
+
+        // register words are unions, only the bits belonging to the register size are meaningful
+        uint64_t word_bits(register_word value, word_size size) {
+            switch (size) {
+                case MICHAELCC_WORD_SIZE_BYTE: return value.ubyte;
+                case MICHAELCC_WORD_SIZE_UINT16: return value.uint16;
+                case MICHAELCC_WORD_SIZE_UINT32: return value.uint32;
+                case MICHAELCC_WORD_SIZE_UINT64: return value.uint64;
+                default: throw std::runtime_error("Invalid word size");
+            }
+        }
+
+        register_word bits_to_word(uint64_t bits, word_size size) {
+            register_word value{ .uint64 = 0 };
+            switch (size) {
+                case MICHAELCC_WORD_SIZE_BYTE: value.ubyte = static_cast<uint8_t>(bits); break;
+                case MICHAELCC_WORD_SIZE_UINT16: value.uint16 = static_cast<uint16_t>(bits); break;
+                case MICHAELCC_WORD_SIZE_UINT32: value.uint32 = static_cast<uint32_t>(bits); break;
+                case MICHAELCC_WORD_SIZE_UINT64: value.uint64 = bits; break;
+                default: throw std::runtime_error("Invalid word size");
+            }
+            return value;
+        }
+
+        class writer : public michaelcc::serialization::byte_writer {
+        public:
+            void vreg(const virtual_register& reg) {
+                varint(reg.id);
+                byte(static_cast<uint8_t>(reg.reg_size));
+                byte(static_cast<uint8_t>(reg.reg_class));
+            }
+
+            void layout(const type_layout_info& layout) {
+                varint(layout.size);
+                varint(layout.alignment);
+            }
+        };
+
+        class reader : public michaelcc::serialization::byte_reader {
+        public:
+            reader(std::span<const uint8_t> data) : byte_reader(data, "serialized linear IR") {}
+
+            word_size size() {
+                uint8_t value = byte();
+                switch (value) {
+                    case MICHAELCC_WORD_SIZE_BYTE:
+                    case MICHAELCC_WORD_SIZE_UINT16:
+                    case MICHAELCC_WORD_SIZE_UINT32:
+                    case MICHAELCC_WORD_SIZE_UINT64:
+                        return static_cast<word_size>(value);
+                    default:
+                        malformed("invalid word size");
+                }
+            }
+
+            register_class reg_class() {
+                uint8_t value = byte();
+                if (value > MICHAELCC_REGISTER_CLASS_FLOATING_POINT) {
+                    malformed("invalid register class");
+                }
+                return static_cast<register_class>(value);
+            }
+
+            a_instruction_type a_type() {
+                uint64_t value = varint();
+                if (value > MICHAELCC_LINEAR_A_FLOAT_COMPARE_GREATER_THAN_OR_EQUAL) {
+                    malformed("invalid a instruction type");
+                }
+                return static_cast<a_instruction_type>(value);
+            }
+
+            u_instruction_type u_type() {
+                uint64_t value = varint();
+                if (value > MICHAELCC_LINEAR_U_BITWISE_NOT) {
+                    malformed("invalid u instruction type");
+                }
+                return static_cast<u_instruction_type>(value);
+            }
+
+            c_instruction_type c_type() {
+                uint64_t value = varint();
+                if (value > MICHAELCC_LINEAR_C_COPY_INIT) {
+                    malformed("invalid c instruction type");
+                }
+                return static_cast<c_instruction_type>(value);
+            }
+
+            virtual_register vreg() {
+                size_t id = varint();
+                word_size reg_size = size();
+                register_class cls = reg_class();
+                return virtual_register{ .id = id, .reg_size = reg_size, .reg_class = cls };
+            }
+
+            type_layout_info layout() {
+                size_t size = varint();
+                size_t alignment = varint();
+                return type_layout_info{ .size = size, .alignment = alignment };
+            }
+        };
+
+        class instruction_writer final : public instruction_dispatcher<void> {
+        private:
+            writer& m_writer;
+
+            void parameter(const function_parameter& parameter) {
+                m_writer.string(parameter.name);
+                m_writer.layout(parameter.layout);
+                m_writer.optional(parameter.offset, [&](size_t offset) { m_writer.varint(offset); });
+                m_writer.optional(parameter.register_class, [&](register_class cls) { m_writer.byte(static_cast<uint8_t>(cls)); });
+                m_writer.optional(parameter.pass_via_register, [&](register_t reg) { m_writer.byte(reg); });
+            }
+
+        public:
+            instruction_writer(writer& writer) : m_writer(writer) {}
+
+            void write_parameter(const function_parameter& value) { parameter(value); }
+
+        protected:
+            void dispatch(const a_instruction& node) override {
+                m_writer.byte(OPCODE_A_INSTRUCTION);
+                m_writer.varint(node.type());
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.operand_a());
+                m_writer.vreg(node.operand_b());
+            }
+
+            void dispatch(const a2_instruction& node) override {
+                m_writer.byte(OPCODE_A2_INSTRUCTION);
+                m_writer.varint(node.type());
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.operand_a());
+                m_writer.varint(node.constant());
+            }
+
+            void dispatch(const u_instruction& node) override {
+                m_writer.byte(OPCODE_U_INSTRUCTION);
+                m_writer.varint(node.type());
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.operand());
+            }
+
+            void dispatch(const c_instruction& node) override {
+                m_writer.byte(OPCODE_C_INSTRUCTION);
+                m_writer.varint(node.type());
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.source());
+            }
+
+            void dispatch(const init_register& node) override {
+                m_writer.byte(OPCODE_INIT_REGISTER);
+                m_writer.vreg(node.destination());
+                m_writer.varint(word_bits(node.value(), node.destination().reg_size));
+            }
+
+            void dispatch(const load_memory& node) override {
+                m_writer.byte(OPCODE_LOAD_MEMORY);
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.source_address());
+                m_writer.svarint(node.offset());
+            }
+
+            void dispatch(const store_memory& node) override {
+                m_writer.byte(OPCODE_STORE_MEMORY);
+                m_writer.vreg(node.destination_address());
+                m_writer.vreg(node.value());
+                m_writer.svarint(node.offset());
+            }
+
+            void dispatch(const alloca_instruction& node) override {
+                m_writer.byte(OPCODE_ALLOCA);
+                m_writer.vreg(node.destination());
+                m_writer.varint(node.size_bytes());
+                m_writer.varint(node.alignment());
+            }
+
+            void dispatch(const valloca_instruction& node) override {
+                m_writer.byte(OPCODE_VALLOCA);
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.size());
+                m_writer.varint(node.alignment());
+            }
+
+            void dispatch(const load_parameter& node) override {
+                m_writer.byte(OPCODE_LOAD_PARAMETER);
+                m_writer.vreg(node.destination());
+                parameter(node.parameter());
+            }
+
+            void dispatch(const branch& node) override {
+                m_writer.byte(OPCODE_BRANCH);
+                m_writer.varint(node.next_block_id());
+            }
+
+            void dispatch(const branch_condition& node) override {
+                m_writer.byte(OPCODE_BRANCH_CONDITION);
+                m_writer.vreg(node.condition());
+                m_writer.varint(node.if_true_block_id());
+                m_writer.varint(node.if_false_block_id());
+                m_writer.boolean(node.is_loop());
+            }
+
+            void dispatch(const jump_table& node) override {
+                m_writer.byte(OPCODE_JUMP_TABLE);
+                m_writer.vreg(node.index());
+                m_writer.varint(node.target_block_ids().size());
+                for (size_t target_block_id : node.target_block_ids()) {
+                    m_writer.varint(target_block_id);
+                }
+            }
+
+            void dispatch(const push_function_argument& node) override {
+                m_writer.byte(OPCODE_PUSH_FUNCTION_ARGUMENT);
+                auto argument = node.argument();
+                m_writer.layout(argument.layout);
+                m_writer.optional(argument.offset, [&](size_t offset) { m_writer.varint(offset); });
+                m_writer.optional(argument.register_class, [&](register_class cls) { m_writer.byte(static_cast<uint8_t>(cls)); });
+                m_writer.optional(argument.pass_via_register, [&](register_t reg) { m_writer.byte(reg); });
+                m_writer.vreg(node.value());
+                m_writer.varint(node.function_call_id());
+            }
+
+            void dispatch(const function_call& node) override {
+                m_writer.byte(OPCODE_FUNCTION_CALL);
+                m_writer.optional(node.destination(), [&](const virtual_register& reg) { m_writer.vreg(reg); });
+                std::visit(overloaded{
+                    [&](const std::string& name) {
+                        m_writer.byte(0);
+                        m_writer.string(name);
+                    },
+                    [&](const virtual_register& reg) {
+                        m_writer.byte(1);
+                        m_writer.vreg(reg);
+                    }
+                }, node.callee());
+                m_writer.varint(node.argument_count());
+                m_writer.varint(node.function_call_id());
+                m_writer.varint(node.caller_saved_registers().size());
+                for (const auto& reg : node.caller_saved_registers()) {
+                    m_writer.vreg(reg);
+                }
+            }
+
+            void dispatch(const function_return&) override {
+                m_writer.byte(OPCODE_FUNCTION_RETURN);
+            }
+
+            void dispatch(const phi_instruction& node) override {
+                m_writer.byte(OPCODE_PHI);
+                m_writer.vreg(node.destination());
+                m_writer.varint(node.values().size());
+                for (const auto& value : node.values()) {
+                    m_writer.vreg(value.vreg);
+                    m_writer.varint(value.block_id);
+                }
+            }
+
+            void dispatch(const select_instruction& node) override {
+                m_writer.byte(OPCODE_SELECT);
+                m_writer.vreg(node.destination());
+                m_writer.vreg(node.condition());
+                m_writer.vreg(node.if_true());
+                m_writer.vreg(node.if_false());
+            }
+
+            void dispatch(const load_effective_address& node) override {
+                m_writer.byte(OPCODE_LOAD_EFFECTIVE_ADDRESS);
+                m_writer.vreg(node.destination());
+                m_writer.string(node.label());
+            }
+        };
+
+        function_parameter read_parameter(reader& in) {
+            function_parameter parameter{
+                .name = in.string(),
+                .layout = in.layout()
+            };
+            parameter.offset = in.optional([&]() -> size_t { return in.varint(); });
+            parameter.register_class = in.optional([&]() { return in.reg_class(); });
+            parameter.pass_via_register = in.optional([&]() -> register_t { return in.byte(); });
+            return parameter;
+        }
+
+        std::unique_ptr<instruction> read_instruction(reader& in) {
+            switch (in.byte()) {
+                case OPCODE_A_INSTRUCTION: {
+                    auto type = in.a_type();
+                    auto destination = in.vreg();
+                    auto operand_a = in.vreg();
+                    auto operand_b = in.vreg();
+                    return std::make_unique<a_instruction>(type, destination, operand_a, operand_b);
+                }
+                case OPCODE_A2_INSTRUCTION: {
+                    auto type = in.a_type();
+                    auto destination = in.vreg();
+                    auto operand_a = in.vreg();
+                    size_t constant = in.varint();
+                    return std::make_unique<a2_instruction>(type, destination, operand_a, constant);
+                }
+                case OPCODE_U_INSTRUCTION: {
+                    auto type = in.u_type();
+                    auto destination = in.vreg();
+                    auto operand = in.vreg();
+                    return std::make_unique<u_instruction>(type, destination, operand);
+                }
+                case OPCODE_C_INSTRUCTION: {
+                    auto type = in.c_type();
+                    auto destination = in.vreg();
+                    auto source = in.vreg();
+                    return std::make_unique<c_instruction>(type, destination, source);
+                }
+                case OPCODE_INIT_REGISTER: {
+                    auto destination = in.vreg();
+                    auto value = bits_to_word(in.varint(), destination.reg_size);
+                    return std::make_unique<init_register>(destination, value);
+                }
+                case OPCODE_LOAD_MEMORY: {
+                    auto destination = in.vreg();
+                    auto source_address = in.vreg();
+                    int64_t offset = in.svarint();
+                    return std::make_unique<load_memory>(destination, source_address, offset);
+                }
+                case OPCODE_STORE_MEMORY: {
+                    auto destination_address = in.vreg();
+                    auto value = in.vreg();
+                    int64_t offset = in.svarint();
+                    return std::make_unique<store_memory>(destination_address, value, offset);
+                }
+                case OPCODE_ALLOCA: {
+                    auto destination = in.vreg();
+                    size_t size_bytes = in.varint();
+                    size_t alignment = in.varint();
+                    return std::make_unique<alloca_instruction>(destination, size_bytes, alignment);
+                }
+                case OPCODE_VALLOCA: {
+                    auto destination = in.vreg();
+                    auto size = in.vreg();
+                    size_t alignment = in.varint();
+                    return std::make_unique<valloca_instruction>(destination, size, alignment);
+                }
+                case OPCODE_LOAD_PARAMETER: {
+                    auto destination = in.vreg();
+                    return std::make_unique<load_parameter>(destination, read_parameter(in));
+                }
+                case OPCODE_BRANCH:
+                    return std::make_unique<branch>(in.varint());
+                case OPCODE_BRANCH_CONDITION: {
+                    auto condition = in.vreg();
+                    size_t if_true = in.varint();
+                    size_t if_false = in.varint();
+                    bool is_loop = in.boolean();
+                    return std::make_unique<branch_condition>(condition, if_true, if_false, is_loop);
+                }
+                case OPCODE_JUMP_TABLE: {
+                    auto index = in.vreg();
+                    std::vector<size_t> target_block_ids(in.count());
+                    for (auto& target_block_id : target_block_ids) {
+                        target_block_id = in.varint();
+                    }
+                    return std::make_unique<jump_table>(index, std::move(target_block_ids));
+                }
+                case OPCODE_PUSH_FUNCTION_ARGUMENT: {
+                    function_argument argument{ .layout = in.layout() };
+                    argument.offset = in.optional([&]() -> size_t { return in.varint(); });
+                    argument.register_class = in.optional([&]() { return in.reg_class(); });
+                    argument.pass_via_register = in.optional([&]() -> register_t { return in.byte(); });
+                    auto value = in.vreg();
+                    size_t function_call_id = in.varint();
+                    return std::make_unique<push_function_argument>(argument, value, function_call_id);
+                }
+                case OPCODE_FUNCTION_CALL: {
+                    auto destination = in.optional([&]() { return in.vreg(); });
+                    function_call::callable callee = in.byte() == 0
+                        ? function_call::callable(in.string())
+                        : function_call::callable(in.vreg());
+                    size_t argument_count = in.varint();
+                    size_t function_call_id = in.varint();
+                    auto call = std::make_unique<function_call>(destination, std::move(callee), argument_count, function_call_id);
+
+                    std::vector<virtual_register> caller_saved_registers(in.count());
+                    for (auto& reg : caller_saved_registers) {
+                        reg = in.vreg();
+                    }
+                    call->set_caller_saved_registers(std::move(caller_saved_registers));
+                    return call;
+                }
+                case OPCODE_FUNCTION_RETURN:
+                    return std::make_unique<function_return>();
+                case OPCODE_PHI: {
+                    auto destination = in.vreg();
+                    std::vector<var_info> values(in.count());
+                    for (auto& value : values) {
+                        value.vreg = in.vreg();
+                        value.block_id = in.varint();
+                    }
+                    return std::make_unique<phi_instruction>(destination, std::move(values));
+                }
+                case OPCODE_SELECT: {
+                    auto destination = in.vreg();
+                    auto condition = in.vreg();
+                    auto if_true = in.vreg();
+                    auto if_false = in.vreg();
+                    return std::make_unique<select_instruction>(destination, condition, if_true, if_false);
+                }
+                case OPCODE_LOAD_EFFECTIVE_ADDRESS: {
+                    auto destination = in.vreg();
+                    return std::make_unique<load_effective_address>(destination, in.string());
+                }
+                default:
+                    in.malformed("unknown instruction opcode");
+            }
+        }
+
+        std::vector<size_t> read_ids(reader& in) {
+            std::vector<size_t> ids(in.count());
+            for (auto& id : ids) {
+                id = in.varint();
+            }
+            return ids;
+        }
+
+        void write_ids(writer& out, const std::vector<size_t>& ids) {
+            out.varint(ids.size());
+            for (size_t id : ids) {
+                out.varint(id);
+            }
+        }
+    }
+
+    std::vector<uint8_t> serialize(const translation_unit& unit) {
+        writer body;
+        instruction_writer instructions(body);
+
+        body.varint(unit.function_definitions.size());
+        for (const auto& function : unit.function_definitions) {
+            body.string(function->name());
+            body.varint(function->entry_block_id());
+            body.varint(function->parameters().size());
+            for (const auto& parameter : function->parameters()) {
+                instructions.write_parameter(parameter);
+            }
+        }
+
+        // blocks are written in id order so equal units serialize to equal bytes
+        std::vector<size_t> block_ids;
+        block_ids.reserve(unit.blocks.size());
+        for (const auto& [block_id, block] : unit.blocks) {
+            block_ids.push_back(block_id);
+        }
+        std::sort(block_ids.begin(), block_ids.end());
+
+        body.varint(block_ids.size());
+        for (size_t block_id : block_ids) {
+            const auto& block = unit.blocks.at(block_id);
+            body.varint(block_id);
+            write_ids(body, block.successor_block_ids());
+            write_ids(body, block.predecessor_block_ids());
+            body.optional(block.immediate_dominator_block_id(), [&](size_t id) { body.varint(id); });
+            write_ids(body, block.immediately_dominated_block_ids());
+
+            body.varint(block.instructions().size());
+            for (const auto& instruction : block.instructions()) {
+                instructions(*instruction);
+            }
+        }
+
+        std::vector<std::pair<virtual_register, register_t>> colors(unit.vreg_colors.begin(), unit.vreg_colors.end());
+        std::sort(colors.begin(), colors.end(), [](const auto& a, const auto& b) { return a.first.id < b.first.id; });
+        body.varint(colors.size());
+        for (const auto& [vreg, color] : colors) {
+            body.vreg(vreg);
+            body.byte(color);
+        }
+
+        std::vector<virtual_register> cannot_spill(unit.cannot_spill_vregs.begin(), unit.cannot_spill_vregs.end());
+        std::sort(cannot_spill.begin(), cannot_spill.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+        body.varint(cannot_spill.size());
+        for (const auto& vreg : cannot_spill) {
+            body.vreg(vreg);
+        }
+
+        body.varint(unit.next_vreg_id);
+        write_ids(body, unit.free_vreg_ids);
+        body.varint(unit.next_function_call_id);
+
+        const auto& sections = unit.static_sections;
+        body.varint(sections.bss_allocations.size());
+        for (const auto& allocation : sections.bss_allocations) {
+            body.string(allocation.label);
+            body.layout(allocation.layout);
+        }
+
+        body.varint(sections.data_allocations.size());
+        for (const auto& allocation : sections.data_allocations) {
+            body.string(allocation.label);
+            body.layout(allocation.layout);
+            body.boolean(allocation.is_read_only);
+            body.boolean(allocation.is_literal);
+            body.varint(allocation.data_words.size());
+            for (const auto& word : allocation.data_words) {
+                body.byte(static_cast<uint8_t>(word.size));
+                body.optional(word.label_ref, [&](const std::string& label) { body.string(label); });
+                if (!word.label_ref.has_value()) {
+                    body.varint(word_bits(word.value, word.size));
+                }
+            }
+        }
+
+        body.varint(sections.strings.size());
+        for (const auto& str : sections.strings) {
+            body.string(str);
+        }
+
+        return body.finish(magic, format_version);
+    }
+
+    translation_unit deserialize(std::span<const uint8_t> data, const platform_info& platform_info) {
+        reader in(data);
+
+        in.read_header(magic, format_version);
+
+        translation_unit unit{ .platform_info = platform_info };
+
+        size_t function_count = in.count();
+        unit.function_definitions.reserve(function_count);
+        for (size_t i = 0; i < function_count; i++) {
+            std::string name = in.string();
+            size_t entry_block_id = in.varint();
+            std::vector<function_parameter> parameters;
+            size_t parameter_count = in.count();
+            parameters.reserve(parameter_count);
+            for (size_t j = 0; j < parameter_count; j++) {
+                parameters.push_back(read_parameter(in));
+            }
+            unit.function_definitions.emplace_back(std::make_unique<function_definition>(std::move(name), entry_block_id, std::move(parameters)));
+        }
+
+        size_t block_count = in.count();
+        unit.blocks.reserve(block_count);
+        for (size_t i = 0; i < block_count; i++) {
+            size_t block_id = in.varint();
+            auto successors = read_ids(in);
+            auto predecessors = read_ids(in);
+            auto immediate_dominator = in.optional([&]() -> size_t { return in.varint(); });
+            auto dominated = read_ids(in);
+
+            std::vector<std::unique_ptr<instruction>> instructions(in.count());
+            for (auto& instruction : instructions) {
+                instruction = read_instruction(in);
+            }
+
+            basic_block block(block_id, std::move(instructions), std::move(successors));
+            for (size_t predecessor : predecessors) {
+                block.add_predecessor_block_id(predecessor);
+            }
+            block.set_dominator_info(std::move(immediate_dominator), std::move(dominated));
+            if (!unit.blocks.insert({ block_id, std::move(block) }).second) {
+                in.malformed("duplicate block id");
+            }
+            unit.next_block_id = std::max(unit.next_block_id, block_id + 1);
+        }
+
+        size_t color_count = in.count();
+        for (size_t i = 0; i < color_count; i++) {
+            auto vreg = in.vreg();
+            unit.vreg_colors.insert({ vreg, in.byte() });
+        }
+
+        size_t cannot_spill_count = in.count();
+        for (size_t i = 0; i < cannot_spill_count; i++) {
+            unit.cannot_spill_vregs.insert(in.vreg());
+        }
+
+        unit.next_vreg_id = in.varint();
+        unit.free_vreg_ids = read_ids(in);
+        unit.next_function_call_id = in.varint();
+
+        auto& sections = unit.static_sections;
+        size_t bss_count = in.count();
+        for (size_t i = 0; i < bss_count; i++) {
+            std::string label = in.string();
+            auto layout = in.layout();
+            sections.bss_allocations.push_back(static_storage::bss_allocation{ .label = std::move(label), .layout = layout });
+        }
+
+        size_t data_count = in.count();
+        for (size_t i = 0; i < data_count; i++) {
+            std::string label = in.string();
+            auto layout = in.layout();
+            bool is_read_only = in.boolean();
+            bool is_literal = in.boolean();
+
+            std::vector<static_storage::data_word> words;
+            size_t word_count = in.count();
+            words.reserve(word_count);
+            for (size_t j = 0; j < word_count; j++) {
+                word_size size = in.size();
+                auto label_ref = in.optional([&]() { return in.string(); });
+                register_word value{ .uint64 = 0 };
+                if (!label_ref.has_value()) {
+                    value = bits_to_word(in.varint(), size);
+                }
+                words.push_back(static_storage::data_word{ .label_ref = std::move(label_ref), .value = value, .size = size });
+            }
+
+            sections.data_allocations.push_back(static_storage::data_allocation{
+                .label = std::move(label),
+                .data_words = std::move(words),
+                .layout = layout,
+                .is_read_only = is_read_only,
+                .is_literal = is_literal
+            });
+        }
+
+        size_t string_count = in.count();
+        sections.strings.reserve(string_count);
+        for (size_t i = 0; i < string_count; i++) {
+            sections.strings.push_back(in.string());
+        }
+
+        if (!in.at_end()) {
+            in.malformed("trailing data");
+        }
+
+        // the dominator tree numbering and frontiers are cheaper to rebuild than to store
+        compute_dominators(unit);
+        return unit;
+    }
+
+    void save(const translation_unit& unit, const std::string& path) {
+        auto bytes = serialize(unit);
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output) {
+            throw std::runtime_error("Could not open " + path + " for writing");
+        }
+        output.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+#ifdef _WIN32
+    translation_unit load(const std::string& path, const platform_info& platform_info) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::runtime_error("Could not open " + path);
+        }
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        return deserialize(bytes, platform_info);
+    }
+#else
+    translation_unit load(const std::string& path, const platform_info& platform_info) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path);
+        }
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Could not stat " + path);
+        }
+
+        size_t size = static_cast<size_t>(status.st_size);
+        if (size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Serialized linear IR " + path + " is empty");
+        }
+
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map " + path);
+        }
+
+        try {
+            auto unit = deserialize(std::span<const uint8_t>(static_cast<const uint8_t*>(mapping), size), platform_info);
+            ::munmap(mapping, size);
+            return unit;
+        }
+        catch (...) {
+            ::munmap(mapping, size);
+            throw;
+        }
+    }
+#endif
+}
@@ -1,6 +1,9 @@
 #include "linear/static.hpp"
 #include "logic/type_info.hpp"
+#include <algorithm>
 #include <cassert>
+#include <numeric>
+#include <unordered_map>
 
 namespace michaelcc {
     namespace linear {
@@ -66,7 +69,7 @@ namespace michaelcc {
             }
 
             void data_section_builder::dispatch(const logic::string_constant& node) {
-                std::string label = "@string_" + std::to_string(node.index());
+                std::string label = string_label(node.index());
                 m_data_words.push_back(data_word{ .label_ref = label, .size = m_platform_info.pointer_size });
                 current_size += m_platform_info.bits_to_au(m_platform_info.pointer_size);
             
@@ -103,7 +106,7 @@ namespace michaelcc {
 
                     if (struct_size < field->offset) {
                         for (size_t j = struct_size; j < field->offset; j++) {
-                            m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = linear::word_size::MICHAELCC_WORD_SIZE_BYTE });
+                            m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = m_platform_info.char_size });
                         }
                         struct_size = field->offset;
                     }
@@ -122,7 +125,7 @@ namespace michaelcc {
                 (*this)(*node.initializer());
 
                 for (size_t i = member_layout.size; i < union_layout.size; i++) {
-                    m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = linear::word_size::MICHAELCC_WORD_SIZE_BYTE });
+                    m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = m_platform_info.char_size });
                 }
             }
 
@@ -133,6 +136,7 @@ namespace michaelcc {
                     data_section_builder sub_builder(m_platform_info, label);
                     auto nested_allocations = sub_builder.build(node);
                     for (auto& allocation : nested_allocations) {
+                        allocation.is_literal = true;
                         m_sub_allocations.push_back(std::move(allocation));
                     }
 
@@ -153,7 +157,7 @@ namespace michaelcc {
                 size_t final_size = current_size + padding;
 
                 for (size_t i = 0; i < padding; i++) {
-                    m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = linear::word_size::MICHAELCC_WORD_SIZE_BYTE });
+                    m_data_words.push_back(data_word{ .value = register_word{ .uint64 = 0 }, .size = m_platform_info.char_size });
                 }
 
                 auto current = data_allocation{ 
@@ -168,6 +172,138 @@ namespace michaelcc {
                 m_sub_allocations.push_back(current);
                 return m_sub_allocations;
             }
+        
+            std::string string_label(size_t index) {
+                return "@string_" + std::to_string(index);
+            }
+
+            static uint64_t data_word_bits(const data_word& word) {
+                switch (word.size) {
+                    case word_size::MICHAELCC_WORD_SIZE_BYTE: return word.value.ubyte;
+                    case word_size::MICHAELCC_WORD_SIZE_UINT16: return word.value.uint16;
+                    case word_size::MICHAELCC_WORD_SIZE_UINT32: return word.value.uint32;
+                    case word_size::MICHAELCC_WORD_SIZE_UINT64: return word.value.uint64;
+                    default: throw std::runtime_error("Invalid word size");
+                }
+            }
+
+            // key identifying an aggregate's contents, used to merge identical read-only literal storage
+            static std::string data_key(const std::vector<data_word>& data_words, const type_layout_info& layout) {
+                std::string key = std::format("{}:{}", layout.size, layout.alignment);
+                for (const auto& word : data_words) {
+                    if (word.label_ref.has_value()) {
+                        key += std::format("|{}@{}", static_cast<int>(word.size), word.label_ref.value());
+                    }
+                    else {
+                        key += std::format("|{}#{}", static_cast<int>(word.size), data_word_bits(word));
+                    }
+                }
+                return key;
+            }
+
+            pooled_sections pool_static_sections(const static_sections& sections, const platform_info& platform_info) {
+                pooled_sections result{ .bss_size = 0, .bss_alignment = 1 };
+
+                // strings: sorting by reversed contents places every suffix directly before a string that ends with it
+                const auto& strings = sections.strings;
+                size_t char_au = platform_info.bits_to_au(platform_info.char_size);
+
+                std::vector<size_t> order(strings.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                    return std::lexicographical_compare(strings[a].rbegin(), strings[a].rend(), strings[b].rbegin(), strings[b].rend());
+                });
+
+                std::vector<size_t> owner(strings.size());
+                std::unordered_map<size_t, size_t> owner_to_pooled;
+                for (size_t i = order.size(); i-- > 0;) {
+                    size_t index = order[i];
+                    owner[index] = index;
+                    if (i + 1 < order.size()) {
+                        const auto& next = strings[owner[order[i + 1]]];
+                        if (next.size() >= strings[index].size() && next.ends_with(strings[index])) {
+                            owner[index] = owner[order[i + 1]];
+                        }
+                    }
+                }
+
+                for (size_t index : order) {
+                    if (owner[index] != index) {
+                        continue;
+                    }
+                    const auto& str = strings[index];
+                    std::vector<data_word> words;
+                    words.reserve(str.size() + 1);
+                    for (char c : str) {
+                        words.push_back(data_word{ .value = const_to_regword(static_cast<unsigned char>(c), platform_info.char_size, false), .size = platform_info.char_size });
+                    }
+                    words.push_back(data_word{ .value = const_to_regword(0, platform_info.char_size, false), .size = platform_info.char_size });
+
+                    owner_to_pooled.insert({ index, result.data.size() });
+                    result.data.push_back(pooled_data{
+                        .data_words = std::move(words),
+                        .size = (str.size() + 1) * char_au,
+                        .alignment = std::max<size_t>(char_au, 1)
+                    });
+                }
+
+                for (size_t index = 0; index < strings.size(); index++) {
+                    size_t offset = (strings[owner[index]].size() - strings[index].size()) * char_au;
+                    result.data[owner_to_pooled.at(owner[index])].labels.push_back(pooled_label{ .label = string_label(index), .offset = offset });
+                }
+
+                // aggregates: only read-only literal storage may be shared, a named object keeps its own address
+                std::unordered_map<std::string, size_t> read_only_data;
+                for (const auto& allocation : sections.data_allocations) {
+                    if (allocation.is_read_only && allocation.is_literal) {
+                        auto key = data_key(allocation.data_words, allocation.layout);
+                        auto it = read_only_data.find(key);
+                        if (it != read_only_data.end()) {
+                            result.data[it->second].labels.push_back(pooled_label{ .label = allocation.label, .offset = 0 });
+                            continue;
+                        }
+                        read_only_data.insert({ std::move(key), result.data.size() });
+                    }
+
+                    result.data.push_back(pooled_data{
+                        .labels = { pooled_label{ .label = allocation.label, .offset = 0 } },
+                        .data_words = allocation.data_words,
+                        .size = allocation.layout.size,
+                        .alignment = allocation.layout.alignment
+                    });
+                }
+
+                for (auto& data : result.data) {
+                    std::sort(data.labels.begin(), data.labels.end(), [](const pooled_label& a, const pooled_label& b) {
+                        return a.offset < b.offset;
+                    });
+                }
+
+                // most aligned first so objects pack without padding
+                std::stable_sort(result.data.begin(), result.data.end(), [](const pooled_data& a, const pooled_data& b) {
+                    return a.alignment > b.alignment;
+                });
+
+                std::vector<const bss_allocation*> bss_order;
+                for (const auto& allocation : sections.bss_allocations) {
+                    bss_order.push_back(&allocation);
+                }
+                std::stable_sort(bss_order.begin(), bss_order.end(), [](const bss_allocation* a, const bss_allocation* b) {
+                    return a->layout.alignment > b->layout.alignment;
+                });
+
+                size_t bss_size = 0;
+                for (const auto* allocation : bss_order) {
+                    size_t alignment = std::max<size_t>(allocation->layout.alignment, 1);
+                    bss_size += (alignment - (bss_size % alignment)) % alignment;
+                    result.bss_labels.push_back(pooled_label{ .label = allocation->label, .offset = bss_size });
+                    bss_size += allocation->layout.size;
+                    result.bss_alignment = std::max(result.bss_alignment, alignment);
+                }
+                result.bss_size = bss_size + (result.bss_alignment - (bss_size % result.bss_alignment)) % result.bss_alignment;
+
+                return result;
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,872 @@
+#include "linear/optimization/value_range.hpp"
+#include "linear/ir.hpp"
+#include <algorithm>
+#include <bit>
+#include <memory>
+
+using value_range_pass = michaelcc::linear::optimization::value_range_pass;
+
+static uint64_t width_mask(michaelcc::linear::word_size size) noexcept {
+    return size == michaelcc::linear::MICHAELCC_WORD_SIZE_UINT64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << size) - 1;
+}
+
+// the signed comparison that orders values the same way when both sides are known to have the same sign
+static michaelcc::linear::a_instruction_type to_signed_comparison(michaelcc::linear::a_instruction_type type) noexcept {
+    switch (type) {
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL;
+    default: return type;
+    }
+}
+
+static bool is_unsigned_comparison(michaelcc::linear::a_instruction_type type) noexcept {
+    return to_signed_comparison(type) != type;
+}
+
+// x op y as y op' x
+static michaelcc::linear::a_instruction_type swap_comparison(michaelcc::linear::a_instruction_type type) noexcept {
+    switch (type) {
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL;
+    default: return type;
+    }
+}
+
+// the comparison that holds exactly when this one fails
+static michaelcc::linear::a_instruction_type negate_comparison(michaelcc::linear::a_instruction_type type) noexcept {
+    switch (type) {
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL;
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL: return michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN;
+    default: return type;
+    }
+}
+
+static bool is_integer_comparison(michaelcc::linear::a_instruction_type type) noexcept {
+    switch (type) {
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_EQUAL:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN:
+    case michaelcc::linear::MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_GREATER_THAN_OR_EQUAL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+value_range_pass::value_range value_range_pass::full_range(word_size size) noexcept {
+    if (size == MICHAELCC_WORD_SIZE_UINT64) {
+        return value_range{ .min = INT64_MIN, .max = INT64_MAX };
+    }
+    int64_t half = int64_t{ 1 } << (size - 1);
+    return value_range{ .min = -half, .max = half - 1 };
+}
+
+value_range_pass::value_range value_range_pass::make_range(__int128 min, __int128 max, word_size size) noexcept {
+    value_range full = full_range(size);
+    if (min < full.min || max > full.max) {
+        return full;
+    }
+    return value_range{ .min = static_cast<int64_t>(min), .max = static_cast<int64_t>(max) };
+}
+
+value_range_pass::value_range value_range_pass::join(value_range a, value_range b) noexcept {
+    return value_range{ .min = std::min(a.min, b.min), .max = std::max(a.max, b.max) };
+}
+
+int64_t value_range_pass::to_signed(uint64_t value, word_size size) noexcept {
+    value &= width_mask(size);
+    if (size != MICHAELCC_WORD_SIZE_UINT64 && (value >> (size - 1)) & 1) {
+        value |= ~width_mask(size);
+    }
+    return static_cast<int64_t>(value);
+}
+
+value_range_pass::value_range value_range_pass::combine(a_instruction_type type, value_range a, value_range b, word_size operand_size, word_size result_size) noexcept {
+    value_range full = full_range(operand_size);
+    value_range boolean{ .min = 0, .max = 1 };
+    bool a_has_zero = a.min <= 0 && a.max >= 0;
+    bool b_has_zero = b.min <= 0 && b.max >= 0;
+
+    // the smallest all ones mask covering a non negative value
+    auto all_ones_above = [](int64_t value) {
+        return static_cast<int64_t>(std::bit_ceil(static_cast<uint64_t>(value) + 1) - 1);
+    };
+    auto corners = [&](auto compute) {
+        __int128 results[] = { compute(a.min, b.min), compute(a.min, b.max), compute(a.max, b.min), compute(a.max, b.max) };
+        return make_range(*std::min_element(std::begin(results), std::end(results)), *std::max_element(std::begin(results), std::end(results)), operand_size);
+    };
+    auto shift_amount = [&]() -> std::optional<size_t> {
+        if (!b.is_constant() || b.min < 0 || b.min >= static_cast<int64_t>(operand_size)) {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(b.min);
+    };
+
+    switch (type) {
+    case MICHAELCC_LINEAR_A_ADD:
+        return make_range(static_cast<__int128>(a.min) + b.min, static_cast<__int128>(a.max) + b.max, operand_size);
+    case MICHAELCC_LINEAR_A_SUBTRACT:
+        return make_range(static_cast<__int128>(a.min) - b.max, static_cast<__int128>(a.max) - b.min, operand_size);
+    case MICHAELCC_LINEAR_A_SIGNED_MULTIPLY:
+    case MICHAELCC_LINEAR_A_UNSIGNED_MULTIPLY:
+        // the low bits of a product are the same either way, so an exact signed product is the result
+        return corners([](int64_t x, int64_t y) { return static_cast<__int128>(x) * y; });
+    case MICHAELCC_LINEAR_A_SIGNED_DIVIDE:
+        if (b_has_zero) {
+            return full;
+        }
+        return corners([](int64_t x, int64_t y) { return static_cast<__int128>(x) / y; });
+    case MICHAELCC_LINEAR_A_SIGNED_MODULO: {
+        if (b_has_zero) {
+            return full;
+        }
+        // the remainder is smaller than the divisor and takes the sign of the dividend
+        __int128 largest = std::max(-static_cast<__int128>(b.min), static_cast<__int128>(b.max)) - 1;
+        __int128 min = a.min >= 0 ? 0 : std::max(static_cast<__int128>(a.min), -largest);
+        __int128 max = a.max <= 0 ? 0 : std::min(static_cast<__int128>(a.max), largest);
+        return make_range(min, max, operand_size);
+    }
+    case MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE:
+        if (a.min < 0 || b.min <= 0) {
+            return full;
+        }
+        return value_range{ .min = a.min / b.max, .max = a.max / b.min };
+    case MICHAELCC_LINEAR_A_UNSIGNED_MODULO:
+        if (b.min <= 0) {
+            return full;
+        }
+        return value_range{ .min = 0, .max = a.min >= 0 ? std::min(a.max, b.max - 1) : b.max - 1 };
+    case MICHAELCC_LINEAR_A_SHIFT_LEFT: {
+        auto amount = shift_amount();
+        if (!amount.has_value()) {
+            return full;
+        }
+        return make_range(static_cast<__int128>(a.min) << amount.value(), static_cast<__int128>(a.max) << amount.value(), operand_size);
+    }
+    case MICHAELCC_LINEAR_A_SIGNED_SHIFT_RIGHT: {
+        auto amount = shift_amount();
+        if (!amount.has_value()) {
+            return full;
+        }
+        return value_range{ .min = a.min >> amount.value(), .max = a.max >> amount.value() };
+    }
+    case MICHAELCC_LINEAR_A_UNSIGNED_SHIFT_RIGHT: {
+        auto amount = shift_amount();
+        if (!amount.has_value()) {
+            return full;
+        }
+        if (a.min >= 0) {
+            return value_range{ .min = a.min >> amount.value(), .max = a.max >> amount.value() };
+        }
+        if (amount.value() == 0) {
+            return a;
+        }
+        return value_range{ .min = 0, .max = static_cast<int64_t>(width_mask(operand_size) >> amount.value()) };
+    }
+    case MICHAELCC_LINEAR_A_BITWISE_AND:
+    case MICHAELCC_LINEAR_A_BITWISE_NAND: {
+        // an and is no larger than either side read as unsigned, and negative only if both sides are
+        value_range result = full;
+        if (a.min >= 0 && b.min >= 0) {
+            result = value_range{ .min = 0, .max = std::min(a.max, b.max) };
+        }
+        else if (a.min >= 0 || b.min >= 0) {
+            result = value_range{ .min = 0, .max = a.min >= 0 ? a.max : b.max };
+        }
+        else if (a.max < 0 && b.max < 0) {
+            result = value_range{ .min = full.min, .max = std::min(a.max, b.max) };
+        }
+        if (type == MICHAELCC_LINEAR_A_BITWISE_NAND) {
+            return value_range{ .min = ~result.max, .max = ~result.min };
+        }
+        return result;
+    }
+    case MICHAELCC_LINEAR_A_BITWISE_OR:
+        if (a.min >= 0 && b.min >= 0) {
+            return value_range{ .min = std::max(a.min, b.min), .max = all_ones_above(std::max(a.max, b.max)) };
+        }
+        if (a.max < 0 && b.max < 0) {
+            return value_range{ .min = std::max(a.min, b.min), .max = -1 };
+        }
+        if (a.max < 0 || b.max < 0) {
+            return value_range{ .min = a.max < 0 ? a.min : b.min, .max = -1 };
+        }
+        return full;
+    case MICHAELCC_LINEAR_A_BITWISE_XOR:
+        if (a.min >= 0 && b.min >= 0) {
+            return value_range{ .min = 0, .max = all_ones_above(std::max(a.max, b.max)) };
+        }
+        return full;
+    case MICHAELCC_LINEAR_A_AND:
+        if (a == value_range{ 0, 0 } || b == value_range{ 0, 0 }) {
+            return value_range{ .min = 0, .max = 0 };
+        }
+        if (!a_has_zero && !b_has_zero) {
+            return value_range{ .min = 1, .max = 1 };
+        }
+        return boolean;
+    case MICHAELCC_LINEAR_A_OR:
+        if (!a_has_zero || !b_has_zero) {
+            return value_range{ .min = 1, .max = 1 };
+        }
+        if (a == value_range{ 0, 0 } && b == value_range{ 0, 0 }) {
+            return value_range{ .min = 0, .max = 0 };
+        }
+        return boolean;
+    case MICHAELCC_LINEAR_A_XOR:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_NOT_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_LESS_THAN:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_LESS_THAN_OR_EQUAL:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_GREATER_THAN:
+    case MICHAELCC_LINEAR_A_FLOAT_COMPARE_GREATER_THAN_OR_EQUAL:
+        return boolean;
+    default:
+        if (is_integer_comparison(type)) {
+            auto result = decide(type, a, b);
+            if (result.has_value()) {
+                return value_range{ .min = result.value(), .max = result.value() };
+            }
+            return boolean;
+        }
+        return full_range(result_size);
+    }
+}
+
+std::optional<bool> value_range_pass::decide(a_instruction_type type, value_range a, value_range b) noexcept {
+    // unsigned order is signed order between values on the same side of zero
+    if (is_unsigned_comparison(type)) {
+        if (!((a.min >= 0 && b.min >= 0) || (a.max < 0 && b.max < 0))) {
+            return std::nullopt;
+        }
+        type = to_signed_comparison(type);
+    }
+
+    switch (type) {
+    case MICHAELCC_LINEAR_A_COMPARE_EQUAL:
+    case MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL: {
+        std::optional<bool> equal;
+        if (a.is_constant() && a == b) {
+            equal = true;
+        }
+        else if (a.max < b.min || b.max < a.min) {
+            equal = false;
+        }
+        if (equal.has_value() && type == MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL) {
+            equal = !equal.value();
+        }
+        return equal;
+    }
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN:
+        if (a.max < b.min) { return true; }
+        if (a.min >= b.max) { return false; }
+        return std::nullopt;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL:
+        if (a.max <= b.min) { return true; }
+        if (a.min > b.max) { return false; }
+        return std::nullopt;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN:
+        return decide(MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN, b, a);
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL:
+        return decide(MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL, b, a);
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::refine(value_range range, a_instruction_type type, bool is_left, value_range other, bool holds) noexcept {
+    // put the vreg on the left of a comparison that holds
+    if (!is_left) {
+        type = swap_comparison(type);
+    }
+    if (!holds) {
+        type = negate_comparison(type);
+    }
+
+    if (is_unsigned_comparison(type)) {
+        if (range.min >= 0 && other.min >= 0) {
+            type = to_signed_comparison(type);
+        }
+        else if (other.min >= 0 && (type == MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN || type == MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN_OR_EQUAL)) {
+            // below a non negative bound read as unsigned, so not negative either
+            int64_t max = type == MICHAELCC_LINEAR_A_COMPARE_UNSIGNED_LESS_THAN ? other.max - 1 : other.max;
+            value_range refined{ .min = std::max<int64_t>(range.min, 0), .max = std::min(range.max, max) };
+            if (refined.min > refined.max) {
+                return std::nullopt;
+            }
+            return refined;
+        }
+        else {
+            return range;
+        }
+    }
+
+    value_range refined = range;
+    switch (type) {
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN:
+        if (other.max == INT64_MIN) {
+            return range;
+        }
+        refined.max = std::min(range.max, other.max - 1);
+        break;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_LESS_THAN_OR_EQUAL:
+        refined.max = std::min(range.max, other.max);
+        break;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN:
+        if (other.min == INT64_MAX) {
+            return range;
+        }
+        refined.min = std::max(range.min, other.min + 1);
+        break;
+    case MICHAELCC_LINEAR_A_COMPARE_SIGNED_GREATER_THAN_OR_EQUAL:
+        refined.min = std::max(range.min, other.min);
+        break;
+    case MICHAELCC_LINEAR_A_COMPARE_EQUAL:
+        refined = value_range{ .min = std::max(range.min, other.min), .max = std::min(range.max, other.max) };
+        break;
+    case MICHAELCC_LINEAR_A_COMPARE_NOT_EQUAL:
+        if (other.is_constant() && other.min == range.min && range.min != range.max) {
+            refined.min = range.min + 1;
+        }
+        else if (other.is_constant() && other.min == range.max && range.min != range.max) {
+            refined.max = range.max - 1;
+        }
+        break;
+    default:
+        break;
+    }
+
+    // no value satisfies a contradiction, the edge is never taken
+    if (refined.min > refined.max) {
+        return std::nullopt;
+    }
+    return refined;
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::get_range(virtual_register vreg) const {
+    if (vreg.reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+        return full_range(vreg.reg_size);
+    }
+    auto it = m_ranges.find(vreg);
+    if (it != m_ranges.end()) {
+        return it->second;
+    }
+    if (m_defined.contains(vreg)) {
+        return std::nullopt;
+    }
+    return full_range(vreg.reg_size);
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::get_range(virtual_register vreg, size_t block_id) const {
+    auto range = get_range(vreg);
+    auto edges = m_block_edges.find(block_id);
+    if (!range.has_value() || edges == m_block_edges.end()) {
+        return range;
+    }
+    for (const auto& edge : edges->second) {
+        range = apply_edge(range.value(), vreg, edge);
+        if (!range.has_value()) {
+            break;
+        }
+    }
+    return range;
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::get_range(virtual_register vreg, size_t predecessor_block_id, const std::optional<branch_edge>& edge) const {
+    auto range = get_range(vreg, predecessor_block_id);
+    if (!range.has_value() || !edge.has_value()) {
+        return range;
+    }
+    return apply_edge(range.value(), vreg, edge.value());
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::apply_edge(value_range range, virtual_register vreg, const branch_edge& edge) const {
+    // a vreg written more than once may hold something else by the time it is read
+    if (!m_defined.contains(vreg) || !m_defined.contains(edge.condition)) {
+        return range;
+    }
+
+    // a branch its condition never sends this way reaches nothing
+    auto condition = get_range(edge.condition);
+    if (condition.has_value() && (edge.taken ? condition.value() == value_range{ 0, 0 } : condition.value().min > 0 || condition.value().max < 0)) {
+        return std::nullopt;
+    }
+
+    if (vreg == edge.condition) {
+        if (!edge.taken) {
+            return value_range{ .min = 0, .max = 0 };
+        }
+        if (range.min == 0 && range.max > 0) {
+            range.min = 1;
+        }
+        else if (range.max == 0 && range.min < 0) {
+            range.max = -1;
+        }
+        return range;
+    }
+
+    auto comparison = m_comparisons.find(edge.condition);
+    if (comparison == m_comparisons.end()) {
+        return range;
+    }
+    const auto& [type, a, b] = comparison->second;
+    std::optional<value_range> refined = range;
+    if (a == vreg) {
+        if (auto other = get_range(b)) {
+            refined = refine(refined.value(), type, true, other.value(), edge.taken);
+        }
+    }
+    if (b == vreg && refined.has_value()) {
+        if (auto other = get_range(a)) {
+            refined = refine(refined.value(), type, false, other.value(), edge.taken);
+        }
+    }
+    return refined;
+}
+
+std::optional<value_range_pass::branch_edge> value_range_pass::get_edge(const translation_unit& unit, size_t predecessor_block_id, size_t block_id) {
+    auto predecessor = unit.blocks.find(predecessor_block_id);
+    if (predecessor == unit.blocks.end() || predecessor->second.instructions().empty()) {
+        return std::nullopt;
+    }
+    auto* terminator = dynamic_cast<const branch_condition*>(predecessor->second.instructions().back().get());
+    if (!terminator || terminator->if_true_block_id() == terminator->if_false_block_id()) {
+        return std::nullopt;
+    }
+    if (terminator->if_true_block_id() == block_id) {
+        return branch_edge{ .condition = terminator->condition(), .taken = true };
+    }
+    if (terminator->if_false_block_id() == block_id) {
+        return branch_edge{ .condition = terminator->condition(), .taken = false };
+    }
+    return std::nullopt;
+}
+
+std::optional<bool> value_range_pass::decide_condition(virtual_register condition, size_t block_id) const {
+    auto range = get_range(condition, block_id);
+    if (!range.has_value() || condition.reg_class != MICHAELCC_REGISTER_CLASS_INTEGER) {
+        return std::nullopt;
+    }
+    if (range.value() == value_range{ 0, 0 }) {
+        return false;
+    }
+    if (range.value().min > 0 || range.value().max < 0) {
+        return true;
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::make_constant(virtual_register destination, int64_t value) const {
+    register_word word{};
+    word.uint64 = static_cast<uint64_t>(value) & width_mask(destination.reg_size);
+    return std::make_unique<init_register>(destination, word);
+}
+
+void value_range_pass::remove_edge(translation_unit& unit, size_t block_id, size_t successor_block_id) {
+    unit.blocks.at(block_id).remove_successor_block_id(successor_block_id);
+    m_folded_block_ids.push_back(block_id);
+
+    auto& successor = unit.blocks.at(successor_block_id);
+    successor.remove_predecessor_block_id(block_id);
+    auto instructions = successor.release_instructions();
+    for (auto& instruction : instructions) {
+        auto* phi = dynamic_cast<const phi_instruction*>(instruction.get());
+        if (!phi) {
+            continue;
+        }
+        std::vector<var_info> values;
+        for (const auto& value : phi->values()) {
+            if (value.block_id != block_id) {
+                values.push_back(value);
+            }
+        }
+        instruction = std::make_unique<phi_instruction>(phi->destination(), std::move(values));
+    }
+    successor.replace_instructions(std::move(instructions));
+}
+
+void value_range_pass::prescan(const translation_unit& unit) {
+    std::unordered_map<virtual_register, size_t> definition_counts;
+    for (const auto& [block_id, block] : unit.blocks) {
+        for (const auto& instruction : block.instructions()) {
+            auto destination = instruction->destination_register();
+            if (destination.has_value()) {
+                definition_counts[destination.value()]++;
+            }
+            auto* comparison = dynamic_cast<const a_instruction*>(instruction.get());
+            if (comparison && is_integer_comparison(comparison->type())) {
+                m_comparisons.insert({ comparison->destination(), value_range_pass::comparison{ .type = comparison->type(), .a = comparison->operand_a(), .b = comparison->operand_b() } });
+            }
+        }
+    }
+    for (const auto& [vreg, count] : definition_counts) {
+        if (count == 1 && vreg.reg_class == MICHAELCC_REGISTER_CLASS_INTEGER && !unit.vreg_colors.contains(vreg)) {
+            m_defined.insert(vreg);
+        }
+    }
+
+    for (const auto& function : unit.function_definitions) {
+        compute_ranges(unit, *function);
+    }
+}
+
+void value_range_pass::compute_ranges(const translation_unit& unit, const function_definition& function) {
+    std::vector<size_t> block_ids;
+    for (size_t block_id : function.reverse_postorder()) {
+        if (unit.blocks.contains(block_id)) {
+            block_ids.push_back(block_id);
+        }
+    }
+
+    // a block is the head of a loop when it is entered from itself or a block after it in reverse postorder
+    std::unordered_map<size_t, size_t> order;
+    for (size_t i = 0; i < block_ids.size(); i++) {
+        order.insert({ block_ids[i], i });
+    }
+    std::unordered_set<size_t> loop_header_block_ids;
+
+    for (size_t block_id : block_ids) {
+        const auto& block = unit.blocks.at(block_id);
+        for (size_t predecessor_block_id : block.predecessor_block_ids()) {
+            auto it = order.find(predecessor_block_id);
+            if (it != order.end() && it->second >= order.at(block_id)) {
+                loop_header_block_ids.insert(block_id);
+            }
+        }
+
+        // every dominator entered through a single conditional edge adds what that branch established
+        std::vector<branch_edge> edges;
+        size_t dominator_block_id = block_id;
+        while (true) {
+            const auto& dominator = unit.blocks.at(dominator_block_id);
+            if (dominator.predecessor_block_ids().size() == 1) {
+                if (auto edge = get_edge(unit, dominator.predecessor_block_ids().front(), dominator_block_id)) {
+                    edges.push_back(edge.value());
+                }
+            }
+            auto immediate_dominator = dominator.immediate_dominator_block_id();
+            if (!immediate_dominator.has_value() || immediate_dominator.value() == dominator_block_id || !unit.blocks.contains(immediate_dominator.value())) {
+                break;
+            }
+            dominator_block_id = immediate_dominator.value();
+        }
+        if (!edges.empty()) {
+            m_block_edges.insert({ block_id, std::move(edges) });
+        }
+
+        if (!block.instructions().empty() && dynamic_cast<const phi_instruction*>(block.instructions().front().get())) {
+            auto& phi_edges = m_phi_edges[block_id];
+            for (size_t predecessor_block_id : block.predecessor_block_ids()) {
+                if (auto edge = get_edge(unit, predecessor_block_id, block_id)) {
+                    phi_edges.insert({ predecessor_block_id, edge.value() });
+                }
+            }
+        }
+    }
+
+    // ranges only grow until nothing changes, those still growing after a few rounds are widened to the end of
+    // the type so loops settle. recomputing afterwards without widening takes back what a loop's exit test bounds
+    auto sweep = [&](bool widen) {
+        bool changed = false;
+        for (size_t block_id : block_ids) {
+            range_calculator calculator(*this, block_id);
+            for (const auto& instruction : unit.blocks.at(block_id).instructions()) {
+                auto destination = instruction->destination_register();
+                if (!destination.has_value() || !m_defined.contains(destination.value())) {
+                    continue;
+                }
+                auto range = calculator(*instruction);
+                if (!range.has_value()) {
+                    continue;
+                }
+
+                auto it = m_ranges.find(destination.value());
+                if (it == m_ranges.end()) {
+                    m_ranges.insert({ destination.value(), range.value() });
+                    changed = true;
+                    continue;
+                }
+
+                // every cycle goes through a phi at the head of its loop, widening those alone lets the loop settle
+                // without giving up the bounds branches inside the loop put on everything else
+                value_range updated = widen ? join(it->second, range.value()) : range.value();
+                bool is_loop_phi = loop_header_block_ids.contains(block_id) && dynamic_cast<const phi_instruction*>(instruction.get());
+                if (widen && is_loop_phi && !(updated == it->second) && ++m_range_updates[destination.value()] > max_range_updates) {
+                    value_range full = full_range(destination.value().reg_size);
+                    if (updated.min < it->second.min) {
+                        updated.min = full.min;
+                    }
+                    if (updated.max > it->second.max) {
+                        updated.max = full.max;
+                    }
+                }
+                if (!(updated == it->second)) {
+                    it->second = updated;
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    };
+
+    while (sweep(true)) { }
+    for (size_t i = 0; i < narrowing_rounds; i++) {
+        sweep(false);
+    }
+}
+
+bool value_range_pass::optimize(translation_unit& unit) {
+    bool made_changes = false;
+
+    for (auto& [block_id, block] : unit.blocks) {
+        instruction_pass pass(*this, unit, block_id);
+        auto released_instructions = block.release_instructions();
+
+        std::vector<std::unique_ptr<instruction>> new_instructions;
+        new_instructions.reserve(released_instructions.size());
+        for (auto& instruction : released_instructions) {
+            std::unique_ptr<linear::instruction> new_instruction = pass(*instruction.get());
+
+            if (new_instruction) {
+                made_changes = true;
+                for (auto& prefix : pass.release_prefix()) {
+                    new_instructions.emplace_back(std::move(prefix));
+                }
+                new_instructions.emplace_back(std::move(new_instruction));
+            } else {
+                new_instructions.emplace_back(std::move(instruction));
+            }
+        }
+
+        block.replace_instructions(std::move(new_instructions));
+        for (size_t successor_block_id : pass.removed_successor_block_ids()) {
+            remove_edge(unit, block_id, successor_block_id);
+        }
+    }
+
+    return made_changes;
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::handle_default(const instruction& node) {
+    return full_range(node.destination_register().value().reg_size);
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const a_instruction& node) {
+    auto a = m_pass.get_range(node.operand_a(), m_block_id);
+    auto b = m_pass.get_range(node.operand_b(), m_block_id);
+    if (!a.has_value() || !b.has_value()) {
+        return std::nullopt;
+    }
+    return combine(node.type(), a.value(), b.value(), node.operand_a().reg_size, node.destination().reg_size);
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const a2_instruction& node) {
+    auto a = m_pass.get_range(node.operand_a(), m_block_id);
+    if (!a.has_value()) {
+        return std::nullopt;
+    }
+    int64_t constant = to_signed(node.constant(), node.operand_a().reg_size);
+    return combine(node.type(), a.value(), value_range{ .min = constant, .max = constant }, node.operand_a().reg_size, node.destination().reg_size);
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const u_instruction& node) {
+    auto operand = m_pass.get_range(node.operand(), m_block_id);
+    if (!operand.has_value()) {
+        return std::nullopt;
+    }
+    auto [min, max] = operand.value();
+
+    switch (node.type()) {
+    case MICHAELCC_LINEAR_U_NEGATE:
+        return make_range(-static_cast<__int128>(max), -static_cast<__int128>(min), node.operand().reg_size);
+    case MICHAELCC_LINEAR_U_BITWISE_NOT:
+        return value_range{ .min = ~max, .max = ~min };
+    case MICHAELCC_LINEAR_U_NOT:
+        if (min == 0 && max == 0) {
+            return value_range{ .min = 1, .max = 1 };
+        }
+        if (min > 0 || max < 0) {
+            return value_range{ .min = 0, .max = 0 };
+        }
+        return value_range{ .min = 0, .max = 1 };
+    default:
+        return full_range(node.destination().reg_size);
+    }
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const c_instruction& node) {
+    auto source = m_pass.get_range(node.source(), m_block_id);
+    if (!source.has_value()) {
+        return std::nullopt;
+    }
+    value_range full = full_range(node.destination().reg_size);
+    bool fits = source.value().min >= full.min && source.value().max <= full.max;
+
+    switch (node.type()) {
+    case MICHAELCC_LINEAR_C_COPY_INIT:
+    case MICHAELCC_LINEAR_C_SEXT_OR_TRUNC:
+        // sign extension keeps the value, truncation keeps it when it fits
+        return fits ? source.value() : full;
+    case MICHAELCC_LINEAR_C_ZEXT_OR_TRUNC:
+        if (node.is_extension() && source.value().min < 0) {
+            return value_range{ .min = 0, .max = static_cast<int64_t>(width_mask(node.source().reg_size)) };
+        }
+        return fits ? source.value() : full;
+    default:
+        return full;
+    }
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const init_register& node) {
+    int64_t value = to_signed(node.value().uint64, node.destination().reg_size);
+    return value_range{ .min = value, .max = value };
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const phi_instruction& node) {
+    auto phi_edges = m_pass.m_phi_edges.find(m_block_id);
+
+    // values that have not been reached yet are left out, a later round adds them
+    std::optional<value_range> result;
+    for (const auto& value : node.values()) {
+        std::optional<branch_edge> edge;
+        if (phi_edges != m_pass.m_phi_edges.end()) {
+            auto it = phi_edges->second.find(value.block_id);
+            if (it != phi_edges->second.end()) {
+                edge = it->second;
+            }
+        }
+
+        auto range = m_pass.get_range(value.vreg, value.block_id, edge);
+        if (range.has_value()) {
+            result = result.has_value() ? join(result.value(), range.value()) : range.value();
+        }
+    }
+    return result;
+}
+
+std::optional<value_range_pass::value_range> value_range_pass::range_calculator::dispatch(const select_instruction& node) {
+    auto condition = m_pass.decide_condition(node.condition(), m_block_id);
+    if (condition.has_value()) {
+        return m_pass.get_range(condition.value() ? node.if_true() : node.if_false(), m_block_id);
+    }
+
+    auto if_true = m_pass.get_range(node.if_true(), m_block_id);
+    auto if_false = m_pass.get_range(node.if_false(), m_block_id);
+    if (!if_true.has_value() || !if_false.has_value()) {
+        return std::nullopt;
+    }
+    return join(if_true.value(), if_false.value());
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const a_instruction& node) {
+    auto range = m_pass.m_ranges.find(node.destination());
+    if (range != m_pass.m_ranges.end() && range->second.is_constant()) {
+        return m_pass.make_constant(node.destination(), range->second.min);
+    }
+
+    auto type = node.type();
+    if (type != MICHAELCC_LINEAR_A_SIGNED_DIVIDE && type != MICHAELCC_LINEAR_A_SIGNED_MODULO
+        && type != MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE && type != MICHAELCC_LINEAR_A_UNSIGNED_MODULO) {
+        return nullptr;
+    }
+    auto dividend = m_pass.get_range(node.operand_a(), m_block_id);
+    auto divisor = m_pass.get_range(node.operand_b(), m_block_id);
+    if (!dividend.has_value() || !divisor.has_value()) {
+        return nullptr;
+    }
+
+    // signed and unsigned division agree while neither side is negative
+    bool made_unsigned = false;
+    if ((type == MICHAELCC_LINEAR_A_SIGNED_DIVIDE || type == MICHAELCC_LINEAR_A_SIGNED_MODULO) && dividend.value().min >= 0 && divisor.value().min > 0) {
+        type = type == MICHAELCC_LINEAR_A_SIGNED_DIVIDE ? MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE : MICHAELCC_LINEAR_A_UNSIGNED_MODULO;
+        made_unsigned = true;
+    }
+
+    // an unsigned division by a power of two is a shift and the remainder a mask
+    bool is_power_of_two = divisor.value().is_constant() && divisor.value().min > 0 && std::has_single_bit(static_cast<uint64_t>(divisor.value().min));
+    if (is_power_of_two && type == MICHAELCC_LINEAR_A_UNSIGNED_DIVIDE) {
+        size_t shift = std::countr_zero(static_cast<uint64_t>(divisor.value().min));
+        if (shift == 0) {
+            return std::make_unique<c_instruction>(MICHAELCC_LINEAR_C_COPY_INIT, node.destination(), node.operand_a());
+        }
+        return std::make_unique<a2_instruction>(MICHAELCC_LINEAR_A_UNSIGNED_SHIFT_RIGHT, node.destination(), node.operand_a(), shift);
+    }
+    if (is_power_of_two && type == MICHAELCC_LINEAR_A_UNSIGNED_MODULO) {
+        auto mask = m_unit.new_vreg(node.operand_b().reg_size, MICHAELCC_REGISTER_CLASS_INTEGER);
+        m_prefix.emplace_back(m_pass.make_constant(mask, divisor.value().min - 1));
+        return std::make_unique<a_instruction>(MICHAELCC_LINEAR_A_BITWISE_AND, node.destination(), node.operand_a(), mask);
+    }
+
+    if (made_unsigned) {
+        return std::make_unique<a_instruction>(type, node.destination(), node.operand_a(), node.operand_b());
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const a2_instruction& node) {
+    auto range = m_pass.m_ranges.find(node.destination());
+    if (range != m_pass.m_ranges.end() && range->second.is_constant()) {
+        return m_pass.make_constant(node.destination(), range->second.min);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const u_instruction& node) {
+    auto range = m_pass.m_ranges.find(node.destination());
+    if (range != m_pass.m_ranges.end() && range->second.is_constant()) {
+        return m_pass.make_constant(node.destination(), range->second.min);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const c_instruction& node) {
+    auto range = m_pass.m_ranges.find(node.destination());
+    if (range != m_pass.m_ranges.end() && range->second.is_constant()) {
+        return m_pass.make_constant(node.destination(), range->second.min);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const select_instruction& node) {
+    auto range = m_pass.m_ranges.find(node.destination());
+    if (range != m_pass.m_ranges.end() && range->second.is_constant()) {
+        return m_pass.make_constant(node.destination(), range->second.min);
+    }
+    return nullptr;
+}
+
+std::unique_ptr<michaelcc::linear::instruction> value_range_pass::instruction_pass::dispatch(const branch_condition& node) {
+    auto condition = m_pass.decide_condition(node.condition(), m_block_id);
+    if (!condition.has_value() || node.if_true_block_id() == node.if_false_block_id()) {
+        return nullptr;
+    }
+
+    if (condition.value()) {
+        m_removed_successor_block_ids.push_back(node.if_false_block_id());
+        return std::make_unique<branch>(node.if_true_block_id());
+    }
+    m_removed_successor_block_ids.push_back(node.if_true_block_id());
+    return std::make_unique<branch>(node.if_false_block_id());
+}
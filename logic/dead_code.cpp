@@ -8,12 +8,17 @@
 namespace michaelcc {
     namespace logic {
         namespace optimization {
+            // each rewrite forgets what it destroys, conditions included, before marking the IR mutated. new ones must too
             std::unique_ptr<logic::expression> dead_code_pass::expression_pass::dispatch(std::unique_ptr<logic::conditional_expression>&& node) {
                 if (is_truey(*node->condition())) {
+                    m_pass.m_side_effects.forget_tree(*node->condition());
+                    m_pass.m_side_effects.forget_tree(*node->else_expression());
                     mark_ir_mutated();
                     return node->release_then_expression();
                 }
                 if (is_falsey(*node->condition())) {
+                    m_pass.m_side_effects.forget_tree(*node->condition());
+                    m_pass.m_side_effects.forget_tree(*node->then_expression());
                     mark_ir_mutated();
                     return node->release_else_expression();
                 }
@@ -21,24 +26,27 @@ namespace michaelcc {
             }
 
             std::unique_ptr<logic::expression> dead_code_pass::expression_pass::dispatch(std::unique_ptr<logic::arithmetic_operator>&& node) {
-                logic::analysis::side_effects_analyzer side_effects_analyzer;
                 if (node->get_operator() == MICHAELCC_TOKEN_ASTERISK) {
-                    if (is_one(*node->left()) && !side_effects_analyzer.expression_has_side_effects(*node->right())) {
+                    if (is_one(*node->left()) && !m_pass.m_side_effects.expression_has_side_effects(*node->right())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_right();
                     }
-                    if (is_one(*node->right()) && !side_effects_analyzer.expression_has_side_effects(*node->left())) {
+                    if (is_one(*node->right()) && !m_pass.m_side_effects.expression_has_side_effects(*node->left())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_left();
                     }
-                    if (is_falsey(*node->left()) && !side_effects_analyzer.expression_has_side_effects(*node->right())) {
+                    if (is_falsey(*node->left()) && !m_pass.m_side_effects.expression_has_side_effects(*node->right())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::type_cast>(
                             std::make_unique<logic::integer_constant>(0, typing::qual_type::owning(std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS))),
                             typing::qual_type(node->get_type())
                         );
                     }
-                    if (is_falsey(*node->right()) && !side_effects_analyzer.expression_has_side_effects(*node->left())) {
+                    if (is_falsey(*node->right()) && !m_pass.m_side_effects.expression_has_side_effects(*node->left())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::type_cast>(
                             std::make_unique<logic::integer_constant>(0, typing::qual_type::owning(std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS))),
@@ -47,7 +55,8 @@ namespace michaelcc {
                     }
                 }
                 else if (node->get_operator() == MICHAELCC_TOKEN_SLASH) {
-                    if (is_falsey(*node->left()) && !side_effects_analyzer.expression_has_side_effects(*node->right())) {
+                    if (is_falsey(*node->left()) && !m_pass.m_side_effects.expression_has_side_effects(*node->right())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::type_cast>(
                             std::make_unique<logic::integer_constant>(0, typing::qual_type::owning(std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS))),
@@ -55,22 +64,26 @@ namespace michaelcc {
                         );
                     }
                     if (is_one(*node->right())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_left();
                     }
                 }
                 else if (node->get_operator() == MICHAELCC_TOKEN_PLUS) {
                     if (is_falsey(*node->left())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_right();
                     }
                     if (is_falsey(*node->right())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_left();
                     }
                 }
                 else if (node->get_operator() == MICHAELCC_TOKEN_MINUS) {
                     if (is_falsey(*node->left())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::unary_operation>(
                             MICHAELCC_TOKEN_MINUS,
@@ -78,26 +91,31 @@ namespace michaelcc {
                         );
                     }
                     if (is_falsey(*node->right())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_left();
                     }
                 }
                 else if (node->get_operator() == MICHAELCC_TOKEN_AND) {
-                    if (is_falsey(*node->left()) && !side_effects_analyzer.expression_has_side_effects(*node->right())) {
+                    if (is_falsey(*node->left()) && !m_pass.m_side_effects.expression_has_side_effects(*node->right())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::integer_constant>(0, typing::qual_type::owning(std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS)));
                     }
-                    if (is_falsey(*node->right()) && !side_effects_analyzer.expression_has_side_effects(*node->left())) {
+                    if (is_falsey(*node->right()) && !m_pass.m_side_effects.expression_has_side_effects(*node->left())) {
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return std::make_unique<logic::integer_constant>(0, typing::qual_type::owning(std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS)));
                     }
                 }
                 else if (node->get_operator() == MICHAELCC_TOKEN_OR) {
-                    if (is_truey(*node->left()) && !side_effects_analyzer.expression_has_side_effects(*node->right())) {
+                    if (is_truey(*node->left()) && !m_pass.m_side_effects.expression_has_side_effects(*node->right())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_right();
                     }
-                    if (is_truey(*node->right()) && !side_effects_analyzer.expression_has_side_effects(*node->left())) {
+                    if (is_truey(*node->right()) && !m_pass.m_side_effects.expression_has_side_effects(*node->left())) {
+                        m_pass.m_side_effects.forget(*node);
                         mark_ir_mutated();
                         return node->release_left();
                     }
@@ -107,10 +125,16 @@ namespace michaelcc {
 
             std::unique_ptr<logic::statement> dead_code_pass::statement_pass::dispatch(std::unique_ptr<logic::if_statement>&& node) {
                 if (is_truey(*node->condition())) {
+                    m_pass.m_side_effects.forget_tree(*node->condition());
+                    if (node->else_body()) {
+                        m_pass.m_side_effects.forget_tree(*node->else_body());
+                    }
                     mark_ir_mutated();
                     return std::make_unique<logic::statement_block>(node->release_then_body());
                 }
                 if (is_falsey(*node->condition())) {
+                    m_pass.m_side_effects.forget_tree(*node->condition());
+                    m_pass.m_side_effects.forget_tree(*node->then_body());
                     mark_ir_mutated();
                     if (!node->else_body()) {
                         return nullptr;
@@ -124,10 +148,12 @@ namespace michaelcc {
                 if (is_falsey(*node->condition())) {
                     if (node->check_condition_first()) {
                         // while/for loop - safe to remove
+                        m_pass.m_side_effects.forget_tree(*node);
                         mark_ir_mutated();
                         return nullptr;
                     } else {
                         // do-while loop - body executes once
+                        m_pass.m_side_effects.forget_tree(*node->condition());
                         mark_ir_mutated();
                         return std::make_unique<logic::statement_block>(node->release_body());
                     }
@@ -136,8 +162,10 @@ namespace michaelcc {
             }
 
             std::unique_ptr<logic::statement> dead_code_pass::statement_pass::dispatch(std::unique_ptr<logic::expression_statement>&& node) {
-                logic::analysis::side_effects_analyzer side_effects_analyzer;
-                if (node->expression() == nullptr || !side_effects_analyzer.expression_has_side_effects(*node->expression())) {
+                if (node->expression() == nullptr || !m_pass.m_side_effects.expression_has_side_effects(*node->expression())) {
+                    if (node->expression() != nullptr) {
+                        m_pass.m_side_effects.forget_tree(*node->expression());
+                    }
                     mark_ir_mutated();
                     return nullptr;
                 }
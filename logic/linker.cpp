@@ -22,7 +22,9 @@ void semantic_lowerer::forward_declare_types::visit(const ast::struct_declaratio
         });
     }
 
-    m_lowerer.m_translation_unit.declare_struct(std::make_shared<typing::struct_type>(node.struct_name().value(), std::move(fields)));
+    auto struct_type = std::make_shared<typing::struct_type>(node.struct_name().value(), std::move(fields));
+    m_lowerer.m_unchecked_layouts.push_back(struct_type);
+    m_lowerer.m_translation_unit.declare_struct(std::move(struct_type));
 }
 
 void semantic_lowerer::forward_declare_types::visit(const ast::union_declaration& node) {
@@ -42,7 +44,9 @@ void semantic_lowerer::forward_declare_types::visit(const ast::union_declaration
             0
         });
     }
-    m_lowerer.m_translation_unit.declare_union(std::make_shared<typing::union_type>(node.union_name().value(), std::move(members)));
+    auto union_type = std::make_shared<typing::union_type>(node.union_name().value(), std::move(members));
+    m_lowerer.m_unchecked_layouts.push_back(union_type);
+    m_lowerer.m_translation_unit.declare_union(std::move(union_type));
 }
 
 void semantic_lowerer::forward_declare_types::visit(const ast::enum_declaration& node) {
@@ -77,6 +81,7 @@ void semantic_lowerer::forward_declare_types::visit(const ast::enum_declaration&
         ));
     }
 
+    m_lowerer.m_unchecked_layouts.push_back(enum_type);
     m_lowerer.m_translation_unit.declare_enum(std::move(enum_type));
 }
 
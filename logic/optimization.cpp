@@ -303,6 +303,22 @@ namespace michaelcc {
                 return m_pass.m_statement_pass->dispatch(std::move(to_transform));
             }
 
+            std::unique_ptr<logic::statement> default_pass::statement_traverser::dispatch(const logic::switch_statement& node) {
+                std::unique_ptr<logic::expression> condition = m_pass.m_expression_traverser(*node.condition());
+
+                std::vector<logic::switch_statement::switch_case> cases;
+                cases.reserve(node.cases().size());
+                for (const auto& switch_case : node.cases()) {
+                    cases.emplace_back(logic::switch_statement::switch_case{
+                        .value = switch_case.value,
+                        .body = m_pass.transform_control_block(*switch_case.body, {})
+                    });
+                }
+
+                auto to_transform = std::make_unique<logic::switch_statement>(std::move(condition), std::move(cases));
+                return m_pass.m_statement_pass->dispatch(std::move(to_transform));
+            }
+
             std::unique_ptr<logic::statement> default_pass::statement_traverser::dispatch(const logic::break_statement& node) {
                 return m_pass.m_statement_pass->dispatch(node);
             }
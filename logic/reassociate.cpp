@@ -0,0 +1,412 @@
+#include "logic/optimization/reassociate.hpp"
+#include "logic/ir.hpp"
+#include "logic/typing.hpp"
+#include "logic/analysis/side_effects.hpp"
+#include "syntax/tokens.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace michaelcc {
+    namespace logic {
+        namespace optimization {
+            // wraps a value to the width of its type, sign extending it unless the type is unsigned
+            static int64_t wrap(int64_t value, size_t width, bool is_unsigned) {
+                if (width >= 64) {
+                    return value;
+                }
+                uint64_t mask = (uint64_t(1) << width) - 1;
+                uint64_t bits = static_cast<uint64_t>(value) & mask;
+                if (!is_unsigned && ((bits >> (width - 1)) & 1)) {
+                    bits |= ~mask;
+                }
+                return static_cast<int64_t>(bits);
+            }
+
+            static std::optional<int64_t> constant_value(const logic::expression& expression) {
+                if (auto integer_constant = dynamic_cast<const logic::integer_constant*>(&expression)) {
+                    return integer_constant->value();
+                }
+                return std::nullopt;
+            }
+
+            static std::optional<int64_t> exact_log2(int64_t value, size_t width) {
+                if (value <= 0 || (value & (value - 1)) != 0) {
+                    return std::nullopt;
+                }
+                int64_t exponent = 0;
+                while ((int64_t(1) << exponent) != value) {
+                    exponent++;
+                }
+                if (static_cast<size_t>(exponent) >= width) {
+                    return std::nullopt;
+                }
+                return exponent;
+            }
+
+            static std::unique_ptr<logic::expression> make_constant(int64_t value, const typing::qual_type& type) {
+                return std::make_unique<logic::integer_constant>(value, typing::qual_type(type));
+            }
+
+            // whether two side effect free expressions always evaluate to the same value
+            static bool same_value(const logic::expression& a, const logic::expression& b, const platform_info& platform_info) {
+                if (!a.get_type().type()->is_equivalent_to(*b.get_type().type(), platform_info)) {
+                    return false;
+                }
+                if (auto a_constant = dynamic_cast<const logic::integer_constant*>(&a)) {
+                    auto b_constant = dynamic_cast<const logic::integer_constant*>(&b);
+                    return b_constant && a_constant->value() == b_constant->value();
+                }
+                if (auto a_reference = dynamic_cast<const logic::variable_reference*>(&a)) {
+                    auto b_reference = dynamic_cast<const logic::variable_reference*>(&b);
+                    return b_reference && a_reference->get_variable() == b_reference->get_variable() && !a_reference->get_type().is_volatile();
+                }
+                if (auto a_operator = dynamic_cast<const logic::arithmetic_operator*>(&a)) {
+                    auto b_operator = dynamic_cast<const logic::arithmetic_operator*>(&b);
+                    return b_operator && a_operator->get_operator() == b_operator->get_operator()
+                        && same_value(*a_operator->left(), *b_operator->left(), platform_info)
+                        && same_value(*a_operator->right(), *b_operator->right(), platform_info);
+                }
+                if (auto a_unary = dynamic_cast<const logic::unary_operation*>(&a)) {
+                    auto b_unary = dynamic_cast<const logic::unary_operation*>(&b);
+                    return b_unary && a_unary->get_operator() == b_unary->get_operator() && same_value(*a_unary->operand(), *b_unary->operand(), platform_info);
+                }
+                if (auto a_cast = dynamic_cast<const logic::type_cast*>(&a)) {
+                    auto b_cast = dynamic_cast<const logic::type_cast*>(&b);
+                    return b_cast && same_value(*a_cast->operand(), *b_cast->operand(), platform_info);
+                }
+                return false;
+            }
+
+            static bool is_associative(token_type op) {
+                switch (op) {
+                    case MICHAELCC_TOKEN_PLUS:
+                    case MICHAELCC_TOKEN_ASTERISK:
+                    case MICHAELCC_TOKEN_AND:
+                    case MICHAELCC_TOKEN_OR:
+                    case MICHAELCC_TOKEN_CARET:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            // the operand that leaves the others unchanged, all ones for &
+            static int64_t identity_of(token_type op) {
+                switch (op) {
+                    case MICHAELCC_TOKEN_ASTERISK: return 1;
+                    case MICHAELCC_TOKEN_AND: return -1;
+                    default: return 0;
+                }
+            }
+
+            // the operand that decides the result on its own, all ones for |
+            static std::optional<int64_t> absorbing_of(token_type op) {
+                switch (op) {
+                    case MICHAELCC_TOKEN_ASTERISK: return 0;
+                    case MICHAELCC_TOKEN_AND: return 0;
+                    case MICHAELCC_TOKEN_OR: return -1;
+                    default: return std::nullopt;
+                }
+            }
+
+            static int64_t combine(token_type op, int64_t left, int64_t right) {
+                // unsigned arithmetic so overflow wraps instead of being undefined
+                uint64_t a = static_cast<uint64_t>(left);
+                uint64_t b = static_cast<uint64_t>(right);
+                switch (op) {
+                    case MICHAELCC_TOKEN_PLUS: return static_cast<int64_t>(a + b);
+                    case MICHAELCC_TOKEN_ASTERISK: return static_cast<int64_t>(a * b);
+                    case MICHAELCC_TOKEN_AND: return static_cast<int64_t>(a & b);
+                    case MICHAELCC_TOKEN_OR: return static_cast<int64_t>(a | b);
+                    case MICHAELCC_TOKEN_CARET: return static_cast<int64_t>(a ^ b);
+                    default: throw std::runtime_error("Operator does not associate");
+                }
+            }
+
+            // values computed by a subexpression go before variables, so the operand needing more registers is
+            // evaluated first
+            static int rank(const logic::expression& expression) {
+                return dynamic_cast<const logic::variable_reference*>(&expression) ? 1 : 2;
+            }
+
+            // whether a node continues the chain of the root, subtracting a constant continues a sum
+            static bool continues_chain(const logic::expression& expression, token_type op, const typing::qual_type& type, const platform_info& platform_info) {
+                auto arithmetic_operator = dynamic_cast<const logic::arithmetic_operator*>(&expression);
+                if (!arithmetic_operator || !arithmetic_operator->get_type().type()->is_equivalent_to(*type.type(), platform_info)) {
+                    return false;
+                }
+                if (arithmetic_operator->get_operator() == op) {
+                    return true;
+                }
+                return op == MICHAELCC_TOKEN_PLUS && arithmetic_operator->get_operator() == MICHAELCC_TOKEN_MINUS && constant_value(*arithmetic_operator->right()).has_value();
+            }
+
+            // the chain can only be rebuilt with its type when every operand already has it
+            static bool operands_match(const logic::expression& expression, token_type op, const typing::qual_type& type, const platform_info& platform_info) {
+                if (continues_chain(expression, op, type, platform_info)) {
+                    auto& arithmetic_operator = static_cast<const logic::arithmetic_operator&>(expression);
+                    return operands_match(*arithmetic_operator.left(), op, type, platform_info) && operands_match(*arithmetic_operator.right(), op, type, platform_info);
+                }
+                return expression.get_type().type()->is_equivalent_to(*type.type(), platform_info);
+            }
+
+            struct chain {
+                std::vector<std::unique_ptr<logic::expression>> operands;
+                std::vector<int64_t> constants;
+
+                // the shape of the chain before it was taken apart, to tell whether rebuilding changes anything
+                size_t leaf_count = 0;
+                size_t last_constant_leaf = 0;
+                bool is_left_deep = true;
+            };
+
+            // the nodes of the chain itself are destroyed once their operands are taken out
+            static void collect(std::unique_ptr<logic::expression>&& expression, token_type op, const typing::qual_type& type, const platform_info& platform_info, logic::analysis::side_effects_analyzer& side_effects, chain& chain, bool is_right_operand) {
+                if (continues_chain(*expression, op, type, platform_info)) {
+                    auto& arithmetic_operator = static_cast<logic::arithmetic_operator&>(*expression);
+                    if (is_right_operand) {
+                        chain.is_left_deep = false;
+                    }
+                    side_effects.forget(arithmetic_operator);
+
+                    collect(arithmetic_operator.release_left(), op, type, platform_info, side_effects, chain, false);
+                    if (arithmetic_operator.get_operator() == MICHAELCC_TOKEN_MINUS) {
+                        chain.constants.push_back(-constant_value(*arithmetic_operator.right()).value());
+                        chain.last_constant_leaf = chain.leaf_count++;
+                        return;
+                    }
+                    collect(arithmetic_operator.release_right(), op, type, platform_info, side_effects, chain, true);
+                    return;
+                }
+
+                if (auto value = constant_value(*expression)) {
+                    chain.constants.push_back(value.value());
+                    chain.last_constant_leaf = chain.leaf_count++;
+                    return;
+                }
+                chain.operands.emplace_back(std::move(expression));
+                chain.leaf_count++;
+            }
+
+            std::unique_ptr<logic::expression> reassociate_pass::expression_pass::reassociate(std::unique_ptr<logic::arithmetic_operator>&& node, size_t width, bool is_unsigned) {
+                const platform_info& platform_info = m_pass.m_layout_calculator.get_platform_info();
+                token_type op = node->get_operator() == MICHAELCC_TOKEN_MINUS ? MICHAELCC_TOKEN_PLUS : node->get_operator();
+                typing::qual_type type = node->get_type();
+                if (!operands_match(*node, op, type, platform_info)) {
+                    return node;
+                }
+
+                token_type original_operator = node->get_operator();
+                std::optional<int64_t> original_constant = constant_value(*node->right());
+
+                auto& side_effects = m_pass.m_side_effects;
+                chain chain;
+                collect(std::move(node), op, type, platform_info, side_effects, chain, false);
+                bool changed = !chain.is_left_deep || chain.constants.size() > 1
+                    || (chain.constants.size() == 1 && chain.last_constant_leaf != chain.leaf_count - 1);
+
+                int64_t identity = wrap(identity_of(op), width, is_unsigned);
+                int64_t constant = identity;
+                for (int64_t value : chain.constants) {
+                    constant = wrap(combine(op, constant, value), width, is_unsigned);
+                }
+
+                bool has_side_effects = std::any_of(chain.operands.begin(), chain.operands.end(), [&](const std::unique_ptr<logic::expression>& operand) {
+                    return side_effects.expression_has_side_effects(*operand);
+                });
+
+                // x & x and x | x are just x, x ^ x cancels out
+                if (!has_side_effects && (op == MICHAELCC_TOKEN_AND || op == MICHAELCC_TOKEN_OR || op == MICHAELCC_TOKEN_CARET)) {
+                    auto& operands = chain.operands;
+                    for (size_t i = 0; i < operands.size();) {
+                        bool cancelled = false;
+                        for (size_t j = i + 1; j < operands.size(); j++) {
+                            if (!same_value(*operands[i], *operands[j], platform_info)) {
+                                continue;
+                            }
+                            changed = true;
+                            side_effects.forget_tree(*operands[j]);
+                            operands.erase(operands.begin() + j);
+                            if (op == MICHAELCC_TOKEN_CARET) {
+                                side_effects.forget_tree(*operands[i]);
+                                operands.erase(operands.begin() + i);
+                                cancelled = true;
+                                break;
+                            }
+                            j--;
+                        }
+                        if (!cancelled) {
+                            i++;
+                        }
+                    }
+                }
+
+                auto absorbing = absorbing_of(op);
+                bool is_absorbed = absorbing.has_value() && constant == wrap(absorbing.value(), width, is_unsigned) && !has_side_effects;
+                if (chain.operands.empty() || is_absorbed) {
+                    for (const auto& operand : chain.operands) {
+                        side_effects.forget_tree(*operand);
+                    }
+                    mark_ir_mutated();
+                    return make_constant(constant, type);
+                }
+
+                // operands with side effects keep their order, only the constants move
+                auto by_rank = [](const std::unique_ptr<logic::expression>& a, const std::unique_ptr<logic::expression>& b) {
+                    return rank(*a) > rank(*b);
+                };
+                if (!has_side_effects && !std::is_sorted(chain.operands.begin(), chain.operands.end(), by_rank)) {
+                    changed = true;
+                    std::stable_sort(chain.operands.begin(), chain.operands.end(), by_rank);
+                }
+
+                std::unique_ptr<logic::expression> result = std::move(chain.operands[0]);
+                for (size_t i = 1; i < chain.operands.size(); i++) {
+                    result = std::make_unique<logic::arithmetic_operator>(op, std::move(result), std::move(chain.operands[i]), typing::qual_type(type));
+                }
+
+                if (constant == identity) {
+                    changed = changed || !chain.constants.empty();
+                }
+                else {
+                    token_type final_operator = op;
+                    int64_t final_constant = constant;
+                    int64_t signed_constant = wrap(constant, width, false);
+                    if (op == MICHAELCC_TOKEN_PLUS && signed_constant < 0 && signed_constant != INT64_MIN && wrap(-signed_constant, width, false) > 0) {
+                        final_operator = MICHAELCC_TOKEN_MINUS;
+                        final_constant = wrap(-signed_constant, width, is_unsigned);
+                    }
+                    else if (op == MICHAELCC_TOKEN_ASTERISK) {
+                        // a shift is much cheaper than a multiplication, which some targets do in software
+                        if (auto exponent = exact_log2(constant, width)) {
+                            final_operator = MICHAELCC_TOKEN_BITSHIFT_LEFT;
+                            final_constant = exponent.value();
+                        }
+                    }
+
+                    changed = changed || original_operator != final_operator || !original_constant.has_value()
+                        || wrap(original_constant.value(), width, is_unsigned) != final_constant;
+                    result = std::make_unique<logic::arithmetic_operator>(final_operator, std::move(result), make_constant(final_constant, type), typing::qual_type(type));
+                }
+
+                if (changed) {
+                    mark_ir_mutated();
+                }
+                return result;
+            }
+
+            std::unique_ptr<logic::expression> reassociate_pass::expression_pass::simplify(std::unique_ptr<logic::arithmetic_operator>&& node, size_t width, bool is_unsigned) {
+                const platform_info& platform_info = m_pass.m_layout_calculator.get_platform_info();
+                typing::qual_type type = node->get_type();
+                auto left = constant_value(*node->left());
+                auto right = constant_value(*node->right());
+                // every rewrite below destroys the node, along with the operands it does not hand on
+                auto& side_effects = m_pass.m_side_effects;
+
+                switch (node->get_operator()) {
+                    case MICHAELCC_TOKEN_MINUS:
+                        if (same_value(*node->left(), *node->right(), platform_info) && !side_effects.expression_has_side_effects(*node->left())) {
+                            side_effects.forget_tree(*node);
+                            mark_ir_mutated();
+                            return make_constant(0, type);
+                        }
+                        break;
+                    case MICHAELCC_TOKEN_SLASH:
+                        if (right == 1) {
+                            side_effects.forget(*node);
+                            mark_ir_mutated();
+                            return node->release_left();
+                        }
+                        // signed division rounds towards zero, a shift would round down
+                        if (is_unsigned && right.has_value()) {
+                            if (auto exponent = exact_log2(right.value(), width)) {
+                                side_effects.forget(*node);
+                                mark_ir_mutated();
+                                return std::make_unique<logic::arithmetic_operator>(MICHAELCC_TOKEN_BITSHIFT_RIGHT, node->release_left(), make_constant(exponent.value(), type), typing::qual_type(type));
+                            }
+                        }
+                        break;
+                    case MICHAELCC_TOKEN_MODULO:
+                        if (right == 1 && !side_effects.expression_has_side_effects(*node->left())) {
+                            side_effects.forget_tree(*node);
+                            mark_ir_mutated();
+                            return make_constant(0, type);
+                        }
+                        if (is_unsigned && right.has_value() && exact_log2(right.value(), width).has_value()) {
+                            side_effects.forget(*node);
+                            mark_ir_mutated();
+                            return std::make_unique<logic::arithmetic_operator>(MICHAELCC_TOKEN_AND, node->release_left(), make_constant(right.value() - 1, type), typing::qual_type(type));
+                        }
+                        break;
+                    case MICHAELCC_TOKEN_BITSHIFT_LEFT:
+                    case MICHAELCC_TOKEN_BITSHIFT_RIGHT: {
+                        if (right == 0) {
+                            side_effects.forget(*node);
+                            mark_ir_mutated();
+                            return node->release_left();
+                        }
+                        if (left == 0 && !side_effects.expression_has_side_effects(*node->right())) {
+                            side_effects.forget_tree(*node);
+                            mark_ir_mutated();
+                            return make_constant(0, type);
+                        }
+
+                        // (a << 2) << 3 is a << 5, as long as the total stays below the width
+                        auto inner = dynamic_cast<logic::arithmetic_operator*>(node->left().get());
+                        if (!right.has_value() || !inner || inner->get_operator() != node->get_operator() || !inner->get_type().type()->is_equivalent_to(*type.type(), platform_info)) {
+                            break;
+                        }
+                        auto inner_amount = constant_value(*inner->right());
+                        if (inner_amount.has_value() && inner_amount.value() >= 0 && right.value() >= 0 && static_cast<size_t>(inner_amount.value() + right.value()) < width) {
+                            side_effects.forget(*node);
+                            side_effects.forget(*inner);
+                            mark_ir_mutated();
+                            auto amount = make_constant(inner_amount.value() + right.value(), node->right()->get_type());
+                            return std::make_unique<logic::arithmetic_operator>(node->get_operator(), inner->release_left(), std::move(amount), typing::qual_type(type));
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                return node;
+            }
+
+            // every rewrite below, and any added later, forgets the nodes it destroys in m_side_effects before they go
+            std::unique_ptr<logic::expression> reassociate_pass::expression_pass::dispatch(std::unique_ptr<logic::arithmetic_operator>&& node) {
+                // signedness as the flattener lowers it, division and shifts pick their instruction by it
+                auto int_type = std::dynamic_pointer_cast<typing::int_type>(node->get_type().type());
+                if (!int_type) {
+                    return node;
+                }
+                size_t width = static_cast<size_t>(type_layout_calculator::get_int_type_size(*int_type, m_pass.m_layout_calculator.get_platform_info()));
+                bool is_unsigned = !int_type->is_signed();
+
+                bool continues_sum = node->get_operator() == MICHAELCC_TOKEN_MINUS && constant_value(*node->right()).has_value();
+                if (is_associative(node->get_operator()) || continues_sum) {
+                    return reassociate(std::move(node), width, is_unsigned);
+                }
+                return simplify(std::move(node), width, is_unsigned);
+            }
+
+            std::unique_ptr<logic::expression> reassociate_pass::expression_pass::dispatch(std::unique_ptr<logic::unary_operation>&& node) {
+                // -(-x) and ~~x are x again for integers
+                auto inner = dynamic_cast<logic::unary_operation*>(node->operand().get());
+                if (!inner || inner->get_operator() != node->get_operator() || !node->get_type().is_same_type<typing::int_type>()) {
+                    return node;
+                }
+                if (node->get_operator() == MICHAELCC_TOKEN_MINUS || node->get_operator() == MICHAELCC_TOKEN_TILDE) {
+                    m_pass.m_side_effects.forget(*node);
+                    m_pass.m_side_effects.forget(*inner);
+                    mark_ir_mutated();
+                    return inner->release_operand();
+                }
+                return node;
+            }
+        }
+    }
+}
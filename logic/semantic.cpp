@@ -831,6 +831,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     }
 
     m_current_loop_depth++;
+    m_current_break_depth++;
     std::shared_ptr<logic::control_block> inner_control_block = std::make_shared<logic::control_block>();
     m_lowerer.m_symbol_explorer.visit(inner_control_block);
     std::vector<std::unique_ptr<logic::statement>> inner_statements;
@@ -840,6 +841,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     }
     m_lowerer.m_symbol_explorer.exit();
     m_current_loop_depth--;
+    m_current_break_depth--;
     inner_statements.emplace_back((*this)(*node.increment_statement()));
     inner_control_block->implement(std::move(inner_statements));
 
@@ -853,6 +855,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     m_lowerer.m_symbol_explorer.visit(control_block);
 
     m_current_loop_depth++;
+    m_current_break_depth++;
     std::vector<std::unique_ptr<logic::statement>> statements;
     statements.reserve(node.body().statements().size());
     for (const auto& statement : node.body().statements()) {
@@ -868,6 +871,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     }
 
     m_current_loop_depth--;
+    m_current_break_depth--;
     m_lowerer.m_symbol_explorer.exit();
     return std::make_unique<logic::loop_statement>(std::move(control_block), std::move(condition), false);
 }
@@ -884,6 +888,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     m_lowerer.m_symbol_explorer.visit(control_block);
 
     m_current_loop_depth++;
+    m_current_break_depth++;
     std::vector<std::unique_ptr<logic::statement>> statements;
     statements.reserve(node.body().statements().size());
     for (const auto& statement : node.body().statements()) {
@@ -892,6 +897,7 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     control_block->implement(std::move(statements));
 
     m_current_loop_depth--;
+    m_current_break_depth--;
     m_lowerer.m_symbol_explorer.exit();
     return std::make_unique<logic::loop_statement>(std::move(control_block), std::move(condition), true);
 }
@@ -952,6 +958,131 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
     return std::make_unique<logic::if_statement>(std::move(condition), std::move(then_control_block), std::move(else_control_block));
 }
 
+std::optional<int64_t> semantic_lowerer::statement_resolver::evaluate_case_value(const logic::expression& expression, const source_location& location) {
+    if (auto* constant = dynamic_cast<const logic::integer_constant*>(&expression)) {
+        return constant->value();
+    }
+    if (auto* enumerator = dynamic_cast<const logic::enumerator_literal*>(&expression)) {
+        return enumerator->enumerator().value;
+    }
+    if (auto* cast = dynamic_cast<const logic::type_cast*>(&expression)) {
+        if (!cast->get_type().is_same_type<typing::int_type>() && !cast->get_type().is_same_type<typing::enum_type>()) {
+            return std::nullopt;
+        }
+        return evaluate_case_value(*cast->operand(), location);
+    }
+    if (auto* unary = dynamic_cast<const logic::unary_operation*>(&expression)) {
+        auto operand = evaluate_case_value(*unary->operand(), location);
+        if (!operand.has_value()) {
+            return std::nullopt;
+        }
+        switch (unary->get_operator()) {
+            case MICHAELCC_TOKEN_MINUS:
+                if (operand.value() == INT64_MIN) {
+                    throw panic("Case label overflows when negated.", location);
+                }
+                return -operand.value();
+            case MICHAELCC_TOKEN_TILDE: return ~operand.value();
+            case MICHAELCC_TOKEN_NOT: return operand.value() == 0 ? 1 : 0;
+            default: return std::nullopt;
+        }
+    }
+    if (auto* arithmetic = dynamic_cast<const logic::arithmetic_operator*>(&expression)) {
+        auto left = evaluate_case_value(*arithmetic->left(), location);
+        auto right = evaluate_case_value(*arithmetic->right(), location);
+        if (!left.has_value() || !right.has_value()) {
+            return std::nullopt;
+        }
+
+        // computed unsigned so overflow wraps, the result is cut down to the condition's type afterwards anyway
+        uint64_t left_bits = static_cast<uint64_t>(left.value());
+        uint64_t right_bits = static_cast<uint64_t>(right.value());
+        switch (arithmetic->get_operator()) {
+            case MICHAELCC_TOKEN_PLUS: return static_cast<int64_t>(left_bits + right_bits);
+            case MICHAELCC_TOKEN_MINUS: return static_cast<int64_t>(left_bits - right_bits);
+            case MICHAELCC_TOKEN_ASTERISK: return static_cast<int64_t>(left_bits * right_bits);
+            case MICHAELCC_TOKEN_AND: return left.value() & right.value();
+            case MICHAELCC_TOKEN_OR: return left.value() | right.value();
+            case MICHAELCC_TOKEN_CARET: return left.value() ^ right.value();
+            case MICHAELCC_TOKEN_BITSHIFT_LEFT:
+            case MICHAELCC_TOKEN_BITSHIFT_RIGHT:
+                if (right.value() < 0 || right.value() >= 64) {
+                    std::ostringstream ss;
+                    ss << "Shift amount " << right.value() << " in case label is out of range.";
+                    throw panic(ss.str(), location);
+                }
+                return arithmetic->get_operator() == MICHAELCC_TOKEN_BITSHIFT_LEFT
+                    ? static_cast<int64_t>(left_bits << right.value())
+                    : left.value() >> right.value();
+            default: return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch(const ast::switch_statement& node) {
+    std::unique_ptr<logic::expression> condition = m_lowerer.lower_expression(*node.condition(), std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS), true);
+    if (!condition->get_type().is_same_type<typing::int_type>() && !condition->get_type().is_same_type<typing::enum_type>()) {
+        std::ostringstream ss;
+        ss << "Expression \"" << ast::to_c_string(*node.condition()) << "\" is not a valid switch condition.";
+        throw panic(ss.str(), node.condition()->location());
+    }
+
+    // case values are converted to the condition's type, so they compare the way the condition does
+    bool is_unsigned_condition = false;
+    size_t condition_bits = static_cast<size_t>(m_lowerer.get_platform_info().int_size);
+    if (auto* int_type = dynamic_cast<const typing::int_type*>(condition->get_type().type().get())) {
+        is_unsigned_condition = int_type->is_unsigned();
+        condition_bits = static_cast<size_t>(type_layout_calculator::get_int_type_size(*int_type, m_lowerer.get_platform_info()));
+    }
+
+    std::set<int64_t> seen_values;
+    std::vector<logic::switch_statement::switch_case> cases;
+    cases.reserve(node.cases().size());
+
+    m_current_break_depth++;
+    for (const auto& switch_case : node.cases()) {
+        std::optional<int64_t> value;
+        if (switch_case.value) {
+            auto value_expression = m_lowerer.lower_expression(*switch_case.value, std::make_shared<typing::int_type>(typing::NO_INT_QUALIFIER, typing::INT_INT_CLASS), true);
+            value = evaluate_case_value(*value_expression, switch_case.value->location());
+            if (!value.has_value()) {
+                std::ostringstream ss;
+                ss << "Case label \"" << ast::to_c_string(*switch_case.value) << "\" is not an integer constant.";
+                throw panic(ss.str(), switch_case.value->location());
+            }
+            if (condition_bits < 64) {
+                uint64_t bits = static_cast<uint64_t>(value.value()) & ((uint64_t(1) << condition_bits) - 1);
+                if (!is_unsigned_condition && (bits >> (condition_bits - 1)) != 0) {
+                    bits |= ~uint64_t(0) << condition_bits;
+                }
+                value = static_cast<int64_t>(bits);
+            }
+            if (!seen_values.insert(value.value()).second) {
+                std::ostringstream ss;
+                ss << "Duplicate case label " << value.value() << " in switch statement.";
+                throw panic(ss.str(), switch_case.value->location());
+            }
+        }
+
+        std::shared_ptr<logic::control_block> control_block = std::make_shared<logic::control_block>();
+        m_lowerer.m_symbol_explorer.visit(control_block);
+
+        std::vector<std::unique_ptr<logic::statement>> statements;
+        statements.reserve(switch_case.body.statements().size());
+        for (const auto& statement : switch_case.body.statements()) {
+            statements.emplace_back((*this)(*statement));
+        }
+        control_block->implement(std::move(statements));
+
+        m_lowerer.m_symbol_explorer.exit();
+        cases.emplace_back(logic::switch_statement::switch_case{ .value = value, .body = std::move(control_block) });
+    }
+    m_current_break_depth--;
+
+    return std::make_unique<logic::switch_statement>(std::move(condition), std::move(cases));
+}
+
 std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch(const ast::return_statement& node) {
     std::shared_ptr<logic::function_definition> function = m_lowerer.m_symbol_explorer.is_in_context<logic::function_definition>();
     if (function == nullptr) {
@@ -967,9 +1098,9 @@ std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch
 }
 
 std::unique_ptr<logic::statement> semantic_lowerer::statement_resolver::dispatch(const ast::break_statement& node) {
-    if (node.depth() > m_current_loop_depth) {
+    if (node.depth() > m_current_break_depth) {
         std::ostringstream ss;
-        ss << "Break statement depth is greater than the current loop depth.";
+        ss << "Break statement depth is greater than the current loop and switch depth.";
         throw panic(ss.str(), node.location());
     }
     return std::make_unique<logic::break_statement>(node.depth());
@@ -1193,7 +1324,7 @@ std::shared_ptr<logic::function_definition> semantic_lowerer::lower_function_dec
     return function;
 }
 
-void semantic_lowerer::lower(const std::vector<std::unique_ptr<ast::ast_element>>& ast) {
+void semantic_lowerer::declare(const std::vector<std::unique_ptr<ast::ast_element>>& ast) {
     forward_declare_types forward_declare_types_pass(*this);
     for (const auto& element : ast) {
         element->accept(forward_declare_types_pass);
@@ -1209,29 +1340,60 @@ void semantic_lowerer::lower(const std::vector<std::unique_ptr<ast::ast_element>
         element->accept(forward_declare_functions_pass);
     }
 
-    for (auto& [name, struct_type] : m_translation_unit.structs()) {
-        check_layout_dependencies(struct_type);
+    check_declared_layouts();
+}
+
+void semantic_lowerer::check_declared_layouts() {
+    for (const auto& type : m_unchecked_layouts) {
+        check_layout_dependencies(type);
     }
-    for (auto& [name, union_type] : m_translation_unit.unions()) {
-        check_layout_dependencies(union_type);
+    m_unchecked_layouts.clear();
+}
+
+void semantic_lowerer::lower_definition(const ast::ast_element& element) {
+    auto variable_declaration = dynamic_cast<const ast::variable_declaration*>(&element);
+    if (variable_declaration) {
+        m_translation_unit.add_static_variable_declaration(lower_variable_declaration(*variable_declaration, true));
     }
-    for (auto& [name, enum_type] : m_translation_unit.enums()) {
-        check_layout_dependencies(enum_type);
+    auto function_declaration = dynamic_cast<const ast::function_declaration*>(&element);
+    if (function_declaration) {
+        lower_function_declaration(*function_declaration);
     }
+}
+
+void semantic_lowerer::lower(const std::vector<std::unique_ptr<ast::ast_element>>& ast) {
+    declare(ast);
 
     m_symbol_explorer.visit(m_translation_unit.global_context());
     for (const auto& element : ast) {
-        auto variable_declaration = dynamic_cast<ast::variable_declaration*>(element.get());
-        if (variable_declaration) {
-            m_translation_unit.add_static_variable_declaration(lower_variable_declaration(*variable_declaration, true));
-        }
-        auto function_declaration = dynamic_cast<ast::function_declaration*>(element.get());
-        if (function_declaration) {
-            lower_function_declaration(*function_declaration);
-        }
+        lower_definition(*element);
     }
     m_symbol_explorer.exit();
 
+    check_functions();
+}
+
+void semantic_lowerer::lower(parser& parser) {
+    forward_declare_types forward_declare_types_pass(*this);
+    implement_type_declarations implement_type_declarations_pass(*this);
+    forward_declare_functions forward_declare_functions_pass(*this);
+
+    // each declaration is released as soon as it has been lowered
+    m_symbol_explorer.visit(m_translation_unit.global_context());
+    while (auto element = parser.parse_next()) {
+        element->accept(forward_declare_types_pass);
+        element->accept(implement_type_declarations_pass);
+        element->accept(forward_declare_functions_pass);
+        check_declared_layouts();
+
+        lower_definition(*element);
+    }
+    m_symbol_explorer.exit();
+
+    check_functions();
+}
+
+void semantic_lowerer::check_functions() {
     logic::analysis::function_dependency_analyzer function_dependency_analyzer;
     for (const auto& symbol : m_translation_unit.global_symbols()) {
         std::shared_ptr<logic::function_definition> function = std::dynamic_pointer_cast<logic::function_definition>(symbol);
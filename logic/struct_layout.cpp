@@ -0,0 +1,406 @@
+#include "logic/optimization/struct_layout.hpp"
+#include "logic/analysis/struct_access.hpp"
+#include "logic/type_info.hpp"
+#include "logic/ir.hpp"
+#include "logic/typing.hpp"
+#include <algorithm>
+#include <format>
+#include <memory>
+#include <sstream>
+
+namespace michaelcc {
+    namespace logic {
+        namespace analysis {
+            struct_access_analyzer::struct_access_analyzer(const logic::translation_unit& unit) : m_expression_analyzer(*this), m_statement_analyzer(*this) {
+                for (const auto& [name, struct_type] : unit.structs()) {
+                    info(struct_type);
+                }
+
+                // a union overlays its members, so reading one member through another depends on their layout
+                for (const auto& [name, union_type] : unit.unions()) {
+                    for (const auto& member : union_type->members()) {
+                        expose(member.member_type, "member of a union", false);
+                    }
+                }
+
+                // static data is laid out by its initializer, and global variables are shared with other units
+                for (const auto& declaration : unit.static_variable_declarations()) {
+                    expose(declaration.variable()->get_type(), "held in static storage", false);
+                    if (declaration.initializer() != nullptr) {
+                        analyze_expression(*declaration.initializer());
+                    }
+                }
+
+                for (const auto& symbol : unit.global_context()->symbols()) {
+                    auto function = std::dynamic_pointer_cast<logic::function_definition>(symbol);
+                    if (!function) {
+                        continue;
+                    }
+
+                    // functions without a body are implemented elsewhere, against the declared layout
+                    if (!function->is_implemented()) {
+                        expose(function->return_type(), "passed to an external function", true);
+                        for (const auto& parameter : function->parameters()) {
+                            expose(parameter->get_type(), "passed to an external function", true);
+                        }
+                        continue;
+                    }
+                    analyze_control_block(*function);
+                }
+            }
+
+            struct_access_analyzer::struct_info& struct_access_analyzer::info(const std::shared_ptr<typing::struct_type>& type) {
+                auto it = m_structs.find(type.get());
+                if (it == m_structs.end()) {
+                    it = m_structs.insert({ type.get(), struct_info{
+                        .type = type,
+                        .field_heat = std::vector<size_t>(type->fields().size(), 0),
+                        .exposure = {}
+                    } }).first;
+                    m_order.push_back(type.get());
+                }
+                return it->second;
+            }
+
+            std::shared_ptr<typing::struct_type> struct_access_analyzer::accessed_struct(const logic::member_access& node) const {
+                auto type = node.base()->get_type().type();
+                if (node.is_dereference()) {
+                    auto pointer_type = std::dynamic_pointer_cast<typing::pointer_type>(type);
+                    if (!pointer_type) {
+                        return nullptr;
+                    }
+                    type = pointer_type->pointee_type().type();
+                }
+                return std::dynamic_pointer_cast<typing::struct_type>(type);
+            }
+
+            void struct_access_analyzer::analyze_address(const logic::expression& address) {
+                // a field address that is immediately loaded or stored through is just an access
+                auto address_of = dynamic_cast<const logic::address_of*>(&address);
+                if (address_of && std::holds_alternative<std::unique_ptr<logic::member_access>>(address_of->operand())) {
+                    analyze_expression(*std::get<std::unique_ptr<logic::member_access>>(address_of->operand()));
+                    return;
+                }
+                analyze_expression(address);
+            }
+
+            void struct_access_analyzer::expose(const typing::qual_type& type, const std::string& reason, bool through_pointers) {
+                auto base_type = type.type();
+                while (auto array_type = std::dynamic_pointer_cast<typing::array_type>(base_type)) {
+                    base_type = array_type->element_type().type();
+                }
+
+                if (through_pointers) {
+                    if (auto pointer_type = std::dynamic_pointer_cast<typing::pointer_type>(base_type)) {
+                        expose(pointer_type->pointee_type(), reason, true);
+                        return;
+                    }
+                }
+
+                auto struct_type = std::dynamic_pointer_cast<typing::struct_type>(base_type);
+                if (!struct_type) {
+                    return;
+                }
+
+                auto& struct_info = info(struct_type);
+                if (!struct_info.exposure.empty()) {
+                    return; // also stops at self referencing structs
+                }
+                struct_info.exposure = reason;
+
+                // the layout of nested structs is part of the enclosing one
+                for (const auto& field : struct_type->fields()) {
+                    expose(field.member_type, reason, false);
+                }
+            }
+
+            void struct_access_analyzer::analyze_control_block(const logic::control_block& control_block) {
+                for (const auto& statement : control_block.statements()) {
+                    m_statement_analyzer(*statement);
+                }
+            }
+
+            std::vector<const struct_access_analyzer::struct_info*> struct_access_analyzer::structs() const {
+                std::vector<const struct_info*> result;
+                result.reserve(m_order.size());
+                for (const auto* type : m_order) {
+                    result.push_back(&m_structs.at(type));
+                }
+                return result;
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::increment_operator& node) {
+                if (auto destination = std::get_if<std::unique_ptr<logic::expression>>(&node.destination())) {
+                    m_analyzer.analyze_expression(**destination);
+                }
+                if (node.increment_amount().has_value()) {
+                    m_analyzer.analyze_expression(*node.increment_amount().value());
+                }
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::arithmetic_operator& node) {
+                m_analyzer.analyze_expression(*node.left());
+                m_analyzer.analyze_expression(*node.right());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::unary_operation& node) {
+                m_analyzer.analyze_expression(*node.operand());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::type_cast& node) {
+                // reinterpreting a struct pointer as another pointer type reads the struct's bytes by position
+                auto target_pointer = std::dynamic_pointer_cast<typing::pointer_type>(node.get_type().type());
+                auto source_pointer = std::dynamic_pointer_cast<typing::pointer_type>(node.operand()->get_type().type());
+                if (target_pointer && source_pointer && target_pointer->pointee_type().type() != source_pointer->pointee_type().type()) {
+                    m_analyzer.expose(target_pointer->pointee_type(), "cast to another pointer type", false);
+                    m_analyzer.expose(source_pointer->pointee_type(), "cast to another pointer type", false);
+                }
+                m_analyzer.analyze_expression(*node.operand());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::address_of& node) {
+                std::visit(overloaded{
+                    [&](const std::shared_ptr<logic::variable>&) { },
+                    [&](const std::unique_ptr<logic::array_index>& array_index) {
+                        m_analyzer.analyze_expression(*array_index);
+                    },
+                    [&](const std::unique_ptr<logic::member_access>& member_access) {
+                        // a field pointer can reach its neighbours with pointer arithmetic
+                        auto struct_type = m_analyzer.accessed_struct(*member_access);
+                        if (struct_type) {
+                            m_analyzer.expose(typing::qual_type(struct_type), "address of a field is taken", false);
+                        }
+                        m_analyzer.analyze_expression(*member_access);
+                    }
+                }, node.operand());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::dereference& node) {
+                m_analyzer.analyze_address(*node.operand());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::member_access& node) {
+                auto struct_type = m_analyzer.accessed_struct(node);
+                if (struct_type) {
+                    auto& struct_info = m_analyzer.info(struct_type);
+                    const auto& fields = struct_type->fields();
+                    auto field = std::find_if(fields.begin(), fields.end(), [&](const typing::member& member) {
+                        return member.name == node.member().name;
+                    });
+                    if (field != fields.end()) {
+                        size_t weight = 1;
+                        for (size_t depth = 0; depth < std::min(m_analyzer.m_loop_depth, max_loop_depth); depth++) {
+                            weight *= loop_weight;
+                        }
+                        struct_info.field_heat[field - fields.begin()] += weight;
+                    }
+                }
+                m_analyzer.analyze_expression(*node.base());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::array_index& node) {
+                m_analyzer.analyze_expression(*node.base());
+                m_analyzer.analyze_expression(*node.index());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::array_initializer& node) {
+                for (const auto& initializer : node.initializers()) {
+                    m_analyzer.analyze_expression(*initializer);
+                }
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::allocate_array& node) {
+                for (const auto& dimension : node.dimensions()) {
+                    m_analyzer.analyze_expression(*dimension);
+                }
+                if (node.fill_value() != nullptr) {
+                    m_analyzer.analyze_expression(*node.fill_value());
+                }
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::struct_initializer& node) {
+                m_analyzer.info(node.struct_type());
+                for (const auto& initializer : node.initializers()) {
+                    m_analyzer.analyze_expression(*initializer.initializer);
+                }
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::union_initializer& node) {
+                m_analyzer.expose(node.target_member().member_type, "member of a union", false);
+                m_analyzer.analyze_expression(*node.initializer());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::function_call& node) {
+                if (auto callee = std::get_if<std::unique_ptr<logic::expression>>(&node.callee())) {
+                    m_analyzer.analyze_expression(**callee);
+                }
+                for (const auto& argument : node.arguments()) {
+                    m_analyzer.analyze_expression(*argument);
+                }
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::conditional_expression& node) {
+                m_analyzer.analyze_expression(*node.condition());
+                m_analyzer.analyze_expression(*node.then_expression());
+                m_analyzer.analyze_expression(*node.else_expression());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::set_address& node) {
+                m_analyzer.analyze_address(*node.destination());
+                m_analyzer.analyze_expression(*node.value());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::set_variable& node) {
+                m_analyzer.analyze_expression(*node.value());
+            }
+
+            void struct_access_analyzer::expression_analyzer::dispatch(const logic::compound_expression& node) {
+                m_analyzer.analyze_control_block(*node.control_block());
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::expression_statement& node) {
+                if (node.expression() != nullptr) {
+                    m_analyzer.analyze_expression(*node.expression());
+                }
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::variable_declaration& node) {
+                if (node.variable()->use_static_storage()) {
+                    m_analyzer.expose(node.variable()->get_type(), "held in static storage", false);
+                }
+                if (node.initializer() != nullptr) {
+                    m_analyzer.analyze_expression(*node.initializer());
+                }
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::return_statement& node) {
+                if (node.value() != nullptr) {
+                    m_analyzer.analyze_expression(*node.value());
+                }
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::if_statement& node) {
+                m_analyzer.analyze_expression(*node.condition());
+                m_analyzer.analyze_control_block(*node.then_body());
+                if (node.else_body() != nullptr) {
+                    m_analyzer.analyze_control_block(*node.else_body());
+                }
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::loop_statement& node) {
+                m_analyzer.m_loop_depth++;
+                m_analyzer.analyze_control_block(*node.body());
+                if (node.condition() != nullptr) {
+                    m_analyzer.analyze_expression(*node.condition());
+                }
+                m_analyzer.m_loop_depth--;
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::switch_statement& node) {
+                m_analyzer.analyze_expression(*node.condition());
+                for (const auto& switch_case : node.cases()) {
+                    m_analyzer.analyze_control_block(*switch_case.body);
+                }
+            }
+
+            void struct_access_analyzer::statement_analyzer::dispatch(const logic::statement_block& node) {
+                m_analyzer.analyze_control_block(*node.control_block());
+            }
+        }
+
+        namespace optimization {
+            std::unique_ptr<logic::expression> struct_layout_pass::expression_pass::dispatch(std::unique_ptr<logic::member_access>&& node) {
+                auto type = node->base()->get_type().type();
+                if (node->is_dereference()) {
+                    auto pointer_type = std::dynamic_pointer_cast<typing::pointer_type>(type);
+                    if (!pointer_type) {
+                        return node;
+                    }
+                    type = pointer_type->pointee_type().type();
+                }
+                auto struct_type = std::dynamic_pointer_cast<typing::struct_type>(type);
+                if (!struct_type) {
+                    return node;
+                }
+
+                const auto& fields = struct_type->fields();
+                auto field = std::find_if(fields.begin(), fields.end(), [&](const typing::member& member) {
+                    return member.name == node->member().name;
+                });
+                if (field == fields.end() || field->offset == node->member().offset) {
+                    return node;
+                }
+
+                mark_ir_mutated();
+                bool is_dereference = node->is_dereference();
+                return std::make_unique<logic::member_access>(node->release_base(), *field, is_dereference);
+            }
+
+            void struct_layout_pass::transform(logic::translation_unit& unit) {
+                m_report.clear();
+                if (m_platform_info.optimize_struct_layout) {
+                    analysis::struct_access_analyzer analyzer(unit);
+
+                    // set the heat of every struct before any layout is recomputed, nested structs are laid out together
+                    for (const auto* info : analyzer.structs()) {
+                        if (info->exposure.empty()) {
+                            info->type->implement_field_heat(std::vector<size_t>(info->field_heat));
+                        }
+                    }
+
+                    type_layout_calculator calculator(m_platform_info);
+                    for (const auto* info : analyzer.structs()) {
+                        if (!info->type->is_implemented()) {
+                            continue;
+                        }
+                        calculator(*info->type);
+
+                        struct_report report{
+                            .name = info->type->name().value_or("<anonymous>"),
+                            .fields = {},
+                            .exposure = info->exposure
+                        };
+                        for (size_t i = 0; i < info->type->fields().size(); i++) {
+                            const auto& field = info->type->fields()[i];
+                            report.fields.push_back(field_report{ .name = field.name, .offset = field.offset, .heat = info->field_heat[i] });
+                        }
+                        std::stable_sort(report.fields.begin(), report.fields.end(), [](const field_report& a, const field_report& b) {
+                            return a.offset < b.offset;
+                        });
+                        m_report.push_back(std::move(report));
+                    }
+                }
+
+                default_pass::transform(unit);
+            }
+
+            void struct_layout_pass::print_report(std::ostream& out) const {
+                for (const auto& report : m_report) {
+                    out << "struct " << report.name;
+                    if (report.exposure.empty()) {
+                        out << " (ordered by access count):";
+                    }
+                    else {
+                        out << " (layout fixed, " << report.exposure << "):";
+                    }
+                    out << '\n';
+                    for (const auto& field : report.fields) {
+                        out << std::format("    {:>4}  {} (heat {})\n", field.offset, field.name, field.heat);
+                    }
+                }
+            }
+
+            std::string struct_layout_pass::layout_signature() const {
+                std::ostringstream signature;
+                for (const auto& report : m_report) {
+                    signature << report.name << '{';
+                    for (const auto& field : report.fields) {
+                        signature << field.name << '@' << field.offset << ';';
+                    }
+                    signature << '}';
+                }
+                return signature.str();
+            }
+        }
+    }
+}
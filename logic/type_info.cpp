@@ -106,6 +106,30 @@ namespace michaelcc {
             return m_declared_info.at(&type);
         }
 
+        // places the fields in the given order, returning their offsets and the padded struct layout
+        auto place_fields = [this, &type](const std::vector<size_t>& order) {
+            size_t offset = 0;
+            size_t max_alignment = 1;
+
+            std::vector<size_t> field_offsets(type.fields().size());
+            for (const auto& index : order) {
+                const auto& field = type.fields().at(index);
+                const type_layout_info field_layout = (*this)(*field.member_type.type());
+
+                // Pad to field alignment
+                size_t padding = (field_layout.alignment - (offset % field_layout.alignment)) % field_layout.alignment;
+                offset += padding;
+                field_offsets[index] = offset;
+                offset += field_layout.size;
+                
+                max_alignment = std::max(max_alignment, field_layout.alignment);
+            }
+
+            // Pad final size to struct alignment
+            size_t final_padding = (max_alignment - (offset % max_alignment)) % max_alignment;
+            return std::make_pair(std::move(field_offsets), type_layout_info{ .size = offset + final_padding, .alignment = max_alignment });
+        };
+
         std::vector<size_t> original_indices(type.fields().size());
         std::iota(original_indices.begin(), original_indices.end(), 0);
         if (m_platform_info.optimize_struct_layout) {
@@ -116,33 +140,32 @@ namespace michaelcc {
                 return a_layout.alignment > b_layout.alignment;
             });
         }
-        
-        size_t size = 0;
-        size_t alignment = 1;
-        size_t offset = 0;
-        size_t max_alignment = 1;
 
-        std::vector<size_t> field_offsets(type.fields().size());
-        for (const auto& index : original_indices) {
-            const auto& field = type.fields().at(index);
-            const type_layout_info field_layout = (*this)(*field.member_type.type());
-
-            // Pad to field alignment
-            size_t padding = (field_layout.alignment - (offset % field_layout.alignment)) % field_layout.alignment;
-            offset += padding;
-            field_offsets[index] = offset;
-            offset += field_layout.size;
-            
-            max_alignment = std::max(max_alignment, field_layout.alignment);
-        }
+        auto [field_offsets, layout] = place_fields(original_indices);
+
+        if (m_platform_info.optimize_struct_layout && type.field_heat().size() == type.fields().size()) {
+            // hot fields first, so they get the smallest offsets. sizeof may already have been folded, so the
+            // hot-first order is only taken when it adds no padding, otherwise hotness only orders fields of the
+            // same alignment.
+            const auto& heat = type.field_heat();
+            std::vector<size_t> hot_first = original_indices;
+            std::stable_sort(hot_first.begin(), hot_first.end(), [&heat](size_t a, size_t b) {
+                return heat[a] > heat[b];
+            });
 
-        // Pad final size to struct alignment
-        size_t final_padding = (max_alignment - (offset % max_alignment)) % max_alignment;
-        size = offset + final_padding;
-        alignment = max_alignment;
+            if (place_fields(hot_first).second.size > layout.size) {
+                hot_first = original_indices;
+                std::stable_sort(hot_first.begin(), hot_first.end(), [this, &type, &heat](size_t a, size_t b) {
+                    size_t a_alignment = (*this)(*type.fields().at(a).member_type.type()).alignment;
+                    size_t b_alignment = (*this)(*type.fields().at(b).member_type.type()).alignment;
+                    return a_alignment != b_alignment ? a_alignment > b_alignment : heat[a] > heat[b];
+                });
+            }
+            field_offsets = place_fields(hot_first).first;
+        }
 
         type.implement_field_offsets(field_offsets);
-        m_declared_info.insert({&type, type_layout_info{.size=size, .alignment=alignment }});
+        m_declared_info.insert({&type, layout});
         return m_declared_info.at(&type);
     }
 
@@ -7,21 +7,38 @@
 #include "logic/optimization/constant_folding.hpp"
 #include "logic/optimization/dead_code.hpp"
 #include "logic/optimization/ir_simplify.hpp"
+#include "logic/optimization/reassociate.hpp"
 #include "logic/optimization/inline_functions.hpp"
 #include "logic/optimization/pointer_propagation.hpp"
 #include "logic/optimization/const_propagation.hpp"	
+#include "logic/optimization/struct_layout.hpp"
+#include "logic/analysis/fingerprint.hpp"
 #include "linear/flatten.hpp"
 #include "linear/pass.hpp"
 #include "linear/allocators/remove_phi.hpp"
 #include "linear/optimization/dead_code.hpp"
 #include "linear/optimization/const_prop.hpp"
 #include "linear/optimization/copy_prop.hpp"
+#include "linear/optimization/known_bits.hpp"
+#include "linear/optimization/value_range.hpp"
+#include "linear/optimization/if_conversion.hpp"
+#include "linear/optimization/jump_threading.hpp"
 #include "linear/optimization/phi.hpp"
+#include "linear/serialize.hpp"
 #include "isa/isa.hpp"
 #include "isa/lc2200.hpp"
+#include "assembly/splice.hpp"
+#include "compile_cache.hpp"
+#include "bounded_queue.hpp"
+#include "precompiled_header.hpp"
+#include "server.hpp"
 #include "CLI11.hpp"
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -31,25 +48,40 @@ struct CompilerOptions {
 	std::string input_file;
 	std::string output_file;
 	std::string platform;
+	std::string linear_ir_file;
+	std::string cache_directory;
+	uintmax_t cache_max_size = 0;
+	bool print_cache_stats = false;
+	std::string create_pch_file;
+	std::string use_pch_file;
+	bool preprocess_thread = false;
+	bool pipeline = false;
+	bool print_struct_layouts = false;
 };
 
-std::unordered_map<std::string, std::unique_ptr<michaelcc::isa::isa>> make_platforms() {
-	std::unordered_map<std::string, std::unique_ptr<michaelcc::isa::isa>> map;
+// how many tokens a background preprocessor may run ahead of the parser
+constexpr size_t token_queue_capacity = 4096;
+
+// how many lowered functions may wait for the backend when compiling one function at a time
+constexpr size_t function_queue_capacity = 2;
+
+using platform_map = std::unordered_map<std::string, std::unique_ptr<michaelcc::isa::isa>>;
+
+void print_cache_stats(const michaelcc::compile_cache& cache, std::ostream& diagnostics) {
+	auto stats = cache.stats();
+	diagnostics << "Cache: " << stats.hits << " hits, " << stats.misses << " misses (" 
+		<< static_cast<int>(stats.hit_rate() * 100) << "% hit rate), " 
+		<< stats.entry_count << " entries, " << stats.size_bytes << " bytes; functions: " 
+		<< stats.function_hits << " reused, " << stats.function_misses << " compiled" << endl;
+}
+
+platform_map make_platforms() {
+	platform_map map;
 	map.emplace("lc2200", std::make_unique<michaelcc::isa::lc2200::lc2200_isa>());
 	return map;
 }
 
-int main(int argc, char* argv[])
-{
-	std::unordered_map<std::string, std::unique_ptr<michaelcc::isa::isa>> platforms = make_platforms();
-	std::vector<std::string> platform_names;
-	for (const auto& [name, _] : platforms)
-		platform_names.push_back(name);
-	
-	CLI::App app("The Michael C Compiler, a basic optimizing C compiler.", "michaelcc");
-	argv = app.ensure_utf8(argv);
-
-	CompilerOptions options;
+void add_options(CLI::App& app, CompilerOptions& options, const std::vector<std::string>& platform_names) {
 	app.add_option("-i, --input", options.input_file, "The input file to compile")
 		->check(CLI::ExistingFile)
 		->required();
@@ -58,65 +90,322 @@ int main(int argc, char* argv[])
 	app.add_option("-p, --platform", options.platform, "The platform to compile for")
 		->check(CLI::IsMember(platform_names))
 		->required();
+	app.add_option("--emit-linear-ir", options.linear_ir_file, "Also write the optimized linear IR, in binary form, to this file");
+	app.add_option("--cache-dir", options.cache_directory, "Reuse outputs of earlier compilations of the same preprocessed source from this directory");
+	app.add_option("--cache-max-size", options.cache_max_size, "Evict least recently used cache entries beyond this many bytes (0 for no limit)");
+	app.add_flag("--cache-stats", options.print_cache_stats, "Print cache hit rate and size after compiling");
+	auto create_pch = app.add_option("--create-pch", options.create_pch_file, "Precompile the #include directives the input file starts with into this file");
+	app.add_option("--use-pch", options.use_pch_file, "Load the input file's leading includes from this precompiled header when it is up to date")
+		->excludes(create_pch);
+	app.add_flag("--preprocess-thread", options.preprocess_thread, "Preprocess on a separate thread, overlapping it with parsing");
+	app.add_flag("--pipeline", options.pipeline, "Lower, allocate and assemble one function at a time on two threads, bounding peak memory")
+		->excludes("--emit-linear-ir")
+		->excludes("--cache-dir");
+	app.add_flag("--struct-layout-report", options.print_struct_layouts, "Print the layout chosen for every struct and how often each field is accessed");
+	app.footer("Start a compile server with \"michaelcc --serve <socket>\", then prefix the usual arguments with \"--connect <socket>\" to compile through it.");
+}
 
-	CLI11_PARSE(app, argc, argv);
+// the server does not share the client's working directory, so paths are forwarded in absolute form
+std::vector<std::string> to_arguments(const CompilerOptions& options) {
+	std::vector<std::string> arguments = {
+		"-i", std::filesystem::absolute(options.input_file).string(),
+		"-o", std::filesystem::absolute(options.output_file).string(),
+		"-p", options.platform
+	};
+	if (!options.linear_ir_file.empty()) {
+		arguments.insert(arguments.end(), { "--emit-linear-ir", std::filesystem::absolute(options.linear_ir_file).string() });
+	}
+	if (!options.cache_directory.empty()) {
+		arguments.insert(arguments.end(), { "--cache-dir", std::filesystem::absolute(options.cache_directory).string() });
+	}
+	if (options.cache_max_size > 0) {
+		arguments.insert(arguments.end(), { "--cache-max-size", std::to_string(options.cache_max_size) });
+	}
+	if (options.print_cache_stats) {
+		arguments.push_back("--cache-stats");
+	}
+	if (!options.create_pch_file.empty()) {
+		arguments.insert(arguments.end(), { "--create-pch", std::filesystem::absolute(options.create_pch_file).string() });
+	}
+	if (!options.use_pch_file.empty()) {
+		arguments.insert(arguments.end(), { "--use-pch", std::filesystem::absolute(options.use_pch_file).string() });
+	}
+	if (options.preprocess_thread) {
+		arguments.push_back("--preprocess-thread");
+	}
+	if (options.pipeline) {
+		arguments.push_back("--pipeline");
+	}
+	if (options.print_struct_layouts) {
+		arguments.push_back("--struct-layout-report");
+	}
+	return arguments;
+}
+
+std::vector<std::unique_ptr<michaelcc::linear::pass>> make_linear_passes() {
+	auto linear_passes = std::vector<std::unique_ptr<michaelcc::linear::pass>>();
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::dead_instruction_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::dead_block_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::const_prop_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::known_bits_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::value_range_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::jump_threading_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::copy_prop_pass>());
+	linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::if_conversion_pass>());
+	return linear_passes;
+}
+
+// the backend for one function at a time. a lowering thread turns each function into a linear unit of its own and
+// drops its logical body, while the calling thread optimizes, allocates and assembles the units in order and drops
+// them in turn, so only a few functions are in linear form at once. the static data is assembled last.
+void assemble_pipelined(michaelcc::logic::translation_unit& logic_translation_unit, michaelcc::isa::isa& platform, std::ostream& output) {
+	michaelcc::logic_lowerer linear_lowerer(platform);
+	linear_lowerer.begin(logic_translation_unit);
+
+	michaelcc::bounded_queue<michaelcc::linear::translation_unit> lowered(function_queue_capacity);
+	std::thread lowering([&]() {
+		try {
+			for (const auto& sym : logic_translation_unit.global_context()->symbols()) {
+				auto function = std::dynamic_pointer_cast<michaelcc::logic::function_definition>(sym);
+				if (!function) {
+					continue;
+				}
+				auto unit = linear_lowerer.lower_function_unit(*function);
+				// calls only refer to the function's signature, its body is done with
+				function->release_statements();
+				if (!lowered.push(std::move(unit))) {
+					return;
+				}
+			}
+			lowered.close();
+		}
+		catch (...) {
+			lowered.fail(std::current_exception());
+		}
+	});
+
+	auto assembler = platform.create_assembler(output);
+	try {
+		auto linear_passes = make_linear_passes();
+		size_t next_block_id = 1;
+		while (auto unit = lowered.pop()) {
+			unit->next_block_id = next_block_id;
+			michaelcc::linear::analysis_manager linear_analyses(*unit);
+			michaelcc::linear::transform(*unit, linear_passes, linear_analyses);
 
+			michaelcc::linear::allocators::frame_allocator frame_allocator(*unit);
+			frame_allocator.allocate();
+
+			michaelcc::linear::transform(*unit, linear_passes, linear_analyses);
+			michaelcc::linear::allocators::remove_phi_nodes(*unit);
+			michaelcc::linear::optimization::postphi::register_allocation(*unit, frame_allocator);
+
+			assembler->assemble_functions(*unit, frame_allocator);
+			next_block_id = unit->next_block_id;
+		}
+	}
+	catch (...) {
+		// the lowering thread may be blocked on a full queue
+		lowered.cancel();
+		lowering.join();
+		throw;
+	}
+	lowering.join();
+
+	assembler->assemble_static_data(linear_lowerer.get_translation_unit());
+}
+
+// warm_headers is set by the compile server, it stands in for --use-pch on requests that pass neither pch option
+int compile(const CompilerOptions& options, const platform_map& platforms, std::ostream& diagnostics, michaelcc::precompiled_header_cache* warm_headers = nullptr)
+{
 	ifstream infile = std::ifstream(options.input_file);
 	
 	if (!infile.is_open()) {
-		cerr << "Failed to open file!" << endl;
+		diagnostics << "Failed to open file!" << endl;
 		return 1;
 	}
 
-	std::stringstream ss;
-	ss << infile.rdbuf();
+	std::string source((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
 
 	try {
-		// preprocess the input file
-		michaelcc::preprocessor preprocessor(ss.str(), options.input_file);
-		preprocessor.preprocess();
-		vector<michaelcc::token> tokens = preprocessor.result();
+		michaelcc::isa::isa& platform = *platforms.at(options.platform);
 
-		// parse the tokens into an AST
-		michaelcc::parser parser(std::move(tokens));
-		std::vector<std::unique_ptr<michaelcc::ast::ast_element>> ast = parser.parse_all();
+		// a precompiled header that is missing or out of date is ignored, the headers are then compiled as usual
+		std::optional<michaelcc::precompiled_header> pch;
+		if (!options.use_pch_file.empty() && std::filesystem::exists(options.use_pch_file)) {
+			pch.emplace(michaelcc::precompiled_header::load(options.use_pch_file));
+			if (!pch->matches(michaelcc::preprocessor::leading_includes(source, options.input_file), options.platform)) {
+				pch.reset();
+			}
+		}
 
-		michaelcc::isa::isa& platform = *platforms.at(options.platform);
-		// lower AST to logical IR
-		michaelcc::semantic_lowerer lowerer(platform.get_platform_info());
+		// the leading includes are precompiled in memory the first time the server sees them
+		bool warm_up = false;
+		if (warm_headers != nullptr && options.use_pch_file.empty() && options.create_pch_file.empty()) {
+			auto leading_includes = michaelcc::preprocessor::leading_includes(source, options.input_file);
+			if (!leading_includes.empty()) {
+				if (auto warm = warm_headers->find(leading_includes, options.platform)) {
+					pch.emplace(std::move(warm.value()));
+				}
+				else {
+					warm_up = true;
+				}
+			}
+		}
 
-		lowerer.lower(ast);
+		michaelcc::preprocessor preprocessor(std::move(source), options.input_file);
+		if (pch.has_value()) {
+			pch->apply(preprocessor);
+		}
+
+		// the cache key and a new precompiled header need the whole token stream up front. otherwise the parser
+		// pulls tokens as it goes, and the lowerer takes each declaration as soon as it is parsed.
+		std::optional<michaelcc::compile_cache> cache;
+		std::string cache_key;
+		std::optional<michaelcc::background_preprocessor> background;
+		std::optional<michaelcc::parser> parser;
+		if (!options.cache_directory.empty() || !options.create_pch_file.empty() || warm_up) {
+			preprocessor.preprocess();
+
+			if (!options.create_pch_file.empty()) {
+				michaelcc::precompiled_header::create(preprocessor, options.platform, platform.get_platform_info()).save(options.create_pch_file);
+			}
+			if (warm_up) {
+				try {
+					warm_headers->insert(michaelcc::precompiled_header::create(preprocessor, options.platform, platform.get_platform_info()));
+				}
+				catch (const michaelcc::compilation_error&) {
+					// headers defining functions or variables are not kept, this file still compiles as usual
+				}
+				catch (const std::runtime_error&) {
+					// nor are headers declaring something the precompiled format cannot hold
+				}
+			}
+
+			// look for an earlier compilation of the same token stream
+			if (!options.cache_directory.empty()) {
+				cache.emplace(options.cache_directory, options.cache_max_size);
+				// the skipped headers' tokens are not in the stream, the header's hash stands in for them
+				std::vector<std::string> key_options = { options.platform };
+				if (pch.has_value()) {
+					key_options.push_back(pch->content_hash());
+				}
+				cache_key = michaelcc::compile_cache::compute_key(preprocessor.result(), key_options);
+
+				std::vector<std::pair<michaelcc::compile_cache::artifact, std::filesystem::path>> artifacts;
+				artifacts.emplace_back(michaelcc::compile_cache::artifact::ASSEMBLY, options.output_file);
+				if (!options.linear_ir_file.empty()) {
+					artifacts.emplace_back(michaelcc::compile_cache::artifact::LINEAR_IR, options.linear_ir_file);
+				}
+
+				if (cache->fetch(cache_key, artifacts)) {
+					if (options.print_cache_stats) {
+						print_cache_stats(*cache, diagnostics);
+					}
+					return 0;
+				}
+			}
+
+			parser.emplace(preprocessor.release_result());
+		}
+		else if (options.preprocess_thread) {
+			background.emplace(preprocessor, token_queue_capacity);
+			parser.emplace(*background);
+		}
+		else {
+			parser.emplace(preprocessor);
+		}
+
+		if (pch.has_value()) {
+			pch->apply(*parser);
+		}
+
+		// parse and lower to logical IR, on top of the precompiled declarations if there are any
+		michaelcc::semantic_lowerer lowerer = pch.has_value()
+			? michaelcc::semantic_lowerer(platform.get_platform_info(), pch->release_declarations())
+			: michaelcc::semantic_lowerer(platform.get_platform_info());
+
+		lowerer.lower(*parser);
 		auto logic_translation_unit = lowerer.release_translation_unit();
 
+		// fingerprint functions before optimization so unchanged ones can reuse their cached assembly.
+		// reuse is off when the linear IR is requested, since it has to describe every function.
+		std::unordered_map<std::string, std::string> function_fingerprints;
+		if (cache.has_value() && options.linear_ir_file.empty()) {
+			michaelcc::logic::analysis::function_fingerprinter fingerprinter(logic_translation_unit);
+			function_fingerprints = fingerprinter.fingerprint_all();
+		}
+
 		auto passes = std::vector<std::unique_ptr<michaelcc::logic::optimization::pass>>();
 		passes.emplace_back(michaelcc::logic::optimization::make_constant_folding_pass(platform.get_platform_info()));
 		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::ir_simplify_pass>(platform.get_platform_info()));
+		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::reassociate_pass>(platform.get_platform_info()));
 		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::dead_code_pass>());
 		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::inline_functions_pass>());
 		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::pointer_propagation_pass>());
 		passes.emplace_back(std::make_unique<michaelcc::logic::optimization::const_propagation_pass>(platform.get_platform_info()));
 		michaelcc::logic::optimization::transform(logic_translation_unit, passes);
+
+		// order struct fields by how often they are accessed, once the code accessing them is final
+		michaelcc::logic::optimization::struct_layout_pass struct_layout(platform.get_platform_info());
+		struct_layout.transform(logic_translation_unit);
+		if (options.print_struct_layouts) {
+			struct_layout.print_report(diagnostics);
+		}
+
+		if (options.pipeline) {
+			auto file_out_stream = std::ofstream(options.output_file);
+			assemble_pipelined(logic_translation_unit, platform, file_out_stream);
+			return 0;
+		}
 		
 		// lower logical IR to linear SSA IR
 		michaelcc::logic_lowerer linear_lowerer(platform);
 		linear_lowerer.lower(logic_translation_unit);
 		auto linear_translation_unit = linear_lowerer.release_translation_unit();
 
+		// drop functions whose assembly can be reused, the backend then only sees the ones that changed
+		std::vector<std::string> function_order;
+		std::unordered_map<std::string, std::string> function_keys;
+		std::unordered_map<std::string, std::string> reused_functions;
+		for (size_t i = linear_translation_unit.function_definitions.size(); i-- > 0;) {
+			const std::string name = linear_translation_unit.function_definitions[i]->name();
+			function_order.insert(function_order.begin(), name);
+
+			auto fingerprint = function_fingerprints.find(name);
+			if (fingerprint == function_fingerprints.end()) {
+				continue;
+			}
+			// the layouts depend on every function's accesses, so a function is only reused under the same ones
+			auto key = michaelcc::compile_cache::compute_function_key(fingerprint->second, { options.platform, struct_layout.layout_signature() });
+			function_keys.insert({ name, key });
+
+			auto cached = cache->fetch_function(key);
+			if (!cached.has_value()) {
+				continue;
+			}
+			auto text = michaelcc::assembly::relocate(*cached, linear_translation_unit.static_sections.strings);
+			if (text.has_value()) {
+				reused_functions.insert({ name, std::move(*text) });
+				linear_translation_unit.remove_function(i);
+			}
+		}
+
 		// optimize the linear IR
-		auto linear_passes = std::vector<std::unique_ptr<michaelcc::linear::pass>>();
-		linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::dead_instruction_pass>());
-		linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::dead_block_pass>());
-		linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::const_prop_pass>());
-		linear_passes.emplace_back(std::make_unique<michaelcc::linear::optimization::copy_prop_pass>());
-		
-		michaelcc::linear::transform(linear_translation_unit, linear_passes);
+		auto linear_passes = make_linear_passes();
+
+		michaelcc::linear::analysis_manager linear_analyses(linear_translation_unit);
+		michaelcc::linear::transform(linear_translation_unit, linear_passes, linear_analyses);
 
+		if (!options.linear_ir_file.empty()) {
+			michaelcc::linear::serialization::save(linear_translation_unit, options.linear_ir_file);
+		}
 
 		// allocate stack frame (remove alloca)
 		michaelcc::linear::allocators::frame_allocator frame_allocator(linear_translation_unit);
 		frame_allocator.allocate();
 
-		michaelcc::linear::transform(linear_translation_unit, linear_passes);
+		michaelcc::linear::transform(linear_translation_unit, linear_passes, linear_analyses);
 
 		// remove phi nodes (no optimization passes can be run after this)
 		michaelcc::linear::allocators::remove_phi_nodes(linear_translation_unit);
@@ -124,23 +413,122 @@ int main(int argc, char* argv[])
 		// register allocation (one pass)
 		michaelcc::linear::optimization::postphi::register_allocation(linear_translation_unit, frame_allocator);
 
-		// assemble the linear IR to assembly
-		auto file_out_stream = std::ofstream(options.output_file);
-		auto assembler = platform.create_assembler(file_out_stream);
-		assembler->assemble(linear_translation_unit, frame_allocator);
+		// assemble the linear IR to assembly, splicing reused functions back in at their original position
+		{
+			std::ostringstream assembled;
+			auto assembler = platform.create_assembler(assembled);
+			assembler->assemble(linear_translation_unit, frame_allocator);
+			std::string text = assembled.str();
+
+			std::unordered_map<std::string, std::string> function_texts = std::move(reused_functions);
+			size_t functions_end = 0;
+			for (const auto& range : assembler->function_text_ranges()) {
+				size_t begin = static_cast<size_t>(range.begin);
+				size_t end = static_cast<size_t>(range.end);
+				std::string function_text = text.substr(begin, end - begin);
+
+				auto key = function_keys.find(range.name);
+				if (key != function_keys.end()) {
+					cache->store_function(key->second, michaelcc::assembly::make_relocatable(range.name, function_text, linear_translation_unit.static_sections.strings));
+				}
+				function_texts.insert({ range.name, std::move(function_text) });
+				functions_end = std::max(functions_end, end);
+			}
+
+			auto file_out_stream = std::ofstream(options.output_file);
+			file_out_stream << text.substr(0, assembler->function_text_ranges().empty() ? 0 : static_cast<size_t>(assembler->function_text_ranges().front().begin));
+			for (const auto& name : function_order) {
+				file_out_stream << function_texts.at(name);
+			}
+			file_out_stream << text.substr(functions_end);
+		}
+
+		if (cache.has_value()) {
+			cache->store(cache_key, michaelcc::compile_cache::artifact::ASSEMBLY, options.output_file);
+			if (!options.linear_ir_file.empty()) {
+				cache->store(cache_key, michaelcc::compile_cache::artifact::LINEAR_IR, options.linear_ir_file);
+			}
+			cache->evict();
+
+			if (options.print_cache_stats) {
+				print_cache_stats(*cache, diagnostics);
+			}
+		}
 	}
 	catch (const michaelcc::compilation_error& error) {
-		cerr << "Compilation error: " << error.what() << endl;
+		diagnostics << "Compilation error: " << error.what() << endl;
 		return 2;
 	}
 	catch (const std::exception& e) {
-		cerr << "Exception: " << e.what() << endl;
+		diagnostics << "Exception: " << e.what() << endl;
 		return 3;
 	}
 	catch (...) {
-		cerr << "Unknown exception caught!" << endl;
+		diagnostics << "Unknown exception caught!" << endl;
 		return 4;
 	}
 	
 	return 0;
 }
+
+int main(int argc, char* argv[])
+{
+	const platform_map platforms = make_platforms();
+	std::vector<std::string> platform_names;
+	for (const auto& [name, _] : platforms)
+		platform_names.push_back(name);
+
+	// server mode keeps the platforms alive and compiles requests from clients, each on its own thread
+	if (argc == 3 && std::string(argv[1]) == "--serve") {
+		michaelcc::precompiled_header_cache warm_headers;
+		try {
+			michaelcc::server::serve(argv[2], [&](const std::vector<std::string>& arguments, std::ostream& diagnostics) {
+				CLI::App app("The Michael C Compiler, a basic optimizing C compiler.", "michaelcc");
+				CompilerOptions options;
+				add_options(app, options, platform_names);
+				try {
+					// CLI11 consumes argument vectors from the back
+					app.parse(std::vector<std::string>(arguments.rbegin(), arguments.rend()));
+				}
+				catch (const CLI::ParseError& error) {
+					return app.exit(error, diagnostics, diagnostics);
+				}
+				return compile(options, platforms, diagnostics, &warm_headers);
+			});
+		}
+		catch (const std::exception& e) {
+			cerr << "Exception: " << e.what() << endl;
+			return 3;
+		}
+		return 0;
+	}
+
+	bool connect = argc >= 3 && std::string(argv[1]) == "--connect";
+	std::string socket_path = connect ? argv[2] : "";
+	if (connect) {
+		// drop "--connect <socket>" and parse the rest as a normal command line
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+
+	CLI::App app("The Michael C Compiler, a basic optimizing C compiler.", "michaelcc");
+	argv = app.ensure_utf8(argv);
+
+	CompilerOptions options;
+	add_options(app, options, platform_names);
+
+	CLI11_PARSE(app, argc, argv);
+
+	if (connect) {
+		try {
+			return michaelcc::server::forward(socket_path, to_arguments(options), cerr);
+		}
+		catch (const std::exception& e) {
+			cerr << "Exception: " << e.what() << endl;
+			return 3;
+		}
+	}
+
+	return compile(options, platforms, cerr);
+}
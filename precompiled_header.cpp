@@ -0,0 +1,742 @@
+#include "precompiled_header.hpp"
+#include "hashing.hpp"
+#include "serialization.hpp"
+#include "logic/semantic.hpp"
+#include "logic/typing.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+using namespace michaelcc;
+
+namespace {
+    constexpr char magic[4] = { 'M', 'C', 'P', 'H' };
+
+    enum type_tag : uint8_t {
+        TYPE_VOID,
+        TYPE_INT,
+        TYPE_FLOAT,
+        TYPE_POINTER,
+        TYPE_ARRAY,
+        TYPE_FUNCTION_POINTER,
+        TYPE_ENUM,
+        TYPE_STRUCT,
+        TYPE_UNION,
+        // named enums, structs and unions are stored once in the unit's tables and referred to by name
+        TYPE_NAMED_ENUM,
+        TYPE_NAMED_STRUCT,
+        TYPE_NAMED_UNION,
+    };
+
+    enum symbol_kind : uint8_t {
+        SYMBOL_ENUMERATOR,
+        SYMBOL_FUNCTION,
+    };
+
+    std::optional<std::string> hash_file(const std::filesystem::path& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            return std::nullopt;
+        }
+        std::stringstream contents;
+        contents << input.rdbuf();
+
+        content_hasher hasher;
+        hasher.string(contents.str());
+        return hasher.hex();
+    }
+
+    // includes written relative to different directories have to compare equal
+    std::filesystem::path normalize(const std::filesystem::path& path) {
+        return std::filesystem::weakly_canonical(std::filesystem::absolute(path));
+    }
+
+    bool is_declaration(const ast::ast_element& element) {
+        return dynamic_cast<const ast::struct_declaration*>(&element) != nullptr
+            || dynamic_cast<const ast::union_declaration*>(&element) != nullptr
+            || dynamic_cast<const ast::enum_declaration*>(&element) != nullptr
+            || dynamic_cast<const ast::typedef_declaration*>(&element) != nullptr
+            || dynamic_cast<const ast::function_prototype*>(&element) != nullptr;
+    }
+
+    // the unit's tables are unordered, names are sorted so equal headers serialize to equal bytes
+    template<typename T>
+    std::vector<std::shared_ptr<T>> sorted_by_name(const std::unordered_map<std::string, std::shared_ptr<T>>& table) {
+        std::vector<std::shared_ptr<T>> result;
+        result.reserve(table.size());
+        for (const auto& [name, type] : table) {
+            result.push_back(type);
+        }
+        std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) { return a->name().value() < b->name().value(); });
+        return result;
+    }
+
+    class writer : public serialization::byte_writer {
+    public:
+        void location(const source_location& value) {
+            varint(value.row());
+            varint(value.col());
+            string(value.filename().string());
+        }
+
+        void tokens(const std::vector<token>& values) {
+            varint(values.size());
+            for (const auto& tok : values) {
+                varint(tok.type());
+                varint(tok.column());
+                switch (tok.type()) {
+                    case MICHAELCC_TOKEN_FLOAT32_LITERAL: {
+                        float value = tok.float32();
+                        raw(&value, sizeof(value));
+                        break;
+                    }
+                    case MICHAELCC_TOKEN_FLOAT64_LITERAL: {
+                        double value = tok.float64();
+                        raw(&value, sizeof(value));
+                        break;
+                    }
+                    case MICHAELCC_TOKEN_LINE_DIRECTIVE:
+                        location(tok.location());
+                        break;
+                    case MICHAELCC_TOKEN_INTEGER_LITERAL:
+                    case MICHAELCC_TOKEN_CHAR_LITERAL:
+                        varint(tok.integer());
+                        break;
+                    case MICHAELCC_TOKEN_IDENTIFIER:
+                    case MICHAELCC_TOKEN_STRING_LITERAL:
+                    case MICHAELCC_PREPROCESSOR_STRINGIFY_IDENTIFIER:
+                        string(tok.string());
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    };
+
+    class reader : public serialization::byte_reader {
+    public:
+        reader(std::span<const uint8_t> data) : byte_reader(data, "precompiled header") {}
+
+        source_location location() {
+            size_t row = varint();
+            size_t col = varint();
+            return source_location(row, col, string());
+        }
+
+        std::vector<token> tokens() {
+            std::vector<token> result;
+            size_t count = this->count();
+            result.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                uint64_t type = varint();
+                if (type > MICHAELCC_TOKEN_END) {
+                    malformed("invalid token type");
+                }
+                auto token_type = static_cast<michaelcc::token_type>(type);
+                size_t column = varint();
+
+                switch (token_type) {
+                    case MICHAELCC_TOKEN_FLOAT32_LITERAL: {
+                        float value;
+                        std::memcpy(&value, raw(sizeof(value)), sizeof(value));
+                        result.emplace_back(value, column);
+                        break;
+                    }
+                    case MICHAELCC_TOKEN_FLOAT64_LITERAL: {
+                        double value;
+                        std::memcpy(&value, raw(sizeof(value)), sizeof(value));
+                        result.emplace_back(value, column);
+                        break;
+                    }
+                    case MICHAELCC_TOKEN_LINE_DIRECTIVE:
+                        result.emplace_back(location());
+                        break;
+                    case MICHAELCC_TOKEN_INTEGER_LITERAL:
+                    case MICHAELCC_TOKEN_CHAR_LITERAL:
+                        result.emplace_back(token_type, static_cast<size_t>(varint()), column);
+                        break;
+                    case MICHAELCC_TOKEN_IDENTIFIER:
+                    case MICHAELCC_TOKEN_STRING_LITERAL:
+                    case MICHAELCC_PREPROCESSOR_STRINGIFY_IDENTIFIER:
+                        result.emplace_back(token_type, string(), column);
+                        break;
+                    default:
+                        result.emplace_back(token_type, column);
+                        break;
+                }
+            }
+            return result;
+        }
+    };
+
+    class type_writer final : public typing::const_type_dispatcher<void> {
+    private:
+        writer& m_writer;
+
+        void members(const std::vector<typing::member>& values) {
+            m_writer.varint(values.size());
+            for (const auto& member : values) {
+                m_writer.string(member.name);
+                write(member.member_type);
+                m_writer.varint(member.offset);
+            }
+        }
+
+        void enumerators(const std::vector<typing::enum_type::enumerator>& values) {
+            m_writer.varint(values.size());
+            for (const auto& enumerator : values) {
+                m_writer.string(enumerator.name);
+                m_writer.svarint(enumerator.value);
+            }
+        }
+
+    public:
+        type_writer(writer& writer) : m_writer(writer) {}
+
+        void write(const typing::qual_type& type) {
+            auto base = type.type();
+            if (!base) {
+                throw std::runtime_error("Cannot precompile an expired type reference");
+            }
+            m_writer.byte(type.qualifiers());
+            m_writer.boolean(type.is_weak());
+            (*this)(*base);
+        }
+
+        void write_enum_body(const typing::enum_type& type) { enumerators(type.enumerators()); }
+        void write_struct_body(const typing::struct_type& type) { members(type.fields()); }
+        void write_union_body(const typing::union_type& type) { members(type.members()); }
+
+    protected:
+        void dispatch(const typing::void_type& type) override {
+            m_writer.byte(TYPE_VOID);
+        }
+
+        void dispatch(const typing::int_type& type) override {
+            m_writer.byte(TYPE_INT);
+            m_writer.byte(type.int_qualifiers());
+            m_writer.byte(static_cast<uint8_t>(type.type_class()));
+        }
+
+        void dispatch(const typing::float_type& type) override {
+            m_writer.byte(TYPE_FLOAT);
+            m_writer.byte(static_cast<uint8_t>(type.type_class()));
+        }
+
+        void dispatch(const typing::pointer_type& type) override {
+            m_writer.byte(TYPE_POINTER);
+            write(type.pointee_type());
+        }
+
+        void dispatch(const typing::array_type& type) override {
+            m_writer.byte(TYPE_ARRAY);
+            write(type.element_type());
+        }
+
+        void dispatch(const typing::function_pointer_type& type) override {
+            m_writer.byte(TYPE_FUNCTION_POINTER);
+            write(type.return_type());
+            m_writer.varint(type.parameter_types().size());
+            for (const auto& parameter_type : type.parameter_types()) {
+                write(parameter_type);
+            }
+        }
+
+        void dispatch(const typing::enum_type& type) override {
+            if (type.name().has_value()) {
+                m_writer.byte(TYPE_NAMED_ENUM);
+                m_writer.string(type.name().value());
+                return;
+            }
+            m_writer.byte(TYPE_ENUM);
+            enumerators(type.enumerators());
+        }
+
+        void dispatch(const typing::struct_type& type) override {
+            if (type.name().has_value()) {
+                m_writer.byte(TYPE_NAMED_STRUCT);
+                m_writer.string(type.name().value());
+                return;
+            }
+            m_writer.byte(TYPE_STRUCT);
+            members(type.fields());
+        }
+
+        void dispatch(const typing::union_type& type) override {
+            if (type.name().has_value()) {
+                m_writer.byte(TYPE_NAMED_UNION);
+                m_writer.string(type.name().value());
+                return;
+            }
+            m_writer.byte(TYPE_UNION);
+            members(type.members());
+        }
+    };
+
+    class type_reader {
+    private:
+        reader& m_reader;
+        logic::translation_unit& m_unit;
+
+        template<typename T>
+        std::shared_ptr<T> named(std::shared_ptr<T> type) {
+            if (!type) {
+                m_reader.malformed("reference to an undeclared type");
+            }
+            return type;
+        }
+
+    public:
+        type_reader(reader& reader, logic::translation_unit& unit) : m_reader(reader), m_unit(unit) {}
+
+        std::vector<typing::member> members() {
+            std::vector<typing::member> result;
+            size_t count = m_reader.count();
+            result.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                std::string name = m_reader.string();
+                typing::qual_type type = read();
+                size_t offset = m_reader.varint();
+                result.emplace_back(std::move(name), std::move(type), offset);
+            }
+            return result;
+        }
+
+        std::vector<typing::enum_type::enumerator> enumerators() {
+            std::vector<typing::enum_type::enumerator> result;
+            size_t count = m_reader.count();
+            result.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                std::string name = m_reader.string();
+                result.push_back(typing::enum_type::enumerator{ std::move(name), m_reader.svarint() });
+            }
+            return result;
+        }
+
+        typing::qual_type read() {
+            uint8_t qualifiers = m_reader.byte();
+            bool is_weak = m_reader.boolean();
+
+            std::shared_ptr<typing::base_type> type;
+            bool is_named = false;
+            switch (m_reader.byte()) {
+                case TYPE_VOID:
+                    type = std::make_shared<typing::void_type>();
+                    break;
+                case TYPE_INT: {
+                    uint8_t int_qualifiers = m_reader.byte();
+                    uint8_t type_class = m_reader.byte();
+                    if (type_class > typing::LONG_INT_CLASS) {
+                        m_reader.malformed("invalid int class");
+                    }
+                    type = std::make_shared<typing::int_type>(int_qualifiers, static_cast<typing::int_class>(type_class));
+                    break;
+                }
+                case TYPE_FLOAT: {
+                    uint8_t type_class = m_reader.byte();
+                    if (type_class > typing::DOUBLE_FLOAT_CLASS) {
+                        m_reader.malformed("invalid float class");
+                    }
+                    type = std::make_shared<typing::float_type>(static_cast<typing::float_class>(type_class));
+                    break;
+                }
+                case TYPE_POINTER:
+                    type = std::make_shared<typing::pointer_type>(read());
+                    break;
+                case TYPE_ARRAY:
+                    type = std::make_shared<typing::array_type>(read());
+                    break;
+                case TYPE_FUNCTION_POINTER: {
+                    typing::qual_type return_type = read();
+                    std::vector<typing::qual_type> parameter_types(m_reader.count());
+                    for (auto& parameter_type : parameter_types) {
+                        parameter_type = read();
+                    }
+                    type = std::make_shared<typing::function_pointer_type>(std::move(return_type), std::move(parameter_types));
+                    break;
+                }
+                case TYPE_ENUM:
+                    type = std::make_shared<typing::enum_type>(std::nullopt, enumerators());
+                    break;
+                case TYPE_STRUCT:
+                    type = std::make_shared<typing::struct_type>(std::nullopt, members());
+                    break;
+                case TYPE_UNION:
+                    type = std::make_shared<typing::union_type>(std::nullopt, members());
+                    break;
+                case TYPE_NAMED_ENUM:
+                    type = named(m_unit.lookup_enum(m_reader.string()));
+                    is_named = true;
+                    break;
+                case TYPE_NAMED_STRUCT:
+                    type = named(m_unit.lookup_struct(m_reader.string()));
+                    is_named = true;
+                    break;
+                case TYPE_NAMED_UNION:
+                    type = named(m_unit.lookup_union(m_reader.string()));
+                    is_named = true;
+                    break;
+                default:
+                    m_reader.malformed("unknown type tag");
+            }
+
+            // only the unit's tables keep a type alive, a weak reference to anything else would expire at once
+            if (is_weak && is_named) {
+                return typing::qual_type::weak(type, qualifiers);
+            }
+            return typing::qual_type::owning(type, qualifiers);
+        }
+    };
+
+    // named types come first, as bare names, so that bodies can refer to any of them regardless of order
+    void write_declarations(writer& out, const logic::translation_unit& unit) {
+        type_writer types(out);
+
+        auto enums = sorted_by_name(unit.enums());
+        out.varint(enums.size());
+        for (const auto& type : enums) {
+            out.string(type->name().value());
+            types.write_enum_body(*type);
+        }
+
+        auto structs = sorted_by_name(unit.structs());
+        out.varint(structs.size());
+        for (const auto& type : structs) {
+            out.string(type->name().value());
+        }
+
+        auto unions = sorted_by_name(unit.unions());
+        out.varint(unions.size());
+        for (const auto& type : unions) {
+            out.string(type->name().value());
+        }
+
+        for (const auto& type : structs) {
+            types.write_struct_body(*type);
+        }
+        for (const auto& type : unions) {
+            types.write_union_body(*type);
+        }
+
+        out.varint(unit.global_symbols().size());
+        for (const auto& symbol : unit.global_symbols()) {
+            if (auto enumerator = std::dynamic_pointer_cast<logic::enumerator_symbol>(symbol)) {
+                // enumerators of an anonymous enum carry the enum with them, it is in none of the unit's tables
+                out.byte(SYMBOL_ENUMERATOR);
+                const auto& enum_name = enumerator->enum_type()->name();
+                out.boolean(enum_name.has_value());
+                if (enum_name.has_value()) {
+                    out.string(enum_name.value());
+                }
+                else {
+                    types.write_enum_body(*enumerator->enum_type());
+                }
+                out.string(enumerator->name());
+                out.svarint(enumerator->enumerator().value);
+            }
+            else if (auto function = std::dynamic_pointer_cast<logic::function_definition>(symbol)) {
+                out.byte(SYMBOL_FUNCTION);
+                out.string(function->name());
+                types.write(function->return_type());
+                out.varint(function->parameters().size());
+                for (const auto& parameter : function->parameters()) {
+                    out.string(parameter->name());
+                    out.byte(parameter->qualifiers());
+                    types.write(parameter->get_type());
+                }
+                out.byte(function->qualifiers());
+                out.location(function->location());
+            }
+            else {
+                throw std::runtime_error("Cannot precompile " + symbol->to_string());
+            }
+        }
+    }
+
+    logic::translation_unit read_declarations(reader& in) {
+        logic::translation_unit unit;
+        type_reader types(in, unit);
+
+        size_t enum_count = in.count();
+        for (size_t i = 0; i < enum_count; i++) {
+            std::string name = in.string();
+            unit.declare_enum(std::make_shared<typing::enum_type>(std::move(name), types.enumerators()));
+        }
+
+        // structs and unions are declared with placeholder members first, like forward_declare_types does
+        auto read_names = [&]() {
+            std::vector<std::string> names(in.count());
+            for (auto& name : names) {
+                name = in.string();
+            }
+            return names;
+        };
+        std::vector<std::string> struct_names = read_names();
+        std::vector<std::string> union_names = read_names();
+        for (const auto& name : struct_names) {
+            unit.declare_struct(std::make_shared<typing::struct_type>(name, std::vector<typing::member>()));
+        }
+        for (const auto& name : union_names) {
+            unit.declare_union(std::make_shared<typing::union_type>(name, std::vector<typing::member>()));
+        }
+
+        // the placeholders are then replaced by complete types, references to them are resolved by name
+        for (const auto& name : struct_names) {
+            auto placeholder = unit.lookup_struct(name);
+            *placeholder = typing::struct_type(name, types.members());
+        }
+        for (const auto& name : union_names) {
+            auto placeholder = unit.lookup_union(name);
+            *placeholder = typing::union_type(name, types.members());
+        }
+
+        size_t symbol_count = in.count();
+        for (size_t i = 0; i < symbol_count; i++) {
+            switch (in.byte()) {
+                case SYMBOL_ENUMERATOR: {
+                    std::shared_ptr<typing::enum_type> enum_type;
+                    if (in.boolean()) {
+                        enum_type = unit.lookup_enum(in.string());
+                        if (!enum_type) {
+                            in.malformed("enumerator of an undeclared enum");
+                        }
+                    }
+                    else {
+                        enum_type = std::make_shared<typing::enum_type>(std::nullopt, types.enumerators());
+                    }
+                    std::string name = in.string();
+                    int64_t value = in.svarint();
+                    unit.declare_global(std::make_shared<logic::enumerator_symbol>(
+                        typing::enum_type::enumerator{ std::move(name), value },
+                        std::move(enum_type)
+                    ));
+                    break;
+                }
+                case SYMBOL_FUNCTION: {
+                    std::string name = in.string();
+                    typing::qual_type return_type = types.read();
+
+                    std::vector<std::shared_ptr<logic::variable>> parameters(in.count());
+                    for (auto& parameter : parameters) {
+                        std::string parameter_name = in.string();
+                        uint8_t qualifiers = in.byte();
+                        parameter = std::make_shared<logic::variable>(std::move(parameter_name), qualifiers, types.read(), false);
+                    }
+
+                    uint8_t qualifiers = in.byte();
+                    unit.declare_global(std::make_shared<logic::function_definition>(
+                        std::move(name),
+                        std::move(return_type),
+                        std::move(parameters),
+                        qualifiers,
+                        in.location()
+                    ));
+                    break;
+                }
+                default:
+                    in.malformed("unknown symbol kind");
+            }
+        }
+        return unit;
+    }
+}
+
+precompiled_header precompiled_header::create(const preprocessor& preprocessor, const std::string& platform, const platform_info& platform_info) {
+    const auto& prefix = preprocessor.prefix();
+
+    precompiled_header header;
+    header.m_platform = platform;
+    for (const auto& include : prefix.includes) {
+        header.m_includes.push_back(normalize(include));
+    }
+    for (const auto& file : prefix.files) {
+        auto hash = hash_file(file);
+        if (!hash.has_value()) {
+            throw std::runtime_error("Could not read " + file.string() + " to precompile it");
+        }
+        header.m_file_hashes.emplace_back(normalize(file), std::move(hash.value()));
+    }
+    header.m_definitions = preprocessor.prefix_definitions();
+
+    // the prefix is parsed and declared on its own, as if it were a file of its own
+    std::vector<token> tokens(preprocessor.result().begin(), preprocessor.result().begin() + prefix.token_count);
+    parser prefix_parser(std::move(tokens));
+    auto ast = prefix_parser.parse_all();
+    for (const auto& element : ast) {
+        if (!is_declaration(*element)) {
+            throw compilation_error("Only type declarations, typedefs and function prototypes can be precompiled.", element->location());
+        }
+    }
+    header.m_typedef_tokens = std::vector<token>(prefix_parser.typedef_tokens());
+
+    semantic_lowerer lowerer(platform_info);
+    lowerer.declare(ast);
+    header.m_declarations = lowerer.release_translation_unit();
+
+    auto bytes = header.serialize();
+    content_hasher hasher;
+    hasher.bytes(bytes.data(), bytes.size());
+    header.m_content_hash = hasher.hex();
+    return header;
+}
+
+std::vector<uint8_t> precompiled_header::serialize() const {
+    writer out;
+    out.string(m_platform);
+
+    out.varint(m_includes.size());
+    for (const auto& include : m_includes) {
+        out.string(include.string());
+    }
+
+    out.varint(m_file_hashes.size());
+    for (const auto& [file, hash] : m_file_hashes) {
+        out.string(file.string());
+        out.string(hash);
+    }
+
+    out.varint(m_definitions.size());
+    for (const auto& definition : m_definitions) {
+        out.string(definition.name());
+        out.varint(definition.params().size());
+        for (const auto& param : definition.params()) {
+            out.string(param);
+        }
+        out.tokens(definition.tokens());
+        out.optional(definition.declared_location(), [&](const source_location& location) { out.location(location); });
+    }
+
+    out.tokens(m_typedef_tokens);
+    write_declarations(out, m_declarations);
+    return out.finish(magic, format_version);
+}
+
+void precompiled_header::save(const std::filesystem::path& path) const {
+    auto bytes = serialize();
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("Could not open " + path.string() + " for writing");
+    }
+    output.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+precompiled_header precompiled_header::load(const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Could not open " + path.string());
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    return deserialize(bytes);
+}
+
+precompiled_header precompiled_header::deserialize(const std::vector<uint8_t>& bytes) {
+    reader in(bytes);
+    in.read_header(magic, format_version);
+
+    precompiled_header header;
+    header.m_platform = in.string();
+
+    size_t include_count = in.count();
+    for (size_t i = 0; i < include_count; i++) {
+        header.m_includes.emplace_back(in.string());
+    }
+
+    size_t file_count = in.count();
+    for (size_t i = 0; i < file_count; i++) {
+        std::filesystem::path file = in.string();
+        header.m_file_hashes.emplace_back(std::move(file), in.string());
+    }
+
+    size_t definition_count = in.count();
+    header.m_definitions.reserve(definition_count);
+    for (size_t i = 0; i < definition_count; i++) {
+        std::string name = in.string();
+        std::vector<std::string> params(in.count());
+        for (auto& param : params) {
+            param = in.string();
+        }
+        std::vector<token> tokens = in.tokens();
+        auto location = in.optional([&]() { return in.location(); });
+        header.m_definitions.emplace_back(std::move(name), std::move(params), std::move(tokens), std::move(location));
+    }
+
+    header.m_typedef_tokens = in.tokens();
+    header.m_declarations = read_declarations(in);
+    if (!in.at_end()) {
+        in.malformed("trailing data");
+    }
+
+    content_hasher hasher;
+    hasher.bytes(bytes.data(), bytes.size());
+    header.m_content_hash = hasher.hex();
+    return header;
+}
+
+bool precompiled_header::matches(const std::vector<std::filesystem::path>& leading_includes, const std::string& platform) const {
+    if (platform != m_platform || leading_includes.size() < m_includes.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < m_includes.size(); i++) {
+        if (normalize(leading_includes[i]) != m_includes[i]) {
+            return false;
+        }
+    }
+    for (const auto& [file, hash] : m_file_hashes) {
+        if (hash_file(file) != hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void precompiled_header::apply(preprocessor& preprocessor) const {
+    preprocessor.skip_leading_includes(m_includes.size(), m_definitions);
+}
+
+void precompiled_header::apply(parser& parser) const {
+    if (!m_typedef_tokens.empty()) {
+        parser.import_typedefs(m_typedef_tokens);
+    }
+}
+
+std::optional<precompiled_header> precompiled_header_cache::find(const std::vector<std::filesystem::path>& leading_includes, const std::string& platform) {
+    // matching hashes every header again, which is done without holding up other compilations
+    std::vector<entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entries = m_entries;
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> best;
+    size_t best_include_count = 0;
+    for (const auto& [header, bytes] : entries) {
+        if (header->m_includes.size() > best_include_count && header->matches(leading_includes, platform)) {
+            best = bytes;
+            best_include_count = header->m_includes.size();
+        }
+    }
+
+    // the declarations are handed over to the compilation, so every one gets a copy of its own
+    if (!best) {
+        return std::nullopt;
+    }
+    return precompiled_header::deserialize(*best);
+}
+
+void precompiled_header_cache::insert(precompiled_header header) {
+    auto bytes = std::make_shared<const std::vector<uint8_t>>(header.serialize());
+    auto shared = std::make_shared<const precompiled_header>(std::move(header));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_entries) {
+        if (entry.header->m_platform == shared->m_platform && entry.header->m_includes == shared->m_includes) {
+            entry = { std::move(shared), std::move(bytes) };
+            return;
+        }
+    }
+    m_entries.push_back({ std::move(shared), std::move(bytes) });
+}
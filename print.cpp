@@ -312,6 +312,7 @@ public:
                 !dynamic_cast<const do_block*>(stmt.get()) &&
                 !dynamic_cast<const if_block*>(stmt.get()) &&
                 !dynamic_cast<const if_else_block*>(stmt.get()) &&
+                !dynamic_cast<const switch_statement*>(stmt.get()) &&
                 !dynamic_cast<const context_block*>(stmt.get())) {
                 m_out << ";";
             }
@@ -374,6 +375,29 @@ public:
         print(node.false_body());
     }
 
+    void visit(const switch_statement& node) override {
+        if (!m_print_requested) return;
+        m_print_requested = false;
+        m_out << "switch (";
+        if (node.condition()) print(*node.condition());
+        m_out << ") {\n";
+        for (const auto& switch_case : node.cases()) {
+            print_indent(m_out, m_indent);
+            if (switch_case.value) {
+                m_out << "case ";
+                print(*switch_case.value);
+                m_out << ": ";
+            }
+            else {
+                m_out << "default: ";
+            }
+            print(switch_case.body);
+            m_out << "\n";
+        }
+        print_indent(m_out, m_indent);
+        m_out << '}';
+    }
+
     void visit(const return_statement& node) override {
         if (!m_print_requested) return;
         m_print_requested = false;
@@ -1053,6 +1077,29 @@ protected:
         m_out << '\n';
     }
 
+    void dispatch(const logic::switch_statement& node) override {
+        print_indent(m_out, m_indent);
+        m_out << "switch ";
+        m_expression_printer(*node.condition());
+        m_out << " {\n";
+        for (const auto& switch_case : node.cases()) {
+            print_indent(m_out, m_indent);
+            if (switch_case.value.has_value()) {
+                m_out << "case " << switch_case.value.value() << ":\n";
+            }
+            else {
+                m_out << "default:\n";
+            }
+            m_indent++;
+            for (const auto& statement : switch_case.body->statements()) {
+                (*this)(*statement);
+            }
+            m_indent--;
+        }
+        print_indent(m_out, m_indent);
+        m_out << "}\n";
+    }
+
     void dispatch(const logic::continue_statement& node) override {
         print_indent(m_out, m_indent);
         m_out << "continue";
@@ -1181,6 +1228,15 @@ public:
             m_out << dominated_block_id;
             first = false;
         }
+        m_out << "], df=[";
+        first = true;
+        for (const auto& frontier_block_id : node.dominance_frontier()) {
+            if (!first) {
+                m_out << ", ";
+            }
+            m_out << frontier_block_id;
+            first = false;
+        }
         m_out << "]):\n";
         m_indent++;
         for (const auto& instruction : node.instructions()) {
@@ -1303,6 +1359,23 @@ protected:
         subsequent_block_ids.push_back(node.if_false_block_id());
     }
 
+    void dispatch(const linear::jump_table& node) override {
+        print_indent(m_out, m_indent);
+        m_out << "jump_table(index=";
+        print_virtual_register(node.index(), true, true);
+        m_out << ", targets=[";
+        for (size_t i = 0; i < node.target_block_ids().size(); i++) {
+            if (i > 0) {
+                m_out << ", ";
+            }
+            m_out << "block" << node.target_block_ids()[i];
+        }
+        m_out << "])\n";
+        for (size_t block_id : node.successor_block_ids()) {
+            subsequent_block_ids.push_back(block_id);
+        }
+    }
+
     void dispatch(const linear::function_call& node) override {
         print_indent(m_out, m_indent);
         if (node.destination().has_value()) {
@@ -1361,6 +1434,18 @@ protected:
         m_out << ")\n";
     }
 
+    void dispatch(const linear::select_instruction& node) override {
+        print_indent(m_out, m_indent);
+        print_virtual_register(node.destination(), true, true);
+        m_out << " = select(condition=";
+        print_virtual_register(node.condition(), true);
+        m_out << ", if_true=";
+        print_virtual_register(node.if_true(), true);
+        m_out << ", if_false=";
+        print_virtual_register(node.if_false(), true);
+        m_out << ")\n";
+    }
+
     void dispatch(const linear::load_effective_address& node) override {
         print_indent(m_out, m_indent);
         print_virtual_register(node.destination(), true, true);
@@ -1370,40 +1455,59 @@ protected:
 
 namespace michaelcc {
 namespace logic {
-    std::string to_tree_string(const translation_unit& unit) {
+    static void print_function(std::ostream& ss, logical_statement_printer& statement_printer, const function_definition& func) {
+        if (func.should_inline()) {
+            ss << "inline ";
+        }
+        if (func.should_tail_call_optimize()) {
+            ss << "tail_call_optimize ";
+        }
+        ss << func.return_type().to_string() << " " << func.name() << "(";
+        bool first = true;
+        for (const auto& param : func.parameters()) {
+            if (!first) {
+                ss << ", ";
+            }
+            ss << param->get_type().to_string() << " " << param->name();
+        }
+        ss << ") {\n";
+
+        statement_printer.begin_indent();
+        for (const auto& statement : func.statements()) {
+            statement_printer(*statement);
+        }
+        statement_printer.end_indent();
+        ss << "}\n";
+    }
+
+    std::string static_declarations_to_tree_string(const translation_unit& unit) {
         std::stringstream ss;
 
         logical_statement_printer statement_printer(ss, unit, 0);
         for (const auto& static_variable : unit.static_variable_declarations()) {
             statement_printer(static_variable);
         }
+        return ss.str();
+    }
+
+    std::string to_tree_string(const translation_unit& unit, const function_definition& function) {
+        std::stringstream ss;
+
+        logical_statement_printer statement_printer(ss, unit, 0);
+        print_function(ss, statement_printer, function);
+        return ss.str();
+    }
+
+    std::string to_tree_string(const translation_unit& unit) {
+        std::stringstream ss;
+        ss << static_declarations_to_tree_string(unit);
 
+        logical_statement_printer statement_printer(ss, unit, 0);
         for (const auto& sym : unit.global_context()->symbols()) {
             auto* func = dynamic_cast<logic::function_definition*>(sym.get());
             if (!func) { continue; }
 
-            if (func->should_inline()) {
-                ss << "inline ";
-            }
-            if (func->should_tail_call_optimize()) {
-                ss << "tail_call_optimize ";
-            }
-            ss << func->return_type().to_string() << " " << func->name() << "(";
-            bool first = true;
-            for (const auto& param : func->parameters()) {
-                if (!first) {
-                    ss << ", ";
-                }
-                ss << param->get_type().to_string() << " " << param->name();
-            }
-            ss << ") {\n";
-
-            statement_printer.begin_indent();
-            for (const auto& statement : func->statements()) {
-                statement_printer(*statement);
-            }
-            statement_printer.end_indent();
-            ss << "}\n";
+            print_function(ss, statement_printer, *func);
         }
 
         return ss.str();
@@ -0,0 +1,253 @@
+#include "server.hpp"
+#include <cstdint>
+#include <cstring>
+#include <semaphore>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace michaelcc;
+
+#ifdef _WIN32
+void server::serve(const std::string&, const request_handler&) {
+    throw std::runtime_error("Compile server mode is not supported on this platform");
+}
+
+int server::forward(const std::string&, const std::vector<std::string>&, std::ostream&) {
+    throw std::runtime_error("Compile server mode is not supported on this platform");
+}
+#else
+namespace {
+    // a client disconnecting early must not kill the server with SIGPIPE
+#ifdef MSG_NOSIGNAL
+    constexpr int send_flags = MSG_NOSIGNAL;
+#else
+    constexpr int send_flags = 0;
+#endif
+
+    // clients past this many wait to be accepted until one of the running compiles is done
+    constexpr std::ptrdiff_t max_concurrent_clients = 16;
+
+    // every message is a sequence of fields: u32 counts and length prefixed strings, in host byte order
+    // since both ends always run on the same machine
+    class connection {
+    private:
+        int m_fd;
+
+    public:
+        explicit connection(int fd) : m_fd(fd) {}
+        connection(const connection&) = delete;
+        connection& operator=(const connection&) = delete;
+        ~connection() { ::close(m_fd); }
+
+        void write_bytes(const void* data, size_t size) {
+            auto* begin = static_cast<const char*>(data);
+            while (size > 0) {
+                ssize_t written = ::send(m_fd, begin, size, send_flags);
+                if (written <= 0) {
+                    throw std::runtime_error("Compile server connection closed while writing");
+                }
+                begin += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+        void read_bytes(void* data, size_t size) {
+            auto* begin = static_cast<char*>(data);
+            while (size > 0) {
+                ssize_t received = ::read(m_fd, begin, size);
+                if (received <= 0) {
+                    throw std::runtime_error("Compile server connection closed while reading");
+                }
+                begin += received;
+                size -= static_cast<size_t>(received);
+            }
+        }
+
+        void write_u32(uint32_t value) { write_bytes(&value, sizeof(value)); }
+
+        uint32_t read_u32() {
+            uint32_t value;
+            read_bytes(&value, sizeof(value));
+            return value;
+        }
+
+        void write_string(const std::string& value) {
+            write_u32(static_cast<uint32_t>(value.size()));
+            write_bytes(value.data(), value.size());
+        }
+
+        std::string read_string() {
+            std::string value(read_u32(), '\0');
+            read_bytes(value.data(), value.size());
+            return value;
+        }
+    };
+
+    sockaddr_un make_address(const std::string& socket_path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path " + socket_path + " is too long");
+        }
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        return address;
+    }
+
+    // requests name files to read and write, so only the user running the server may send them
+    bool is_same_user(int fd) {
+#ifdef SO_PEERCRED
+        ucred credentials{};
+        socklen_t length = sizeof(credentials);
+        if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+            return false;
+        }
+        return credentials.uid == ::geteuid();
+#else
+        uid_t uid;
+        gid_t gid;
+        if (::getpeereid(fd, &uid, &gid) != 0) {
+            return false;
+        }
+        return uid == ::geteuid();
+#endif
+    }
+
+    // diagnostics go out as a sequence of non empty strings, each sent when the handler flushes its stream, so the
+    // client sees them while the compile is still running. an empty string ends them and is followed by the exit code
+    class diagnostics_buffer : public std::stringbuf {
+    private:
+        connection& m_client;
+        bool m_disconnected = false;
+
+    protected:
+        int sync() override {
+            std::string pending = str();
+            if (pending.empty() || m_disconnected) {
+                return 0;
+            }
+            str(std::string());
+            try {
+                m_client.write_string(pending);
+            }
+            catch (const std::exception&) {
+                // the compile still runs to completion, writing its outputs, so later flushes are dropped
+                m_disconnected = true;
+                return -1;
+            }
+            return 0;
+        }
+
+    public:
+        explicit diagnostics_buffer(connection& client) : m_client(client) {}
+    };
+
+    void finish(connection& client, int exit_code) {
+        client.write_string(std::string());
+        client.write_u32(static_cast<uint32_t>(exit_code));
+    }
+
+    void handle_client(int fd, const server::request_handler& handler) {
+        connection client(fd);
+        try {
+            if (!is_same_user(fd)) {
+                client.write_string("The compile server only accepts requests from the user running it.\n");
+                finish(client, 1);
+                return;
+            }
+
+            std::vector<std::string> arguments(client.read_u32());
+            for (auto& argument : arguments) {
+                argument = client.read_string();
+            }
+
+            diagnostics_buffer buffer(client);
+            std::ostream diagnostics(&buffer);
+            int exit_code;
+            try {
+                exit_code = handler(arguments, diagnostics);
+            }
+            catch (const std::exception& e) {
+                diagnostics << "Exception: " << e.what() << std::endl;
+                exit_code = 3;
+            }
+
+            diagnostics.flush();
+            finish(client, exit_code);
+        }
+        catch (const std::exception&) {
+            // the client went away, nobody is left to report to
+        }
+    }
+}
+
+void server::serve(const std::string& socket_path, const request_handler& handler) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Could not create compile server socket");
+    }
+
+    // a socket file left behind by an earlier server would make bind fail, but anything else at that path is not ours
+    // to delete. nobody can connect before listen, so the socket is closed to other users before it accepts anyone
+    struct stat existing {};
+    if (::lstat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            ::close(fd);
+            throw std::runtime_error(socket_path + " already exists and is not a socket");
+        }
+        ::unlink(socket_path.c_str());
+    }
+    sockaddr_un address = make_address(socket_path);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) != 0
+        || ::listen(fd, SOMAXCONN) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Could not listen on " + socket_path);
+    }
+
+    std::counting_semaphore<max_concurrent_clients> client_slots(max_concurrent_clients);
+    while (true) {
+        client_slots.acquire();
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            client_slots.release();
+            continue;
+        }
+        std::thread([client, &handler, &client_slots]() {
+            handle_client(client, handler);
+            client_slots.release();
+        }).detach();
+    }
+}
+
+int server::forward(const std::string& socket_path, const std::vector<std::string>& arguments, std::ostream& diagnostics) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Could not create compile server socket");
+    }
+    connection server_connection(fd);
+
+    sockaddr_un address = make_address(socket_path);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error("Could not connect to a compile server at " + socket_path);
+    }
+
+    server_connection.write_u32(static_cast<uint32_t>(arguments.size()));
+    for (const auto& argument : arguments) {
+        server_connection.write_string(argument);
+    }
+
+    for (std::string chunk = server_connection.read_string(); !chunk.empty(); chunk = server_connection.read_string()) {
+        diagnostics << chunk << std::flush;
+    }
+    return static_cast<int>(server_connection.read_u32());
+}
+#endif
@@ -53,13 +53,14 @@ const std::map<token_type, int> ast::arithmetic_operator::operator_precedence =
     {MICHAELCC_TOKEN_MODULO,              12},
 };
 
-void michaelcc::parser::next_token() noexcept {
+void michaelcc::parser::next_token() {
 	for (;;) {
 		if (end()) {
 			return;
 		}
 
 		m_token_index++;
+		fill_window();
 
 		if (current_token().type() == MICHAELCC_TOKEN_LINE_DIRECTIVE) {
 			current_loc = current_token().location();
@@ -76,6 +77,24 @@ void michaelcc::parser::next_token() noexcept {
 	}
 }
 
+void michaelcc::parser::fill_window() {
+	while (m_source != nullptr && static_cast<int64_t>(m_window_begin + m_tokens.size()) <= m_token_index) {
+		auto tok = m_source->next();
+		if (!tok.has_value()) {
+			m_source = nullptr;
+			break;
+		}
+		m_tokens.push_back(std::move(tok.value()));
+	}
+}
+
+void michaelcc::parser::release_window() {
+	while (!m_tokens.empty() && static_cast<int64_t>(m_window_begin) < m_token_index) {
+		m_tokens.pop_front();
+		m_window_begin++;
+	}
+}
+
 void michaelcc::parser::match_token(token_type type) const
 {
 	if (current_token().type() != type) {
@@ -637,6 +656,56 @@ std::unique_ptr<ast::ast_element> parser::parse_statement() {
             std::move(location)
         );
     }
+    case MICHAELCC_TOKEN_SWITCH: {
+        next_token();
+        match_token(MICHAELCC_TOKEN_OPEN_PAREN);
+        next_token();
+        auto condition = parse_expression();
+        match_token(MICHAELCC_TOKEN_CLOSE_PAREN);
+        next_token();
+        match_token(MICHAELCC_TOKEN_OPEN_BRACE);
+        next_token();
+
+        std::vector<ast::switch_statement::switch_case> cases;
+        bool has_default = false;
+        while (current_token().type() != MICHAELCC_TOKEN_CLOSE_BRACE && !end()) {
+            source_location case_location = current_loc;
+            std::unique_ptr<ast::ast_element> value;
+            if (current_token().type() == MICHAELCC_TOKEN_DEFAULT) {
+                if (has_default) {
+                    throw panic("Switch statement has more than one default label.");
+                }
+                has_default = true;
+                next_token();
+            }
+            else {
+                match_token(MICHAELCC_TOKEN_CASE);
+                next_token();
+                value = parse_expression();
+            }
+            match_token(MICHAELCC_TOKEN_COLON);
+            next_token();
+
+            std::vector<std::unique_ptr<ast::ast_element>> statements;
+            while (current_token().type() != MICHAELCC_TOKEN_CASE &&
+                current_token().type() != MICHAELCC_TOKEN_DEFAULT &&
+                current_token().type() != MICHAELCC_TOKEN_CLOSE_BRACE && !end()) {
+                statements.push_back(parse_statement());
+            }
+            cases.push_back(ast::switch_statement::switch_case{
+                .value = std::move(value),
+                .body = ast::context_block(std::move(statements), std::move(case_location))
+            });
+        }
+        match_token(MICHAELCC_TOKEN_CLOSE_BRACE);
+        next_token();
+
+        return std::make_unique<ast::switch_statement>(
+            std::move(condition),
+            std::move(cases),
+            std::move(location)
+        );
+    }
     case MICHAELCC_TOKEN_RETURN: {
         next_token();
         std::unique_ptr<ast::ast_element> value;
@@ -928,7 +997,7 @@ std::unique_ptr<ast::function_declaration> parser::parse_function_declaration()
     );
 }
 
-std::vector<std::unique_ptr<ast::ast_element>> michaelcc::parser::parse_all()
+bool michaelcc::parser::parse_top_level()
 {
     auto parse_function_or_variable = [this](size_t backup, source_location backup_loc) {
         // Try to parse as function prototype or declaration
@@ -962,88 +1031,134 @@ std::vector<std::unique_ptr<ast::ast_element>> michaelcc::parser::parse_all()
         m_result.push_back(std::make_unique<ast::variable_declaration>(parse_variable_declaration()));
     };
 
-    while (!end())
-    {
-        size_t backup = m_token_index;
-        auto backup_loc = current_loc;
-        bool need_semicolon = true;
+    if (end()) {
+        return false;
+    }
 
-        switch (current_token().type())
-        {
-        case MICHAELCC_TOKEN_STRUCT: {
-            auto struct_decl = parse_struct_declaration();
-            if (struct_decl->fields().empty()) {
-                m_token_index = backup;
-                current_loc = backup_loc;
-                parse_function_or_variable(backup, backup_loc);
-                need_semicolon = false;
-            } else {
-                m_result.emplace_back(std::move(struct_decl));
-            }
-            break;
-        }
-        case MICHAELCC_TOKEN_UNION: {
-            auto union_decl = parse_union_declaration();
-            if (union_decl->members().empty()) {
-                m_token_index = backup;
-                current_loc = backup_loc;
-                parse_function_or_variable(backup, backup_loc);
-                need_semicolon = false;
-            } else {
-                m_result.emplace_back(std::move(union_decl));
-            }
-            break;
-        }
-        case MICHAELCC_TOKEN_ENUM: {
-            auto enum_decl = parse_enum_declaration();
-            if (enum_decl->enumerators().empty()) {
-                m_token_index = backup;
-                current_loc = backup_loc;
-                parse_function_or_variable(backup, backup_loc);
-                need_semicolon = false;
-            } else {
-                m_result.emplace_back(std::move(enum_decl));
-            }
-            break;
+    // Nothing before this declaration is looked at again
+    release_window();
+
+    size_t backup = m_token_index;
+    auto backup_loc = current_loc;
+    bool need_semicolon = true;
+
+    switch (current_token().type())
+    {
+    case MICHAELCC_TOKEN_STRUCT: {
+        auto struct_decl = parse_struct_declaration();
+        if (struct_decl->fields().empty()) {
+            m_token_index = backup;
+            current_loc = backup_loc;
+            parse_function_or_variable(backup, backup_loc);
+            need_semicolon = false;
+        } else {
+            m_result.emplace_back(std::move(struct_decl));
         }
-        case MICHAELCC_TOKEN_TYPEDEF: {
-            auto typedef_decl = parse_typedef_declaration();
-            // Register typedef internally for type substitution
-            m_typedefs.insert({ typedef_decl->name(), typedef_decl->type() });
-            m_result.push_back(std::move(typedef_decl));
-            break;
+        break;
+    }
+    case MICHAELCC_TOKEN_UNION: {
+        auto union_decl = parse_union_declaration();
+        if (union_decl->members().empty()) {
+            m_token_index = backup;
+            current_loc = backup_loc;
+            parse_function_or_variable(backup, backup_loc);
+            need_semicolon = false;
+        } else {
+            m_result.emplace_back(std::move(union_decl));
         }
-        case MICHAELCC_TOKEN_CONST:
-        case MICHAELCC_TOKEN_VOLATILE:
-        case MICHAELCC_TOKEN_EXTERN:
-        case MICHAELCC_TOKEN_STATIC:
-        case MICHAELCC_TOKEN_REGISTER:
-        case MICHAELCC_TOKEN_SIGNED:
-        case MICHAELCC_TOKEN_UNSIGNED:
-        case MICHAELCC_TOKEN_SHORT:
-        case MICHAELCC_TOKEN_LONG:
-        case MICHAELCC_TOKEN_CHAR:
-        case MICHAELCC_TOKEN_INT:
-        case MICHAELCC_TOKEN_FLOAT:
-        case MICHAELCC_TOKEN_DOUBLE:
-        case MICHAELCC_TOKEN_IDENTIFIER:
-        case MICHAELCC_TOKEN_VOID:
-        case MICHAELCC_TOKEN_INLINE:
-        case MICHAELCC_TOKEN_TAIL_CALL_OPTIMIZE:
+        break;
+    }
+    case MICHAELCC_TOKEN_ENUM: {
+        auto enum_decl = parse_enum_declaration();
+        if (enum_decl->enumerators().empty()) {
+            m_token_index = backup;
+            current_loc = backup_loc;
             parse_function_or_variable(backup, backup_loc);
             need_semicolon = false;
-            break;
-        default:
-            break;
+        } else {
+            m_result.emplace_back(std::move(enum_decl));
         }
-
-        if (need_semicolon) {
-            match_token(MICHAELCC_TOKEN_SEMICOLON);
-            next_token();
+        break;
+    }
+    case MICHAELCC_TOKEN_TYPEDEF: {
+        auto typedef_decl = parse_typedef_declaration();
+        // Register typedef internally for type substitution
+        m_typedefs.insert({ typedef_decl->name(), typedef_decl->type()->clone() });
+        m_result.push_back(std::move(typedef_decl));
+
+        // Keep the declaration's tokens, starting from its location, so it can be replayed later
+        m_typedef_tokens.emplace_back(backup_loc);
+        for (size_t i = backup; i < static_cast<size_t>(m_token_index); i++) {
+            m_typedef_tokens.push_back(m_tokens[i - m_window_begin]);
         }
+        m_typedef_tokens.emplace_back(MICHAELCC_TOKEN_SEMICOLON, current_loc.col());
+        break;
+    }
+    case MICHAELCC_TOKEN_CONST:
+    case MICHAELCC_TOKEN_VOLATILE:
+    case MICHAELCC_TOKEN_EXTERN:
+    case MICHAELCC_TOKEN_STATIC:
+    case MICHAELCC_TOKEN_REGISTER:
+    case MICHAELCC_TOKEN_SIGNED:
+    case MICHAELCC_TOKEN_UNSIGNED:
+    case MICHAELCC_TOKEN_SHORT:
+    case MICHAELCC_TOKEN_LONG:
+    case MICHAELCC_TOKEN_CHAR:
+    case MICHAELCC_TOKEN_INT:
+    case MICHAELCC_TOKEN_FLOAT:
+    case MICHAELCC_TOKEN_DOUBLE:
+    case MICHAELCC_TOKEN_IDENTIFIER:
+    case MICHAELCC_TOKEN_VOID:
+    case MICHAELCC_TOKEN_INLINE:
+    case MICHAELCC_TOKEN_TAIL_CALL_OPTIMIZE:
+        parse_function_or_variable(backup, backup_loc);
+        need_semicolon = false;
+        break;
+    default:
+        break;
     }
 
+    if (need_semicolon) {
+        match_token(MICHAELCC_TOKEN_SEMICOLON);
+        next_token();
+    }
+
+    return true;
+}
+
+std::vector<std::unique_ptr<ast::ast_element>> michaelcc::parser::parse_all()
+{
+    while (parse_top_level()) { }
+
     // Clear internal typedef map after parsing
     m_typedefs.clear();
     return std::move(m_result);
 }
+
+std::unique_ptr<ast::ast_element> michaelcc::parser::parse_next()
+{
+    // A top level declaration adds at most one element, empty ones like a stray semicolon add none
+    while (m_result.empty()) {
+        if (!parse_top_level()) {
+            return nullptr;
+        }
+    }
+
+    auto element = std::move(m_result.front());
+    m_result.erase(m_result.begin());
+    return element;
+}
+
+void michaelcc::parser::import_typedefs(const std::vector<token>& tokens) {
+    parser typedef_parser{ std::vector<token>(tokens) };
+    for (auto& element : typedef_parser.parse_all()) {
+        auto* typedef_decl = dynamic_cast<const ast::typedef_declaration*>(element.get());
+        if (typedef_decl == nullptr) {
+            throw compilation_error("Expected only typedef declarations to import.", element->location());
+        }
+        m_typedefs.insert({ typedef_decl->name(), typedef_decl->type()->clone() });
+    }
+    for (const auto& tok : tokens) {
+        m_typedef_tokens.push_back(tok);
+    }
+}
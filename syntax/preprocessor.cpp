@@ -1,5 +1,6 @@
 #include "syntax/preprocessor.hpp"
 #include <fstream>
+#include <iterator>
 #include <sstream>
 
 using namespace michaelcc;
@@ -63,172 +64,273 @@ token michaelcc::preprocessor::expect_token(token_type type)
 	return tok;
 }
 
+void preprocessor::end_prefix()
+{
+	m_in_prefix = false;
+	m_prefix.token_count = m_emitted;
+	for (const auto& [name, definition] : m_definitions) {
+		m_prefix.macro_names.push_back(name);
+	}
+}
+
+std::vector<preprocessor::definition> preprocessor::prefix_definitions() const
+{
+	std::vector<definition> definitions;
+	definitions.reserve(m_prefix.macro_names.size());
+	for (const auto& name : m_prefix.macro_names) {
+		definitions.push_back(m_definitions.at(name));
+	}
+	return definitions;
+}
+
+void preprocessor::skip_leading_includes(size_t count, const std::vector<definition>& definitions)
+{
+	m_skipped_includes = count;
+	for (const auto& definition : definitions) {
+		m_definitions.insert({ definition.name(), definition });
+	}
+}
+
+std::vector<std::filesystem::path> preprocessor::leading_includes(const std::string& source, const std::filesystem::path& file_name)
+{
+	scanner scanner(source, file_name);
+	std::vector<std::filesystem::path> includes;
+	while (scanner.scan_token_if_match(MICHAELCC_PREPROCESSOR_TOKEN_INCLUDE)) {
+		token requested_path = scanner.scan_token();
+		if (requested_path.type() != MICHAELCC_TOKEN_STRING_LITERAL) {
+			break;
+		}
+		auto file_path = scanner.resolve_file_path(requested_path.string());
+		if (!file_path.has_value()) {
+			break;
+		}
+		includes.push_back(file_path.value());
+	}
+	return includes;
+}
+
 void preprocessor::preprocess()
 {
-	std::vector<preprocessor_scope> preprocessor_scopes;
-	m_result.push_back(token(m_scanners.front().location()));
-
-	while (!m_scanners.empty()) {
-		auto& scanner = m_scanners.back();
-		
-		source_location location = scanner.location();
-		token tok = scanner.scan_token();
-
-		if (!preprocessor_scopes.empty() && preprocessor_scopes.back().skip) {
-			if (tok.is_preprocessor_condition()) {
-				preprocessor_scopes.push_back(preprocessor_scope(tok.type(), location, true, true));
-			}
-			else if (tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_ELSE && !preprocessor_scopes.back().override_skip) {
-				preprocessor_scopes.pop_back();
-				preprocessor_scopes.push_back(preprocessor_scope(tok.type(), location, false, false));
-				m_result.push_back(token(scanner.end_location()));
-			}
-			else if (tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_ENDIF) {
-				preprocessor_scopes.pop_back();
-				m_result.push_back(token(scanner.end_location()));
-			}
-			continue;
+	while (auto tok = next()) {
+		m_result.push_back(std::move(tok.value()));
+	}
+}
+
+std::optional<token> preprocessor::next()
+{
+	while (m_pending.empty()) {
+		if (!step()) {
+			return std::nullopt;
 		}
+	}
 
-		switch (tok.type())
-		{
-		case MICHAELCC_PREPROCESSOR_TOKEN_INCLUDE: {
-			std::string requested_path = expect_token(MICHAELCC_TOKEN_STRING_LITERAL).string();
-			auto file_path = scanner.resolve_file_path(requested_path);
-			if (!file_path.has_value()) {
-				std::stringstream ss;
-				ss << "File \"" << requested_path << "\" doesn't exist.";
-				throw panic(ss.str());
-			}
+	token tok = std::move(m_pending.front());
+	m_pending.pop_front();
+	return tok;
+}
 
-			std::ifstream infile(file_path.value());
-			if (!infile.good()) {
-				std::stringstream ss;
-				ss << "Unable to open file \"" << file_path.value() << "\".";
-				throw panic(ss.str());
-			}
+bool preprocessor::step()
+{
+	if (m_scanners.empty()) {
+		return false;
+	}
 
+	auto& scanner = m_scanners.back();
+	
+	source_location location = scanner.location();
+	token tok = scanner.scan_token();
+
+	if (!m_scopes.empty() && m_scopes.back().skip) {
+		if (tok.is_preprocessor_condition()) {
+			m_scopes.push_back(preprocessor_scope(tok.type(), location, true, true));
+		}
+		else if (tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_ELSE && !m_scopes.back().override_skip) {
+			m_scopes.pop_back();
+			m_scopes.push_back(preprocessor_scope(tok.type(), location, false, false));
+			emit(token(scanner.end_location()));
+		}
+		else if (tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_ENDIF) {
+			m_scopes.pop_back();
+			emit(token(scanner.end_location()));
+		}
+		return true;
+	}
+
+	if (m_in_prefix && m_scanners.size() == 1 && tok.type() != MICHAELCC_PREPROCESSOR_TOKEN_INCLUDE) {
+		end_prefix();
+	}
+
+	switch (tok.type())
+	{
+	case MICHAELCC_PREPROCESSOR_TOKEN_INCLUDE: {
+		std::string requested_path = expect_token(MICHAELCC_TOKEN_STRING_LITERAL).string();
+		auto file_path = scanner.resolve_file_path(requested_path);
+		if (!file_path.has_value()) {
 			std::stringstream ss;
-			ss << infile.rdbuf();
-
-			m_scanners.push_back(preprocessor::scanner(ss.str(), file_path.value()));
-			m_result.push_back(token(m_scanners.back().location()));
-			continue;
-		}
-		case MICHAELCC_PREPROCESSOR_TOKEN_DEFINE: {
-			std::string macro_name = expect_token(MICHAELCC_TOKEN_IDENTIFIER).string();
-			{
-				auto it = m_definitions.find(macro_name);
-				if (it != m_definitions.end()) {
-					std::stringstream ss;
-					ss << "Redefinition of macro " << macro_name << " declared at " << it->second.location().to_string() << '.';
-					throw panic(ss.str());
+			ss << "File \"" << requested_path << "\" doesn't exist.";
+			throw panic(ss.str());
+		}
+
+		if (m_in_prefix) {
+			if (m_scanners.size() == 1) {
+				m_prefix.includes.push_back(file_path.value());
+				if (m_prefix.includes.size() <= m_skipped_includes) {
+					return true;
 				}
 			}
+			m_prefix.files.push_back(file_path.value());
+		}
 
-			std::vector<std::string> params;
-			if (scanner.scan_token_if_match(MICHAELCC_TOKEN_OPEN_PAREN)) {
-				if (!scanner.scan_token_if_match(MICHAELCC_TOKEN_CLOSE_PAREN)) {
+		std::ifstream infile(file_path.value());
+		if (!infile.good()) {
+			std::stringstream ss;
+			ss << "Unable to open file \"" << file_path.value() << "\".";
+			throw panic(ss.str());
+		}
+
+		std::string source((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+		m_scanners.emplace_back(std::move(source), file_path.value());
+		emit(token(m_scanners.back().location()));
+		return true;
+	}
+	case MICHAELCC_PREPROCESSOR_TOKEN_DEFINE: {
+		std::string macro_name = expect_token(MICHAELCC_TOKEN_IDENTIFIER).string();
+		{
+			auto it = m_definitions.find(macro_name);
+			if (it != m_definitions.end()) {
+				std::stringstream ss;
+				ss << "Redefinition of macro " << macro_name << " declared at " << it->second.location().to_string() << '.';
+				throw panic(ss.str());
+			}
+		}
+
+		std::vector<std::string> params;
+		if (scanner.scan_token_if_match(MICHAELCC_TOKEN_OPEN_PAREN)) {
+			if (!scanner.scan_token_if_match(MICHAELCC_TOKEN_CLOSE_PAREN)) {
                     do {
                         params.push_back(expect_token(MICHAELCC_TOKEN_IDENTIFIER).string());
                     } while (scanner.scan_token_if_match(MICHAELCC_TOKEN_COMMA));
     
                     expect_token(MICHAELCC_TOKEN_CLOSE_PAREN);
-				}
 			}
+		}
 
-			std::vector<token> tokens;
-			while (!scanner.scan_token_if_match(MICHAELCC_TOKEN_NEWLINE, false, true)) {
-				token tok = scanner.scan_token(true);
-				if (tok.is_preprocessor()) {
-					std::stringstream ss;
-					ss << "Unexpected preprocessor token " << token_to_str(tok.type()) << '.';
-					throw panic(ss.str());
-				}
-				tokens.push_back(tok);
+		std::vector<token> tokens;
+		while (!scanner.scan_token_if_match(MICHAELCC_TOKEN_NEWLINE, false, true)) {
+			token tok = scanner.scan_token(true);
+			if (tok.is_preprocessor()) {
+				std::stringstream ss;
+				ss << "Unexpected preprocessor token " << token_to_str(tok.type()) << '.';
+				throw panic(ss.str());
 			}
+			tokens.push_back(tok);
+		}
 
-			m_definitions.insert({ macro_name, definition(macro_name, params, tokens, location) });
+		m_definitions.insert({ macro_name, definition(macro_name, params, tokens, location) });
 
-			break;
-		}
-		case MICHAELCC_PREPROCESSOR_TOKEN_IFNDEF:
-			[[fallthrough]];
-		case MICHAELCC_PREPROCESSOR_TOKEN_IFDEF: {
-			std::string identifier = expect_token(MICHAELCC_TOKEN_IDENTIFIER).string();
+		break;
+	}
+	case MICHAELCC_PREPROCESSOR_TOKEN_IFNDEF:
+		[[fallthrough]];
+	case MICHAELCC_PREPROCESSOR_TOKEN_IFDEF: {
+		std::string identifier = expect_token(MICHAELCC_TOKEN_IDENTIFIER).string();
 
-			bool condition = ((tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_IFDEF) ^ m_definitions.contains(identifier));
+		bool condition = ((tok.type() == MICHAELCC_PREPROCESSOR_TOKEN_IFDEF) ^ m_definitions.contains(identifier));
 
-			preprocessor_scopes.push_back(preprocessor_scope(tok.type(), location, condition, false));
+		m_scopes.push_back(preprocessor_scope(tok.type(), location, condition, false));
 
-			break;
+		break;
+	}
+	case MICHAELCC_PREPROCESSOR_TOKEN_ELSE:
+		if (m_scopes.empty()) {
+			throw panic("Unexpected preprocessor else. No matching #ifdef or #ifndef.");
 		}
-		case MICHAELCC_PREPROCESSOR_TOKEN_ELSE:
-			if (preprocessor_scopes.empty()) {
-				throw panic("Unexpected preprocessor else. No matching #ifdef or #ifndef.");
-			}
-			if (preprocessor_scopes.back().type == MICHAELCC_PREPROCESSOR_TOKEN_ELSE) {
-				std::stringstream ss;
-				ss << "Unexpected preprocessor else. Found previous #else at " << preprocessor_scopes.back().begin_location.to_string() << '.';
-				throw panic(ss.str());
-			}
-			preprocessor_scopes.pop_back();
-			preprocessor_scopes.push_back(preprocessor_scope(tok.type(), location, true, false));
-			break;
-		case MICHAELCC_PREPROCESSOR_TOKEN_ENDIF:
-			if (preprocessor_scopes.empty()) {
-				throw panic("Unexpected preprocessor end. No matching #ifdef or #ifndef.");
-			}
-			preprocessor_scopes.pop_back();
-			break;
-		case MICHAELCC_TOKEN_END: {
-			if (!preprocessor_scopes.empty()) {
-				std::stringstream ss;
-				for (const auto& preprocessor_scope : preprocessor_scopes) {
-					ss << "Preprocessor directive " << token_to_str(preprocessor_scope.type) << " declared at " << preprocessor_scope.begin_location.to_string() << " expected end but got none.";
-					if (&preprocessor_scope != &preprocessor_scopes.back()) {
-						ss << '\n';
-					}
+		if (m_scopes.back().type == MICHAELCC_PREPROCESSOR_TOKEN_ELSE) {
+			std::stringstream ss;
+			ss << "Unexpected preprocessor else. Found previous #else at " << m_scopes.back().begin_location.to_string() << '.';
+			throw panic(ss.str());
+		}
+		m_scopes.pop_back();
+		m_scopes.push_back(preprocessor_scope(tok.type(), location, true, false));
+		break;
+	case MICHAELCC_PREPROCESSOR_TOKEN_ENDIF:
+		if (m_scopes.empty()) {
+			throw panic("Unexpected preprocessor end. No matching #ifdef or #ifndef.");
+		}
+		m_scopes.pop_back();
+		break;
+	case MICHAELCC_TOKEN_END: {
+		if (!m_scopes.empty()) {
+			std::stringstream ss;
+			for (const auto& preprocessor_scope : m_scopes) {
+				ss << "Preprocessor directive " << token_to_str(preprocessor_scope.type) << " declared at " << preprocessor_scope.begin_location.to_string() << " expected end but got none.";
+				if (&preprocessor_scope != &m_scopes.back()) {
+					ss << '\n';
 				}
-				throw panic(ss.str());
 			}
+			throw panic(ss.str());
+		}
 
-			m_scanners.pop_back();
-			if (!m_scanners.empty()) {
-				m_result.push_back(token(m_scanners.back().end_location()));
+		m_scanners.pop_back();
+		if (!m_scanners.empty()) {
+			emit(token(m_scanners.back().end_location()));
+		}
+		return true;
+	}
+	case MICHAELCC_TOKEN_IDENTIFIER:
+	{
+		auto it = m_definitions.find(tok.string());
+		if (it != m_definitions.end()) {
+			std::vector<std::vector<token>> arguments;
+			if (scanner.scan_token_if_match(MICHAELCC_TOKEN_OPEN_PAREN)) {
+				do {
+					std::vector<token> argument;
+					while (scanner.peek_token().type() != MICHAELCC_TOKEN_COMMA 
+						&& scanner.peek_token().type() != MICHAELCC_TOKEN_CLOSE_PAREN
+						&& scanner.peek_token().type() != MICHAELCC_TOKEN_END)
+					{
+						argument.emplace_back(scanner.scan_token());
+					}
+					if (scanner.peek_token().type() == MICHAELCC_TOKEN_END) {
+						throw panic("Unexpected end of file.");
+					}
+					scanner.scan_token_if_match(MICHAELCC_TOKEN_COMMA);
+					arguments.emplace_back(std::move(argument));
+				} while (!scanner.scan_token_if_match(MICHAELCC_TOKEN_CLOSE_PAREN));
 			}
-			continue;
+			it->second.expand(scanner, arguments, *this);
+			emit(token(scanner.location()));
+			return true;
 		}
-		case MICHAELCC_TOKEN_IDENTIFIER:
-		{
-			auto it = m_definitions.find(tok.string());
-			if (it != m_definitions.end()) {
-				std::vector<std::vector<token>> arguments;
-				if (scanner.scan_token_if_match(MICHAELCC_TOKEN_OPEN_PAREN)) {
-					do {
-						std::vector<token> argument;
-						while (scanner.peek_token().type() != MICHAELCC_TOKEN_COMMA 
-							&& scanner.peek_token().type() != MICHAELCC_TOKEN_CLOSE_PAREN
-							&& scanner.peek_token().type() != MICHAELCC_TOKEN_END)
-						{
-							argument.emplace_back(scanner.scan_token());
-						}
-						if (scanner.peek_token().type() == MICHAELCC_TOKEN_END) {
-							throw panic("Unexpected end of file.");
-						}
-						scanner.scan_token_if_match(MICHAELCC_TOKEN_COMMA);
-						arguments.emplace_back(std::move(argument));
-					} while (!scanner.scan_token_if_match(MICHAELCC_TOKEN_CLOSE_PAREN));
+	}
+	[[fallthrough]];
+	default:
+		emit(std::move(tok));
+		break;
+	}
+	return true;
+}
+
+background_preprocessor::background_preprocessor(preprocessor& preprocessor, size_t capacity) : m_tokens(capacity)
+{
+	m_thread = std::thread([this, &preprocessor]() {
+		try {
+			while (auto tok = preprocessor.next()) {
+				if (!m_tokens.push(std::move(tok.value()))) {
+					return;
 				}
-				it->second.expand(scanner, arguments, *this);
-				m_result.push_back(token(scanner.location()));
-				continue;
 			}
+			m_tokens.close();
 		}
-		[[fallthrough]];
-		default:
-			m_result.push_back(tok);
-			break;
+		catch (...) {
+			m_tokens.fail(std::current_exception());
 		}
-	}
+	});
+}
+
+background_preprocessor::~background_preprocessor()
+{
+	// the reader may have stopped early, e.g. on a parse error, leaving the preprocessor blocked on a full queue
+	m_tokens.cancel();
+	m_thread.join();
 }
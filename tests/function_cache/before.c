@@ -0,0 +1,24 @@
+int clamp(int x, int lo, int hi) {
+    if (x < lo) {
+        return lo;
+    }
+    if (x > hi) {
+        return hi;
+    }
+    return x;
+}
+
+int grade(int score) {
+    switch (score) {
+        case 5:
+        case 9: return 4;
+        case 8: return 3;
+        case 7: return 2;
+        case 6: return 1;
+        default: return 0;
+    }
+}
+
+int main() {
+    return clamp(grade(8), 0, 3);
+}
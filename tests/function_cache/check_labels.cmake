@@ -0,0 +1,50 @@
+# compiles before.c into an empty function cache, then compiles after.c (which only changes main) against that cache
+# and checks that the reused functions define every block and symbol label the output refers to
+cmake_minimum_required(VERSION 3.16)
+foreach(variable MICHAELCC SOURCE_DIR WORK_DIR)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif()
+endforeach()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+foreach(program before after)
+    execute_process(
+        COMMAND ${MICHAELCC} --platform lc2200 --input ${SOURCE_DIR}/${program}.c --output ${WORK_DIR}/${program}.s
+            --cache-dir ${WORK_DIR}/cache --cache-stats
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE stats
+        ERROR_VARIABLE stats)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "compiling ${program}.c failed:\n${stats}")
+    endif()
+endforeach()
+
+if(NOT stats MATCHES "[1-9][0-9]* reused")
+    message(FATAL_ERROR "after.c did not reuse any cached function:\n${stats}")
+endif()
+
+file(READ ${WORK_DIR}/after.s assembly)
+# semicolons start comments in the assembly but separate list elements in cmake
+string(REGEX REPLACE ";[^\n]*" "" assembly "${assembly}")
+string(REPLACE "\n" ";" lines "${assembly}")
+
+set(defined)
+set(referenced)
+foreach(line IN LISTS lines)
+    if(line MATCHES "^[ \t]*([A-Za-z_][A-Za-z0-9_]*):")
+        list(APPEND defined ${CMAKE_MATCH_1})
+        string(REGEX REPLACE "^[ \t]*[A-Za-z_][A-Za-z0-9_]*:" "" line "${line}")
+    endif()
+    string(REGEX MATCHALL "([A-Za-z_][A-Za-z0-9_]*__)?(block|sym)[0-9]+" labels "${line}")
+    list(APPEND referenced ${labels})
+endforeach()
+
+list(REMOVE_DUPLICATES referenced)
+foreach(label IN LISTS referenced)
+    if(NOT label IN_LIST defined)
+        message(FATAL_ERROR "label ${label} is referenced but never defined in after.s")
+    endif()
+endforeach()
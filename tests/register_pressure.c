@@ -0,0 +1,57 @@
+// Test expressions with more values live at once than there are registers
+
+int twelve_locals(int a, int b, int c) {
+    int v0 = a + b;
+    int v1 = a - c;
+    int v2 = b & c;
+    int v3 = v0 + c;
+    int v4 = v1 - b;
+    int v5 = v2 + a;
+    int v6 = v3 & v4;
+    int v7 = v5 - v0;
+    int v8 = v1 + v2;
+    int v9 = v6 - v3;
+    int v10 = v7 + v8;
+    int v11 = v9 & v5;
+    return v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + a + b + c;
+}
+
+int eighteen_locals(int a, int b, int c) {
+    int v0 = a + b;
+    int v1 = a - c;
+    int v2 = b & c;
+    int v3 = v0 + c;
+    int v4 = v1 - b;
+    int v5 = v2 + a;
+    int v6 = v3 & v4;
+    int v7 = v5 - v0;
+    int v8 = v1 + v2;
+    int v9 = v6 - v3;
+    int v10 = v7 + v8;
+    int v11 = v9 & v5;
+    int v12 = v10 - v11;
+    int v13 = v12 & v0;
+    int v14 = v13 + v1;
+    int v15 = v14 - v2;
+    int v16 = v15 + v3;
+    int v17 = v16 & v4;
+    return v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 + v13 + v14 + v15 + v16 + v17 + a + b + c;
+}
+
+int nested_tree(int a, int b, int c, int d) {
+    int t0 = a + 1;
+    int t1 = b + 2;
+    int t2 = c + 3;
+    int t3 = d + 4;
+    int t4 = a - b;
+    int t5 = c - d;
+    int t6 = a & d;
+    int t7 = b & c;
+    int t8 = a + c;
+    int t9 = b + d;
+    return t0 & (t1 + (t2 - (t3 & (t4 + (t5 - (t6 & (t7 + (t8 - t9))))))));
+}
+
+int main() {
+    return twelve_locals(1, 2, 3) + eighteen_locals(4, 5, 6) + nested_tree(7, 8, 9, 10);
+}
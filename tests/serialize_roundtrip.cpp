@@ -0,0 +1,134 @@
+// saves the linear IR of every sample program, loads it back and checks that it prints and encodes the same. the
+// round trip runs on the freshly lowered IR and again after register allocation, where the colors and the emitted
+// assembly have to match as well
+#include "syntax/preprocessor.hpp"
+#include "syntax/parser.hpp"
+#include "logic/semantic.hpp"
+#include "linear/flatten.hpp"
+#include "linear/serialize.hpp"
+#include "linear/allocators/frame_allocator.hpp"
+#include "linear/allocators/remove_phi.hpp"
+#include "linear/optimization/phi.hpp"
+#include "isa/lc2200.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+
+namespace {
+    michaelcc::linear::translation_unit lower_file(const std::filesystem::path& path, michaelcc::isa::isa& platform) {
+        std::ifstream input(path);
+        std::string source((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+        michaelcc::preprocessor preprocessor(std::move(source), path);
+        preprocessor.preprocess();
+        michaelcc::parser parser(preprocessor.release_result());
+
+        michaelcc::semantic_lowerer lowerer(platform.get_platform_info());
+        lowerer.lower(parser);
+        auto logic_translation_unit = lowerer.release_translation_unit();
+
+        michaelcc::logic_lowerer linear_lowerer(platform);
+        linear_lowerer.lower(logic_translation_unit);
+        return linear_lowerer.release_translation_unit();
+    }
+
+    // the reason the loaded unit differs, or nothing when it round trips
+    std::optional<std::string> round_trip(const michaelcc::linear::translation_unit& unit, const michaelcc::linear::translation_unit& loaded) {
+        if (michaelcc::linear::print_linear_ir(loaded) != michaelcc::linear::print_linear_ir(unit)) {
+            return "loaded IR prints differently";
+        }
+        if (michaelcc::linear::serialization::serialize(loaded) != michaelcc::linear::serialization::serialize(unit)) {
+            return "loaded IR encodes differently";
+        }
+        return std::nullopt;
+    }
+
+    std::string assemble(michaelcc::isa::isa& platform, const michaelcc::linear::translation_unit& unit, const michaelcc::linear::allocators::frame_allocator& frame_allocator) {
+        std::ostringstream output;
+        auto assembler = platform.create_assembler(output);
+        assembler->assemble(unit, frame_allocator);
+        return output.str();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "usage: serialize_roundtrip <directory of sample programs>" << std::endl;
+        return 2;
+    }
+
+    michaelcc::isa::lc2200::lc2200_isa platform;
+    auto ir_path = std::filesystem::temp_directory_path() / "michaelcc_serialize_roundtrip.mcir";
+
+    int checked = 0;
+    int allocated_checked = 0;
+    int failed = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(argv[1])) {
+        if (entry.path().extension() != ".c") {
+            continue;
+        }
+
+        // samples the front end rejects have nothing to round trip
+        std::optional<michaelcc::linear::translation_unit> unit;
+        try {
+            unit.emplace(lower_file(entry.path(), platform));
+        }
+        catch (const std::exception&) {
+            continue;
+        }
+
+        michaelcc::linear::serialization::save(*unit, ir_path.string());
+        auto loaded = michaelcc::linear::serialization::load(ir_path.string(), platform.get_platform_info());
+
+        checked++;
+        if (auto failure = round_trip(*unit, loaded)) {
+            std::cerr << entry.path().filename().string() << ": " << failure.value() << std::endl;
+            failed++;
+            continue;
+        }
+
+        // the frame sizes are not part of the format, so the loaded unit is assembled with the original frames,
+        // which are keyed by entry block
+        michaelcc::linear::allocators::frame_allocator frame_allocator(*unit);
+        std::string assembly;
+        try {
+            frame_allocator.allocate();
+            michaelcc::linear::allocators::remove_phi_nodes(*unit);
+            michaelcc::linear::optimization::postphi::register_allocation(*unit, frame_allocator);
+            assembly = assemble(platform, *unit, frame_allocator);
+        }
+        catch (const std::exception&) {
+            // samples the back end rejects only round trip before allocation
+            continue;
+        }
+
+        michaelcc::linear::serialization::save(*unit, ir_path.string());
+        auto allocated = michaelcc::linear::serialization::load(ir_path.string(), platform.get_platform_info());
+
+        allocated_checked++;
+        if (auto failure = round_trip(*unit, allocated)) {
+            std::cerr << entry.path().filename().string() << ": allocated " << failure.value() << std::endl;
+            failed++;
+        }
+        else if (allocated.vreg_colors != unit->vreg_colors) {
+            std::cerr << entry.path().filename().string() << ": loaded register colors differ" << std::endl;
+            failed++;
+        }
+        else if (assemble(platform, allocated, frame_allocator) != assembly) {
+            std::cerr << entry.path().filename().string() << ": loaded IR assembles differently" << std::endl;
+            failed++;
+        }
+    }
+    std::filesystem::remove(ir_path);
+
+    if (checked == 0 || allocated_checked == 0) {
+        std::cerr << "no sample program could be " << (checked == 0 ? "lowered" : "allocated") << std::endl;
+        return 1;
+    }
+    std::cout << checked << " programs round tripped, " << allocated_checked << " of them after register allocation, " << failed << " failed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
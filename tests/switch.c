@@ -0,0 +1,106 @@
+// Test switch statements
+
+enum Color {
+    RED,
+    GREEN,
+    BLUE
+};
+
+// dense cases, lowered to a jump table
+int days_in_month(int month) {
+    switch (month) {
+    case 2:
+        return 28;
+    case 4:
+    case 6:
+    case 9:
+    case 11:
+        return 30;
+    case 1:
+    case 3:
+    case 5:
+    case 7:
+    case 8:
+    case 10:
+    case 12:
+        return 31;
+    default:
+        return 0;
+    }
+}
+
+// sparse cases, lowered to a tree of compares
+int http_class(int status) {
+    int result = 0;
+    switch (status) {
+    case 200:
+        result = 1;
+        break;
+    case 301:
+    case 302:
+        result = 2;
+        break;
+    case 404:
+        result = 3;
+        break;
+    case -1:
+        result = -1;
+        break;
+    case 500:
+        result = 4;
+        break;
+    }
+    return result;
+}
+
+int color_value(enum Color color) {
+    switch (color) {
+    case RED:
+        return 0xFF0000;
+    case GREEN:
+        return 0x00FF00;
+    case BLUE:
+        return 0x0000FF;
+    }
+    return 0;
+}
+
+// falls through and breaks out of an enclosing loop
+int count_down(int start) {
+    int steps = 0;
+    while (1) {
+        switch (start) {
+        case 3:
+            steps = steps + 1;
+        case 2:
+            steps = steps + 1;
+        case 1:
+            steps = steps + 1;
+            break 2;
+        default:
+            start = start - 1;
+            continue;
+        }
+    }
+    return steps;
+}
+
+// unsigned cases past the sign bit are ordered as unsigned
+int unsigned_class(unsigned int value) {
+    switch (value) {
+    case 1:
+        return 1;
+    case 5:
+        return 2;
+    case 9:
+        return 3;
+    case 100:
+        return 4;
+    case 0x80000000:
+        return 5;
+    case 0xFFFFFFFF:
+        return 6;
+    default:
+        return 0;
+    }
+}